@@ -29,6 +29,22 @@ extern "C" {
  */
 int bme68x_sensor_api_init(struct device const *dev, struct bme68x_dev *bme68x_dev);
 
+/**
+ * @brief Recover the bus of a BME68X Sensor API sensor.
+ *
+ * Typically after repeated communication failures:
+ * - I2C: bus clear with i2c_recover_bus(), e.g. when a peripheral holds SDA low
+ * - SPI: not supported
+ *
+ * This does not reset the BME680/688.
+ *
+ * @param bme68x_dev A BME68X Sensor API sensor, bound with bme68x_sensor_api_init().
+ *
+ * @return 0 on success, -ENOSYS if not supported by the bus or its driver,
+ * -ENOTSUP if the sensor isn't bound to a compatible device, negative errno otherwise.
+ */
+int bme68x_sensor_api_recover_bus(struct bme68x_dev const *bme68x_dev);
+
 #ifdef __cplusplus
 }
 #endif
@@ -85,6 +85,18 @@ int bme68x_sensor_api_init(struct device const *dev, struct bme68x_dev *bme68x_d
 	return 0;
 }
 
+/*
+ * Recovers the bus of a BME68X Sensor API sensor.
+ */
+int bme68x_sensor_api_recover_bus(struct bme68x_dev const *bme68x_dev)
+{
+	if (bme68x_dev->read != bme68x_sensor_api_read) {
+		/* Not bound with bme68x_sensor_api_init(). */
+		return -ENOTSUP;
+	}
+	return bme68x_sensor_api_recover(bme68x_dev->intf_ptr);
+}
+
 /*
  * Driver instance initialization.
  *
@@ -140,6 +152,13 @@ int z_impl_bme68x_sensor_api_check(struct device const *dev)
 	return bme68x_drv_bus_check(dev);
 }
 
+int z_impl_bme68x_sensor_api_recover(struct device const *dev)
+{
+	struct bme68x_drv_config const *config = dev->config;
+
+	return config->bus_io->recover(&config->bus);
+}
+
 #ifdef CONFIG_USERSPACE
 #include <zephyr/internal/syscall_handler.h>
 
@@ -165,6 +184,12 @@ int z_vrfy_bme68x_sensor_api_check(struct device const *dev)
 }
 #include <syscalls/bme68x_sensor_api_check_mrsh.c>
 
+int z_vrfy_bme68x_sensor_api_recover(struct device const *dev)
+{
+	return z_impl_bme68x_sensor_api_recover(dev);
+}
+#include <syscalls/bme68x_sensor_api_recover_mrsh.c>
+
 #endif /* CONFIG_USERSPACE */
 
 #define BME68X_DRV_CONFIG_SPI(inst)                                                                \
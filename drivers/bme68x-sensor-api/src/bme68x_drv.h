@@ -44,6 +44,12 @@ union bme68x_drv_bus {
  */
 typedef int (*bme68x_drv_io_check_fn)(union bme68x_drv_bus const *bus);
 
+/*
+ * Recover bus instance, e.g. after a peripheral got stuck in a transaction.
+ * Returns 0 on success, -ENOSYS if not supported, negative errno otherwise.
+ */
+typedef int (*bme68x_drv_io_recover_fn)(union bme68x_drv_bus const *bus);
+
 /*
  * Device driver IO operation for reading BME680/688 registers.
  *
@@ -94,6 +100,7 @@ typedef int (*bme68x_drv_io_write_fn)(struct device const *dev, uint8_t start, u
  */
 struct bme68x_drv_io {
 	bme68x_drv_io_check_fn check;
+	bme68x_drv_io_recover_fn recover;
 	bme68x_drv_io_read_fn read;
 	bme68x_drv_io_write_fn write;
 };
@@ -151,5 +158,14 @@ __syscall BME68X_INTF_RET_TYPE bme68x_sensor_api_write(uint8_t start, uint8_t co
  */
 __syscall int bme68x_sensor_api_check(struct device const *dev);
 
+/*
+ * Private system call for recovering device bus.
+ *
+ * dev: "bosch,bme68x-sensor-api" compatible device.
+ *
+ * Returns 0 on success, -ENOSYS if not supported, negative errno otherwise.
+ */
+__syscall int bme68x_sensor_api_recover(struct device const *dev);
+
 #include "syscalls/bme68x_drv.h"
 #endif /* _BME68X_DRV_H_ */
@@ -24,6 +24,22 @@ static int bme68x_drv_io_check_i2c(union bme68x_drv_bus const *bus)
 	return i2c_is_ready_dt(&bus->i2c) ? 0 : -ENODEV;
 }
 
+/*
+ * Implements bme68x_drv_io_recover_fn.
+ *
+ * I2C bus clear, e.g. when a peripheral holds SDA low.
+ */
+static int bme68x_drv_io_recover_i2c(union bme68x_drv_bus const *bus)
+{
+	int err = i2c_recover_bus(bus->i2c.bus);
+	if (err < 0) {
+		LOG_ERR("I2C-recover: %d", err);
+	} else {
+		LOG_DBG("I2C-recover");
+	}
+	return err;
+}
+
 /*
  * Implements bme68x_drv_io_write_fn.
  */
@@ -77,6 +93,7 @@ static int bme68x_drv_io_read_i2c(struct device const *dev, uint8_t start, uint8
 
 struct bme68x_drv_io const bme68x_drv_io_i2c = {
 	.check = bme68x_drv_io_check_i2c,
+	.recover = bme68x_drv_io_recover_i2c,
 	.read = bme68x_drv_io_read_i2c,
 	.write = bme68x_drv_io_write_i2c,
 };
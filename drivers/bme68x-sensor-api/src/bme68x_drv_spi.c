@@ -24,6 +24,16 @@ static int bme68x_drv_io_check_spi(union bme68x_drv_bus const *bus)
 	return spi_is_ready_dt(&bus->spi) ? 0 : -ENODEV;
 }
 
+/*
+ * Implements bme68x_drv_io_recover_fn.
+ *
+ * SPI has no bus-level recovery.
+ */
+static int bme68x_drv_io_recover_spi(union bme68x_drv_bus const *bus)
+{
+	return -ENOSYS;
+}
+
 /*
  * Implements bme68x_drv_io_write_fn.
  *
@@ -91,6 +101,7 @@ static int bme68x_drv_io_read_spi(struct device const *dev, uint8_t start, uint8
 
 struct bme68x_drv_io const bme68x_drv_io_spi = {
 	.check = bme68x_drv_io_check_spi,
+	.recover = bme68x_drv_io_recover_spi,
 	.read = bme68x_drv_io_read_spi,
 	.write = bme68x_drv_io_write_spi,
 };
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Record header of the compact binary encodings (IAQ samples, TPHG measurements).
+ */
+
+#ifndef BME68X_CODEC_H_
+#define BME68X_CODEC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Encoding format version.
+ *
+ * Encoded records start with a header byte:
+ * - bits 0-3: format version
+ * - bit 4: key frame, the timestamp is absolute (otherwise relative to the previous record)
+ * - bits 5-7: record type (`BME68X_CODEC_TYPE_*`)
+ *
+ * The header is followed by the timestamp in milliseconds (unsigned LEB128 varint),
+ * then by the fixed-size record payload (little-endian scaled integers).
+ *
+ * See scripts/bme68x_decode.py for the host decoder.
+ */
+#define BME68X_CODEC_VERSION 1U
+
+/** Header bit for key frames (absolute timestamps). */
+#define BME68X_CODEC_KEY_FRAME BIT(4)
+
+/** Record type: IAQ sample. */
+#define BME68X_CODEC_TYPE_IAQ  0U
+/** Record type: TPHG measurement. */
+#define BME68X_CODEC_TYPE_TPHG 1U
+
+/** Maximum size in bytes of an encoded timestamp (64-bit LEB128 varint). */
+#define BME68X_CODEC_TS_MAX_SIZE 10U
+
+/** Maximum size in bytes of a record header (header byte and timestamp). */
+#define BME68X_CODEC_HDR_MAX_SIZE (1U + BME68X_CODEC_TS_MAX_SIZE)
+
+/**
+ * @brief Encoder or decoder context.
+ *
+ * Timestamps are delta-encoded: each context tracks the timestamp
+ * of the last record it has encoded or decoded.
+ */
+struct bme68x_codec {
+	/** Timestamp of the last record in milliseconds. */
+	int64_t ts_ms;
+	/** Whether the next record is relative to ts_ms (otherwise a key frame is needed). */
+	bool sync;
+};
+
+/**
+ * @brief Reset encoder or decoder context.
+ *
+ * The next encoded record will be a key frame.
+ *
+ * @param codec The context to reset.
+ */
+void bme68x_codec_reset(struct bme68x_codec *codec);
+
+/**
+ * @brief Encode record header and timestamp.
+ *
+ * A key frame (absolute timestamp) is encoded when the context is not synchronized,
+ * or when the timestamp goes backward, e.g. after a reboot.
+ *
+ * Nothing is written, and the context is left unchanged, unless the buffer
+ * can hold the whole record: the caller then writes exactly `payload_size` bytes
+ * after the header.
+ *
+ * @param codec Encoder context.
+ * @param type Record type.
+ * @param ts_ns Record timestamp in nanoseconds.
+ * @param payload_size Size in bytes of the record payload.
+ * @param buf Destination buffer.
+ * @param size Size of the destination buffer.
+ *
+ * @return Size in bytes of the header on success, -ENOMEM if the buffer is too small.
+ */
+int bme68x_codec_put_header(struct bme68x_codec *codec, uint8_t type, int64_t ts_ns,
+			    size_t payload_size, uint8_t *buf, size_t size);
+
+/**
+ * @brief Decode record header and timestamp.
+ *
+ * The context is left unchanged unless the whole record is available.
+ *
+ * @param codec Decoder context.
+ * @param type Expected record type.
+ * @param payload_size Size in bytes of the record payload.
+ * @param buf Encoded record.
+ * @param len Number of available bytes.
+ * @param ts_ns Output parameter for the record timestamp in nanoseconds.
+ *
+ * @return Size in bytes of the header on success,
+ * -ENOTSUP for an unsupported version or record type,
+ * -EMSGSIZE for a truncated record,
+ * -EAGAIN for a relative timestamp without prior key frame.
+ */
+int bme68x_codec_get_header(struct bme68x_codec *codec, uint8_t type, size_t payload_size,
+			    uint8_t const *buf, size_t len, int64_t *ts_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_CODEC_H_ */
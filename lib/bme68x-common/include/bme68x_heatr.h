@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Heater resistance computation, shared by the IAQ and TPHG libraries.
+ */
+
+#ifndef BME68X_HEATR_H_
+#define BME68X_HEATR_H_
+
+#include <stdint.h>
+
+#include "bme68x_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Heater resistance register value for a target temperature.
+ *
+ * Same computation as the Sensor API's private calc_res_heat(),
+ * fixed-point or floating-point depending on the API variant,
+ * for callers that write the heater registers themselves.
+ *
+ * @param dev Sensor (calibration data and ambient temperature).
+ * @param heatr_temp Heater target temperature in degree Celsius,
+ *                   capped at 400 like the Sensor API does.
+ *
+ * @return The value bme68x_set_heatr_conf() would write to res_heat_0.
+ */
+uint8_t bme68x_res_heat(struct bme68x_dev const *dev, uint16_t heatr_temp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_HEATR_H_ */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Report-on-change rule evaluation, shared by the IAQ and TPHG filters.
+ */
+
+#ifndef BME68X_ROC_H_
+#define BME68X_ROC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @name Changes detected by a report-on-change rule.
+ *
+ * @{
+ */
+/** The value moved beyond the deadband. */
+#define BME68X_ROC_DEADBAND  BIT(0)
+/** The value crossed the threshold (with hysteresis). */
+#define BME68X_ROC_THRESHOLD BIT(1)
+/** @} */
+
+/**
+ * @brief Internal state of a report-on-change rule.
+ */
+struct bme68x_roc_state {
+	/** Last forwarded value. */
+	float value;
+	/** Whether the value is above the threshold. */
+	bool above;
+};
+
+/**
+ * @brief Evaluate a report-on-change rule.
+ *
+ * The threshold state is updated for every value, forwarded or not.
+ * The caller updates the reference value (`state->value`) once it forwards.
+ *
+ * @param state Rule state.
+ * @param value New value.
+ * @param deadband Deadband, zero to disable.
+ * @param threshold_enable Whether threshold crossings are reported.
+ * @param threshold Threshold.
+ * @param hysteresis Hysteresis below the threshold.
+ * @param primed Whether a value was forwarded since initialization or reset,
+ * no change is reported otherwise.
+ *
+ * @return Detected changes (`BME68X_ROC_*`), zero if none.
+ */
+uint32_t bme68x_roc_eval(struct bme68x_roc_state *state, float value, float deadband,
+			 bool threshold_enable, float threshold, float hysteresis, bool primed);
+
+/**
+ * @brief Evaluate a report-on-change rule.
+ *
+ * Shorthand for bme68x_roc_eval() with the rule's deadband, threshold_enable,
+ * threshold and hysteresis fields.
+ *
+ * @param _state Rule state (`struct bme68x_roc_state`).
+ * @param _rule Rule (e.g. `struct bme68x_iaq_roc_rule`).
+ * @param _value New value.
+ * @param _primed Whether a value was forwarded since initialization or reset.
+ */
+#define BME68X_ROC_EVAL(_state, _rule, _value, _primed)                                            \
+	bme68x_roc_eval((_state), (_value), (_rule)->deadband, (_rule)->threshold_enable,          \
+			(_rule)->threshold, (_rule)->hysteresis, (_primed))
+
+/**
+ * @brief Check a report-on-change heartbeat.
+ *
+ * @param heartbeat_ms Heartbeat in milliseconds, zero to disable.
+ * @param last_ts_ns Timestamp of the last forwarded value in nanoseconds.
+ * @param ts_ns Timestamp of the new value in nanoseconds.
+ *
+ * @return Whether the heartbeat expired.
+ */
+static inline bool bme68x_roc_heartbeat(uint32_t heartbeat_ms, int64_t last_ts_ns, int64_t ts_ns)
+{
+	return heartbeat_ms && ((ts_ns - last_ts_ns) >= (int64_t)heartbeat_ms * 1000000);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_ROC_H_ */
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_codec.h"
+
+#include <errno.h>
+
+/* Header byte fields. */
+#define CODEC_HDR_VERSION_MSK 0x0FU
+#define CODEC_HDR_TYPE_POS    5U
+
+/*
+ * Unsigned LEB128 size in bytes of the given value.
+ */
+static size_t codec_leb128_size(uint64_t val);
+
+void bme68x_codec_reset(struct bme68x_codec *codec)
+{
+	codec->ts_ms = 0;
+	codec->sync = false;
+}
+
+int bme68x_codec_put_header(struct bme68x_codec *codec, uint8_t type, int64_t ts_ns,
+			    size_t payload_size, uint8_t *buf, size_t size)
+{
+	int64_t ts_ms = ts_ns / 1000000;
+	uint8_t hdr = BME68X_CODEC_VERSION | (type << CODEC_HDR_TYPE_POS);
+	uint64_t ts_val;
+
+	if (codec->sync && (ts_ms >= codec->ts_ms)) {
+		ts_val = (uint64_t)(ts_ms - codec->ts_ms);
+	} else {
+		hdr |= BME68X_CODEC_KEY_FRAME;
+		ts_val = (uint64_t)ts_ms;
+	}
+
+	size_t len = 1 + codec_leb128_size(ts_val);
+	if ((size < len) || ((size - len) < payload_size)) {
+		return -ENOMEM;
+	}
+
+	uint8_t *p = buf;
+	*p++ = hdr;
+
+	/* Unsigned LEB128: 7 bits per byte, LSB first, MSB set on all bytes but the last. */
+	do {
+		uint8_t byte = ts_val & 0x7FU;
+		ts_val >>= 7;
+		if (ts_val) {
+			byte |= 0x80U;
+		}
+		*p++ = byte;
+	} while (ts_val);
+
+	codec->ts_ms = ts_ms;
+	codec->sync = true;
+	return (int)len;
+}
+
+int bme68x_codec_get_header(struct bme68x_codec *codec, uint8_t type, size_t payload_size,
+			    uint8_t const *buf, size_t len, int64_t *ts_ns)
+{
+	if (len < 1) {
+		return -EMSGSIZE;
+	}
+
+	uint8_t hdr = buf[0];
+	if (((hdr & CODEC_HDR_VERSION_MSK) != BME68X_CODEC_VERSION) ||
+	    ((hdr >> CODEC_HDR_TYPE_POS) != type)) {
+		return -ENOTSUP;
+	}
+
+	uint64_t ts_val = 0;
+	size_t pos = 1;
+	for (unsigned int shift = 0;; shift += 7) {
+		if ((pos >= len) || (shift >= 64)) {
+			return -EMSGSIZE;
+		}
+		uint8_t byte = buf[pos++];
+		ts_val |= (uint64_t)(byte & 0x7FU) << shift;
+		if (!(byte & 0x80U)) {
+			break;
+		}
+	}
+	if ((len - pos) < payload_size) {
+		return -EMSGSIZE;
+	}
+
+	if (hdr & BME68X_CODEC_KEY_FRAME) {
+		codec->ts_ms = (int64_t)ts_val;
+	} else if (codec->sync) {
+		codec->ts_ms += (int64_t)ts_val;
+	} else {
+		return -EAGAIN;
+	}
+	codec->sync = true;
+
+	*ts_ns = codec->ts_ms * 1000000;
+	return (int)pos;
+}
+
+size_t codec_leb128_size(uint64_t val)
+{
+	size_t size = 1;
+
+	while (val >>= 7) {
+		size++;
+	}
+	return size;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_heatr.h"
+
+#include <zephyr/sys/util.h>
+
+#if BME68X_SENSOR_API_FLOAT
+uint8_t bme68x_res_heat(struct bme68x_dev const *dev, uint16_t heatr_temp)
+{
+	float temp = (float)MIN(heatr_temp, 400);
+	float var1 = ((float)dev->calib.par_gh1 / 16.0f) + 49.0f;
+	float var2 = (((float)dev->calib.par_gh2 / 32768.0f) * 0.0005f) + 0.00235f;
+	float var3 = (float)dev->calib.par_gh3 / 1024.0f;
+	float var4 = var1 * (1.0f + (var2 * temp));
+	float var5 = var4 + (var3 * (float)dev->amb_temp);
+
+	return (uint8_t)(3.4f * ((var5 * (4 / (4 + (float)dev->calib.res_heat_range)) *
+				  (1 / (1 + ((float)dev->calib.res_heat_val * 0.002f)))) -
+				 25));
+}
+#else
+uint8_t bme68x_res_heat(struct bme68x_dev const *dev, uint16_t heatr_temp)
+{
+	int32_t temp = MIN(heatr_temp, 400);
+	int32_t var1 = (((int32_t)dev->amb_temp * dev->calib.par_gh3) / 1000) * 256;
+	int32_t var2 = (dev->calib.par_gh1 + 784) *
+		       (((((dev->calib.par_gh2 + 154009) * temp * 5) / 100) + 3276800) / 10);
+	int32_t var3 = var1 + (var2 / 2);
+	int32_t var4 = var3 / (dev->calib.res_heat_range + 4);
+	int32_t var5 = (131 * dev->calib.res_heat_val) + 65536;
+	int32_t res_heat_x100 = ((var4 / var5) - 250) * 34;
+
+	return (uint8_t)((res_heat_x100 + 50) / 100);
+}
+#endif /* BME68X_SENSOR_API_FLOAT */
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_roc.h"
+
+#include <math.h>
+
+uint32_t bme68x_roc_eval(struct bme68x_roc_state *state, float value, float deadband,
+			 bool threshold_enable, float threshold, float hysteresis, bool primed)
+{
+	uint32_t changes = 0;
+
+	if (primed && (deadband > 0.0f) && (fabsf(value - state->value) > deadband)) {
+		changes |= BME68X_ROC_DEADBAND;
+	}
+
+	if (threshold_enable) {
+		bool above = state->above;
+		if (!above && (value >= threshold)) {
+			above = true;
+		} else if (above && (value < (threshold - hysteresis))) {
+			above = false;
+		}
+		if (primed && (above != state->above)) {
+			changes |= BME68X_ROC_THRESHOLD;
+		}
+		state->above = above;
+	}
+
+	return changes;
+}
@@ -10,6 +10,11 @@
 #ifndef BME68X_IAQ_H_
 #define BME68X_IAQ_H_
 
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/iterable_sections.h>
+#include <zephyr/sys/util.h>
+
 #include "bme68x_defs.h"
 
 #ifdef __cplusplus
@@ -36,6 +41,44 @@ enum bme68x_iaq_status {
 	BME68X_IAQ_STAB_FINISHED,
 };
 
+/**
+ * @name IAQ output channels.
+ *
+ * One channel per BSEC output signal supported in IAQ mode,
+ * for building observers channel masks.
+ *
+ * @{
+ */
+/** Raw temperature. */
+#define BME68X_IAQ_CHAN_RAW_TEMPERATURE BIT(0)
+/** Raw pressure. */
+#define BME68X_IAQ_CHAN_RAW_PRESSURE    BIT(1)
+/** Raw relative humidity. */
+#define BME68X_IAQ_CHAN_RAW_HUMIDITY    BIT(2)
+/** Raw gas resistance. */
+#define BME68X_IAQ_CHAN_RAW_GAS         BIT(3)
+/** Heat compensated temperature. */
+#define BME68X_IAQ_CHAN_TEMPERATURE     BIT(4)
+/** Heat compensated relative humidity. */
+#define BME68X_IAQ_CHAN_HUMIDITY        BIT(5)
+/** IAQ estimate. */
+#define BME68X_IAQ_CHAN_IAQ             BIT(6)
+/** Unscaled IAQ. */
+#define BME68X_IAQ_CHAN_STATIC_IAQ      BIT(7)
+/** CO2 equivalent. */
+#define BME68X_IAQ_CHAN_CO2             BIT(8)
+/** VOC equivalent. */
+#define BME68X_IAQ_CHAN_VOC             BIT(9)
+/** Gas percentage. */
+#define BME68X_IAQ_CHAN_GAS_PERCENTAGE  BIT(10)
+/** Stabilization status. */
+#define BME68X_IAQ_CHAN_STAB_STATUS     BIT(11)
+/** Run-in status. */
+#define BME68X_IAQ_CHAN_RUN_STATUS      BIT(12)
+/** All channels. */
+#define BME68X_IAQ_CHAN_ALL             BIT_MASK(13)
+/** @} */
+
 /**
  * @brief IAQ output signals produced by the BSEC algorithm.
  */
@@ -44,6 +87,8 @@ struct bme68x_iaq_sample {
 	int64_t ts_ns;
 	/** Number of BSEC output signals updated during the last algorithm iteration. */
 	uint8_t cnt_outputs;
+	/** Output channels updated during the last algorithm iteration (`BME68X_IAQ_CHAN_*`). */
+	uint32_t channels;
 	/** Temperature directly measured by BME68x in degree Celsius. */
 	float raw_temperature;
 	/** Pressure directly measured by the BME68x in Pa. */
@@ -102,30 +147,245 @@ struct bme68x_iaq_sample {
  */
 typedef void (*bme68x_iaq_output_cb)(struct bme68x_iaq_sample const *iaq_sample);
 
+/**
+ * @brief IAQ output observer.
+ *
+ * Observers are registered at build time with BME68X_IAQ_OBSERVER_DEFINE(),
+ * the IAQ control loop fans out each IAQ sample to all observers
+ * interested in at least one of the updated channels.
+ *
+ * Each observer consumes the IAQ samples at its own rate:
+ * with a decimation factor of N, the handler receives the first sample
+ * and then one out of N samples.
+ */
+struct bme68x_iaq_observer {
+	/** Synchronous handler. */
+	bme68x_iaq_output_cb handler;
+	/** Channels of interest (`BME68X_IAQ_CHAN_*`). */
+	uint32_t channels;
+	/** Decimation factor (at least 1). */
+	uint32_t decimation;
+	/** Internal: number of samples observed since the last notification. */
+	uint32_t cnt;
+};
+
+/**
+ * @brief Define an IAQ output observer.
+ *
+ * For example, with the LP sample rate (3 s), a display refreshed with each sample
+ * and a 5 minutes uplink for the IAQ estimate only:
+ *
+ * @code{.c}
+ * BME68X_IAQ_OBSERVER_DEFINE(display, display_handler, 1, BME68X_IAQ_CHAN_ALL);
+ * BME68X_IAQ_OBSERVER_DEFINE(uplink, uplink_handler, 100, BME68X_IAQ_CHAN_IAQ);
+ * @endcode
+ *
+ * @param _name Observer name.
+ * @param _handler Synchronous handler (bme68x_iaq_output_cb).
+ * @param _decimation Decimation factor, 1 to receive all samples.
+ * @param _channels Channels of interest (`BME68X_IAQ_CHAN_*`).
+ */
+#define BME68X_IAQ_OBSERVER_DEFINE(_name, _handler, _decimation, _channels)                        \
+	BUILD_ASSERT((_decimation) > 0, "decimation factor must be at least 1");                   \
+	STRUCT_SECTION_ITERABLE(bme68x_iaq_observer, _name) = {                                    \
+		.handler = (_handler),                                                             \
+		.channels = (_channels),                                                           \
+		.decimation = (_decimation),                                                       \
+		.cnt = 0,                                                                          \
+	}
+
 /**
  * @brief Initialize and configure the BSEC algorithm.
  *
  * - initialize BSEC library
- * - load the selected IAQ configuration (Kconfig)
+ * - load the IAQ configuration (Kconfig) for the sensor variant (BME680 or BME688)
  * - if BSEC state persistence is enabled (Kconfig),
  *   initialize NVS file-system and load saved BSEC state
+ *   (see bme68x_iaq_state_info_get())
  * - subscribe to all virtual sensors supported in IAQ mode
  *
- * @return 0 on success.
+ * A saved state that the BSEC library rejects, or that was saved
+ * by another BSEC version or configuration, does not prevent startup:
+ * the BSEC calibration then starts from scratch.
+ *
+ * @param dev The sensor to control, initialized with bme68x_init().
+ *
+ * @return 0 on success, -ENOTSUP if no configuration is embedded for the sensor variant.
  */
-int bme68x_iaq_init(void);
+int bme68x_iaq_init(struct bme68x_dev const *dev);
 
 /**
  * @brief Run BSEC algorithm control loop.
  *
  * Put BME68X sensor under control of the BSEC algorithm to produce IAQ estimates.
  *
- * This function won't return unless a fatal error occurs.
+ * IAQ samples are fanned out to the observers defined with BME68X_IAQ_OBSERVER_DEFINE(),
+ * from the calling thread, or from the processing thread with `CONFIG_BME68X_IAQ_SPLIT`.
+ *
+ * Sensor I/O errors are recovered without reinitializing the BSEC algorithm
+ * (see struct bme68x_iaq_recovery_stats), the measurement is skipped otherwise.
+ *
+ * This function won't return unless a BSEC error occurs,
+ * `CONFIG_BME68X_IAQ_RECOVERY_MAX_FAULTS` consecutive sensor faults aren't recovered,
+ * or bme68x_iaq_stop() is called.
  *
  * @param dev The controlled BME68X sensor.
- * @param iaq_output_handler Synchronous callback that will consume the produced IAQ outputs.
  */
-void bme68x_iaq_run(struct bme68x_dev *dev, bme68x_iaq_output_cb iaq_output_handler);
+void bme68x_iaq_run(struct bme68x_dev *dev);
+
+/**
+ * @brief Stop BSEC algorithm control loop.
+ *
+ * bme68x_iaq_run() returns without waiting for the next BSEC rendez-vous,
+ * after saving the BSEC state if periodic persistence is enabled.
+ *
+ * A stop request is cleared by bme68x_iaq_init().
+ */
+void bme68x_iaq_stop(void);
+
+/**
+ * @brief Request an on-demand measurement (ULP plus).
+ *
+ * With the ULP sample rate (one sample per 300 s), request an extra measurement
+ * and wake up the IAQ control loop: the observers receive a fresh IAQ sample
+ * within seconds, instead of at the next ULP rendez-vous.
+ *
+ * May be called from any thread or ISR, e.g. a button callback.
+ *
+ * BSEC may decline the request, e.g. when an ULP measurement just took or will
+ * take place, or too soon after the previous on-demand measurement:
+ * the next IAQ sample then comes with the regular ULP schedule.
+ *
+ * @return 0 on success, -ENOTSUP with the LP sample rate,
+ * -EAGAIN if the IAQ control loop is not running.
+ */
+int bme68x_iaq_request_measurement(void);
+
+/**
+ * @brief Start the library-managed IAQ thread.
+ *
+ * Bind the BME68X Sensor API sensor to the device, initialize it
+ * and the BSEC algorithm (see bme68x_iaq_init()), then run the BSEC control loop
+ * in the IAQ thread (`CONFIG_BME68X_IAQ_THREAD`).
+ *
+ * Initialization runs in the IAQ thread, on its stack, and the caller waits
+ * for its completion: the caller's stack doesn't need to fit the BSEC working buffers.
+ *
+ * The thread's stack size, priority and CPU affinity (SMP) are set with Kconfig.
+ *
+ * @param dev The BME68X Sensor API device ("bosch,bme68x-sensor-api" bindings).
+ *
+ * @return 0 on success, -EALREADY if already running,
+ * negative errno, BSEC or BME68X Sensor API status otherwise.
+ */
+int bme68x_iaq_thread_start(struct device const *dev);
+
+/**
+ * @brief Stop the library-managed IAQ thread.
+ *
+ * The IAQ thread is idle once stopped, and may be started again.
+ *
+ * @param timeout How long to wait for the control loop to return.
+ *
+ * @return 0 on success, -EALREADY if not running, -EAGAIN on timeout.
+ */
+int bme68x_iaq_thread_stop(k_timeout_t timeout);
+
+/**
+ * @brief Get a snapshot of the most recent IAQ sample.
+ *
+ * The IAQ control loop publishes each new sample before notifying observers.
+ *
+ * This is lock-free and never blocks the IAQ control loop: any thread,
+ * or deferred interrupt context (work queue), may poll the current IAQ sample
+ * at its own rate, and will always get a consistent copy.
+ *
+ * @param iaq_sample Output parameter for the latest IAQ sample.
+ *
+ * @return 0 on success, -ENODATA if no IAQ sample has been produced yet.
+ */
+int bme68x_iaq_latest_get(struct bme68x_iaq_sample *iaq_sample);
+
+/** BSEC state loaded on startup. */
+enum bme68x_iaq_state_outcome {
+	/** No state loaded, the BSEC calibration starts from scratch. */
+	BME68X_IAQ_STATE_NONE = 0,
+	/** Saved state loaded, same BSEC version and configuration. */
+	BME68X_IAQ_STATE_LOADED,
+	/** Untagged saved state, or from another BSEC bugfix version, accepted by BSEC. */
+	BME68X_IAQ_STATE_MIGRATED,
+	/** Fallback state loaded, the BSEC version or configuration was rolled back. */
+	BME68X_IAQ_STATE_FALLBACK,
+	/** Provisioned baseline state loaded. */
+	BME68X_IAQ_STATE_BASELINE,
+};
+
+/**
+ * @brief BSEC state migration on startup.
+ *
+ * Saved states are tagged with the BSEC version and configuration that produced them:
+ * - same version and configuration: loaded
+ * - untagged, or other BSEC bugfix version with the same configuration:
+ *   loaded if accepted by BSEC (migrated), otherwise discarded
+ * - other BSEC major or minor version, or other configuration:
+ *   kept as fallback (`BME68X_IAQ_NVS_FALLBACK_SLOT`), not loaded
+ *
+ * A fallback state that matches the running BSEC version and configuration
+ * (e.g. after a rollback) is loaded when no other saved state is loaded.
+ */
+struct bme68x_iaq_state_info {
+	/** BSEC state loaded on startup. */
+	enum bme68x_iaq_state_outcome outcome;
+	/** Whether an incompatible saved state was kept as fallback on startup. */
+	bool kept;
+	/** Whether a saved state rejected by BSEC was discarded on startup. */
+	bool discarded;
+	/** Number of saved states discarded so far, persisted with the saved state. */
+	uint32_t discards;
+};
+
+/**
+ * @brief Get the outcome of the BSEC state load on startup.
+ *
+ * @param info Output parameter, valid once bme68x_iaq_init() has returned.
+ */
+void bme68x_iaq_state_info_get(struct bme68x_iaq_state_info *info);
+
+/**
+ * @brief Sensor fault recovery statistics of the IAQ control loop.
+ *
+ * On a sensor I/O error, the control loop escalates until the transaction succeeds:
+ * 1. retry the failed transaction
+ * 2. soft reset the sensor, keeping its calibration data
+ * 3. recover the bus (I2C), then soft reset the sensor
+ *
+ * The BSEC instance, its state, and its rendez-vous schedule are preserved:
+ * the recovery stops early rather than miss the next BSEC rendez-vous,
+ * and the measurement is then skipped.
+ */
+struct bme68x_iaq_recovery_stats {
+	/** Number of sensor I/O faults. */
+	uint32_t faults;
+	/** Number of faults recovered by retrying the transaction. */
+	uint32_t retries;
+	/** Number of faults recovered by a sensor soft reset. */
+	uint32_t resets;
+	/** Number of faults recovered by a bus recovery and sensor soft reset. */
+	uint32_t bus_recoveries;
+	/** Number of faults not recovered, measurement skipped. */
+	uint32_t failures;
+	/** Duration of the last recovery in microseconds. */
+	uint32_t last_us;
+	/** Worst-case recovery duration in microseconds. */
+	uint32_t max_us;
+};
+
+/**
+ * @brief Get the sensor fault recovery statistics.
+ *
+ * @param stats Output parameter, cumulative since startup.
+ */
+void bme68x_iaq_recovery_stats_get(struct bme68x_iaq_recovery_stats *stats);
 
 #ifdef __cplusplus
 }
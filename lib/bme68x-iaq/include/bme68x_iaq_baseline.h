@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Provisioned baseline BSEC state:
+ * - BSEC state exported from a calibrated reference unit
+ * - provisioned in a dedicated read-only flash partition
+ * - loaded when no device-specific state is available
+ */
+
+#ifndef BME68X_IAQ_BASELINE_H_
+#define BME68X_IAQ_BASELINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/toolchain.h>
+
+#include "bsec_datatypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Devicetree label of the Flash partition dedicated to the baseline state.
+ */
+#define BME68X_IAQ_BASELINE_PARTITION_LABEL bsec_baseline_partition
+
+/** @brief Header magic ("BSBL", little-endian). */
+#define BME68X_IAQ_BASELINE_MAGIC 0x4C425342U
+
+/** @brief Header format version. */
+#define BME68X_IAQ_BASELINE_HDR_VERSION 1U
+
+/**
+ * @brief Baseline image header, at the start of the partition.
+ *
+ * All fields are little-endian, the BSEC state immediately follows
+ * the header (32 bytes).
+ *
+ * See scripts/bsec_baseline_image.py to extract the image from an exported hexdump.
+ */
+struct bme68x_iaq_baseline_hdr {
+	/** Header magic, `BME68X_IAQ_BASELINE_MAGIC`. */
+	uint32_t magic;
+	/** Header format version, `BME68X_IAQ_BASELINE_HDR_VERSION`. */
+	uint8_t hdr_version;
+	/** BSEC version of the reference unit: major, minor, major bugfix, minor bugfix. */
+	uint8_t bsec_version[4];
+	/** Reserved, zero. */
+	uint8_t reserved[3];
+	/** CRC-32 (IEEE) of the reference unit's BSEC configuration. */
+	uint32_t config_crc;
+	/** Size of the BSEC state in bytes. */
+	uint32_t size;
+	/** CRC-32 (IEEE) of the BSEC state. */
+	uint32_t crc;
+	/** Reserved, zero. */
+	uint32_t reserved2[2];
+} __packed;
+
+/** @brief Maximum size in bytes of a baseline image (header and state). */
+#define BME68X_IAQ_BASELINE_IMAGE_MAX_SIZE                                                         \
+	(sizeof(struct bme68x_iaq_baseline_hdr) + BSEC_MAX_STATE_BLOB_SIZE)
+
+/**
+ * @brief Export the current BSEC state as a baseline image.
+ *
+ * Typically called on a calibrated reference unit (IAQ accuracy high),
+ * the image is then provisioned at the start of the baseline partition
+ * of new devices with the same BSEC version and configuration.
+ *
+ * NOTE: The calling thread's stack must accommodate the BSEC working buffers.
+ *
+ * @param image Destination buffer, at least `BME68X_IAQ_BASELINE_IMAGE_MAX_SIZE` bytes.
+ * @param size Size of the destination buffer in bytes.
+ * @param len Output parameter for the image size in bytes.
+ *
+ * @return 0 on success, -ENOMEM if the buffer is too small, BSEC status otherwise.
+ */
+int bme68x_iaq_baseline_export(uint8_t *image, size_t size, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_IAQ_BASELINE_H_ */
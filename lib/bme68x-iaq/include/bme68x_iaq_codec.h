@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Compact binary encoding of IAQ samples.
+ */
+
+#ifndef BME68X_IAQ_CODEC_H_
+#define BME68X_IAQ_CODEC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bme68x_codec.h"
+#include "bme68x_iaq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Size in bytes of the IAQ record payload.
+ *
+ * | Field                 | Encoding                                |
+ * |-----------------------|-----------------------------------------|
+ * | channels              | uint16, `BME68X_IAQ_CHAN_*`             |
+ * | raw_temperature       | int16, 1/100 degC                       |
+ * | raw_pressure          | uint24, Pa                              |
+ * | raw_humidity          | uint16, 1/100 %                         |
+ * | raw_gas_res           | uint32, Ohm                             |
+ * | temperature           | int16, 1/100 degC                       |
+ * | humidity              | uint16, 1/100 %                         |
+ * | iaq                   | uint16                                  |
+ * | static_iaq            | uint16                                  |
+ * | co2_equivalent        | uint16, ppm                             |
+ * | voc_equivalent        | uint16, 1/100 ppm                       |
+ * | gas_percentage        | uint8, %                                |
+ * | accuracies and status | bits 0-1: IAQ accuracy                  |
+ * |                       | bits 2-3: CO2 accuracy                  |
+ * |                       | bits 4-5: VOC accuracy                  |
+ * |                       | bit 6: stabilization, bit 7: run-in     |
+ *
+ * Values out of range are saturated.
+ */
+#define BME68X_IAQ_CODEC_PAYLOAD_SIZE 27U
+
+/** Maximum size in bytes of an encoded IAQ sample. */
+#define BME68X_IAQ_CODEC_MAX_SIZE (BME68X_CODEC_HDR_MAX_SIZE + BME68X_IAQ_CODEC_PAYLOAD_SIZE)
+
+/**
+ * @brief Encoder or decoder context.
+ */
+struct bme68x_iaq_codec {
+	/** Record header context (delta-encoded timestamps). */
+	struct bme68x_codec ctx;
+};
+
+/**
+ * @brief Reset encoder or decoder context.
+ *
+ * The next encoded record will be a key frame.
+ *
+ * @param codec The context to reset.
+ */
+void bme68x_iaq_codec_reset(struct bme68x_iaq_codec *codec);
+
+/**
+ * @brief Encode IAQ sample.
+ *
+ * @param codec Encoder context.
+ * @param iaq_sample The IAQ sample to encode.
+ * @param buf Destination buffer, `BME68X_IAQ_CODEC_MAX_SIZE` bytes is always enough.
+ * @param size Size of the destination buffer.
+ *
+ * @return Number of encoded bytes on success, -ENOMEM if the buffer is too small
+ * (nothing is encoded, the context is left unchanged).
+ */
+int bme68x_iaq_encode(struct bme68x_iaq_codec *codec, struct bme68x_iaq_sample const *iaq_sample,
+		      uint8_t *buf, size_t size);
+
+/**
+ * @brief Decode IAQ sample.
+ *
+ * Fields not transmitted with the compact encoding
+ * (e.g. the number of BSEC outputs) are derived from the output channels.
+ *
+ * @param codec Decoder context.
+ * @param buf Encoded record.
+ * @param len Number of available bytes.
+ * @param iaq_sample Output parameter for the decoded IAQ sample.
+ *
+ * @return Number of consumed bytes on success,
+ * -ENOTSUP for an unsupported version or record type,
+ * -EMSGSIZE for a truncated record,
+ * -EAGAIN for a relative timestamp without prior key frame.
+ */
+int bme68x_iaq_decode(struct bme68x_iaq_codec *codec, uint8_t const *buf, size_t len,
+		      struct bme68x_iaq_sample *iaq_sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_IAQ_CODEC_H_ */
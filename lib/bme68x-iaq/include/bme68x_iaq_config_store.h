@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * External BSEC configuration store:
+ * - BSEC configuration blob in a dedicated flash partition, with a header
+ * - loaded in place from memory-mapped flash (XIP), or copied to RAM
+ * - the built-in configuration is used when the store is empty or invalid
+ */
+
+#ifndef BME68X_IAQ_CONFIG_STORE_H_
+#define BME68X_IAQ_CONFIG_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/toolchain.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Devicetree label of the Flash partition dedicated to the configuration store.
+ */
+#define BME68X_IAQ_CONFIG_STORE_PARTITION_LABEL bsec_config_partition
+
+/** @brief Header magic ("BSCF", little-endian). */
+#define BME68X_IAQ_CONFIG_STORE_MAGIC 0x46435342U
+
+/** @brief Header format version. */
+#define BME68X_IAQ_CONFIG_STORE_HDR_VERSION 1U
+
+/** @brief Header variant for configurations that apply to any sensor variant. */
+#define BME68X_IAQ_CONFIG_STORE_ANY_VARIANT 0xFFU
+
+/** @brief Maximum length of the configuration name, including the terminating NUL. */
+#define BME68X_IAQ_CONFIG_STORE_NAME_SIZE 32U
+
+/**
+ * @brief Configuration store header, at the start of the partition.
+ *
+ * All fields are little-endian, the BSEC configuration blob
+ * immediately follows the header (64 bytes).
+ *
+ * See scripts/bsec_config_image.py to build the partition image.
+ */
+struct bme68x_iaq_config_store_hdr {
+	/** Header magic, `BME68X_IAQ_CONFIG_STORE_MAGIC`. */
+	uint32_t magic;
+	/** Header format version, `BME68X_IAQ_CONFIG_STORE_HDR_VERSION`. */
+	uint8_t hdr_version;
+	/**
+	 * Sensor variant (`BME68X_VARIANT_GAS_LOW` or `BME68X_VARIANT_GAS_HIGH`),
+	 * or `BME68X_IAQ_CONFIG_STORE_ANY_VARIANT`.
+	 */
+	uint8_t variant;
+	/** Reserved, zero. */
+	uint16_t reserved;
+	/** Configuration name, NUL terminated, e.g. "bme680_iaq_33v_3s_28d". */
+	char name[BME68X_IAQ_CONFIG_STORE_NAME_SIZE];
+	/** Configuration version, chosen by the publisher. */
+	uint32_t version;
+	/** Size of the BSEC configuration blob in bytes. */
+	uint32_t size;
+	/** CRC-32 (IEEE) of the BSEC configuration blob. */
+	uint32_t crc;
+	/** Reserved, zero. */
+	uint32_t reserved2[3];
+} __packed;
+
+/**
+ * @brief Load the BSEC configuration from the store.
+ *
+ * The header and the configuration's CRC are checked on each call:
+ * the returned configuration points either directly to the memory-mapped
+ * flash (`BME68X_IAQ_CONFIG_STORE_XIP`), or to a static RAM copy that is
+ * valid until the next call.
+ *
+ * @param variant_id Sensor variant the configuration is intended for.
+ * @param config Output parameter for the BSEC configuration blob.
+ * @param size Output parameter for the blob size in bytes.
+ * @param hdr Output parameter for the store header, may be NULL.
+ *
+ * @return 0 on success, -ENOENT if the store is empty, -ENOTSUP if the configuration
+ * targets another variant, -EINVAL on invalid header, -EBADMSG on CRC error,
+ * negative errno otherwise.
+ */
+int bme68x_iaq_config_store_load(uint32_t variant_id, uint8_t const **config, size_t *size,
+				 struct bme68x_iaq_config_store_hdr *hdr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_IAQ_CONFIG_STORE_H_ */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Emergency BSEC state flush:
+ * - the IAQ control loop keeps a RAM snapshot of the BSEC state
+ * - on power-fail or shutdown, the snapshot is written to a pre-erased partition
+ * - on next boot, the flushed state replaces the saved state (NVS)
+ */
+
+#ifndef BME68X_IAQ_FLUSH_H_
+#define BME68X_IAQ_FLUSH_H_
+
+#include <stdint.h>
+
+#include <zephyr/toolchain.h>
+
+#include "bme68x_iaq_nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Devicetree label of the Flash partition dedicated to emergency flushes.
+ */
+#define BME68X_IAQ_FLUSH_PARTITION_LABEL bsec_flush_partition
+
+/** @brief Record magic ("BSFL", little-endian). */
+#define BME68X_IAQ_FLUSH_MAGIC 0x4C465342U
+
+/**
+ * @brief Flush record header.
+ *
+ * Records are appended to the partition, the BSEC state immediately
+ * follows the header (32 bytes), padded to the flash write block size.
+ * The last valid record is the most recent flush.
+ */
+struct bme68x_iaq_flush_hdr {
+	/** Record magic, `BME68X_IAQ_FLUSH_MAGIC`. */
+	uint32_t magic;
+	/** Size of the BSEC state in bytes. */
+	uint32_t size;
+	/** CRC-32 (IEEE) of the state tag and BSEC state. */
+	uint32_t crc;
+	/** Reserved, zero. */
+	uint32_t reserved;
+	/** State tag. */
+	struct bme68x_iaq_nvs_meta meta;
+} __packed;
+
+/**
+ * @brief Write the latest BSEC state snapshot to the flush partition.
+ *
+ * Intended for power-fail (e.g. comparator) handlers and shutdown paths
+ * (e.g. before sys_reboot()): a single write of less than 256 bytes
+ * to pre-erased flash, no erase, no garbage collection, no heap,
+ * typically completes within a few milliseconds.
+ *
+ * The snapshot is at most `CONFIG_BME68X_IAQ_FLUSH_SNAPSHOT_DECIM`
+ * BSEC iterations old. Each call appends a record, the partition is
+ * erased once the flushed state has been reconciled on next boot.
+ *
+ * NOTE: The flash driver must support writes from the calling context,
+ * e.g. interrupt context requires a driver that doesn't block
+ * (for nRF SoCs, CONFIG_SOC_FLASH_NRF_RADIO_SYNC_NONE).
+ *
+ * @return 0 on success, -ENODATA if no snapshot yet, -ENOSPC if the partition is full,
+ * -EBUSY if a flush is in progress, -ENODEV if the partition is unavailable,
+ * negative errno otherwise.
+ */
+int bme68x_iaq_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_IAQ_FLUSH_H_ */
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Flash-backed time-series journal of IAQ samples, with incremental aggregation.
+ */
+
+#ifndef BME68X_IAQ_JOURNAL_H_
+#define BME68X_IAQ_JOURNAL_H_
+
+#include <stdint.h>
+
+#include <zephyr/sys/util.h>
+
+#include "bme68x_iaq.h"
+
+/**
+ * @brief Whether the IAQ journal is supported.
+ */
+#if defined(CONFIG_BME68X_IAQ_JOURNAL)
+#define BME68X_IAQ_JOURNAL_ENABLED 1
+#else
+#define BME68X_IAQ_JOURNAL_ENABLED 0
+#endif
+
+/**
+ * @brief Devicetree label of the Flash partition dedicated to the journal (FCB).
+ */
+#define BME68X_IAQ_JOURNAL_PARTITION_LABEL bme68x_journal_partition
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Aggregation levels. */
+enum bme68x_iaq_journal_level {
+	/** One aggregate per minute. */
+	BME68X_IAQ_JOURNAL_MINUTE = 0,
+	/** One aggregate per hour. */
+	BME68X_IAQ_JOURNAL_HOUR,
+	/** One aggregate per day. */
+	BME68X_IAQ_JOURNAL_DAY,
+	/** Number of aggregation levels. */
+	BME68X_IAQ_JOURNAL_LEVEL_COUNT,
+};
+
+/**
+ * @brief Aggregated fields.
+ *
+ * Aggregates are computed with scaled integers,
+ * same units as the compact encoding (see bme68x_iaq_codec.h).
+ */
+enum bme68x_iaq_journal_field {
+	/** Heat compensated temperature in 1/100 degC. */
+	BME68X_IAQ_JOURNAL_TEMPERATURE = 0,
+	/** Heat compensated relative humidity in 1/100 %. */
+	BME68X_IAQ_JOURNAL_HUMIDITY,
+	/** Pressure in Pa. */
+	BME68X_IAQ_JOURNAL_PRESSURE,
+	/** Gas resistance in Ohm. */
+	BME68X_IAQ_JOURNAL_GAS_RES,
+	/** IAQ estimate. */
+	BME68X_IAQ_JOURNAL_IAQ,
+	/** CO2 equivalent in ppm. */
+	BME68X_IAQ_JOURNAL_CO2,
+	/** VOC equivalent in 1/100 ppm. */
+	BME68X_IAQ_JOURNAL_VOC,
+	/** Number of aggregated fields. */
+	BME68X_IAQ_JOURNAL_FIELD_COUNT,
+};
+
+/** Journal entry kinds. */
+enum bme68x_iaq_journal_kind {
+	/** IAQ sample. */
+	BME68X_IAQ_JOURNAL_KIND_SAMPLE = 0,
+	/** Minute aggregate. */
+	BME68X_IAQ_JOURNAL_KIND_MINUTE,
+	/** Hour aggregate. */
+	BME68X_IAQ_JOURNAL_KIND_HOUR,
+	/** Day aggregate. */
+	BME68X_IAQ_JOURNAL_KIND_DAY,
+};
+
+/** Mask for walking all journal entry kinds. */
+#define BME68X_IAQ_JOURNAL_KIND_ALL BIT_MASK(4)
+
+/**
+ * @brief Rollup of an aggregated field.
+ */
+struct bme68x_iaq_rollup {
+	/** Minimum value. */
+	int32_t min;
+	/** Maximum value. */
+	int32_t max;
+	/** Mean value. */
+	int32_t mean;
+	/** Number of aggregated values, zero if the field was not available. */
+	uint32_t count;
+};
+
+/**
+ * @brief Aggregate of IAQ samples over a time interval.
+ */
+struct bme68x_iaq_aggregate {
+	/** Start of the aggregation interval in ms (journal time). */
+	int64_t start_ms;
+	/** Rollups, indexed by `enum bme68x_iaq_journal_field`. */
+	struct bme68x_iaq_rollup fields[BME68X_IAQ_JOURNAL_FIELD_COUNT];
+};
+
+/**
+ * @brief Journal entry.
+ */
+struct bme68x_iaq_journal_entry {
+	/** Entry kind. */
+	enum bme68x_iaq_journal_kind kind;
+	union {
+		/** IAQ sample (`BME68X_IAQ_JOURNAL_KIND_SAMPLE`), timestamp in journal time. */
+		struct bme68x_iaq_sample sample;
+		/** Aggregate (other kinds). */
+		struct bme68x_iaq_aggregate aggregate;
+	};
+};
+
+/**
+ * @brief Callback for walking journal entries.
+ *
+ * @param entry The journal entry, invalid once the callback has returned.
+ * @param user_data User data passed to bme68x_iaq_journal_walk().
+ *
+ * @return Zero to continue, non-zero to stop walking.
+ */
+typedef int (*bme68x_iaq_journal_walk_cb)(struct bme68x_iaq_journal_entry const *entry,
+					  void *user_data);
+
+/**
+ * @brief Initialize the journal.
+ *
+ * Mounts the FCBs (one per entry kind) on the dedicated Flash partition,
+ * and restores the aggregation state: the aggregates cached in RAM,
+ * and the intervals still open at reset, from the journaled entries.
+ * Until initialized, the journal ignores IAQ samples.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int bme68x_iaq_journal_init(void);
+
+/**
+ * @brief Set the journal time base.
+ *
+ * Journal time is the IAQ sample timestamp (uptime) plus this offset,
+ * e.g. the UNIX time of boot once known (RTC, SNTP), so that entries written
+ * before and after a reboot remain ordered.
+ *
+ * Aggregates that are still open are closed first.
+ *
+ * @param offset_ms Offset in milliseconds added to IAQ sample timestamps.
+ */
+void bme68x_iaq_journal_set_time_offset(int64_t offset_ms);
+
+/**
+ * @brief Aggregate IAQ samples over a time range.
+ *
+ * The answer is computed from the aggregates of the requested level,
+ * never from raw samples: recent aggregates are cached in RAM
+ * (see Kconfig), older aggregates are read from the journal.
+ *
+ * For example, the last 24 hours from hour aggregates:
+ *
+ * @code{.c}
+ * struct bme68x_iaq_aggregate day;
+ * int64_t now_ms = bme68x_iaq_journal_now_ms();
+ *
+ * bme68x_iaq_journal_query(BME68X_IAQ_JOURNAL_HOUR, now_ms - 24 * 3600 * 1000, now_ms, &day);
+ * @endcode
+ *
+ * @param level Aggregation level, defines the time resolution.
+ * @param from_ms Start of the time range (journal time).
+ * @param to_ms End of the time range, excluded (journal time).
+ * @param result Output parameter for the aggregate over the time range,
+ * its start time is the start of the first contributing interval.
+ *
+ * @return 0 on success, -ENODATA if no aggregate is available for this range,
+ * -EINVAL for an invalid level, negative errno otherwise.
+ */
+int bme68x_iaq_journal_query(enum bme68x_iaq_journal_level level, int64_t from_ms,
+			     int64_t to_ms, struct bme68x_iaq_aggregate *result);
+
+/**
+ * @brief Walk journal entries, oldest first for each entry kind.
+ *
+ * Entry kinds are walked in turn: raw samples, then minute, hour and day aggregates.
+ *
+ * Typically for bulk reads of the history, e.g. after connectivity gaps.
+ *
+ * @param kinds Entry kinds to walk (bit mask of `BIT(BME68X_IAQ_JOURNAL_KIND_*)`).
+ * @param from_ms Skip entries older than this (journal time).
+ * @param cb Callback invoked for each entry.
+ * @param user_data User data passed to the callback.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int bme68x_iaq_journal_walk(uint32_t kinds, int64_t from_ms, bme68x_iaq_journal_walk_cb cb,
+			    void *user_data);
+
+/**
+ * @brief Current journal time.
+ *
+ * @return System uptime plus journal time offset, in milliseconds.
+ */
+int64_t bme68x_iaq_journal_now_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_IAQ_JOURNAL_H_ */
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Multi-sensor IAQ engine:
+ * - one BSEC instance per sensor (BSEC multi-instance interface)
+ * - BSEC instances distributed across worker threads, one per CPU on SMP
+ * - bus I/O serialized per bus, algorithm iterations run in parallel
+ */
+
+#ifndef BME68X_IAQ_MULTI_H_
+#define BME68X_IAQ_MULTI_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
+
+#include "bme68x_defs.h"
+#include "bme68x_iaq.h"
+#include "bsec_datatypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Communication bus shared by BME68X sensors.
+ *
+ * Sensor I/O sequences (trigger, data read) on the same bus are serialized,
+ * sensors on different buses are accessed concurrently.
+ *
+ * Define with BME68X_IAQ_MULTI_BUS_DEFINE().
+ */
+struct bme68x_iaq_multi_bus {
+	/** Internal: serializes the bus I/O sequences. */
+	struct k_mutex *lock;
+};
+
+/**
+ * @brief Define a communication bus shared by BME68X sensors.
+ *
+ * The bus lock is statically initialized: sensors on the same bus
+ * don't initialize it again, and it's never re-initialized while held.
+ *
+ * @param _name Bus name.
+ */
+#define BME68X_IAQ_MULTI_BUS_DEFINE(_name)                                                         \
+	static K_MUTEX_DEFINE(_name##_lock);                                                       \
+	static struct bme68x_iaq_multi_bus _name = {                                               \
+		.lock = &_name##_lock,                                                             \
+	}
+
+struct bme68x_iaq_multi_sensor;
+
+/**
+ * @brief Synchronous callback for the IAQ samples of a sensor.
+ *
+ * Invoked from the sensor's worker thread: with several workers,
+ * callbacks for different sensors may run concurrently.
+ */
+typedef void (*bme68x_iaq_multi_cb)(struct bme68x_iaq_multi_sensor const *sensor,
+				    struct bme68x_iaq_sample const *iaq_sample);
+
+/**
+ * @brief Timing statistics of a sensor.
+ */
+struct bme68x_iaq_multi_stats {
+	/** Number of IAQ samples produced. */
+	uint32_t samples;
+	/** Number of BSEC timing violations (late rendez-vous). */
+	uint32_t violations;
+	/** Number of failed bus I/O sequences. */
+	uint32_t io_errors;
+	/** Maximum delay after the BSEC rendez-vous in microseconds. */
+	uint32_t late_max_us;
+	/** Maximum wait for the bus in microseconds. */
+	uint32_t bus_wait_max_us;
+	/** Maximum algorithm iteration duration (bsec_do_steps_m()) in microseconds. */
+	uint32_t steps_max_us;
+	/** Total time spent in algorithm iterations in microseconds. */
+	uint64_t steps_total_us;
+};
+
+/**
+ * @brief Load statistics of a worker thread.
+ */
+struct bme68x_iaq_multi_worker_stats {
+	/** CPU the worker is pinned to, -1 if not pinned. */
+	int cpu;
+	/** Number of sensors handled by the worker. */
+	uint32_t sensors;
+	/** Time spent processing (not sleeping) in microseconds. */
+	uint64_t busy_us;
+	/** Time since the worker was started in microseconds. */
+	uint64_t elapsed_us;
+};
+
+/**
+ * @brief BME68X sensor controlled by the multi-sensor IAQ engine.
+ *
+ * Define with BME68X_IAQ_MULTI_SENSOR_DEFINE().
+ */
+struct bme68x_iaq_multi_sensor {
+	/** BME68X Sensor API device ("bosch,bme68x-sensor-api" bindings). */
+	struct device const *dev;
+	/** Bus the sensor is connected to. */
+	struct bme68x_iaq_multi_bus *bus;
+	/** Synchronous IAQ samples callback. */
+	bme68x_iaq_multi_cb cb;
+	/** User data, e.g. to identify the sensor in the callback. */
+	void *user_data;
+	/** Internal: the controlled sensor. */
+	struct bme68x_dev bme68x_dev;
+	/** Internal: last BSEC control request. */
+	bsec_bme_settings_t settings;
+	/** Internal: timestamp of the triggered measurement. */
+	int64_t ts_ns;
+	/** Internal: when the sensor needs the worker's attention. */
+	int64_t due_ns;
+	/** Internal: whether a measurement is in progress. */
+	bool measuring;
+	/** Internal: timing statistics, see bme68x_iaq_multi_stats_get(). */
+	struct bme68x_iaq_multi_stats stats;
+	/** Internal: BSEC instance. */
+	uint8_t inst[CONFIG_BME68X_IAQ_MULTI_INSTANCE_SIZE] __aligned(8);
+};
+
+/**
+ * @brief Define a BME68X sensor controlled by the multi-sensor IAQ engine.
+ *
+ * @param _name Sensor name.
+ * @param _dev BME68X Sensor API device.
+ * @param _bus Bus the sensor is connected to (`struct bme68x_iaq_multi_bus *`).
+ * @param _cb IAQ samples callback (bme68x_iaq_multi_cb).
+ * @param _user_data User data.
+ */
+#define BME68X_IAQ_MULTI_SENSOR_DEFINE(_name, _dev, _bus, _cb, _user_data)                         \
+	static struct bme68x_iaq_multi_sensor _name = {                                            \
+		.dev = (_dev),                                                                     \
+		.bus = (_bus),                                                                     \
+		.cb = (_cb),                                                                       \
+		.user_data = (_user_data),                                                         \
+	}
+
+/**
+ * @brief Initialize the multi-sensor IAQ engine.
+ *
+ * For each sensor:
+ * - bind the BME68X Sensor API sensor to its device, and initialize it
+ * - initialize and configure a BSEC instance for IAQ (Kconfig)
+ * - subscribe to all virtual sensors supported in IAQ mode
+ *
+ * The sensors are then distributed across the worker threads (round-robin).
+ *
+ * NOTE: The calling thread's stack must accommodate the BSEC working buffers.
+ *
+ * @param sensors The sensors to control, must remain valid while the engine is running.
+ * @param n_sensors Number of sensors.
+ *
+ * @return 0 on success, -EINVAL if no sensors, -ENOMEM if the BSEC instance size
+ * exceeds `CONFIG_BME68X_IAQ_MULTI_INSTANCE_SIZE`, -EBUSY if running,
+ * negative errno, BSEC or BME68X Sensor API status otherwise.
+ */
+int bme68x_iaq_multi_init(struct bme68x_iaq_multi_sensor *const *sensors, size_t n_sensors);
+
+/**
+ * @brief Start the worker threads.
+ *
+ * On SMP systems, worker N is pinned to CPU N (modulo the number of CPUs).
+ *
+ * @return 0 on success, -EALREADY if running, -EINVAL if not initialized.
+ */
+int bme68x_iaq_multi_start(void);
+
+/**
+ * @brief Stop the worker threads.
+ *
+ * Measurements in progress are abandoned.
+ *
+ * @param timeout How long to wait for each worker.
+ *
+ * @return 0 on success, -EALREADY if not running, -EAGAIN on timeout.
+ */
+int bme68x_iaq_multi_stop(k_timeout_t timeout);
+
+/**
+ * @brief Get timing statistics of a sensor.
+ *
+ * @param sensor The sensor.
+ * @param stats Output parameter for the statistics.
+ */
+void bme68x_iaq_multi_stats_get(struct bme68x_iaq_multi_sensor const *sensor,
+				struct bme68x_iaq_multi_stats *stats);
+
+/**
+ * @brief Get load statistics of a worker thread.
+ *
+ * The worker's CPU utilization is busy_us / elapsed_us.
+ *
+ * @param worker Worker index, less than `CONFIG_BME68X_IAQ_MULTI_WORKERS`.
+ * @param stats Output parameter for the statistics.
+ *
+ * @return 0 on success, -EINVAL on invalid index.
+ */
+int bme68x_iaq_multi_worker_stats_get(size_t worker, struct bme68x_iaq_multi_worker_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_IAQ_MULTI_H_ */
@@ -28,10 +28,66 @@
  */
 #define BME68X_IAQ_NVS_PARTITION_LABEL bsec_partition
 
+/**
+ * @brief Number of BSEC state slots.
+ *
+ * Slot 0 is the IAQ control loop's state, the last slot keeps the state
+ * saved by another BSEC version or configuration (`BME68X_IAQ_NVS_FALLBACK_SLOT`),
+ * other slots are available to shadow BSEC instances (see bme68x_iaq_shadow.h).
+ */
+#define BME68X_IAQ_NVS_SLOTS 16
+
+/**
+ * @brief State slot that keeps an incompatible IAQ control loop's state.
+ *
+ * When the BSEC library or configuration changes, the previous state
+ * is moved to this slot instead of being discarded, and loaded back
+ * if the library or configuration is rolled back.
+ */
+#define BME68X_IAQ_NVS_FALLBACK_SLOT (BME68X_IAQ_NVS_SLOTS - 1)
+
+/** @brief State tag format version. */
+#define BME68X_IAQ_NVS_META_VERSION 1U
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief State tag, saved with a BSEC state.
+ *
+ * Identifies the BSEC library and configuration that produced the state,
+ * so that it can be validated before being loaded.
+ */
+struct bme68x_iaq_nvs_meta {
+	/** Tag format version, `BME68X_IAQ_NVS_META_VERSION`. */
+	uint8_t version;
+	/** BSEC version: major, minor, major bugfix, minor bugfix. */
+	uint8_t bsec_version[4];
+	/** Reserved, zero. */
+	uint8_t reserved[3];
+	/** CRC-32 (IEEE) of the BSEC configuration. */
+	uint32_t config_crc;
+	/** Number of states discarded so far, carried across saves. */
+	uint32_t discards;
+};
+
+/**
+ * @brief Timing statistics of the BSEC state persistence.
+ */
+struct bme68x_iaq_nvs_stats {
+	/** Number of state writes. */
+	uint32_t saves;
+	/** Duration of the last state write in microseconds. */
+	uint32_t save_last_us;
+	/** Worst-case state write duration in microseconds. */
+	uint32_t save_max_us;
+	/** Number of maintenance runs that compacted and erased a sector. */
+	uint32_t maint_runs;
+	/** Worst-case maintenance duration in microseconds. */
+	uint32_t maint_max_us;
+};
+
 /**
  * @brief Initialize NVS support.
  *
@@ -46,11 +102,11 @@ int bme68x_iaq_nvs_init(void);
 /**
  * @brief Read BSEC state from NVS.
  *
- * @param data Destination buffer for BSEC state data.
- * Recommended buffer size if `BSEC_MAX_STATE_BLOB_SIZE` bytes
+ * @param data Destination buffer for BSEC state data, `BSEC_MAX_STATE_BLOB_SIZE` bytes.
  * @param len Size in bytes of the BSEC state retrieved from NVS.
  *
- * @return 0 on success, negative errno otherwise (`-ENOENT` if no saved state available).
+ * @return 0 on success, negative errno otherwise (`-ENOENT` if no saved state available,
+ * `-ERANGE` if the saved state is larger than `BSEC_MAX_STATE_BLOB_SIZE`).
  */
 #if BME68X_IAQ_NVS_ENABLED
 __syscall int bme68x_iaq_nvs_read_state(uint8_t *data, uint32_t *len);
@@ -85,6 +141,105 @@ __syscall int bme68x_iaq_nvs_delete_state(void);
 int bme68x_iaq_nvs_delete_state(void);
 #endif
 
+/**
+ * @brief Read BSEC state from a NVS slot.
+ *
+ * @param slot State slot, less than `BME68X_IAQ_NVS_SLOTS` (0 is bme68x_iaq_nvs_read_state()).
+ * @param data Destination buffer for BSEC state data, `BSEC_MAX_STATE_BLOB_SIZE` bytes.
+ * @param len Size in bytes of the BSEC state retrieved from NVS.
+ *
+ * @return 0 on success, negative errno otherwise (`-ENOENT` if no saved state available,
+ * `-ERANGE` if the saved state is larger than `BSEC_MAX_STATE_BLOB_SIZE`,
+ * `-EINVAL` on invalid slot).
+ */
+#if BME68X_IAQ_NVS_ENABLED
+__syscall int bme68x_iaq_nvs_read_slot_state(uint8_t slot, uint8_t *data, uint32_t *len);
+#else
+int bme68x_iaq_nvs_read_slot_state(uint8_t slot, uint8_t *data, uint32_t *len);
+#endif
+
+/**
+ * @brief Write BSEC state to a NVS slot.
+ *
+ * The state tag is written before the state is committed,
+ * a state written without tag (e.g. bme68x_iaq_nvs_write_state()) is untagged.
+ *
+ * @param slot State slot, less than `BME68X_IAQ_NVS_SLOTS` (0 is bme68x_iaq_nvs_write_state()).
+ * @param data The buffer that contains the state data.
+ * @param len Length of the state data in bytes.
+ * @param meta State tag, may be NULL.
+ *
+ * @return 0 on success, negative errno otherwise (`-EINVAL` on invalid slot).
+ */
+#if BME68X_IAQ_NVS_ENABLED
+__syscall int bme68x_iaq_nvs_write_slot_state(uint8_t slot, uint8_t const *data, uint32_t len,
+					      struct bme68x_iaq_nvs_meta const *meta);
+#else
+int bme68x_iaq_nvs_write_slot_state(uint8_t slot, uint8_t const *data, uint32_t len,
+				    struct bme68x_iaq_nvs_meta const *meta);
+#endif
+
+/**
+ * @brief Read the tag of the BSEC state saved in a NVS slot.
+ *
+ * @param slot State slot, less than `BME68X_IAQ_NVS_SLOTS`.
+ * @param meta Output parameter for the state tag.
+ *
+ * @return 0 on success, negative errno otherwise (`-ENOENT` if the state is untagged,
+ * `-EINVAL` on invalid slot).
+ */
+#if BME68X_IAQ_NVS_ENABLED
+__syscall int bme68x_iaq_nvs_read_slot_meta(uint8_t slot, struct bme68x_iaq_nvs_meta *meta);
+#else
+int bme68x_iaq_nvs_read_slot_meta(uint8_t slot, struct bme68x_iaq_nvs_meta *meta);
+#endif
+
+/**
+ * @brief Delete saved state from a NVS slot.
+ *
+ * @param slot State slot, less than `BME68X_IAQ_NVS_SLOTS` (0 is bme68x_iaq_nvs_delete_state()).
+ *
+ * @return 0 on success, negative errno otherwise (`-ENOENT` if no saved state available,
+ * `-EINVAL` on invalid slot).
+ */
+#if BME68X_IAQ_NVS_ENABLED
+__syscall int bme68x_iaq_nvs_delete_slot_state(uint8_t slot);
+#else
+int bme68x_iaq_nvs_delete_slot_state(uint8_t slot);
+#endif
+
+/**
+ * @brief Compact and pre-erase NVS sectors ahead of the next state saves.
+ *
+ * When the active sector has less than `reserve` bytes left, switch to the next
+ * (erased) sector now: NVS copies the valid entries to that sector (garbage collection),
+ * and erases the oldest sector. The following writes then only program flash,
+ * until the active sector fills up again.
+ *
+ * May take as long as a flash sector erase, e.g. from idle time.
+ *
+ * @param reserve Space in bytes needed in the active sector for the next saves.
+ *
+ * @return 0 on success (sectors compacted or not), -EAGAIN if NVS isn't initialized,
+ * negative errno otherwise.
+ */
+#if BME68X_IAQ_NVS_ENABLED
+__syscall int bme68x_iaq_nvs_maintain(uint32_t reserve);
+#else
+int bme68x_iaq_nvs_maintain(uint32_t reserve);
+#endif
+
+/**
+ * @brief Get the timing statistics of the BSEC state persistence.
+ *
+ * @param stats Output parameter for the statistics.
+ */
+#if BME68X_IAQ_NVS_ENABLED
+__syscall void bme68x_iaq_nvs_stats_get(struct bme68x_iaq_nvs_stats *stats);
+#else
+void bme68x_iaq_nvs_stats_get(struct bme68x_iaq_nvs_stats *stats);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
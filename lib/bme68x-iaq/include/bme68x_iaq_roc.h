@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Report-on-change filtering of IAQ samples.
+ */
+
+#ifndef BME68X_IAQ_ROC_H_
+#define BME68X_IAQ_ROC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#include "bme68x_iaq.h"
+#include "bme68x_roc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @name Reasons for forwarding an IAQ sample.
+ *
+ * @{
+ */
+/** First sample since initialization or reset. */
+#define BME68X_IAQ_ROC_FIRST     BIT(0)
+/** A channel moved beyond its deadband. */
+#define BME68X_IAQ_ROC_DEADBAND  BIT(1)
+/** A channel crossed its threshold (with hysteresis). */
+#define BME68X_IAQ_ROC_THRESHOLD BIT(2)
+/** An accuracy changed. */
+#define BME68X_IAQ_ROC_ACCURACY  BIT(3)
+/** The stabilization or run-in status changed. */
+#define BME68X_IAQ_ROC_STATUS    BIT(4)
+/** The heartbeat expired. */
+#define BME68X_IAQ_ROC_HEARTBEAT BIT(5)
+/** @} */
+
+/**
+ * @brief Report-on-change rule for an IAQ output channel.
+ */
+struct bme68x_iaq_roc_rule {
+	/** Channel (a single `BME68X_IAQ_CHAN_*` bit, e.g. `BME68X_IAQ_CHAN_IAQ`). */
+	uint32_t channel;
+	/**
+	 * @brief Deadband, in the channel's unit.
+	 *
+	 * The sample is forwarded when the channel moves more than this
+	 * from its last forwarded value. Zero disables the deadband.
+	 */
+	float deadband;
+	/** Whether threshold crossings are reported. */
+	bool threshold_enable;
+	/**
+	 * @brief Threshold, in the channel's unit.
+	 *
+	 * The sample is forwarded when the channel rises to the threshold,
+	 * and when it then falls below the threshold minus the hysteresis.
+	 */
+	float threshold;
+	/** Hysteresis below the threshold. */
+	float hysteresis;
+};
+
+/**
+ * @brief Report-on-change filter.
+ *
+ * Define with BME68X_IAQ_ROC_DEFINE() or BME68X_IAQ_ROC_OBSERVER_DEFINE().
+ */
+struct bme68x_iaq_roc {
+	/** Rules. */
+	struct bme68x_iaq_roc_rule const *rules;
+	/** Rules state, one per rule. */
+	struct bme68x_roc_state *states;
+	/** Number of rules. */
+	size_t n_rules;
+	/** Heartbeat in milliseconds: forward at least one sample per period, zero to disable. */
+	uint32_t heartbeat_ms;
+	/** Internal: last forwarded sample. */
+	struct bme68x_iaq_sample last;
+	/** Internal: whether a sample was forwarded since initialization or reset. */
+	bool primed;
+	/** Number of forwarded samples. */
+	atomic_t forwarded;
+	/** Number of suppressed samples. */
+	atomic_t suppressed;
+};
+
+/**
+ * @brief Define a report-on-change filter.
+ *
+ * Accuracy and status changes are always reported.
+ *
+ * @code{.c}
+ * static struct bme68x_iaq_roc_rule const uplink_rules[] = {
+ *	{.channel = BME68X_IAQ_CHAN_IAQ, .deadband = 10.0f,
+ *	 .threshold_enable = true, .threshold = 150.0f, .hysteresis = 20.0f},
+ *	{.channel = BME68X_IAQ_CHAN_TEMPERATURE, .deadband = 0.5f},
+ * };
+ * BME68X_IAQ_ROC_DEFINE(uplink_roc, uplink_rules, 15 * 60 * 1000);
+ * @endcode
+ *
+ * @param _name Filter name.
+ * @param _rules Array of rules (`struct bme68x_iaq_roc_rule`).
+ * @param _heartbeat_ms Heartbeat in milliseconds, zero to disable.
+ */
+#define BME68X_IAQ_ROC_DEFINE(_name, _rules, _heartbeat_ms)                                        \
+	static struct bme68x_roc_state _name##_states[ARRAY_SIZE(_rules)];                         \
+	static struct bme68x_iaq_roc _name = {                                                     \
+		.rules = (_rules),                                                                 \
+		.states = _name##_states,                                                          \
+		.n_rules = ARRAY_SIZE(_rules),                                                     \
+		.heartbeat_ms = (_heartbeat_ms),                                                   \
+	}
+
+/**
+ * @brief Define an IAQ output observer behind a report-on-change filter.
+ *
+ * The filter is named `_name##_roc`.
+ *
+ * @param _name Observer name.
+ * @param _handler Synchronous handler (bme68x_iaq_output_cb), only invoked for forwarded samples.
+ * @param _rules Array of rules (`struct bme68x_iaq_roc_rule`).
+ * @param _heartbeat_ms Heartbeat in milliseconds, zero to disable.
+ */
+#define BME68X_IAQ_ROC_OBSERVER_DEFINE(_name, _handler, _rules, _heartbeat_ms)                     \
+	BME68X_IAQ_ROC_DEFINE(_name##_roc, _rules, _heartbeat_ms);                                 \
+	static void _name##_roc_handler(struct bme68x_iaq_sample const *iaq_sample)                \
+	{                                                                                          \
+		if (bme68x_iaq_roc_filter(&_name##_roc, iaq_sample)) {                             \
+			_handler(iaq_sample);                                                      \
+		}                                                                                  \
+	}                                                                                          \
+	BME68X_IAQ_OBSERVER_DEFINE(_name, _name##_roc_handler, 1, BME68X_IAQ_CHAN_ALL)
+
+/**
+ * @brief Filter IAQ sample.
+ *
+ * @param roc The report-on-change filter.
+ * @param iaq_sample The IAQ sample to filter.
+ *
+ * @return Reasons for forwarding the sample (`BME68X_IAQ_ROC_*`),
+ * zero if the sample is suppressed.
+ */
+uint32_t bme68x_iaq_roc_filter(struct bme68x_iaq_roc *roc,
+			       struct bme68x_iaq_sample const *iaq_sample);
+
+/**
+ * @brief Reset filter: the next sample will be forwarded.
+ *
+ * Counters are not reset.
+ *
+ * @param roc The report-on-change filter.
+ */
+void bme68x_iaq_roc_reset(struct bme68x_iaq_roc *roc);
+
+/**
+ * @brief Get filter counters.
+ *
+ * @param roc The report-on-change filter.
+ * @param forwarded Output parameter for the number of forwarded samples.
+ * @param suppressed Output parameter for the number of suppressed samples.
+ */
+static inline void bme68x_iaq_roc_stats(struct bme68x_iaq_roc const *roc, uint32_t *forwarded,
+					uint32_t *suppressed)
+{
+	*forwarded = (uint32_t)atomic_get(&roc->forwarded);
+	*suppressed = (uint32_t)atomic_get(&roc->suppressed);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_IAQ_ROC_H_ */
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Segmented sensor self-test:
+ * - the measurements of bme68x_selftest_check(), one per idle slot
+ *   between BSEC rendez-vous
+ * - on the sensor controlled by the IAQ control loop, without stopping IAQ
+ * - result reported through a callback
+ */
+
+#ifndef BME68X_IAQ_SELFTEST_H_
+#define BME68X_IAQ_SELFTEST_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Self-test completion callback.
+ *
+ * Invoked from the thread running the IAQ control loop.
+ *
+ * @param result `BME68X_OK` if the sensor passed the self-test,
+ * `BME68X_E_SELF_TEST` if it failed, negative BME68X Sensor API status on communication error,
+ * -ECANCELED if the IAQ control loop returned first.
+ * @param user_data User data passed to bme68x_iaq_selftest_request().
+ */
+typedef void (*bme68x_iaq_selftest_cb)(int result, void *user_data);
+
+/**
+ * @brief Request a self-test of the sensor controlled by the IAQ control loop.
+ *
+ * Same measurements and criteria as bme68x_selftest_check()
+ * (one 1 s heater measurement, then six 2 s heater measurements at alternating
+ * temperatures), but each measurement runs in an idle slot of the IAQ control loop,
+ * when it completes before the next BSEC rendez-vous: IAQ samples keep their cadence,
+ * the BSEC state and the sensor's calibration data are preserved.
+ *
+ * The self-test takes at least seven BSEC periods, e.g. 21 s with the LP sample rate.
+ *
+ * NOTE: The BSEC gas measurement that follows a self-test measurement
+ * may be slightly affected by the residual heat of the hot plate.
+ *
+ * @param cb Completion callback.
+ * @param user_data User data passed to the callback.
+ *
+ * @return 0 on success, -EBUSY if a self-test is already in progress, -EINVAL if no callback.
+ */
+int bme68x_iaq_selftest_request(bme68x_iaq_selftest_cb cb, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_IAQ_SELFTEST_H_ */
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Shadow BSEC instances, e.g. for A/B evaluation of BSEC configurations:
+ * - the IAQ control loop's (primary) instance drives the sensor
+ * - shadow instances process the same inputs with their own configuration
+ * - each shadow has its own outputs and state persistence
+ */
+
+#ifndef BME68X_IAQ_SHADOW_H_
+#define BME68X_IAQ_SHADOW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/toolchain.h>
+
+#include "bme68x_iaq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct bme68x_iaq_shadow;
+
+/**
+ * @brief Synchronous callback for the IAQ samples of a shadow instance.
+ *
+ * Invoked from the thread that runs the primary BSEC iterations,
+ * right after the primary instance's iteration.
+ */
+typedef void (*bme68x_iaq_shadow_cb)(struct bme68x_iaq_shadow const *shadow,
+				     struct bme68x_iaq_sample const *iaq_sample);
+
+/**
+ * @brief Statistics of a shadow instance.
+ */
+struct bme68x_iaq_shadow_stats {
+	/** Number of IAQ samples produced. */
+	uint32_t samples;
+	/** Number of primary inputs skipped (shadow sample rate). */
+	uint32_t skipped;
+	/** Number of BSEC errors and warnings. */
+	uint32_t errors;
+};
+
+/**
+ * @brief Shadow BSEC instance.
+ *
+ * Define with BME68X_IAQ_SHADOW_DEFINE().
+ */
+struct bme68x_iaq_shadow {
+	/** Shadow name, for logging. */
+	char const *name;
+	/** BSEC configuration blob. */
+	uint8_t const *config;
+	/** BSEC configuration size in bytes. */
+	size_t config_size;
+	/**
+	 * Sample rate (`BSEC_SAMPLE_RATE_LP` or `BSEC_SAMPLE_RATE_ULP`),
+	 * zero for the primary instance's sample rate.
+	 */
+	float sample_rate;
+	/**
+	 * NVS state slot (1 to `BME68X_IAQ_NVS_FALLBACK_SLOT` - 1),
+	 * zero for no state persistence.
+	 */
+	uint8_t nvs_slot;
+	/** Synchronous IAQ samples callback. */
+	bme68x_iaq_shadow_cb cb;
+	/** User data, e.g. to identify the shadow in the callback. */
+	void *user_data;
+	/** Internal: CRC-32 (IEEE) of the BSEC configuration, tags saved states. */
+	uint32_t config_crc;
+	/** Internal: timestamp of the next input to process. */
+	int64_t next_ns;
+	/** Internal: statistics, see bme68x_iaq_shadow_stats_get(). */
+	struct bme68x_iaq_shadow_stats stats;
+	/** Internal: BSEC instance. */
+	uint8_t inst[CONFIG_BME68X_IAQ_SHADOW_INSTANCE_SIZE] __aligned(8);
+};
+
+/**
+ * @brief Define a shadow BSEC instance.
+ *
+ * @param _name Shadow name.
+ * @param _config BSEC configuration blob (array).
+ * @param _sample_rate Sample rate, zero for the primary instance's sample rate.
+ * @param _nvs_slot NVS state slot, zero for no state persistence.
+ * @param _cb IAQ samples callback (bme68x_iaq_shadow_cb).
+ * @param _user_data User data.
+ */
+#define BME68X_IAQ_SHADOW_DEFINE(_name, _config, _sample_rate, _nvs_slot, _cb, _user_data)         \
+	static struct bme68x_iaq_shadow _name = {                                                  \
+		.name = #_name,                                                                    \
+		.config = (_config),                                                               \
+		.config_size = sizeof(_config),                                                    \
+		.sample_rate = (_sample_rate),                                                     \
+		.nvs_slot = (_nvs_slot),                                                           \
+		.cb = (_cb),                                                                       \
+		.user_data = (_user_data),                                                         \
+	}
+
+/**
+ * @brief Initialize shadow BSEC instances.
+ *
+ * For each shadow:
+ * - initialize and configure a BSEC instance with the shadow's configuration
+ * - load its saved BSEC state, if any (NVS) and saved with the same BSEC version
+ *   and configuration, see struct bme68x_iaq_state_info
+ * - subscribe to all virtual sensors supported in IAQ mode
+ *
+ * Must be called after bme68x_iaq_init(), and before bme68x_iaq_run().
+ * The shadows then process the primary instance's inputs,
+ * and save their state along with the primary instance (`BME68X_IAQ_STATE_SAVE_INTVL`).
+ *
+ * A shadow's sample rate can't be faster than the primary instance's:
+ * a slower shadow (e.g. ULP for a LP primary) processes one input out of N.
+ *
+ * NOTE: The calling thread's stack must accommodate the BSEC working buffers.
+ *
+ * @param shadows The shadow instances, must remain valid while the control loop is running.
+ * @param n_shadows Number of shadows, zero to disable shadows.
+ *
+ * @return 0 on success, -ENOMEM if the BSEC instance size exceeds
+ * `CONFIG_BME68X_IAQ_SHADOW_INSTANCE_SIZE`, -EINVAL on invalid NVS slot,
+ * BSEC status otherwise.
+ */
+int bme68x_iaq_shadow_init(struct bme68x_iaq_shadow *const *shadows, size_t n_shadows);
+
+/**
+ * @brief Get statistics of a shadow instance.
+ *
+ * @param shadow The shadow.
+ * @param stats Output parameter for the statistics.
+ */
+void bme68x_iaq_shadow_stats_get(struct bme68x_iaq_shadow const *shadow,
+				 struct bme68x_iaq_shadow_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_IAQ_SHADOW_H_ */
@@ -6,23 +6,26 @@
 
 #include "bme68x_iaq.h"
 
+#include <string.h>
+
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
+#include <zephyr/sys/crc.h>
 
 #include "bme68x.h"
+#include "bme68x_heatr.h"
 #include "bsec_interface.h"
-/*
- * Selected (Kconfig) BSEC algorithm configuration for IAQ.
- *
- * Defines configuration blob as bsec_config_iaq.
- *
- * NOTE: Typical configuration is just over 2 kB.
- */
-#include "bsec_iaq.h"
+#include "bme68x_iaq_bsec.h"
 
 /* API will return -ENOSYS if NVS support is disabled. */
 #include "bme68x_iaq_nvs.h"
 
+#if defined(CONFIG_BME68X_SENSOR_API_DRIVER)
+#include <drivers/bme68x_sensor_api.h>
+#endif
+
 LOG_MODULE_REGISTER(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
 
 /*
@@ -42,13 +45,20 @@ LOG_MODULE_REGISTER(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
  */
 #define BME68X_IAQ_AMBIENT_TEMP INT8_C(CONFIG_BME68X_IAQ_AMBIENT_TEMP)
 
+/* Whether a provisioned baseline state is loaded when no saved state is available. */
+#if defined(CONFIG_BME68X_IAQ_BASELINE)
+#define BME68X_IAQ_BASELINE_ENABLED 1
+#else
+#define BME68X_IAQ_BASELINE_ENABLED 0
+#endif
+
 #if defined(CONFIG_BME68X_IAQ_STATE_SAVE_INTVL) && (CONFIG_BME68X_IAQ_STATE_SAVE_INTVL > 0)
 /* BSEC state saves periodicity in minutes. */
 #define BME68X_IAQ_STATE_SAVE_INTVL CONFIG_BME68X_IAQ_STATE_SAVE_INTVL
 /*
  * Dedicated timer:
  * - started just before entering the BSEC control loop
- * - then managed by iaq_bsec_save_state() bellow
+ * - then managed by iaq_bsec_save_state() below
  */
 K_TIMER_DEFINE(iaq_state_save_timer, NULL, NULL);
 /*
@@ -68,6 +78,11 @@ static void iaq_bsec_save_state(void);
 #define BME68X_IAQ_STATE_SAVE_INTVL 0
 #endif
 
+#if defined(CONFIG_BME68X_IAQ_NVS_MAINT)
+/* Idle time needed before the next BSEC rendez-vous to run the NVS maintenance. */
+#define BME68X_IAQ_NVS_MAINT_BUDGET_NS ((int64_t)CONFIG_BME68X_IAQ_NVS_MAINT_BUDGET * NSEC_PER_MSEC)
+#endif
+
 /*
  *  Configure the BSEC algorithm for IAQ.
  *
@@ -76,12 +91,15 @@ static void iaq_bsec_save_state(void);
  * - Supply voltage (1.8 V or 3.3 V)
  * - Calibration time (4 or 28 days)
  *
- * These options together identify a BSEC configuration blob,
+ * These options together identify a BSEC configuration blob per sensor variant,
  * e.g. `bme680_iaq_33v_3s_4d`.
  *
- * Returns 0 on success, BSEC status otherwise.
+ * dev: the controlled BME68X sensor, initialized (variant)
+ *
+ * Returns 0 on success, -ENOTSUP if no configuration for the variant,
+ * BSEC status otherwise.
  */
-static bsec_library_return_t iaq_bsec_configure(void);
+static int iaq_bsec_configure(struct bme68x_dev const *dev);
 
 /*
  * Subscribe to all virtual sensors supported in IAQ mode.
@@ -91,13 +109,40 @@ static bsec_library_return_t iaq_bsec_configure(void);
 static bsec_library_return_t iaq_bsec_subscribe(void);
 
 /*
- * Load saved BSEC state from NVS, if available.
+ * Request an extra measurement in ULP mode (ULP plus):
+ * subscribe to the IAQ output with the on-demand sample rate.
+ *
+ * Returns 0 on success, BSEC status otherwise.
+ */
+static bsec_library_return_t iaq_bsec_subscribe_on_demand(void);
+
+/*
+ * Load saved BSEC state from NVS, if available,
+ * otherwise the provisioned baseline state, if enabled (Kconfig) and valid.
  *
- * Returns 0 on success, -ENOENT if no saved state available,
- * -EIO on NVS error, BSEC status code otherwise.
+ * Returns 0 on success, -ENOENT if no state loaded, negative errno on NVS error.
  */
 static int iaq_bsec_load_state(void);
 
+/*
+ * Load the saved BSEC state from NVS, see struct bme68x_iaq_state_info
+ * for the migration rules.
+ *
+ * work_buf: BSEC working buffer, `BSEC_MAX_WORKBUFFER_SIZE` bytes
+ *
+ * Returns 0 on success, -ENOENT if no state loaded, negative errno on NVS error.
+ */
+static int iaq_bsec_load_saved_state(uint8_t *work_buf);
+
+/* CRC-32 of the loaded BSEC configuration, identifies saved and baseline states. */
+static uint32_t iaq_config_crc;
+
+/* BSEC version (major, minor, major bugfix, minor bugfix), identifies saved states. */
+static uint8_t iaq_bsec_version[4];
+
+/* BSEC state loaded on startup. */
+static struct bme68x_iaq_state_info iaq_state_info;
+
 /*
  * Trigger the TPHG measurements requested by the BSEC control loop:
  * - configure BME68X sensor with requested settings
@@ -112,47 +157,169 @@ static int8_t iaq_bsec_trigger_measurement(bsec_bme_settings_t const *sensor_set
 					   struct bme68x_dev *dev);
 
 /*
- * Populate BSEC inputs with TPHG data.
+ * Retrieve the data of the TPHG measurement triggered by the BSEC algorithm
+ * from the controlled BME68X sensor registers.
  *
  * sensor_settings: BSEC control request
- * ts_ns: timestamp of the BSEC control loop iteration
- * bme68x_data: TPHG data from controlled BME68X device
- * bsec_inputs: BSEC algorithm inputs to configure
+ * dev: controlled BME68X sensor
+ * bme68x_data: output parameter, TPHG data
  *
- * Returns the number of configured BSEC inputs (typically 4, TPHG).
+ * Returns 0 on success, a BME68X Sensor API status otherwise.
  */
-static size_t iaq_bsec_set_inputs(bsec_bme_settings_t const *sensor_settings, int64_t ts_ns,
-				  struct bme68x_data const *bme68x_data,
-				  bsec_input_t bsec_inputs[BSEC_MAX_PHYSICAL_SENSOR]);
+static int iaq_read_data(bsec_bme_settings_t const *sensor_settings, struct bme68x_dev *dev,
+			 struct bme68x_data *bme68x_data);
+
+/*
+ * Run the sensor I/O requested by the BSEC control loop:
+ * - trigger the forced mode measurement, and wait for its completion
+ * - read the TPHG data
+ *
+ * Sensor I/O errors are recovered in place, without reinitializing BSEC,
+ * escalating until the transaction succeeds (recovery ladder):
+ * 1. retry the failed transaction
+ * 2. soft reset the sensor, the calibration data read by bme68x_init() remain valid
+ * 3. recover the bus (I2C), then soft reset the sensor
+ *
+ * The ladder stops early rather than miss the next BSEC rendez-vous.
+ *
+ * sensor_settings: BSEC control request
+ * dev: the controlled BME68X sensor
+ * bme68x_data: output parameter, TPHG data
+ *
+ * Returns 0 on success, a BME68X Sensor API status otherwise
+ * (negative if the sensor fault could not be recovered).
+ */
+static int iaq_sensor_io(bsec_bme_settings_t const *sensor_settings, struct bme68x_dev *dev,
+			 struct bme68x_data *bme68x_data);
+
+/*
+ * Apply a step of the sensor fault recovery ladder.
+ *
+ * dev: the controlled BME68X sensor
+ * step: the recovery step (`IAQ_RECOVERY_*`)
+ *
+ * Returns 0 on success, a BME68X Sensor API status otherwise.
+ */
+static int iaq_sensor_recover(struct bme68x_dev *dev, int step);
+
 /*
- * Process TPHG measurement triggered by the BSEC algorithm:
- * - retrieve the data from the controlled BME68X sensor registers
+ * Update recovery statistics at the end of the recovery ladder.
+ *
+ * step: the last recovery step applied
+ * ret: the final sensor I/O status
+ * fault_ns: uptime of the first sensor I/O error
+ */
+static void iaq_recovery_record(int step, int ret, int64_t fault_ns);
+
+/*
+ * Process TPHG data:
  * - configure BSEC inputs with the new data
  * - run BSEC algorithm to process inputs into IAQ output signals
  *
- * sensor_settings: BSEC control request
+ * process_data: BSEC inputs requested by the BSEC control (`BSEC_PROCESS_*`)
  * ts_ns: timestamp of the BSEC control loop iteration
- * dev: controlled BME68X sensor
+ * bme68x_data: TPHG data
  * iaq_sample: output parameter, IAQ output signals
  *
- * Returns 0 on success, BSEC or BME68X Sensor API status otherwise.
+ * Returns 0 on success, BSEC status otherwise.
+ */
+static int iaq_process_data(uint32_t process_data, int64_t ts_ns,
+			    struct bme68x_data const *bme68x_data,
+			    struct bme68x_iaq_sample *iaq_sample);
+
+/*
+ * Dispatch IAQ sample:
+ * - publish to the latest sample store, and fan out to observers
+ * - update the ambient temperature used to compute heater resistance
+ *
+ * iaq_sample: the IAQ sample to dispatch
+ */
+static void iaq_sample_dispatch(struct bme68x_iaq_sample const *iaq_sample);
+
+/*
+ * BSEC control loop: meet the BSEC rendez-vous, have the sensor I/O done,
+ * process the TPHG data, until negative status or bme68x_iaq_stop().
+ *
+ * Runs the whole IAQ control loop in the thread running bme68x_iaq_run(),
+ * see iaq_acq_loop() and iaq_proc_loop() for CONFIG_BME68X_IAQ_SPLIT.
+ *
+ * dev: the controlled BME68X sensor
+ *
+ * Returns the negative status that ended the loop, 0 on bme68x_iaq_stop().
  */
-static int iaq_next_sample(bsec_bme_settings_t const *sensor_settings, int64_t ts_ns,
-			   struct bme68x_dev *dev, struct bme68x_iaq_sample *iaq_sample);
+static int iaq_bsec_loop(struct bme68x_dev *dev);
 
 /*
- * Compute forced mode TPHG measurement duration in microseconds.
+ * End of the BSEC control loop: stop the periodic BSEC state persistence,
+ * and save the algorithm progress on a clean stop.
+ */
+static void iaq_bsec_loop_end(void);
+
+/*
+ * Get the BSEC control request at the BSEC rendez-vous,
+ * or right now for an on-demand measurement.
  *
- * The duration includes:
- * - the wake-up time needed to reach the forced mode
- * - the time needed to measure temperature, pressure, and humidity
- * - the heating duration needed before we can measure the gas resistance
+ * ts_ns: timestamp of the BSEC control loop iteration
+ * on_demand: whether an on-demand measurement is requested
+ * sensor_settings: in: previous BSEC control request (next rendez-vous),
+ *                  out: the new BSEC control request
+ *
+ * Returns 0 if a measurement is requested, a positive value if there's nothing to do
+ * (too early, BSEC warning, no measurement), a negative BSEC status otherwise.
+ */
+static int iaq_bsec_control(int64_t ts_ns, bool on_demand, bsec_bme_settings_t *sensor_settings);
+
+/*
+ * Acquire the TPHG data requested by the BSEC control (see iaq_sensor_io()),
+ * and count consecutive unrecovered sensor faults.
  *
  * sensor_settings: BSEC control request
+ * dev: the controlled BME68X sensor
+ * bme68x_data: output parameter, TPHG data
+ *
+ * Returns 0 on success, a positive value if there's nothing to process
+ * (no new data, skipped measurement, stopped), a negative BME68X Sensor API status
+ * when unrecovered sensor faults end the IAQ control loop.
+ */
+static int iaq_acquire(bsec_bme_settings_t const *sensor_settings, struct bme68x_dev *dev,
+		       struct bme68x_data *bme68x_data);
+
+/*
+ * Process TPHG data into an IAQ sample (see iaq_process_data()),
+ * dispatch the sample, and save the BSEC state when due.
+ *
+ * process_data: BSEC inputs requested by the BSEC control (`BSEC_PROCESS_*`)
+ * ts_ns: timestamp of the BSEC control loop iteration
+ * bme68x_data: TPHG data
+ *
+ * Returns 0 on success, BSEC status otherwise.
+ */
+static int iaq_process(uint32_t process_data, int64_t ts_ns,
+		       struct bme68x_data const *bme68x_data);
+
+/*
+ * Run a pending self-test step, when it fits before the next BSEC rendez-vous.
+ *
+ * dev: the controlled BME68X sensor
+ * next_call: next BSEC rendez-vous
+ */
+static void iaq_selftest_idle(struct bme68x_dev *dev, int64_t next_call);
+
+/*
+ * Maintain NVS sectors (if enabled), when idle long enough before the next BSEC rendez-vous.
  *
- * Returns the TPHG cycle duration in microseconds.
+ * next_call: next BSEC rendez-vous
  */
-static uint32_t iaq_get_tphg_meas_dur(bsec_bme_settings_t const *sensor_settings);
+static void iaq_nvs_idle(int64_t next_call);
+
+/*
+ * Wait for the next BSEC rendez-vous, maintaining NVS sectors meanwhile (if enabled).
+ *
+ * Woken up early by bme68x_iaq_request_measurement() or bme68x_iaq_stop().
+ *
+ * next_call: next BSEC rendez-vous
+ */
+static void iaq_wait_rdv(int64_t next_call);
 
 /*
  * Uptime in 64-bit nanosecond precision:
@@ -171,20 +338,257 @@ static uint32_t iaq_get_tphg_meas_dur(bsec_bme_settings_t const *sensor_settings
 static int64_t iaq_uptime_ns(void);
 
 /*
- * Populate IAQ sample with BSEC output signals.
+ * Fan out IAQ sample to interested observers, according to their decimation factor.
  *
- * ts_ns: timestamp of the BSEC control loop iteration
- * bsec_outputs: BSEC output signals
- * n_output: number of BSEC output signals
- * iaq_sample: IAQ sample to populate
+ * iaq_sample: IAQ sample to dispatch
+ */
+static void iaq_observers_notify(struct bme68x_iaq_sample const *iaq_sample);
+
+/*
+ * Publish IAQ sample to the latest sample store.
+ *
+ * iaq_sample: the IAQ sample to publish
+ */
+static void iaq_latest_publish(struct bme68x_iaq_sample const *iaq_sample);
+
+/*
+ * Thread running the IAQ control loop, and whether it should return.
  */
-static void iaq_sample_set_outputs(int64_t ts_ns, bsec_output_t const *bsec_outputs,
-				   size_t n_output, struct bme68x_iaq_sample *iaq_output);
+static k_tid_t iaq_thread;
+static atomic_t iaq_stop;
 
 /*
- * Virtual sensors for all BSEC outputs supported in IAQ mode.
+ * Wakes up the IAQ control loop waiting for the next BSEC rendez-vous,
+ * and whether an on-demand measurement is requested.
+ */
+static K_SEM_DEFINE(iaq_wake_sem, 0, 1);
+static atomic_t iaq_on_demand;
+
+/*
+ * Ambient temperature used to compute heater resistance (degree Celsius):
+ * updated with the IAQ samples, loaded before triggering measurements.
+ */
+static atomic_t iaq_amb_temp;
+
+/*
+ * Serializes BSEC library calls (not thread-safe): the BSEC control loop
+ * and state snapshots (bme68x_iaq_bsec_get_state()) may run in different threads.
+ */
+static K_MUTEX_DEFINE(iaq_bsec_lock);
+
+#if defined(CONFIG_BME68X_IAQ_SPLIT)
+#define BME68X_IAQ_SPLIT 1
+
+/* Number of raw frames in the acquisition ring. */
+#define IAQ_RING_SIZE CONFIG_BME68X_IAQ_SPLIT_RING_SIZE
+BUILD_ASSERT(IS_POWER_OF_TWO(IAQ_RING_SIZE), "ring size must be a power of two");
+
+/*
+ * Raw frame produced by the acquisition thread.
+ */
+struct iaq_raw_frame {
+	/* Raw frame number, from 1. */
+	uint32_t id;
+	/* Timestamp of the measurement, for the BSEC control and algorithm iteration. */
+	int64_t ts_ns;
+	/* Whether it's an on-demand measurement. */
+	bool on_demand;
+	/* Acquisition status (see iaq_acquire()), or a positive value if not measured. */
+	int status;
+	/* Sensor settings of the measurement (last published BSEC control request). */
+	bsec_bme_settings_t settings;
+	/* TPHG data, valid if status is 0. */
+	struct bme68x_data data;
+};
+
+/*
+ * BSEC control request published to the acquisition thread.
+ */
+struct iaq_ctrl_req {
+	/* Raw frame the BSEC control request was made for. */
+	uint32_t frame_id;
+	/* Timestamp of the BSEC control request (the raw frame's). */
+	int64_t ts_ns;
+	/* BSEC control request: sensor settings and next rendez-vous. */
+	bsec_bme_settings_t settings;
+};
+
+/*
+ * Last BSEC control request, behind a sequence lock:
+ * - the processing thread (writer) never waits: odd sequence while writing
+ * - the acquisition thread (reader) never waits either: it retries when woken up
+ *   by the next publication, instead of spinning on a preempted writer
+ */
+static struct {
+	atomic_t seq;
+	struct iaq_ctrl_req sched;
+} iaq_sched;
+
+/*
+ * Single-producer/single-consumer ring of raw frames:
+ * - the acquisition thread only writes the head, the processing thread only writes the tail
+ * - slots are published (head) and released (tail) after a full memory barrier
+ *
+ * The producer never waits: frames are dropped when the ring is full.
+ */
+static struct {
+	atomic_t head;
+	atomic_t tail;
+	atomic_t dropped;
+	struct iaq_raw_frame frames[IAQ_RING_SIZE];
+} iaq_ring;
+
+/* Signaled for each published raw frame. */
+static K_SEM_DEFINE(iaq_ring_sem, 0, K_SEM_MAX_LIMIT);
+
+/*
+ * Non recoverable error, ends the IAQ control loop:
+ * - processing (BSEC status), read by the acquisition thread
+ * - acquisition (unrecovered sensor faults), read by the processing thread
+ */
+static atomic_t iaq_proc_status;
+static atomic_t iaq_acq_status;
+
+/*
+ * Start the BSEC control loop in the processing thread,
+ * and signal its end (BSEC state saved).
+ */
+static K_SEM_DEFINE(iaq_proc_start, 0, 1);
+static K_SEM_DEFINE(iaq_proc_done, 0, 1);
+
+/*
+ * Publish raw frame to the processing thread.
+ *
+ * Returns 0 on success, -ENOBUFS if the ring is full (frame dropped).
+ */
+static int iaq_ring_put(struct iaq_raw_frame const *frame);
+
+/*
+ * Consume the next raw frame, if any.
+ *
+ * frame: output parameter, the raw frame
+ *
+ * Returns 0 on success, -EAGAIN if the ring is empty.
  */
-static bsec_sensor_configuration_t const iaq_virt_sensors[] = {
+static int iaq_ring_get(struct iaq_raw_frame *frame);
+
+/*
+ * Publish a BSEC control request to the acquisition thread, and wake it up.
+ *
+ * frame_id: raw frame the BSEC control request was made for
+ * ts_ns: timestamp of the BSEC control request
+ * sensor_settings: the BSEC control request
+ */
+static void iaq_sched_publish(uint32_t frame_id, int64_t ts_ns,
+			      bsec_bme_settings_t const *sensor_settings);
+
+/*
+ * Get the last published BSEC control request, if new.
+ *
+ * seq: in: sequence of the last BSEC control request read, out: updated
+ * sched: output parameter, the BSEC control request
+ *
+ * Returns true if a new BSEC control request is read, false if there's none
+ * or it's being published (the acquisition thread is then woken up again).
+ */
+static bool iaq_sched_get(atomic_val_t *seq, struct iaq_ctrl_req *sched);
+
+/*
+ * Whether a raw frame was measured as the BSEC control request asks for.
+ *
+ * frame: sensor settings of the raw frame
+ * sensor_settings: BSEC control request for the raw frame
+ */
+static bool iaq_sched_match(bsec_bme_settings_t const *frame,
+			    bsec_bme_settings_t const *sensor_settings);
+
+/*
+ * Acquisition loop, in the thread running bme68x_iaq_run():
+ * meet the BSEC rendez-vous, trigger and read measurements, self-test steps,
+ * until the processing thread returns or unrecovered sensor faults.
+ *
+ * The next rendez-vous comes from the BSEC control request for the last raw frame,
+ * extrapolated from the previous BSEC control request while it's not processed.
+ *
+ * dev: the controlled BME68X sensor
+ */
+static void iaq_acq_loop(struct bme68x_dev *dev);
+
+/*
+ * Processing loop, in the processing thread: for each raw frame,
+ * get the BSEC control request at the raw frame's timestamp and publish it,
+ * then process the TPHG data if measured as requested, until negative status,
+ * end of the acquisition loop, or bme68x_iaq_stop().
+ *
+ * Returns the negative status that ended the loop, 0 on bme68x_iaq_stop().
+ */
+static int iaq_proc_loop(void);
+
+/*
+ * Processing thread: run the processing loop for bme68x_iaq_run().
+ */
+static void iaq_proc_main(void *p1, void *p2, void *p3);
+
+K_THREAD_DEFINE(iaq_proc_thread, CONFIG_BME68X_IAQ_SPLIT_STACK_SIZE, iaq_proc_main, NULL, NULL,
+		NULL, CONFIG_BME68X_IAQ_SPLIT_PRIORITY, 0, 0);
+
+#else
+/* The IAQ control loop processes its own measurements. */
+#define BME68X_IAQ_SPLIT 0
+#endif
+
+/*
+ * Last sensor configuration applied by iaq_bsec_trigger_measurement():
+ * BSEC almost always requests identical settings, which then need
+ * only the forced mode write (cached ctrl_meas image).
+ *
+ * Invalidated upon errors, forcing a full configuration.
+ */
+static struct {
+	bool valid;
+	uint8_t os_temp;
+	uint8_t os_pres;
+	uint8_t os_hum;
+	uint8_t run_gas;
+	uint16_t heatr_temp;
+	uint16_t heatr_dur;
+	/* res_heat_0 register value, depends on the ambient temperature. */
+	uint8_t res_heat;
+	/* ctrl_meas register image, forced mode. */
+	uint8_t ctrl_meas;
+} iaq_trigger_cache;
+
+/* Sensor fault recovery ladder. */
+#define IAQ_RECOVERY_RETRY 1
+#define IAQ_RECOVERY_RESET 2
+#define IAQ_RECOVERY_BUS   3
+
+/*
+ * Sensor fault recovery statistics, and consecutive sensor faults
+ * not recovered (control loop only).
+ */
+static struct bme68x_iaq_recovery_stats iaq_recovery_stats;
+static struct k_spinlock iaq_recovery_lock;
+static uint32_t iaq_sensor_faults;
+
+/*
+ * Latest IAQ sample store, a double-buffered sequence lock (latch):
+ * - odd sequence numbers: readers copy buf[1] while the producer updates buf[0]
+ * - even sequence numbers: readers copy buf[0] while the producer updates buf[1]
+ *
+ * Readers retry if the sequence number changed while they were copying the sample,
+ * the producer never waits for readers.
+ *
+ * The sequence number wraps around (only its parity and changes matter),
+ * whether the first sample is fully published is a separate flag.
+ */
+static struct {
+	atomic_t seq;
+	atomic_t published;
+	struct bme68x_iaq_sample buf[2];
+} iaq_latest;
+
+bsec_sensor_configuration_t const bme68x_iaq_virt_sensors[BME68X_IAQ_N_VIRT_SENSORS] = {
 	{
 		.sensor_id = BSEC_OUTPUT_RAW_TEMPERATURE,
 		.sample_rate = BME68X_IAQ_SAMPLE_RATE,
@@ -239,8 +643,22 @@ static bsec_sensor_configuration_t const iaq_virt_sensors[] = {
 	},
 };
 
-int bme68x_iaq_init(void)
+int bme68x_iaq_init(struct bme68x_dev const *dev)
 {
+	/* A stop request applies to the control loop we're about to run. */
+	atomic_clear(&iaq_stop);
+#if BME68X_IAQ_SPLIT
+	/* Frames, schedule and status left by a previous control loop. */
+	atomic_clear(&iaq_ring.head);
+	atomic_clear(&iaq_ring.tail);
+	atomic_clear(&iaq_ring.dropped);
+	k_sem_reset(&iaq_ring_sem);
+	atomic_clear(&iaq_sched.seq);
+	k_sem_reset(&iaq_proc_done);
+	atomic_clear(&iaq_proc_status);
+	atomic_clear(&iaq_acq_status);
+#endif
+
 	bsec_version_t ver;
 	int ret = bsec_get_version(&ver);
 	if (!ret) {
@@ -251,8 +669,13 @@ int bme68x_iaq_init(void)
 		return ret;
 	}
 	LOG_INF("BSEC %hu.%hu.%hu.%hu", ver.major, ver.minor, ver.major_bugfix, ver.minor_bugfix);
+	iaq_bsec_version[0] = ver.major;
+	iaq_bsec_version[1] = ver.minor;
+	iaq_bsec_version[2] = ver.major_bugfix;
+	iaq_bsec_version[3] = ver.minor_bugfix;
+	iaq_state_info = (struct bme68x_iaq_state_info){0};
 
-	ret = iaq_bsec_configure();
+	ret = iaq_bsec_configure(dev);
 	if (ret) {
 		return ret;
 	}
@@ -265,9 +688,17 @@ int bme68x_iaq_init(void)
 					BME68X_IAQ_STATE_SAVE_INTVL);
 			}
 
+			/* State flushed on power-fail or shutdown, if any. */
+			bme68x_iaq_flush_reconcile();
+
 			ret = iaq_bsec_load_state();
 		}
 
+		if (ret && (ret != -ENOENT)) {
+			return ret;
+		}
+	} else if (BME68X_IAQ_BASELINE_ENABLED) {
+		ret = iaq_bsec_load_state();
 		if (ret && (ret != -ENOENT)) {
 			return ret;
 		}
@@ -277,12 +708,16 @@ int bme68x_iaq_init(void)
 	return ret;
 }
 
-void bme68x_iaq_run(struct bme68x_dev *dev, bme68x_iaq_output_cb iaq_output_handler)
+void bme68x_iaq_run(struct bme68x_dev *dev)
 {
-	bsec_bme_settings_t sensor_settings = {0};
-
 	/* Initialize temperature used to compute heater resistance. */
-	dev->amb_temp = BME68X_IAQ_AMBIENT_TEMP;
+	atomic_set(&iaq_amb_temp, BME68X_IAQ_AMBIENT_TEMP);
+	iaq_trigger_cache.valid = false;
+	iaq_sensor_faults = 0;
+
+	atomic_clear(&iaq_on_demand);
+	k_sem_reset(&iaq_wake_sem);
+	iaq_thread = k_current_get();
 
 #if BME68X_IAQ_STATE_SAVE_INTVL
 	/* Enable periodic BSEC state persistence. */
@@ -290,111 +725,299 @@ void bme68x_iaq_run(struct bme68x_dev *dev, bme68x_iaq_output_cb iaq_output_hand
 #endif
 
 	/*
-	 * Run the algorithm until negative BME68X Sensor API/BSEC status code.
+	 * Run the algorithm until negative BSEC status code,
+	 * unrecovered sensor faults (see CONFIG_BME68X_IAQ_RECOVERY_MAX_FAULTS),
+	 * or bme68x_iaq_stop().
 	 */
-	for (int ret = 0; ret >= 0;) {
-		ret = 0;
+#if BME68X_IAQ_SPLIT
+	/* BSEC calls in the processing thread, sensor I/O scheduled in this thread. */
+	k_sem_give(&iaq_proc_start);
+	iaq_acq_loop(dev);
+	/* BSEC state saved on a clean stop. */
+	(void)k_sem_take(&iaq_proc_done, K_FOREVER);
+#else
+	(void)iaq_bsec_loop(dev);
+#endif
+
+	/* Self-test steps need the control loop. */
+	bme68x_iaq_selftest_cancel(-ECANCELED);
+	iaq_thread = NULL;
+}
+
+void bme68x_iaq_stop(void)
+{
+	atomic_set(&iaq_stop, 1);
+
+	k_tid_t thread = iaq_thread;
+	if (thread) {
+		/* Don't wait for the next BSEC rendez-vous, or the end of the measurement. */
+		k_sem_give(&iaq_wake_sem);
+		k_wakeup(thread);
+#if BME68X_IAQ_SPLIT
+		/* Nor for the next raw frame. */
+		k_sem_give(&iaq_ring_sem);
+#endif
+	}
+}
+
+int bme68x_iaq_request_measurement(void)
+{
+	if (!IS_ENABLED(CONFIG_BME68X_IAQ_SAMPLE_RATE_ULP)) {
+		return -ENOTSUP;
+	}
+	if (!iaq_thread) {
+		return -EAGAIN;
+	}
+
+	/* The control loop updates the BSEC subscription itself. */
+	atomic_set(&iaq_on_demand, 1);
+	k_sem_give(&iaq_wake_sem);
+	return 0;
+}
+
+int iaq_bsec_loop(struct bme68x_dev *dev)
+{
+	bsec_bme_settings_t sensor_settings = {0};
+	int ret = 0;
 
+	while ((ret >= 0) && !atomic_get(&iaq_stop)) {
 		int64_t ts_ns = iaq_uptime_ns();
-		if (ts_ns < sensor_settings.next_call) {
-			/*
-			 * Too early at BSEC control rendez-vous,
-			 * continue until it's time to get the next BSEC request.
-			 */
-			continue;
-		}
 
-		sensor_settings = (bsec_bme_settings_t){0};
-		ret = bsec_sensor_control(ts_ns, &sensor_settings);
-		if (ret) {
-			if (ret < 0) {
-				LOG_ERR("BSEC control error: %d", ret);
-			} else {
-				/*
-				 * Typically, we're too late (BSEC_W_SC_CALL_TIMING_VIOLATION)
-				 * because the difference between two consecutive measurements
-				 * is greater than allowed.
-				 * For example, in LP mode, sampling rate 3 seconds,
-				 * the difference between two measurements (algorithm iterations)
-				 * must no exceed 106.25% of 3 s, which is 3.1875 s.
-				 *
-				 * TPHG wait: 239590 us
-				 * BSEC wait: 2747772 us
-				 * IAQ loop total wait: 2987362 us
-				 * IAQ loop body: 3187500 - 2987362 = 200138 us
-				 *
-				 * We'll then be too late if running the BSEC algorithm
-				 * iteration and the IAQ output handler,
-				 * plus the needed I2C/SPI communications,
-				 * exceeds 200 ms.
-				 */
-				LOG_WRN("BSEC control status: %d", ret);
+		ret = iaq_bsec_control(ts_ns, atomic_cas(&iaq_on_demand, 1, 0), &sensor_settings);
+		if (!ret) {
+			struct bme68x_data bme68x_data;
+			ret = iaq_acquire(&sensor_settings, dev, &bme68x_data);
+			if (!ret) {
+				ret = iaq_process(sensor_settings.process_data, ts_ns,
+						  &bme68x_data);
 			}
-			goto iaq_loop_next;
 		}
 
-		if (!sensor_settings.trigger_measurement) {
-			/* Nothing to do. */
-			goto iaq_loop_next;
+		/* Non recoverable error, exit IAQ loop immediately. */
+		if (ret < 0) {
+			break;
 		}
 
-		ret = iaq_bsec_trigger_measurement(&sensor_settings, dev);
-		if (ret) {
-			goto iaq_loop_next;
-		}
+		iaq_selftest_idle(dev, sensor_settings.next_call);
+		iaq_wait_rdv(sensor_settings.next_call);
+	}
 
-		uint32_t tphg_us = iaq_get_tphg_meas_dur(&sensor_settings);
-		LOG_DBG("TPHG wait: %u us ...", tphg_us);
-		k_sleep(K_USEC(tphg_us));
+	iaq_bsec_loop_end();
+	return MIN(ret, 0);
+}
 
-		struct bme68x_iaq_sample iaq_sample;
-		ret = iaq_next_sample(&sensor_settings, ts_ns, dev, &iaq_sample);
-		if (ret) {
-			goto iaq_loop_next;
+void iaq_bsec_loop_end(void)
+{
+#if BME68X_IAQ_STATE_SAVE_INTVL
+	k_timer_stop(&iaq_state_save_timer);
+	if (atomic_get(&iaq_stop)) {
+		/* Clean stop: don't lose the algorithm progress since the last save. */
+		iaq_bsec_save_state();
+	}
+#endif
+}
+
+int iaq_bsec_control(int64_t ts_ns, bool on_demand, bsec_bme_settings_t *sensor_settings)
+{
+	if (on_demand && !iaq_bsec_subscribe_on_demand()) {
+		/* BSEC control right now, for the extra measurement. */
+		LOG_DBG("on-demand measurement");
+	} else if (ts_ns < sensor_settings->next_call) {
+		/*
+		 * Too early at BSEC control rendez-vous,
+		 * wait again until it's time to get the next BSEC request.
+		 */
+		return 1;
+	}
+
+	*sensor_settings = (bsec_bme_settings_t){0};
+	k_mutex_lock(&iaq_bsec_lock, K_FOREVER);
+	int ret = bsec_sensor_control(ts_ns, sensor_settings);
+	k_mutex_unlock(&iaq_bsec_lock);
+	if (ret) {
+		if (ret < 0) {
+			LOG_ERR("BSEC control error: %d", ret);
+		} else {
+			/*
+			 * Typically, we're too late (BSEC_W_SC_CALL_TIMING_VIOLATION)
+			 * because the difference between two consecutive measurements
+			 * is greater than allowed.
+			 * For example, in LP mode, sampling rate 3 seconds,
+			 * the difference between two measurements (algorithm iterations)
+			 * must no exceed 106.25% of 3 s, which is 3.1875 s.
+			 *
+			 * TPHG wait: 239590 us
+			 * BSEC wait: 2747772 us
+			 * IAQ loop total wait: 2987362 us
+			 * IAQ loop body: 3187500 - 2987362 = 200138 us
+			 *
+			 * We'll then be too late if running the BSEC algorithm
+			 * iteration and the IAQ observers,
+			 * plus the needed I2C/SPI communications,
+			 * exceeds 200 ms.
+			 */
+			LOG_WRN("BSEC control status: %d", ret);
 		}
+		return ret;
+	}
 
-		if (iaq_sample.cnt_outputs) {
-			iaq_output_handler(&iaq_sample);
+	if (!sensor_settings->trigger_measurement) {
+		/* Nothing to do. */
+		return 1;
+	}
+	if (sensor_settings->op_mode != BME68X_FORCED_MODE) {
+		/* The embedded IAQ configurations run forced mode measurements only. */
+		LOG_WRN("unsupported operation mode: %u", sensor_settings->op_mode);
+		return 1;
+	}
+	return 0;
+}
 
-			/* Update temperature used to compute heater resistance. */
-			dev->amb_temp = (int8_t)iaq_sample.temperature;
+int iaq_acquire(bsec_bme_settings_t const *sensor_settings, struct bme68x_dev *dev,
+		struct bme68x_data *bme68x_data)
+{
+	/* Temperature used to compute heater resistance. */
+	dev->amb_temp = (int8_t)atomic_get(&iaq_amb_temp);
+
+	int ret = iaq_sensor_io(sensor_settings, dev, bme68x_data);
+	if (ret < 0) {
+		iaq_sensor_faults++;
+		if (CONFIG_BME68X_IAQ_RECOVERY_MAX_FAULTS &&
+		    (iaq_sensor_faults >= CONFIG_BME68X_IAQ_RECOVERY_MAX_FAULTS)) {
+			return ret;
 		}
+		/* Skip this measurement, BSEC keeps its schedule and state. */
+		LOG_WRN("sensor fault not recovered (%u), measurement skipped", iaq_sensor_faults);
+		return 1;
+	}
+	iaq_sensor_faults = 0;
+
+	if (!ret && atomic_get(&iaq_stop)) {
+		/* Stopped during the measurement. */
+		return 1;
+	}
+	return ret;
+}
+
+int iaq_process(uint32_t process_data, int64_t ts_ns, struct bme68x_data const *bme68x_data)
+{
+	struct bme68x_iaq_sample iaq_sample;
+	int ret = iaq_process_data(process_data, ts_ns, bme68x_data, &iaq_sample);
+	if (ret) {
+		return ret;
+	}
+
+	if (iaq_sample.cnt_outputs) {
+		iaq_sample_dispatch(&iaq_sample);
+	}
 
 #if BME68X_IAQ_STATE_SAVE_INTVL
-		if (!k_timer_remaining_get(&iaq_state_save_timer)) {
-			/* Save state to NVS and restart timer on success. */
-			iaq_bsec_save_state();
-		}
+	if (!k_timer_remaining_get(&iaq_state_save_timer)) {
+		/* Save state to NVS and restart timer on success. */
+		iaq_bsec_save_state();
+	}
 #endif
+	return 0;
+}
+
+void iaq_selftest_idle(struct bme68x_dev *dev, int64_t next_call)
+{
+	if (bme68x_iaq_selftest_step(dev, MAX(next_call - iaq_uptime_ns(), 0))) {
+		/* Forced mode configuration must be rewritten on the next trigger. */
+		iaq_trigger_cache.valid = false;
+	}
+}
+
+void iaq_nvs_idle(int64_t next_call)
+{
+#if defined(CONFIG_BME68X_IAQ_NVS_MAINT)
+	if ((next_call - iaq_uptime_ns()) >= BME68X_IAQ_NVS_MAINT_BUDGET_NS) {
+		/* Idle: prepare the NVS sectors so that state saves only program flash. */
+		(void)bme68x_iaq_nvs_maintain(CONFIG_BME68X_IAQ_NVS_MAINT_RESERVE);
+	}
+#else
+	ARG_UNUSED(next_call);
+#endif
+}
+
+void iaq_wait_rdv(int64_t next_call)
+{
+	iaq_nvs_idle(next_call);
+
+	int64_t next_rdv_ns = MAX(next_call - iaq_uptime_ns(), 0);
+	LOG_DBG("BSEC wait: %lld us ...", next_rdv_ns / 1000);
+	/* Woken up early by bme68x_iaq_request_measurement() or bme68x_iaq_stop(). */
+	(void)k_sem_take(&iaq_wake_sem, K_NSEC(next_rdv_ns));
+}
 
-	iaq_loop_next:
-		/* Non recoverable error, exit IAQ loop immediately. */
-		if (ret < 0) {
-			continue;
-		}
+int bme68x_iaq_latest_get(struct bme68x_iaq_sample *iaq_sample)
+{
+	atomic_val_t seq;
 
-		int64_t next_rdv_ns = (sensor_settings.next_call - iaq_uptime_ns());
-		LOG_DBG("BSEC wait: %lld us ...", next_rdv_ns / 1000);
-		k_sleep(K_NSEC(next_rdv_ns));
+	if (!atomic_get(&iaq_latest.published)) {
+		return -ENODATA;
 	}
 
-#if BME68X_IAQ_STATE_SAVE_INTVL
-	k_timer_stop(&iaq_state_save_timer);
-#endif
+	do {
+		seq = atomic_get(&iaq_latest.seq);
+		*iaq_sample = iaq_latest.buf[seq & 1];
+		barrier_dmem_fence_full();
+	} while (atomic_get(&iaq_latest.seq) != seq);
+
+	return 0;
+}
+
+void iaq_latest_publish(struct bme68x_iaq_sample const *iaq_sample)
+{
+	/* Odd: readers switch to buf[1]. */
+	atomic_inc(&iaq_latest.seq);
+	iaq_latest.buf[0] = *iaq_sample;
+	/* Even: readers switch back to buf[0]. */
+	atomic_inc(&iaq_latest.seq);
+	iaq_latest.buf[1] = *iaq_sample;
+
+	/* Both copies written once. */
+	atomic_set(&iaq_latest.published, 1);
 }
 
-bsec_library_return_t iaq_bsec_configure(void)
+int iaq_bsec_configure(struct bme68x_dev const *dev)
 {
+	size_t sz_conf;
+	uint8_t const *config = bme68x_iaq_bsec_config(dev->variant_id, &sz_conf);
+	if (!config) {
+		LOG_ERR("no BSEC configuration for variant %u", dev->variant_id);
+		return -ENOTSUP;
+	}
+
 	/* NOTE: stack size > 4096 bytes. */
 	uint8_t buf[BSEC_MAX_WORKBUFFER_SIZE];
-	size_t const sz_conf = sizeof(bsec_config_iaq);
-	bsec_library_return_t ret = bsec_set_configuration(bsec_config_iaq, sz_conf, buf,
-							   sizeof(buf));
+	bsec_library_return_t ret = bsec_set_configuration(config, sz_conf, buf, sizeof(buf));
 
 	if (ret) {
 		LOG_ERR("BSEC configuration failed: %d", ret);
 	} else {
-		LOG_INF("loaded BSEC configuration (%u bytes)", sz_conf);
+		iaq_config_crc = crc32_ieee(config, sz_conf);
+		LOG_INF("loaded BSEC configuration (%u bytes, 0x%08x)", sz_conf, iaq_config_crc);
+	}
+	return ret;
+}
+
+bsec_library_return_t iaq_bsec_subscribe_on_demand(void)
+{
+	static bsec_sensor_configuration_t const on_demand = {
+		.sensor_id = BSEC_OUTPUT_IAQ,
+		.sample_rate = BSEC_SAMPLE_RATE_ULP_MEASUREMENT_ON_DEMAND,
+	};
+	uint8_t n_phy = BSEC_MAX_PHYSICAL_SENSOR;
+	bsec_sensor_configuration_t phy_sensors[BSEC_MAX_PHYSICAL_SENSOR];
+
+	k_mutex_lock(&iaq_bsec_lock, K_FOREVER);
+	bsec_library_return_t ret = bsec_update_subscription(&on_demand, 1, phy_sensors, &n_phy);
+	k_mutex_unlock(&iaq_bsec_lock);
+
+	if (ret) {
+		/* Not fatal: the sample will come with the regular ULP schedule. */
+		LOG_WRN("on-demand measurement declined: %d", ret);
 	}
 	return ret;
 }
@@ -403,10 +1026,10 @@ bsec_library_return_t iaq_bsec_subscribe(void)
 {
 	uint8_t n_phy = BSEC_MAX_PHYSICAL_SENSOR;
 	bsec_sensor_configuration_t phy_sensors[BSEC_MAX_PHYSICAL_SENSOR];
-	size_t const n_subscriptions = ARRAY_SIZE(iaq_virt_sensors);
+	size_t const n_subscriptions = ARRAY_SIZE(bme68x_iaq_virt_sensors);
 
-	bsec_library_return_t ret = bsec_update_subscription(iaq_virt_sensors, n_subscriptions,
-							     phy_sensors, &n_phy);
+	bsec_library_return_t ret = bsec_update_subscription(
+		bme68x_iaq_virt_sensors, n_subscriptions, phy_sensors, &n_phy);
 
 	if (ret) {
 		LOG_ERR("BSEC subscriptions failed: %d", ret);
@@ -418,46 +1041,209 @@ bsec_library_return_t iaq_bsec_subscribe(void)
 
 int iaq_bsec_load_state(void)
 {
-	/* NOTE: stack size > 221 + 4086 (4307 bytes). */
+	/* NOTE: stack size > 221 + 4086 + iaq_bsec_load_saved_state() (4781 bytes). */
 	uint8_t data[BSEC_MAX_STATE_BLOB_SIZE];
 	uint8_t buf[BSEC_MAX_WORKBUFFER_SIZE];
 	uint32_t len;
 
+	int ret = BME68X_IAQ_NVS_ENABLED ? iaq_bsec_load_saved_state(buf) : -ENOENT;
+#if BME68X_IAQ_BASELINE_ENABLED
+	if (ret == -ENOENT) {
+		/* New device: start from the reference unit's calibration. */
+		ret = bme68x_iaq_baseline_read(data, sizeof(data), &len, iaq_config_crc);
+		if (!ret) {
+			ret = bsec_set_state(data, len, buf, sizeof(buf));
+			if (ret) {
+				LOG_ERR("failed to set baseline BSEC state: %d", ret);
+			} else {
+				LOG_INF("loaded baseline BSEC state (%u bytes)", len);
+				iaq_state_info.outcome = BME68X_IAQ_STATE_BASELINE;
+			}
+		}
+		if (ret) {
+			/* Unusable baseline: start calibration from scratch. */
+			ret = -ENOENT;
+		}
+	}
+#else
+	ARG_UNUSED(data);
+	ARG_UNUSED(len);
+#endif
+	if (ret == -ENOENT) {
+		LOG_INF("no BSEC state available");
+	}
+	return ret;
+}
+
+int iaq_bsec_load_saved_state(uint8_t *work_buf)
+{
+	/* NOTE: stack size > 2 x (221 + 16) bytes. */
+	uint8_t data[BSEC_MAX_STATE_BLOB_SIZE];
+	struct bme68x_iaq_nvs_meta meta;
+	uint32_t len;
+	/* Whether the saved state is moved to the fallback slot. */
+	bool keep = false;
+
 	int ret = bme68x_iaq_nvs_read_state(data, &len);
-	if (ret) {
-		if (ret == -ENOENT) {
-			LOG_INF("no BSEC state available");
+	if (!ret) {
+		ret = bme68x_iaq_nvs_read_slot_meta(0, &meta);
+		if (ret && (ret != -ENOENT)) {
+			return ret;
+		}
+
+		bool tagged = !ret;
+		if (tagged) {
+			iaq_state_info.discards = meta.discards;
+		}
+
+		enum bme68x_iaq_state_compat compat =
+			bme68x_iaq_bsec_state_compat(tagged ? &meta : NULL, iaq_config_crc);
+		if (compat == BME68X_IAQ_STATE_COMPAT_NONE) {
+			LOG_WRN("incompatible BSEC state: BSEC %u.%u.%u.%u, configuration 0x%08x",
+				meta.bsec_version[0], meta.bsec_version[1], meta.bsec_version[2],
+				meta.bsec_version[3], meta.config_crc);
+			keep = true;
+			ret = -ENOENT;
 		} else {
-			LOG_ERR("failed to read BSEC state: %d", ret);
+			ret = bsec_set_state(data, len, work_buf, BSEC_MAX_WORKBUFFER_SIZE);
+			if (!ret) {
+				bool migrated = (compat == BME68X_IAQ_STATE_COMPAT_MIGRATE);
+				LOG_INF("loaded %s BSEC state (%u bytes)",
+					migrated ? "migrated" : "saved", len);
+				iaq_state_info.outcome = migrated ? BME68X_IAQ_STATE_MIGRATED
+								  : BME68X_IAQ_STATE_LOADED;
+				return 0;
+			}
+
+			/* Typically an untagged state from an incompatible BSEC version. */
+			LOG_WRN("saved BSEC state rejected: %d, discarded", ret);
+			iaq_state_info.discarded = true;
+			iaq_state_info.discards++;
+			(void)bme68x_iaq_nvs_delete_state();
+			ret = -ENOENT;
 		}
+	}
+	if (ret != -ENOENT) {
+		LOG_ERR("failed to read BSEC state: %d", ret);
 		return ret;
 	}
 
-	ret = bsec_set_state(data, len, buf, BSEC_MAX_WORKBUFFER_SIZE);
-	if (ret) {
-		LOG_ERR("failed to set BSEC state: %d", ret);
-	} else {
-		LOG_INF("loaded BSEC state (%u bytes)", len);
+	/* State saved by the running BSEC version and configuration before an upgrade. */
+	uint8_t fb_data[BSEC_MAX_STATE_BLOB_SIZE];
+	struct bme68x_iaq_nvs_meta fb_meta;
+	uint32_t fb_len;
+	bool fallback = false;
+
+	ret = bme68x_iaq_nvs_read_slot_state(BME68X_IAQ_NVS_FALLBACK_SLOT, fb_data, &fb_len);
+	if (!ret) {
+		ret = bme68x_iaq_nvs_read_slot_meta(BME68X_IAQ_NVS_FALLBACK_SLOT, &fb_meta);
+	}
+	if (!ret && (bme68x_iaq_bsec_state_compat(&fb_meta, iaq_config_crc) ==
+		     BME68X_IAQ_STATE_COMPAT_MATCH)) {
+		ret = bsec_set_state(fb_data, fb_len, work_buf, BSEC_MAX_WORKBUFFER_SIZE);
+		if (!ret) {
+			LOG_INF("loaded fallback BSEC state (%u bytes)", fb_len);
+			iaq_state_info.outcome = BME68X_IAQ_STATE_FALLBACK;
+			iaq_state_info.discards = MAX(iaq_state_info.discards, fb_meta.discards);
+			fallback = true;
+		} else {
+			LOG_WRN("fallback BSEC state rejected: %d, discarded", ret);
+			iaq_state_info.discarded = true;
+			iaq_state_info.discards++;
+			(void)bme68x_iaq_nvs_delete_slot_state(BME68X_IAQ_NVS_FALLBACK_SLOT);
+		}
 	}
 
+	if (keep) {
+		/*
+		 * Swap the saved and fallback states: the loaded fallback state first
+		 * becomes the saved state, so that it survives a reset in between.
+		 */
+		ret = fallback ? bme68x_iaq_nvs_write_slot_state(0, fb_data, fb_len, &fb_meta) : 0;
+		if (!ret) {
+			ret = bme68x_iaq_nvs_write_slot_state(BME68X_IAQ_NVS_FALLBACK_SLOT, data,
+							      len, &meta);
+		}
+		if (!ret && !fallback) {
+			ret = bme68x_iaq_nvs_delete_state();
+		}
+
+		if (ret) {
+			LOG_ERR("failed to keep BSEC state as fallback: %d", ret);
+		} else {
+			LOG_INF("kept saved BSEC state as fallback (%u bytes)", len);
+			iaq_state_info.kept = true;
+		}
+	}
+
+	return fallback ? 0 : -ENOENT;
+}
+
+void bme68x_iaq_state_info_get(struct bme68x_iaq_state_info *info)
+{
+	*info = iaq_state_info;
+}
+
+void bme68x_iaq_bsec_state_tag(uint32_t config_crc, uint32_t discards,
+			       struct bme68x_iaq_nvs_meta *meta)
+{
+	*meta = (struct bme68x_iaq_nvs_meta){
+		.version = BME68X_IAQ_NVS_META_VERSION,
+		.config_crc = config_crc,
+		.discards = discards,
+	};
+	memcpy(meta->bsec_version, iaq_bsec_version, sizeof(meta->bsec_version));
+}
+
+enum bme68x_iaq_state_compat bme68x_iaq_bsec_state_compat(struct bme68x_iaq_nvs_meta const *meta,
+							  uint32_t config_crc)
+{
+	if (!meta) {
+		/* Saved before states were tagged. */
+		return BME68X_IAQ_STATE_COMPAT_MIGRATE;
+	}
+	if ((meta->config_crc != config_crc) ||
+	    memcmp(meta->bsec_version, iaq_bsec_version, 2)) {
+		/* BSEC states are not portable across major or minor versions. */
+		return BME68X_IAQ_STATE_COMPAT_NONE;
+	}
+	return memcmp(meta->bsec_version, iaq_bsec_version, sizeof(iaq_bsec_version))
+		       ? BME68X_IAQ_STATE_COMPAT_MIGRATE
+		       : BME68X_IAQ_STATE_COMPAT_MATCH;
+}
+
+int bme68x_iaq_bsec_get_state(uint8_t *state, uint32_t size, uint32_t *len)
+{
+	/* NOTE: stack size > 4096 bytes. */
+	uint8_t buf[BSEC_MAX_WORKBUFFER_SIZE];
+
+	k_mutex_lock(&iaq_bsec_lock, K_FOREVER);
+	int ret = bsec_get_state(0, state, size, buf, sizeof(buf), len);
+	k_mutex_unlock(&iaq_bsec_lock);
 	return ret;
 }
 
+uint32_t bme68x_iaq_bsec_config_crc(void)
+{
+	return iaq_config_crc;
+}
+
 #if BME68X_IAQ_STATE_SAVE_INTVL
 void iaq_bsec_save_state(void)
 {
 	/* NOTE: stack size > 221 + 4086 (4307 bytes). */
 	uint8_t state[BSEC_MAX_STATE_BLOB_SIZE];
-	uint8_t buf[BSEC_MAX_WORKBUFFER_SIZE];
 	uint32_t len;
 
-	int ret = bsec_get_state(0, state, sizeof(state), buf, sizeof(buf), &len);
+	int ret = bme68x_iaq_bsec_get_state(state, sizeof(state), &len);
 	if (ret) {
 		LOG_ERR("BSEC state unavailable: %d", ret);
+	} else {
+		struct bme68x_iaq_nvs_meta meta;
+		bme68x_iaq_bsec_state_tag(iaq_config_crc, iaq_state_info.discards, &meta);
+		ret = bme68x_iaq_nvs_write_slot_state(0, state, len, &meta);
 	}
 
-	ret = bme68x_iaq_nvs_write_state(state, len);
-
 	/*
 	 * Disable BSEC state persistence on first error,
 	 * restart timer only when successful.
@@ -470,6 +1256,9 @@ void iaq_bsec_save_state(void)
 		LOG_INF("saved BSEC state (%u bytes)", len);
 		k_timer_start(&iaq_state_save_timer, K_MINUTES(BME68X_IAQ_STATE_SAVE_INTVL),
 			      K_NO_WAIT);
+
+		bme68x_iaq_shadow_save();
+		bme68x_iaq_flush_discard();
 	}
 }
 #endif
@@ -477,6 +1266,29 @@ void iaq_bsec_save_state(void)
 int8_t iaq_bsec_trigger_measurement(bsec_bme_settings_t const *sensor_settings,
 				    struct bme68x_dev *dev)
 {
+	uint8_t const ctrl_meas_addr = BME68X_REG_CTRL_MEAS;
+	uint8_t res_heat = bme68x_res_heat(dev, sensor_settings->heater_temperature);
+	int8_t ret;
+
+	if (iaq_trigger_cache.valid &&
+	    (iaq_trigger_cache.os_temp == sensor_settings->temperature_oversampling) &&
+	    (iaq_trigger_cache.os_pres == sensor_settings->pressure_oversampling) &&
+	    (iaq_trigger_cache.os_hum == sensor_settings->humidity_oversampling) &&
+	    (iaq_trigger_cache.run_gas == sensor_settings->run_gas) &&
+	    (iaq_trigger_cache.heatr_temp == sensor_settings->heater_temperature) &&
+	    (iaq_trigger_cache.heatr_dur == sensor_settings->heater_duration) &&
+	    (iaq_trigger_cache.res_heat == res_heat)) {
+		/* Unchanged configuration: forced mode write only. */
+		ret = bme68x_set_regs(&ctrl_meas_addr, &iaq_trigger_cache.ctrl_meas, 1, dev);
+		if (ret) {
+			iaq_trigger_cache.valid = false;
+			LOG_ERR("switching sensor to forced mode failed: %d", ret);
+		} else {
+			LOG_DBG("forced mode (cached configuration)");
+		}
+		return ret;
+	}
+
 	struct bme68x_conf conf = {
 		.os_temp = sensor_settings->temperature_oversampling,
 		.os_pres = sensor_settings->pressure_oversampling,
@@ -489,7 +1301,9 @@ int8_t iaq_bsec_trigger_measurement(bsec_bme_settings_t const *sensor_settings,
 		.heatr_dur = sensor_settings->heater_duration,
 	};
 
-	int8_t ret = bme68x_set_conf(&conf, dev);
+	iaq_trigger_cache.valid = false;
+
+	ret = bme68x_set_conf(&conf, dev);
 	if (ret) {
 		LOG_ERR("oversampling configuration failed: %d", ret);
 		return ret;
@@ -507,16 +1321,166 @@ int8_t iaq_bsec_trigger_measurement(bsec_bme_settings_t const *sensor_settings,
 	ret = bme68x_set_op_mode(BME68X_FORCED_MODE, dev);
 	if (ret) {
 		LOG_ERR("switching sensor to forced mode failed: %d", ret);
-	} else {
-		LOG_DBG("forced mode");
+		return ret;
+	}
+	LOG_DBG("forced mode");
+
+	/* Oversampling as applied (bounded) by the Sensor API, forced mode. */
+	ret = bme68x_get_regs(BME68X_REG_CTRL_MEAS, &iaq_trigger_cache.ctrl_meas, 1, dev);
+	if (!ret) {
+		iaq_trigger_cache.ctrl_meas =
+			BME68X_SET_BITS_POS_0(iaq_trigger_cache.ctrl_meas, BME68X_MODE,
+					      BME68X_FORCED_MODE);
+		iaq_trigger_cache.os_temp = sensor_settings->temperature_oversampling;
+		iaq_trigger_cache.os_pres = sensor_settings->pressure_oversampling;
+		iaq_trigger_cache.os_hum = sensor_settings->humidity_oversampling;
+		iaq_trigger_cache.run_gas = sensor_settings->run_gas;
+		iaq_trigger_cache.heatr_temp = sensor_settings->heater_temperature;
+		iaq_trigger_cache.heatr_dur = sensor_settings->heater_duration;
+		iaq_trigger_cache.res_heat = res_heat;
+		iaq_trigger_cache.valid = true;
+	}
+
+	/* The measurement is triggered anyway. */
+	return BME68X_OK;
+}
+
+int iaq_sensor_io(bsec_bme_settings_t const *sensor_settings, struct bme68x_dev *dev,
+		  struct bme68x_data *bme68x_data)
+{
+	uint32_t tphg_us = bme68x_iaq_tphg_meas_dur(sensor_settings);
+	/* Whether the measurement must be (re)started before reading the data. */
+	bool measure = true;
+	bool fault = false;
+	int64_t fault_ns = 0;
+	int step = 0;
+	int ret;
+
+	for (;;) {
+		ret = BME68X_OK;
+		if (measure) {
+			ret = iaq_bsec_trigger_measurement(sensor_settings, dev);
+			if (!ret) {
+				LOG_DBG("TPHG wait: %u us ...", tphg_us);
+				k_sleep(K_USEC(tphg_us));
+				if (atomic_get(&iaq_stop)) {
+					/* Woken up before the end of the measurement. */
+					break;
+				}
+			}
+		}
+		if (!ret) {
+			/* A read error then only needs the read retried. */
+			measure = false;
+			ret = iaq_read_data(sensor_settings, dev, bme68x_data);
+		}
+
+		if ((ret >= 0) || (step == IAQ_RECOVERY_BUS)) {
+			break;
+		}
+
+		/* Sensor I/O error, escalate unless we'd miss the next BSEC rendez-vous. */
+		int64_t now_ns = iaq_uptime_ns();
+		if (!fault) {
+			fault = true;
+			fault_ns = now_ns;
+		}
+		if ((now_ns + (int64_t)tphg_us * NSEC_PER_USEC) >= sensor_settings->next_call) {
+			LOG_WRN("no time left for sensor fault recovery");
+			break;
+		}
+		step++;
+		int err = iaq_sensor_recover(dev, step);
+		if (err) {
+			/* Next step, if any. */
+			ret = err;
+			if (step == IAQ_RECOVERY_BUS) {
+				break;
+			}
+			continue;
+		}
+		if (step > IAQ_RECOVERY_RETRY) {
+			/* The sensor went back to sleep mode, the measurement is lost. */
+			measure = true;
+		}
+	}
+
+	if (fault) {
+		iaq_recovery_record(step, ret, fault_ns);
+	}
+	return ret;
+}
+
+int iaq_sensor_recover(struct bme68x_dev *dev, int step)
+{
+	if (step == IAQ_RECOVERY_RETRY) {
+		LOG_WRN("sensor I/O error, retrying");
+		return BME68X_OK;
+	}
+
+	if (step == IAQ_RECOVERY_BUS) {
+#if defined(CONFIG_BME68X_SENSOR_API_DRIVER)
+		/* The soft reset is worth trying anyway. */
+		int err = bme68x_sensor_api_recover_bus(dev);
+		LOG_WRN("sensor bus recovery: %d", err);
+#else
+		LOG_WRN("sensor bus recovery unavailable");
+#endif
 	}
 
+	/* The sensor configuration must be fully rewritten. */
+	iaq_trigger_cache.valid = false;
+
+	/* Keeps the calibration data, unlike bme68x_init(). */
+	int8_t ret = bme68x_soft_reset(dev);
+	if (!ret) {
+		uint8_t chip_id;
+		ret = bme68x_get_regs(BME68X_REG_CHIP_ID, &chip_id, 1, dev);
+		if (!ret && (chip_id != dev->chip_id)) {
+			ret = BME68X_E_DEV_NOT_FOUND;
+		}
+	}
+	if (ret) {
+		LOG_ERR("sensor soft reset failed: %d", ret);
+	} else {
+		LOG_WRN("sensor soft reset");
+	}
 	return ret;
 }
 
-size_t iaq_bsec_set_inputs(bsec_bme_settings_t const *sensor_settings, int64_t ts_ns,
-			   struct bme68x_data const *bme68x_data,
-			   bsec_input_t bsec_inputs[BSEC_MAX_PHYSICAL_SENSOR])
+void iaq_recovery_record(int step, int ret, int64_t fault_ns)
+{
+	uint32_t recovery_us = (uint32_t)((iaq_uptime_ns() - fault_ns) / NSEC_PER_USEC);
+
+	k_spinlock_key_t key = k_spin_lock(&iaq_recovery_lock);
+	iaq_recovery_stats.faults++;
+	if (ret < 0) {
+		iaq_recovery_stats.failures++;
+	} else if (step == IAQ_RECOVERY_RETRY) {
+		iaq_recovery_stats.retries++;
+	} else if (step == IAQ_RECOVERY_RESET) {
+		iaq_recovery_stats.resets++;
+	} else {
+		iaq_recovery_stats.bus_recoveries++;
+	}
+	iaq_recovery_stats.last_us = recovery_us;
+	iaq_recovery_stats.max_us = MAX(iaq_recovery_stats.max_us, recovery_us);
+	k_spin_unlock(&iaq_recovery_lock, key);
+
+	LOG_INF("sensor fault %s in %u us (step %d)", (ret < 0) ? "not recovered" : "recovered",
+		recovery_us, step);
+}
+
+void bme68x_iaq_recovery_stats_get(struct bme68x_iaq_recovery_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&iaq_recovery_lock);
+	*stats = iaq_recovery_stats;
+	k_spin_unlock(&iaq_recovery_lock, key);
+}
+
+size_t bme68x_iaq_bsec_set_inputs(bsec_bme_settings_t const *sensor_settings, int64_t ts_ns,
+				  struct bme68x_data const *bme68x_data,
+				  bsec_input_t bsec_inputs[BSEC_MAX_PHYSICAL_SENSOR])
 {
 	size_t n_inputs = 0;
 
@@ -579,28 +1543,41 @@ size_t iaq_bsec_set_inputs(bsec_bme_settings_t const *sensor_settings, int64_t t
 	return n_inputs;
 }
 
-int iaq_next_sample(bsec_bme_settings_t const *sensor_settings, int64_t ts_ns,
-		    struct bme68x_dev *dev, struct bme68x_iaq_sample *iaq_sample)
+int iaq_read_data(bsec_bme_settings_t const *sensor_settings, struct bme68x_dev *dev,
+		  struct bme68x_data *bme68x_data)
 {
 	uint8_t n_data; /* Ignored, always 1 on success in IAQ mode. */
-	struct bme68x_data bme68x_data;
-	int ret = bme68x_get_data(sensor_settings->op_mode, &bme68x_data, &n_data, dev);
+	int ret = bme68x_get_data(sensor_settings->op_mode, bme68x_data, &n_data, dev);
 	if (ret) {
 		if (ret < 0) {
 			LOG_ERR("failed to read BME68X data: %d", ret);
 		} else {
 			LOG_DBG("no new data: %d", ret);
 		}
-		return ret;
 	}
+	return ret;
+}
 
+int iaq_process_data(uint32_t process_data, int64_t ts_ns, struct bme68x_data const *bme68x_data,
+		     struct bme68x_iaq_sample *iaq_sample)
+{
+	bsec_bme_settings_t const sensor_settings = {
+		.process_data = process_data,
+	};
 	bsec_input_t bsec_inputs[BSEC_MAX_PHYSICAL_SENSOR];
-	bsec_output_t bsec_outputs[ARRAY_SIZE(iaq_virt_sensors)];
+	bsec_output_t bsec_outputs[ARRAY_SIZE(bme68x_iaq_virt_sensors)];
 	uint8_t n_outputs = ARRAY_SIZE(bsec_outputs);
 
-	uint8_t n_inputs = iaq_bsec_set_inputs(sensor_settings, ts_ns, &bme68x_data, bsec_inputs);
+	uint8_t n_inputs =
+		bme68x_iaq_bsec_set_inputs(&sensor_settings, ts_ns, bme68x_data, bsec_inputs);
+
+	k_mutex_lock(&iaq_bsec_lock, K_FOREVER);
+	int ret = bsec_do_steps(bsec_inputs, n_inputs, bsec_outputs, &n_outputs);
+	k_mutex_unlock(&iaq_bsec_lock);
+
+	/* Same inputs for the shadow instances, if any. */
+	bme68x_iaq_shadow_process(bsec_inputs, n_inputs, ts_ns);
 
-	ret = bsec_do_steps(bsec_inputs, n_inputs, bsec_outputs, &n_outputs);
 	if (ret) {
 		if (ret < 0) {
 			LOG_ERR("BSEC algorithm error: %d", ret);
@@ -610,11 +1587,235 @@ int iaq_next_sample(bsec_bme_settings_t const *sensor_settings, int64_t ts_ns,
 		return ret;
 	}
 
-	iaq_sample_set_outputs(ts_ns, bsec_outputs, n_outputs, iaq_sample);
+	/* Latest state for an emergency flush, if enabled. */
+	bme68x_iaq_flush_snapshot();
+
+	bme68x_iaq_sample_set_outputs(ts_ns, bsec_outputs, n_outputs, iaq_sample);
+	return 0;
+}
+
+void iaq_sample_dispatch(struct bme68x_iaq_sample const *iaq_sample)
+{
+	iaq_latest_publish(iaq_sample);
+	iaq_observers_notify(iaq_sample);
+
+	/* Update temperature used to compute heater resistance. */
+	atomic_set(&iaq_amb_temp, (int8_t)iaq_sample->temperature);
+}
+
+#if BME68X_IAQ_SPLIT
+int iaq_ring_put(struct iaq_raw_frame const *frame)
+{
+	atomic_val_t head = atomic_get(&iaq_ring.head);
+
+	if ((head - atomic_get(&iaq_ring.tail)) >= IAQ_RING_SIZE) {
+		LOG_WRN("raw frame dropped (%ld)", atomic_inc(&iaq_ring.dropped) + 1);
+		return -ENOBUFS;
+	}
+
+	iaq_ring.frames[head & (IAQ_RING_SIZE - 1)] = *frame;
+
+	/* Frame written before it's published. */
+	barrier_dmem_fence_full();
+	atomic_set(&iaq_ring.head, head + 1);
+
+	k_sem_give(&iaq_ring_sem);
+	return 0;
+}
+
+int iaq_ring_get(struct iaq_raw_frame *frame)
+{
+	atomic_val_t tail = atomic_get(&iaq_ring.tail);
+	if (tail == atomic_get(&iaq_ring.head)) {
+		return -EAGAIN;
+	}
+
+	/* Frame read after it's published, and before it's released. */
+	barrier_dmem_fence_full();
+	*frame = iaq_ring.frames[tail & (IAQ_RING_SIZE - 1)];
+	barrier_dmem_fence_full();
+	atomic_set(&iaq_ring.tail, tail + 1);
 	return 0;
 }
 
-uint32_t iaq_get_tphg_meas_dur(bsec_bme_settings_t const *sensor_settings)
+void iaq_sched_publish(uint32_t frame_id, int64_t ts_ns,
+		       bsec_bme_settings_t const *sensor_settings)
+{
+	atomic_inc(&iaq_sched.seq);
+	barrier_dmem_fence_full();
+	iaq_sched.sched.frame_id = frame_id;
+	iaq_sched.sched.ts_ns = ts_ns;
+	iaq_sched.sched.settings = *sensor_settings;
+	barrier_dmem_fence_full();
+	atomic_inc(&iaq_sched.seq);
+
+	/* The next rendez-vous may have changed. */
+	k_sem_give(&iaq_wake_sem);
+}
+
+bool iaq_sched_get(atomic_val_t *seq, struct iaq_ctrl_req *sched)
+{
+	atomic_val_t begin = atomic_get(&iaq_sched.seq);
+	if ((begin == *seq) || (begin & 1)) {
+		return false;
+	}
+
+	barrier_dmem_fence_full();
+	struct iaq_ctrl_req const copy = iaq_sched.sched;
+	barrier_dmem_fence_full();
+	if (atomic_get(&iaq_sched.seq) != begin) {
+		/* Published meanwhile. */
+		return false;
+	}
+
+	*sched = copy;
+	*seq = begin;
+	return true;
+}
+
+bool iaq_sched_match(bsec_bme_settings_t const *frame, bsec_bme_settings_t const *sensor_settings)
+{
+	return (frame->trigger_measurement == sensor_settings->trigger_measurement) &&
+	       (frame->op_mode == sensor_settings->op_mode) &&
+	       (frame->temperature_oversampling == sensor_settings->temperature_oversampling) &&
+	       (frame->pressure_oversampling == sensor_settings->pressure_oversampling) &&
+	       (frame->humidity_oversampling == sensor_settings->humidity_oversampling) &&
+	       (frame->run_gas == sensor_settings->run_gas) &&
+	       (frame->heater_temperature == sensor_settings->heater_temperature) &&
+	       (frame->heater_duration == sensor_settings->heater_duration);
+}
+
+void iaq_acq_loop(struct bme68x_dev *dev)
+{
+	/* No BSEC control request yet: the first raw frame only gets one. */
+	struct iaq_ctrl_req sched = {0};
+	atomic_val_t seq = 0;
+	uint32_t frame_id = 0;
+	int64_t next_call = 0;
+	int ret = 0;
+
+	while (!atomic_get(&iaq_stop) && (atomic_get(&iaq_proc_status) >= 0)) {
+		if (iaq_sched_get(&seq, &sched) && (sched.frame_id == frame_id)) {
+			/* Up to date BSEC control request: its rendez-vous. */
+			next_call = sched.settings.next_call;
+		}
+
+		int64_t ts_ns = iaq_uptime_ns();
+		bool on_demand = atomic_cas(&iaq_on_demand, 1, 0);
+		if (!on_demand && (ts_ns < next_call)) {
+			iaq_selftest_idle(dev, next_call);
+
+			k_timeout_t timeout = K_FOREVER;
+			if (next_call != INT64_MAX) {
+				timeout = K_NSEC(MAX(next_call - iaq_uptime_ns(), 0));
+			}
+			/* Woken up early by BSEC control requests, on-demand requests or stop. */
+			(void)k_sem_take(&iaq_wake_sem, timeout);
+			continue;
+		}
+
+		/* Period of the last BSEC control request, 0 if none. */
+		int64_t period_ns = sched.settings.next_call - sched.ts_ns;
+		struct iaq_raw_frame frame = {
+			.id = ++frame_id,
+			.ts_ns = ts_ns,
+			.on_demand = on_demand,
+			.status = 1,
+			.settings = sched.settings,
+		};
+
+		if (sched.settings.trigger_measurement &&
+		    (sched.settings.op_mode == BME68X_FORCED_MODE)) {
+			/* Sensor fault recovery must end before the next rendez-vous. */
+			frame.settings.next_call = ts_ns + period_ns;
+			ret = iaq_acquire(&frame.settings, dev, &frame.data);
+			if (ret < 0) {
+				break;
+			}
+			frame.status = ret;
+		}
+		/* Processing thread takes over, even when not measured (BSEC control). */
+		(void)iaq_ring_put(&frame);
+
+		if (!on_demand) {
+			/* Until the BSEC control request for this frame is published. */
+			next_call = (period_ns > 0) ? (ts_ns + period_ns) : INT64_MAX;
+		}
+	}
+
+	if (ret < 0) {
+		/* The processing thread returns after the pending raw frames. */
+		atomic_set(&iaq_acq_status, ret);
+		k_sem_give(&iaq_ring_sem);
+	}
+}
+
+int iaq_proc_loop(void)
+{
+	bsec_bme_settings_t sensor_settings = {0};
+	struct iaq_raw_frame frame;
+	int ret = 0;
+
+	while ((ret >= 0) && !atomic_get(&iaq_stop)) {
+		if (iaq_ring_get(&frame)) {
+			ret = (int)atomic_get(&iaq_acq_status);
+			if (ret < 0) {
+				/* Unrecovered sensor faults ended the acquisition loop. */
+				break;
+			}
+			iaq_nvs_idle(sensor_settings.next_call);
+			(void)k_sem_take(&iaq_ring_sem, K_FOREVER);
+			continue;
+		}
+
+		/*
+		 * BSEC only knows the time from its timestamps: the BSEC control request
+		 * is made at the raw frame's timestamp, however late it's processed.
+		 */
+		int64_t next_call = sensor_settings.next_call;
+		ret = iaq_bsec_control(frame.ts_ns, frame.on_demand, &sensor_settings);
+		if ((ret >= 0) && (sensor_settings.next_call != next_call)) {
+			/* New BSEC control request (not too early). */
+			iaq_sched_publish(frame.id, frame.ts_ns, &sensor_settings);
+		}
+		if (ret || frame.status) {
+			/* Nothing requested, or not measured. */
+			continue;
+		}
+
+		if (!iaq_sched_match(&frame.settings, &sensor_settings)) {
+			/* Measured with the previous BSEC control request. */
+			LOG_INF("sensor settings changed, measurement skipped");
+			continue;
+		}
+		ret = iaq_process(sensor_settings.process_data, frame.ts_ns, &frame.data);
+	}
+
+	iaq_bsec_loop_end();
+	return MIN(ret, 0);
+}
+
+void iaq_proc_main(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	for (;;) {
+		(void)k_sem_take(&iaq_proc_start, K_FOREVER);
+
+		int ret = iaq_proc_loop();
+		if (ret < 0) {
+			/* The acquisition thread returns from bme68x_iaq_run(). */
+			atomic_set(&iaq_proc_status, ret);
+		}
+		k_sem_give(&iaq_wake_sem);
+		k_sem_give(&iaq_proc_done);
+	}
+}
+#endif /* BME68X_IAQ_SPLIT */
+
+uint32_t bme68x_iaq_tphg_meas_dur(bsec_bme_settings_t const *sensor_settings)
 {
 	static uint8_t const os_to_meas_cycles[6] = {0, 1, 2, 4, 8, 16};
 
@@ -637,58 +1838,72 @@ uint32_t iaq_get_tphg_meas_dur(bsec_bme_settings_t const *sensor_settings)
 	return meas_dur + heatr_dur;
 }
 
-void iaq_sample_set_outputs(int64_t ts_ns, bsec_output_t const *bsec_outputs, size_t n_outputs,
-			    struct bme68x_iaq_sample *iaq_sample)
+void bme68x_iaq_sample_set_outputs(int64_t ts_ns, bsec_output_t const *bsec_outputs,
+				   size_t n_outputs, struct bme68x_iaq_sample *iaq_sample)
 {
 	iaq_sample->ts_ns = ts_ns;
 	iaq_sample->cnt_outputs = n_outputs;
+	iaq_sample->channels = 0;
 
 	for (size_t i = 0; i < n_outputs; i++) {
 		switch (bsec_outputs[i].sensor_id) {
 		case BSEC_OUTPUT_RAW_TEMPERATURE:
 			iaq_sample->raw_temperature = bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_RAW_TEMPERATURE;
 			break;
 		case BSEC_OUTPUT_RAW_PRESSURE:
 			iaq_sample->raw_pressure = bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_RAW_PRESSURE;
 			break;
 		case BSEC_OUTPUT_RAW_HUMIDITY:
 			iaq_sample->raw_humidity = bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_RAW_HUMIDITY;
 			break;
 		case BSEC_OUTPUT_RAW_GAS:
 			iaq_sample->raw_gas_res = bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_RAW_GAS;
 			break;
 		case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE:
 			iaq_sample->temperature = bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_TEMPERATURE;
 			break;
 		case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY:
 			iaq_sample->humidity = bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_HUMIDITY;
 			break;
 		case BSEC_OUTPUT_IAQ:
 			iaq_sample->iaq = (uint16_t)bsec_outputs[i].signal;
 			iaq_sample->iaq_accuracy =
 				(enum bme68x_iaq_accuracy)bsec_outputs[i].accuracy;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_IAQ;
 			break;
 		case BSEC_OUTPUT_STATIC_IAQ:
 			iaq_sample->static_iaq = (uint32_t)bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_STATIC_IAQ;
 			break;
 		case BSEC_OUTPUT_CO2_EQUIVALENT:
 			iaq_sample->co2_equivalent = bsec_outputs[i].signal;
 			iaq_sample->co2_accuracy =
 				(enum bme68x_iaq_accuracy)bsec_outputs[i].accuracy;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_CO2;
 			break;
 		case BSEC_OUTPUT_BREATH_VOC_EQUIVALENT:
 			iaq_sample->voc_equivalent = bsec_outputs[i].signal;
 			iaq_sample->voc_accuracy =
 				(enum bme68x_iaq_accuracy)bsec_outputs[i].accuracy;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_VOC;
 			break;
 		case BSEC_OUTPUT_GAS_PERCENTAGE:
 			iaq_sample->gas_percentage = bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_GAS_PERCENTAGE;
 			break;
 		case BSEC_OUTPUT_STABILIZATION_STATUS:
 			iaq_sample->stab_status = (enum bme68x_iaq_status)bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_STAB_STATUS;
 			break;
 		case BSEC_OUTPUT_RUN_IN_STATUS:
 			iaq_sample->run_status = (enum bme68x_iaq_status)bsec_outputs[i].signal;
+			iaq_sample->channels |= BME68X_IAQ_CHAN_RUN_STATUS;
 			break;
 		default:
 			break;
@@ -696,6 +1911,22 @@ void iaq_sample_set_outputs(int64_t ts_ns, bsec_output_t const *bsec_outputs, si
 	}
 }
 
+void iaq_observers_notify(struct bme68x_iaq_sample const *iaq_sample)
+{
+	STRUCT_SECTION_FOREACH(bme68x_iaq_observer, observer) {
+		if (!(observer->channels & iaq_sample->channels)) {
+			continue;
+		}
+
+		if (!observer->cnt) {
+			observer->handler(iaq_sample);
+		}
+		if (++observer->cnt >= observer->decimation) {
+			observer->cnt = 0;
+		}
+	}
+}
+
 int64_t iaq_uptime_ns(void)
 {
 	int64_t ticks = k_uptime_ticks();
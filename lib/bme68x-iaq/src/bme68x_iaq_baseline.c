@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * The baseline partition contains:
+ * - the baseline header (32 bytes)
+ * - the BSEC state (typically 220 bytes)
+ *
+ * The partition is only read by the library, never written.
+ */
+
+#include "bme68x_iaq_baseline.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+#include "bsec_interface.h"
+#include "bme68x_iaq_bsec.h"
+
+#define BME68X_IAQ_BASELINE_PARTITION_ID FIXED_PARTITION_ID(BME68X_IAQ_BASELINE_PARTITION_LABEL)
+
+BUILD_ASSERT(sizeof(struct bme68x_iaq_baseline_hdr) == 32, "unexpected header size");
+
+LOG_MODULE_DECLARE(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
+
+/*
+ * Check a baseline header against the running BSEC library and configuration.
+ *
+ * Returns 0 on success, -ENOENT if no baseline, -EINVAL on invalid header,
+ * -ENOTSUP on BSEC version or configuration mismatch.
+ */
+static int iaq_baseline_check_hdr(struct bme68x_iaq_baseline_hdr *hdr, uint32_t config_crc);
+
+int bme68x_iaq_baseline_read(uint8_t *state, uint32_t size, uint32_t *len, uint32_t config_crc)
+{
+	struct flash_area const *fa;
+	int ret = flash_area_open(BME68X_IAQ_BASELINE_PARTITION_ID, &fa);
+	if (ret) {
+		LOG_ERR("baseline partition unavailable: %d", ret);
+		return ret;
+	}
+
+	struct bme68x_iaq_baseline_hdr hdr;
+	ret = flash_area_read(fa, 0, &hdr, sizeof(hdr));
+	if (!ret) {
+		ret = iaq_baseline_check_hdr(&hdr, config_crc);
+	}
+	if (!ret && (hdr.size > size)) {
+		LOG_ERR("baseline state: invalid size %u", hdr.size);
+		ret = -EINVAL;
+	}
+	if (!ret) {
+		ret = flash_area_read(fa, sizeof(hdr), state, hdr.size);
+	}
+	flash_area_close(fa);
+
+	if (ret) {
+		return ret;
+	}
+	if (crc32_ieee(state, hdr.size) != hdr.crc) {
+		LOG_ERR("baseline state: CRC error");
+		return -EBADMSG;
+	}
+
+	*len = hdr.size;
+	return 0;
+}
+
+int bme68x_iaq_baseline_export(uint8_t *image, size_t size, size_t *len)
+{
+	struct bme68x_iaq_baseline_hdr hdr = {
+		.magic = sys_cpu_to_le32(BME68X_IAQ_BASELINE_MAGIC),
+		.hdr_version = BME68X_IAQ_BASELINE_HDR_VERSION,
+		.config_crc = sys_cpu_to_le32(bme68x_iaq_bsec_config_crc()),
+	};
+
+	if (size < BME68X_IAQ_BASELINE_IMAGE_MAX_SIZE) {
+		return -ENOMEM;
+	}
+
+	bsec_version_t ver;
+	int ret = bsec_get_version(&ver);
+	if (ret) {
+		return ret;
+	}
+	hdr.bsec_version[0] = ver.major;
+	hdr.bsec_version[1] = ver.minor;
+	hdr.bsec_version[2] = ver.major_bugfix;
+	hdr.bsec_version[3] = ver.minor_bugfix;
+
+	uint8_t *state = image + sizeof(hdr);
+	uint32_t state_len;
+	ret = bme68x_iaq_bsec_get_state(state, BSEC_MAX_STATE_BLOB_SIZE, &state_len);
+	if (ret) {
+		LOG_ERR("BSEC state unavailable: %d", ret);
+		return ret;
+	}
+
+	hdr.size = sys_cpu_to_le32(state_len);
+	hdr.crc = sys_cpu_to_le32(crc32_ieee(state, state_len));
+	memcpy(image, &hdr, sizeof(hdr));
+
+	*len = sizeof(hdr) + state_len;
+	LOG_INF("exported baseline state (%u bytes)", state_len);
+	return 0;
+}
+
+int iaq_baseline_check_hdr(struct bme68x_iaq_baseline_hdr *hdr, uint32_t config_crc)
+{
+	hdr->magic = sys_le32_to_cpu(hdr->magic);
+	hdr->config_crc = sys_le32_to_cpu(hdr->config_crc);
+	hdr->size = sys_le32_to_cpu(hdr->size);
+	hdr->crc = sys_le32_to_cpu(hdr->crc);
+
+	if (hdr->magic != BME68X_IAQ_BASELINE_MAGIC) {
+		/* Typically erased flash. */
+		LOG_DBG("no baseline state");
+		return -ENOENT;
+	}
+	if (hdr->hdr_version != BME68X_IAQ_BASELINE_HDR_VERSION) {
+		LOG_ERR("baseline state: unsupported header version %u", hdr->hdr_version);
+		return -EINVAL;
+	}
+
+	bsec_version_t ver;
+	if (bsec_get_version(&ver) || (hdr->bsec_version[0] != ver.major) ||
+	    (hdr->bsec_version[1] != ver.minor) || (hdr->bsec_version[2] != ver.major_bugfix) ||
+	    (hdr->bsec_version[3] != ver.minor_bugfix)) {
+		LOG_WRN("baseline state: BSEC %u.%u.%u.%u mismatch", hdr->bsec_version[0],
+			hdr->bsec_version[1], hdr->bsec_version[2], hdr->bsec_version[3]);
+		return -ENOTSUP;
+	}
+	if (hdr->config_crc != config_crc) {
+		LOG_WRN("baseline state: configuration mismatch (0x%08x)", hdr->config_crc);
+		return -ENOTSUP;
+	}
+	return 0;
+}
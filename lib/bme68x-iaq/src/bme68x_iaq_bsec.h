@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Library internals shared by the single and multi-instance BSEC control loops.
+ */
+
+#ifndef BME68X_IAQ_BSEC_H_
+#define BME68X_IAQ_BSEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bme68x_defs.h"
+#include "bme68x_iaq.h"
+#include "bsec_datatypes.h"
+
+/* Number of BSEC outputs supported in IAQ mode. */
+#define BME68X_IAQ_N_VIRT_SENSORS 13
+
+/*
+ * Virtual sensors for all BSEC outputs supported in IAQ mode,
+ * at the selected (Kconfig) sample rate.
+ */
+extern bsec_sensor_configuration_t const bme68x_iaq_virt_sensors[BME68X_IAQ_N_VIRT_SENSORS];
+
+/*
+ * Get the BSEC configuration for a sensor variant:
+ * - the configuration store's, when enabled and valid for the variant
+ * - BME680 (BME68X_VARIANT_GAS_LOW): CONFIG_BME68X_IAQ_CONFIG_BME680
+ * - BME688 (BME68X_VARIANT_GAS_HIGH): the BME680 configuration,
+ *   BME688 configurations are only loaded from the configuration store
+ *
+ * variant_id: sensor variant, from the initialized BME68X sensor
+ * size: output parameter, configuration size in bytes
+ *
+ * Returns the configuration blob, NULL if none for the variant.
+ */
+uint8_t const *bme68x_iaq_bsec_config(uint32_t variant_id, size_t *size);
+
+/*
+ * Populate BSEC inputs with TPHG data.
+ *
+ * sensor_settings: BSEC control request
+ * ts_ns: timestamp of the BSEC control loop iteration
+ * bme68x_data: TPHG data from controlled BME68X device
+ * bsec_inputs: BSEC algorithm inputs to configure
+ *
+ * Returns the number of configured BSEC inputs (typically 4, TPHG).
+ */
+size_t bme68x_iaq_bsec_set_inputs(bsec_bme_settings_t const *sensor_settings, int64_t ts_ns,
+				  struct bme68x_data const *bme68x_data,
+				  bsec_input_t bsec_inputs[BSEC_MAX_PHYSICAL_SENSOR]);
+
+/*
+ * Compute forced mode TPHG measurement duration in microseconds.
+ *
+ * The duration includes:
+ * - the wake-up time needed to reach the forced mode
+ * - the time needed to measure temperature, pressure, and humidity
+ * - the heating duration needed before we can measure the gas resistance
+ *
+ * sensor_settings: BSEC control request
+ *
+ * Returns the TPHG cycle duration in microseconds.
+ */
+uint32_t bme68x_iaq_tphg_meas_dur(bsec_bme_settings_t const *sensor_settings);
+
+/*
+ * Populate IAQ sample with BSEC output signals.
+ *
+ * ts_ns: timestamp of the BSEC control loop iteration
+ * bsec_outputs: BSEC output signals
+ * n_output: number of BSEC output signals
+ * iaq_sample: IAQ sample to populate
+ */
+void bme68x_iaq_sample_set_outputs(int64_t ts_ns, bsec_output_t const *bsec_outputs,
+				   size_t n_outputs, struct bme68x_iaq_sample *iaq_sample);
+
+/*
+ * Get the state of the control loop's BSEC instance.
+ *
+ * state: destination buffer
+ * size: size of the destination buffer in bytes
+ * len: output parameter, state size in bytes
+ *
+ * Returns 0 on success, BSEC status otherwise.
+ */
+int bme68x_iaq_bsec_get_state(uint8_t *state, uint32_t size, uint32_t *len);
+
+/*
+ * Returns the CRC-32 (IEEE) of the control loop's BSEC configuration.
+ */
+uint32_t bme68x_iaq_bsec_config_crc(void);
+
+/*
+ * Compatibility of a saved BSEC state with the running library and a configuration.
+ */
+enum bme68x_iaq_state_compat {
+	/* Same BSEC version and configuration. */
+	BME68X_IAQ_STATE_COMPAT_MATCH,
+	/* Untagged state, or other BSEC bugfix version: let BSEC check the state. */
+	BME68X_IAQ_STATE_COMPAT_MIGRATE,
+	/* Other BSEC major or minor version, or other configuration. */
+	BME68X_IAQ_STATE_COMPAT_NONE,
+};
+
+struct bme68x_iaq_nvs_meta;
+
+/*
+ * Tag a BSEC state with the running BSEC version and a configuration.
+ *
+ * config_crc: CRC-32 of the BSEC configuration the state was produced with
+ * discards: number of states discarded so far
+ * meta: state tag to populate
+ */
+void bme68x_iaq_bsec_state_tag(uint32_t config_crc, uint32_t discards,
+			       struct bme68x_iaq_nvs_meta *meta);
+
+/*
+ * Check a saved BSEC state's tag against the running BSEC version and a configuration.
+ *
+ * meta: state tag, NULL for untagged states
+ * config_crc: CRC-32 of the loaded BSEC configuration
+ */
+enum bme68x_iaq_state_compat bme68x_iaq_bsec_state_compat(struct bme68x_iaq_nvs_meta const *meta,
+							  uint32_t config_crc);
+
+/*
+ * Read the provisioned baseline state, checked against the running BSEC version
+ * and the given configuration.
+ *
+ * state: destination buffer
+ * size: size of the destination buffer in bytes
+ * len: output parameter, state size in bytes
+ * config_crc: CRC-32 of the loaded BSEC configuration
+ *
+ * Returns 0 on success, -ENOENT if no baseline, -ENOTSUP on BSEC version or
+ * configuration mismatch, negative errno otherwise.
+ */
+int bme68x_iaq_baseline_read(uint8_t *state, uint32_t size, uint32_t *len, uint32_t config_crc);
+
+#if defined(CONFIG_BME68X_IAQ_SHADOW)
+/*
+ * Feed the shadow BSEC instances with the primary instance's inputs,
+ * and notify their callbacks.
+ *
+ * bsec_inputs: BSEC inputs of the primary instance's iteration
+ * n_inputs: number of BSEC inputs
+ * ts_ns: timestamp of the BSEC control loop iteration
+ */
+void bme68x_iaq_shadow_process(bsec_input_t const *bsec_inputs, uint8_t n_inputs, int64_t ts_ns);
+
+/*
+ * Save the shadow BSEC instances' state to their NVS slots.
+ */
+void bme68x_iaq_shadow_save(void);
+#else
+static inline void bme68x_iaq_shadow_process(bsec_input_t const *bsec_inputs, uint8_t n_inputs,
+					     int64_t ts_ns)
+{
+}
+static inline void bme68x_iaq_shadow_save(void)
+{
+}
+#endif
+
+#if defined(CONFIG_BME68X_IAQ_FLUSH)
+/*
+ * Write the last flushed BSEC state, if any, to NVS,
+ * and erase the flush partition for the next flushes.
+ *
+ * Called on initialization, after the NVS initialization
+ * and before the saved state is loaded.
+ */
+void bme68x_iaq_flush_reconcile(void);
+
+/*
+ * Snapshot the BSEC state for the next flush, every
+ * `CONFIG_BME68X_IAQ_FLUSH_SNAPSHOT_DECIM` BSEC iterations.
+ *
+ * NOTE: The calling thread's stack must accommodate the BSEC working buffers.
+ */
+void bme68x_iaq_flush_snapshot(void);
+
+/*
+ * Discard flushed records once the BSEC state has been saved to NVS.
+ */
+void bme68x_iaq_flush_discard(void);
+#else
+static inline void bme68x_iaq_flush_reconcile(void)
+{
+}
+static inline void bme68x_iaq_flush_snapshot(void)
+{
+}
+static inline void bme68x_iaq_flush_discard(void)
+{
+}
+#endif
+
+#if defined(CONFIG_BME68X_IAQ_SELFTEST)
+/*
+ * Run the next step of the requested self-test, if any,
+ * provided it completes before the next BSEC rendez-vous.
+ *
+ * Called by the IAQ control loop while idle, the sensor in sleep mode.
+ *
+ * dev: the controlled BME68X sensor
+ * idle_ns: time until the next BSEC rendez-vous
+ *
+ * Returns true if a step ran, overwriting the sensor configuration.
+ */
+bool bme68x_iaq_selftest_step(struct bme68x_dev *dev, int64_t idle_ns);
+
+/*
+ * Complete the requested self-test, if any, without running its remaining steps.
+ *
+ * result: the result reported to the self-test callback
+ */
+void bme68x_iaq_selftest_cancel(int result);
+#else
+static inline bool bme68x_iaq_selftest_step(struct bme68x_dev *dev, int64_t idle_ns)
+{
+	return false;
+}
+static inline void bme68x_iaq_selftest_cancel(int result)
+{
+}
+#endif
+
+#endif /* BME68X_IAQ_BSEC_H_ */
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_iaq_codec.h"
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+/* Accuracies and status byte fields. */
+#define IAQ_CODEC_ACC_IAQ_POS 0U
+#define IAQ_CODEC_ACC_CO2_POS 2U
+#define IAQ_CODEC_ACC_VOC_POS 4U
+#define IAQ_CODEC_ACC_MSK     0x03U
+#define IAQ_CODEC_STAB_STATUS BIT(6)
+#define IAQ_CODEC_RUN_STATUS  BIT(7)
+
+/*
+ * Round and saturate scaled floating-point value to the given integer range.
+ */
+static inline int32_t iaq_codec_scale(float value, float scale, int32_t min, int32_t max);
+
+void bme68x_iaq_codec_reset(struct bme68x_iaq_codec *codec)
+{
+	bme68x_codec_reset(&codec->ctx);
+}
+
+int bme68x_iaq_encode(struct bme68x_iaq_codec *codec, struct bme68x_iaq_sample const *iaq_sample,
+		      uint8_t *buf, size_t size)
+{
+	int len = bme68x_codec_put_header(&codec->ctx, BME68X_CODEC_TYPE_IAQ, iaq_sample->ts_ns,
+					  BME68X_IAQ_CODEC_PAYLOAD_SIZE, buf, size);
+	if (len < 0) {
+		return len;
+	}
+
+	uint8_t *p = buf + len;
+
+	sys_put_le16((uint16_t)(iaq_sample->channels & BME68X_IAQ_CHAN_ALL), p);
+	p += 2;
+	sys_put_le16((uint16_t)iaq_codec_scale(iaq_sample->raw_temperature, 100.0f, INT16_MIN,
+					       INT16_MAX),
+		     p);
+	p += 2;
+	sys_put_le24((uint32_t)iaq_codec_scale(iaq_sample->raw_pressure, 1.0f, 0, BIT_MASK(24)), p);
+	p += 3;
+	sys_put_le16((uint16_t)iaq_codec_scale(iaq_sample->raw_humidity, 100.0f, 0, UINT16_MAX),
+		     p);
+	p += 2;
+	sys_put_le32((uint32_t)iaq_codec_scale(iaq_sample->raw_gas_res, 1.0f, 0, INT32_MAX), p);
+	p += 4;
+	sys_put_le16(
+		(uint16_t)iaq_codec_scale(iaq_sample->temperature, 100.0f, INT16_MIN, INT16_MAX),
+		p);
+	p += 2;
+	sys_put_le16((uint16_t)iaq_codec_scale(iaq_sample->humidity, 100.0f, 0, UINT16_MAX), p);
+	p += 2;
+	sys_put_le16(iaq_sample->iaq, p);
+	p += 2;
+	sys_put_le16((uint16_t)MIN(iaq_sample->static_iaq, UINT16_MAX), p);
+	p += 2;
+	sys_put_le16((uint16_t)iaq_codec_scale(iaq_sample->co2_equivalent, 1.0f, 0, UINT16_MAX),
+		     p);
+	p += 2;
+	sys_put_le16((uint16_t)iaq_codec_scale(iaq_sample->voc_equivalent, 100.0f, 0, UINT16_MAX),
+		     p);
+	p += 2;
+	*p++ = (uint8_t)iaq_codec_scale(iaq_sample->gas_percentage, 1.0f, 0, UINT8_MAX);
+
+	uint8_t flags = ((iaq_sample->iaq_accuracy & IAQ_CODEC_ACC_MSK) << IAQ_CODEC_ACC_IAQ_POS) |
+			((iaq_sample->co2_accuracy & IAQ_CODEC_ACC_MSK) << IAQ_CODEC_ACC_CO2_POS) |
+			((iaq_sample->voc_accuracy & IAQ_CODEC_ACC_MSK) << IAQ_CODEC_ACC_VOC_POS);
+	if (iaq_sample->stab_status == BME68X_IAQ_STAB_FINISHED) {
+		flags |= IAQ_CODEC_STAB_STATUS;
+	}
+	if (iaq_sample->run_status == BME68X_IAQ_STAB_FINISHED) {
+		flags |= IAQ_CODEC_RUN_STATUS;
+	}
+	*p++ = flags;
+
+	return (int)(p - buf);
+}
+
+int bme68x_iaq_decode(struct bme68x_iaq_codec *codec, uint8_t const *buf, size_t len,
+		      struct bme68x_iaq_sample *iaq_sample)
+{
+	int64_t ts_ns;
+	int hdr_len = bme68x_codec_get_header(&codec->ctx, BME68X_CODEC_TYPE_IAQ,
+					      BME68X_IAQ_CODEC_PAYLOAD_SIZE, buf, len, &ts_ns);
+	if (hdr_len < 0) {
+		return hdr_len;
+	}
+
+	uint8_t const *p = buf + hdr_len;
+
+	iaq_sample->ts_ns = ts_ns;
+	iaq_sample->channels = sys_get_le16(p) & BME68X_IAQ_CHAN_ALL;
+	iaq_sample->cnt_outputs = (uint8_t)POPCOUNT(iaq_sample->channels);
+	p += 2;
+	iaq_sample->raw_temperature = (int16_t)sys_get_le16(p) / 100.0f;
+	p += 2;
+	iaq_sample->raw_pressure = (float)sys_get_le24(p);
+	p += 3;
+	iaq_sample->raw_humidity = sys_get_le16(p) / 100.0f;
+	p += 2;
+	iaq_sample->raw_gas_res = (float)sys_get_le32(p);
+	p += 4;
+	iaq_sample->temperature = (int16_t)sys_get_le16(p) / 100.0f;
+	p += 2;
+	iaq_sample->humidity = sys_get_le16(p) / 100.0f;
+	p += 2;
+	iaq_sample->iaq = sys_get_le16(p);
+	p += 2;
+	iaq_sample->static_iaq = sys_get_le16(p);
+	p += 2;
+	iaq_sample->co2_equivalent = (float)sys_get_le16(p);
+	p += 2;
+	iaq_sample->voc_equivalent = sys_get_le16(p) / 100.0f;
+	p += 2;
+	iaq_sample->gas_percentage = (float)*p++;
+
+	uint8_t flags = *p++;
+	iaq_sample->iaq_accuracy =
+		(enum bme68x_iaq_accuracy)((flags >> IAQ_CODEC_ACC_IAQ_POS) & IAQ_CODEC_ACC_MSK);
+	iaq_sample->co2_accuracy =
+		(enum bme68x_iaq_accuracy)((flags >> IAQ_CODEC_ACC_CO2_POS) & IAQ_CODEC_ACC_MSK);
+	iaq_sample->voc_accuracy =
+		(enum bme68x_iaq_accuracy)((flags >> IAQ_CODEC_ACC_VOC_POS) & IAQ_CODEC_ACC_MSK);
+	iaq_sample->stab_status = (flags & IAQ_CODEC_STAB_STATUS) ? BME68X_IAQ_STAB_FINISHED
+								  : BME68X_IAQ_STAB_ONGOING;
+	iaq_sample->run_status = (flags & IAQ_CODEC_RUN_STATUS) ? BME68X_IAQ_STAB_FINISHED
+								: BME68X_IAQ_STAB_ONGOING;
+
+	return (int)(p - buf);
+}
+
+int32_t iaq_codec_scale(float value, float scale, int32_t min, int32_t max)
+{
+	float scaled = value * scale;
+
+	if (scaled <= (float)min) {
+		return min;
+	}
+	if (scaled >= (float)max) {
+		return max;
+	}
+	return (int32_t)(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+}
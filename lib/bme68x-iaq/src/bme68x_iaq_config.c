@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Embedded BSEC IAQ configurations (Kconfig), selected at runtime
+ * from the sensor variant, unless overridden by the configuration store.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/logging/log.h>
+
+#include "bme68x_defs.h"
+#include "bme68x_iaq_bsec.h"
+#include "bme68x_iaq_config_store.h"
+/*
+ * Generated: declares bsec_config_bme680.
+ *
+ * NOTE: Typical configuration is just over 2 kB.
+ */
+#include "bme68x_iaq_config.h"
+
+LOG_MODULE_DECLARE(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
+
+uint8_t const *bme68x_iaq_bsec_config(uint32_t variant_id, size_t *size)
+{
+#if defined(CONFIG_BME68X_IAQ_CONFIG_STORE)
+	uint8_t const *config;
+	int ret = bme68x_iaq_config_store_load(variant_id, &config, size, NULL);
+	if (!ret) {
+		return config;
+	}
+	if (ret != -ENOENT) {
+		LOG_WRN("invalid stored configuration (%d), using built-in", ret);
+	}
+#endif
+
+	switch (variant_id) {
+	case BME68X_VARIANT_GAS_HIGH:
+		/*
+		 * Only the BME680 configurations are embedded, which BSEC also
+		 * runs on BME688 (forced mode): BME688 specific configurations
+		 * are provided through the configuration store.
+		 */
+		LOG_INF("BME688: built-in BME680 configuration");
+		/* Fall through. */
+
+	case BME68X_VARIANT_GAS_LOW:
+#if defined(CONFIG_BME68X_IAQ_CONFIG_BME680)
+		*size = sizeof(bsec_config_bme680);
+		return bsec_config_bme680;
+#endif
+		break;
+
+	default:
+		break;
+	}
+	return NULL;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * The configuration store partition contains:
+ * - the store header (64 bytes)
+ * - the BSEC configuration blob (typically 2063 bytes)
+ */
+
+#include "bme68x_iaq_config_store.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+#include "bsec_datatypes.h"
+
+#define BME68X_IAQ_CONFIG_STORE_PARTITION_ID                                                       \
+	FIXED_PARTITION_ID(BME68X_IAQ_CONFIG_STORE_PARTITION_LABEL)
+#define BME68X_IAQ_CONFIG_STORE_PARTITION_OFFSET                                                   \
+	FIXED_PARTITION_OFFSET(BME68X_IAQ_CONFIG_STORE_PARTITION_LABEL)
+
+#if defined(CONFIG_BME68X_IAQ_CONFIG_STORE_XIP)
+#define BME68X_IAQ_CONFIG_STORE_XIP 1
+#else
+#define BME68X_IAQ_CONFIG_STORE_XIP 0
+#endif
+
+#if BME68X_IAQ_CONFIG_STORE_XIP
+/* The blob address is computed from CONFIG_FLASH_BASE_ADDRESS. */
+#define BME68X_IAQ_CONFIG_STORE_NODE DT_NODELABEL(BME68X_IAQ_CONFIG_STORE_PARTITION_LABEL)
+BUILD_ASSERT(DT_SAME_NODE(DT_MTD_FROM_FIXED_PARTITION(BME68X_IAQ_CONFIG_STORE_NODE),
+			  DT_PARENT(DT_CHOSEN(zephyr_flash))),
+	     "configuration store not on the XIP flash, disable BME68X_IAQ_CONFIG_STORE_XIP");
+#endif
+
+BUILD_ASSERT(sizeof(struct bme68x_iaq_config_store_hdr) == 64, "unexpected header size");
+
+LOG_MODULE_DECLARE(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
+
+/*
+ * Read and check the store header.
+ *
+ * fa: the store partition, opened
+ * variant_id: sensor variant the configuration is intended for
+ * hdr: output parameter, store header (host byte order)
+ *
+ * Returns 0 on success, negative errno otherwise.
+ */
+static int iaq_config_store_read_hdr(struct flash_area const *fa, uint32_t variant_id,
+				     struct bme68x_iaq_config_store_hdr *hdr);
+
+#if !BME68X_IAQ_CONFIG_STORE_XIP
+/* RAM copy of the stored configuration. */
+static uint8_t iaq_config_store_buf[BSEC_MAX_PROPERTY_BLOB_SIZE];
+#endif
+
+int bme68x_iaq_config_store_load(uint32_t variant_id, uint8_t const **config, size_t *size,
+				 struct bme68x_iaq_config_store_hdr *hdr)
+{
+	struct flash_area const *fa;
+	int ret = flash_area_open(BME68X_IAQ_CONFIG_STORE_PARTITION_ID, &fa);
+	if (ret) {
+		LOG_ERR("configuration store unavailable: %d", ret);
+		return ret;
+	}
+
+	struct bme68x_iaq_config_store_hdr store_hdr;
+	ret = iaq_config_store_read_hdr(fa, variant_id, &store_hdr);
+	if (ret) {
+		goto store_close;
+	}
+
+#if BME68X_IAQ_CONFIG_STORE_XIP
+	/* Zero-copy: BSEC reads the configuration from memory-mapped flash. */
+	uint8_t const *blob = (uint8_t const *)(CONFIG_FLASH_BASE_ADDRESS +
+						BME68X_IAQ_CONFIG_STORE_PARTITION_OFFSET +
+						sizeof(store_hdr));
+#else
+	uint8_t *blob = iaq_config_store_buf;
+	ret = flash_area_read(fa, sizeof(store_hdr), blob, store_hdr.size);
+	if (ret) {
+		LOG_ERR("failed to read stored configuration: %d", ret);
+		goto store_close;
+	}
+#endif
+
+	if (crc32_ieee(blob, store_hdr.size) != store_hdr.crc) {
+		LOG_ERR("stored configuration: CRC error");
+		ret = -EBADMSG;
+		goto store_close;
+	}
+
+	LOG_INF("stored configuration: %s v%u (%u bytes)", store_hdr.name, store_hdr.version,
+		store_hdr.size);
+	*config = blob;
+	*size = store_hdr.size;
+	if (hdr) {
+		*hdr = store_hdr;
+	}
+
+store_close:
+	flash_area_close(fa);
+	return ret;
+}
+
+int iaq_config_store_read_hdr(struct flash_area const *fa, uint32_t variant_id,
+			      struct bme68x_iaq_config_store_hdr *hdr)
+{
+	int ret = flash_area_read(fa, 0, hdr, sizeof(*hdr));
+	if (ret) {
+		LOG_ERR("failed to read configuration store: %d", ret);
+		return ret;
+	}
+
+	hdr->magic = sys_le32_to_cpu(hdr->magic);
+	hdr->version = sys_le32_to_cpu(hdr->version);
+	hdr->size = sys_le32_to_cpu(hdr->size);
+	hdr->crc = sys_le32_to_cpu(hdr->crc);
+	/* Never trust the stored name. */
+	hdr->name[sizeof(hdr->name) - 1] = '\0';
+
+	if (hdr->magic != BME68X_IAQ_CONFIG_STORE_MAGIC) {
+		/* Typically erased flash. */
+		LOG_DBG("no stored configuration");
+		return -ENOENT;
+	}
+	if (hdr->hdr_version != BME68X_IAQ_CONFIG_STORE_HDR_VERSION) {
+		LOG_ERR("stored configuration: unsupported header version %u", hdr->hdr_version);
+		return -EINVAL;
+	}
+	if (!hdr->size || (hdr->size > BSEC_MAX_PROPERTY_BLOB_SIZE) ||
+	    (hdr->size > (fa->fa_size - sizeof(*hdr)))) {
+		LOG_ERR("stored configuration: invalid size %u", hdr->size);
+		return -EINVAL;
+	}
+	if ((hdr->variant != BME68X_IAQ_CONFIG_STORE_ANY_VARIANT) &&
+	    (hdr->variant != variant_id)) {
+		LOG_WRN("stored configuration %s: variant %u, sensor %u", hdr->name, hdr->variant,
+			variant_id);
+		return -ENOTSUP;
+	}
+	return 0;
+}
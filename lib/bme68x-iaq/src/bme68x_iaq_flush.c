@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * The flush partition contains flush records, appended from offset zero:
+ * - the record header (32 bytes), with the state tag
+ * - the BSEC state (typically 220 bytes)
+ * - padding to the flash write block size
+ *
+ * The partition is erased on boot, once the last record has been
+ * written to NVS, and after each periodic state save,
+ * so that a flush never has to erase flash.
+ */
+
+#include "bme68x_iaq_flush.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+
+#include "bsec_datatypes.h"
+#include "bme68x_iaq_bsec.h"
+
+#define BME68X_IAQ_FLUSH_PARTITION_ID FIXED_PARTITION_ID(BME68X_IAQ_FLUSH_PARTITION_LABEL)
+
+/* Largest supported flash write block size. */
+#define BME68X_IAQ_FLUSH_ALIGN_MAX 32U
+
+/* Size of the largest flush record. */
+#define BME68X_IAQ_FLUSH_REC_MAX                                                                   \
+	ROUND_UP(sizeof(struct bme68x_iaq_flush_hdr) + BSEC_MAX_STATE_BLOB_SIZE,                   \
+		 BME68X_IAQ_FLUSH_ALIGN_MAX)
+
+BUILD_ASSERT(sizeof(struct bme68x_iaq_flush_hdr) == 32, "unexpected header size");
+
+LOG_MODULE_DECLARE(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
+
+/*
+ * Read the flush record at a given offset.
+ *
+ * fa: the flush partition, opened
+ * off: record offset
+ * rec_size: output parameter, record size in bytes (padded)
+ *
+ * Returns 0 on success, the record in iaq_flush_rec,
+ * -ENOENT if erased, -EBADMSG if invalid, negative errno otherwise.
+ */
+static int iaq_flush_read_rec(struct flash_area const *fa, off_t off, size_t *rec_size);
+
+/*
+ * Whether the flush partition is erased from a given offset.
+ */
+static bool iaq_flush_is_erased(struct flash_area const *fa, off_t off);
+
+/* Double-buffered BSEC state snapshots. */
+static struct {
+	uint32_t len;
+	struct bme68x_iaq_nvs_meta meta;
+	uint8_t state[BSEC_MAX_STATE_BLOB_SIZE];
+} iaq_flush_snaps[2];
+/* Index of the latest snapshot, negative if none. */
+static atomic_t iaq_flush_snap_idx = ATOMIC_INIT(-1);
+/* BSEC iterations since the latest snapshot. */
+static uint32_t iaq_flush_iter;
+
+/* Flush partition, opened once reconciled, NULL if unavailable. */
+static struct flash_area const *iaq_flush_fa;
+/* Offset of the next record. */
+static off_t iaq_flush_off;
+/* Flash write block size and erased value. */
+static size_t iaq_flush_align;
+static uint8_t iaq_flush_erased;
+/* Set while a flush is in progress. */
+static atomic_t iaq_flush_busy;
+
+/* Record buffer, static so that flushes don't need a large stack. */
+static uint8_t iaq_flush_rec[BME68X_IAQ_FLUSH_REC_MAX] __aligned(4);
+
+int bme68x_iaq_flush(void)
+{
+	struct flash_area const *fa = iaq_flush_fa;
+	if (!fa) {
+		return -ENODEV;
+	}
+	if (!atomic_cas(&iaq_flush_busy, 0, 1)) {
+		return -EBUSY;
+	}
+
+	int ret = 0;
+	atomic_val_t idx = atomic_get(&iaq_flush_snap_idx);
+	if (idx < 0) {
+		ret = -ENODATA;
+		goto flush_done;
+	}
+
+	uint32_t len = iaq_flush_snaps[idx].len;
+	size_t rec_size = ROUND_UP(sizeof(struct bme68x_iaq_flush_hdr) + len, iaq_flush_align);
+	if ((iaq_flush_off + rec_size) > fa->fa_size) {
+		ret = -ENOSPC;
+		goto flush_done;
+	}
+
+	struct bme68x_iaq_flush_hdr *hdr = (struct bme68x_iaq_flush_hdr *)iaq_flush_rec;
+	*hdr = (struct bme68x_iaq_flush_hdr){
+		.magic = sys_cpu_to_le32(BME68X_IAQ_FLUSH_MAGIC),
+		.size = sys_cpu_to_le32(len),
+		.meta = iaq_flush_snaps[idx].meta,
+	};
+	memcpy(&iaq_flush_rec[sizeof(*hdr)], iaq_flush_snaps[idx].state, len);
+	memset(&iaq_flush_rec[sizeof(*hdr) + len], iaq_flush_erased,
+	       rec_size - sizeof(*hdr) - len);
+	/* State tag and BSEC state are contiguous. */
+	uint32_t crc = crc32_ieee((uint8_t const *)&hdr->meta, sizeof(hdr->meta) + len);
+	hdr->crc = sys_cpu_to_le32(crc);
+
+	ret = flash_area_write(fa, iaq_flush_off, iaq_flush_rec, rec_size);
+	if (!ret) {
+		iaq_flush_off += rec_size;
+	}
+
+flush_done:
+	atomic_clear(&iaq_flush_busy);
+	return ret;
+}
+
+void bme68x_iaq_flush_snapshot(void)
+{
+	if ((++iaq_flush_iter < CONFIG_BME68X_IAQ_FLUSH_SNAPSHOT_DECIM) ||
+	    atomic_get(&iaq_flush_busy)) {
+		/* Never overwrite a snapshot that may be being flushed. */
+		return;
+	}
+	iaq_flush_iter = 0;
+
+	/* Write the other buffer, then publish it. */
+	atomic_val_t idx = (atomic_get(&iaq_flush_snap_idx) == 0) ? 1 : 0;
+	int ret = bme68x_iaq_bsec_get_state(iaq_flush_snaps[idx].state,
+					    sizeof(iaq_flush_snaps[idx].state),
+					    &iaq_flush_snaps[idx].len);
+	if (ret) {
+		LOG_WRN("BSEC state snapshot failed: %d", ret);
+		return;
+	}
+
+	struct bme68x_iaq_state_info info;
+	bme68x_iaq_state_info_get(&info);
+	bme68x_iaq_bsec_state_tag(bme68x_iaq_bsec_config_crc(), info.discards,
+				  &iaq_flush_snaps[idx].meta);
+	atomic_set(&iaq_flush_snap_idx, idx);
+}
+
+void bme68x_iaq_flush_discard(void)
+{
+	if (!iaq_flush_fa || !atomic_cas(&iaq_flush_busy, 0, 1)) {
+		return;
+	}
+
+	/* Flushed records are older than the saved state. */
+	if (iaq_flush_off) {
+		int ret = flash_area_erase(iaq_flush_fa, 0, iaq_flush_fa->fa_size);
+		if (ret) {
+			/* Would overwrite the saved state on next boot. */
+			LOG_ERR("failed to erase flush partition: %d", ret);
+			flash_area_close(iaq_flush_fa);
+			iaq_flush_fa = NULL;
+		} else {
+			iaq_flush_off = 0;
+		}
+	}
+
+	atomic_clear(&iaq_flush_busy);
+}
+
+void bme68x_iaq_flush_reconcile(void)
+{
+	/* No flush until reconciled. */
+	if (iaq_flush_fa) {
+		flash_area_close(iaq_flush_fa);
+		iaq_flush_fa = NULL;
+	}
+	atomic_set(&iaq_flush_snap_idx, -1);
+	iaq_flush_iter = 0;
+
+	struct flash_area const *fa;
+	int ret = flash_area_open(BME68X_IAQ_FLUSH_PARTITION_ID, &fa);
+	if (ret) {
+		LOG_ERR("flush partition unavailable: %d", ret);
+		return;
+	}
+
+	iaq_flush_align = flash_area_align(fa);
+	iaq_flush_erased = flash_area_erased_val(fa);
+	if (!iaq_flush_align || (iaq_flush_align > BME68X_IAQ_FLUSH_ALIGN_MAX)) {
+		LOG_ERR("flush partition: unsupported write block size %u", iaq_flush_align);
+		flash_area_close(fa);
+		return;
+	}
+
+	/* The last valid record is the most recent flush. */
+	uint8_t state[BSEC_MAX_STATE_BLOB_SIZE];
+	struct bme68x_iaq_nvs_meta meta;
+	uint32_t len = 0;
+	off_t off = 0;
+	size_t rec_size;
+
+	while ((ret = iaq_flush_read_rec(fa, off, &rec_size)) == 0) {
+		struct bme68x_iaq_flush_hdr const *hdr =
+			(struct bme68x_iaq_flush_hdr const *)iaq_flush_rec;
+		len = sys_le32_to_cpu(hdr->size);
+		meta = hdr->meta;
+		memcpy(state, &iaq_flush_rec[sizeof(*hdr)], len);
+		off += rec_size;
+	}
+	/* Torn or invalid record: the partition needs erasing. */
+	bool erased = (ret == -ENOENT) && iaq_flush_is_erased(fa, off);
+
+	if (len) {
+		ret = bme68x_iaq_nvs_write_slot_state(0, state, len, &meta);
+		if (ret) {
+			/* Keep the flushed state for the next boot, append if possible. */
+			LOG_ERR("failed to reconcile flushed BSEC state: %d", ret);
+			if (erased) {
+				iaq_flush_off = off;
+				iaq_flush_fa = fa;
+			} else {
+				flash_area_close(fa);
+			}
+			return;
+		}
+		LOG_INF("reconciled flushed BSEC state (%u bytes)", len);
+	}
+
+	if (!erased || off) {
+		ret = flash_area_erase(fa, 0, fa->fa_size);
+		if (ret) {
+			LOG_ERR("failed to erase flush partition: %d", ret);
+			flash_area_close(fa);
+			return;
+		}
+	}
+
+	iaq_flush_off = 0;
+	iaq_flush_fa = fa;
+}
+
+int iaq_flush_read_rec(struct flash_area const *fa, off_t off, size_t *rec_size)
+{
+	struct bme68x_iaq_flush_hdr *hdr = (struct bme68x_iaq_flush_hdr *)iaq_flush_rec;
+	if ((off + sizeof(*hdr)) > fa->fa_size) {
+		return -ENOENT;
+	}
+
+	int ret = flash_area_read(fa, off, hdr, sizeof(*hdr));
+	if (ret) {
+		LOG_ERR("failed to read flush partition: %d", ret);
+		return ret;
+	}
+
+	uint32_t magic = sys_le32_to_cpu(hdr->magic);
+	if (magic != BME68X_IAQ_FLUSH_MAGIC) {
+		uint32_t erased;
+		memset(&erased, iaq_flush_erased, sizeof(erased));
+		return (magic == erased) ? -ENOENT : -EBADMSG;
+	}
+
+	uint32_t len = sys_le32_to_cpu(hdr->size);
+	*rec_size = ROUND_UP(sizeof(*hdr) + len, iaq_flush_align);
+	if (!len || (len > BSEC_MAX_STATE_BLOB_SIZE) || ((off + *rec_size) > fa->fa_size)) {
+		return -EBADMSG;
+	}
+
+	ret = flash_area_read(fa, off + sizeof(*hdr), &iaq_flush_rec[sizeof(*hdr)], len);
+	if (ret) {
+		LOG_ERR("failed to read flush partition: %d", ret);
+		return ret;
+	}
+	if (crc32_ieee((uint8_t const *)&hdr->meta, sizeof(hdr->meta) + len) !=
+	    sys_le32_to_cpu(hdr->crc)) {
+		/* Typically power lost while flushing. */
+		LOG_WRN("flush record at 0x%lx: CRC error", (long)off);
+		return -EBADMSG;
+	}
+	return 0;
+}
+
+bool iaq_flush_is_erased(struct flash_area const *fa, off_t off)
+{
+	while (off < fa->fa_size) {
+		size_t n = MIN(sizeof(iaq_flush_rec), fa->fa_size - off);
+		if (flash_area_read(fa, off, iaq_flush_rec, n)) {
+			return false;
+		}
+		for (size_t i = 0; i < n; i++) {
+			if (iaq_flush_rec[i] != iaq_flush_erased) {
+				return false;
+			}
+		}
+		off += n;
+	}
+	return true;
+}
@@ -0,0 +1,891 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Journal entries are FCB elements, one FCB per entry kind on the journal partition:
+ * minute, hour and day aggregates first (Kconfig), raw samples in the remaining sectors.
+ * - first byte: entry kind (enum bme68x_iaq_journal_kind)
+ * - IAQ samples: compact encoding (key frame, absolute journal time)
+ * - aggregates: start time (int64), then for each field min, max, mean (int32)
+ *   and count (uint32), little-endian
+ *
+ * Each FCB rotates (erases its oldest sector) when full: queries only walk
+ * the aggregates of their level, and raw samples never push aggregates out.
+ *
+ * Entries are serialized by the IAQ observer, and appended to the FCB
+ * by the journal writer thread: flash writes and sector erases never
+ * delay the IAQ control loop.
+ */
+
+#include "bme68x_iaq_journal.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/fs/fcb.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "bme68x_iaq_codec.h"
+
+LOG_MODULE_DECLARE(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
+
+#define IAQ_JOURNAL_PARTITION_ID FIXED_PARTITION_ID(BME68X_IAQ_JOURNAL_PARTITION_LABEL)
+
+/* FCB magic ("BMEJ", plus the entry kind) and version of the journal format. */
+#define IAQ_JOURNAL_FCB_MAGIC   0x424d454aU
+#define IAQ_JOURNAL_FCB_VERSION 2U
+
+/* One FCB per entry kind. */
+#define IAQ_JOURNAL_FCB_COUNT (BME68X_IAQ_JOURNAL_KIND_DAY + 1)
+
+/* Size of a serialized aggregate entry. */
+#define IAQ_JOURNAL_AGGREGATE_SIZE (1U + 8U + (BME68X_IAQ_JOURNAL_FIELD_COUNT * 16U))
+
+/* Size of the largest journal entry. */
+#define IAQ_JOURNAL_ENTRY_MAX_SIZE MAX(IAQ_JOURNAL_AGGREGATE_SIZE, 1U + BME68X_IAQ_CODEC_MAX_SIZE)
+
+/* Largest supported flash write block size, entries are padded to it. */
+#define IAQ_JOURNAL_ALIGN_MAX 32U
+
+/*
+ * Serialized entry, queued for the journal writer.
+ */
+struct iaq_journal_msg {
+	uint16_t len;
+	uint8_t data[ROUND_UP(IAQ_JOURNAL_ENTRY_MAX_SIZE, IAQ_JOURNAL_ALIGN_MAX)];
+};
+
+/*
+ * Rollup accumulator, for both the open aggregation intervals
+ * and the answers to queries.
+ */
+struct iaq_journal_acc {
+	int64_t start_ms;
+	int64_t sum[BME68X_IAQ_JOURNAL_FIELD_COUNT];
+	struct bme68x_iaq_rollup fields[BME68X_IAQ_JOURNAL_FIELD_COUNT];
+};
+
+/*
+ * Aggregates cached in RAM for a given level (ring buffer, oldest at tail).
+ */
+struct iaq_journal_ring {
+	struct bme68x_iaq_aggregate *buf;
+	size_t size;
+	size_t head;
+	size_t len;
+};
+
+/*
+ * Aggregation level state: open interval and recently closed aggregates.
+ */
+struct iaq_journal_level {
+	int64_t period_ms;
+	bool open;
+	struct iaq_journal_acc acc;
+	struct iaq_journal_ring ring;
+};
+
+/*
+ * State rebuilt from an FCB by bme68x_iaq_journal_init().
+ */
+struct iaq_journal_rebuild {
+	/* Start (aggregates) or timestamp (samples) of the last entry, INT64_MIN if none. */
+	int64_t last_ms;
+	/*
+	 * Entries of the last interval of the level above (open interval candidate),
+	 * start INT64_MIN if none.
+	 */
+	struct iaq_journal_acc acc;
+};
+
+/*
+ * Walk context for bme68x_iaq_journal_walk().
+ */
+struct iaq_journal_walk_ctx {
+	uint32_t kinds;
+	int64_t from_ms;
+	int64_t to_ms;
+	bme68x_iaq_journal_walk_cb cb;
+	void *user_data;
+};
+
+/*
+ * IAQ observer: aggregate the sample and append it to the journal.
+ */
+static void iaq_journal_handler(struct bme68x_iaq_sample const *iaq_sample);
+
+/*
+ * Close open interval: cache the aggregate in RAM and append it to the journal.
+ */
+static void iaq_journal_close(enum bme68x_iaq_journal_level level);
+
+/*
+ * Mount the FCB of an entry kind on its sectors,
+ * erasing them first if they hold another format.
+ *
+ * Returns 0 on success, negative errno otherwise.
+ */
+static int iaq_journal_fcb_init(enum bme68x_iaq_journal_kind kind, struct flash_sector *sectors,
+				uint32_t sector_cnt);
+
+/*
+ * Rebuild the aggregation state from the journal, as if the IAQ samples
+ * were aggregated without reset: RAM cached aggregates, and open intervals
+ * from the entries not yet aggregated at the level above.
+ *
+ * The open minute is rebuilt from the journaled raw samples of the active sector.
+ */
+static void iaq_journal_rebuild(void);
+
+/* Walk callback for bme68x_iaq_journal_init(), see struct iaq_journal_rebuild. */
+static int iaq_journal_rebuild_entry(struct bme68x_iaq_journal_entry const *entry,
+				     void *user_data);
+
+/* Cache aggregate in RAM, dropping the oldest when full. */
+static void iaq_journal_ring_push(struct iaq_journal_ring *ring,
+				  struct bme68x_iaq_aggregate const *aggregate);
+
+/*
+ * Queue entry for the journal writer, dropped if the queue is full.
+ */
+static void iaq_journal_enqueue(struct iaq_journal_msg const *msg);
+
+/*
+ * Journal writer thread: append queued entries to the FCB.
+ */
+static void iaq_journal_writer(void *p1, void *p2, void *p3);
+
+/*
+ * Append entry to the FCB, rotating the oldest sector when full.
+ * The entry is padded in place to the flash write block size.
+ *
+ * Returns 0 on success, negative errno otherwise.
+ */
+static int iaq_journal_append(struct iaq_journal_msg *msg);
+
+/*
+ * FCB walk callback: decode entry and forward it to the walk context callback.
+ */
+static int iaq_journal_walk_entry(struct fcb_entry_ctx *loc_ctx, void *arg);
+
+/* Walk callback for queries: merge aggregates into the accumulator. */
+static int iaq_journal_query_entry(struct bme68x_iaq_journal_entry const *entry, void *user_data);
+
+/* Rollup accumulator helpers. */
+static void iaq_journal_acc_reset(struct iaq_journal_acc *acc, int64_t start_ms);
+static void iaq_journal_acc_add_value(struct iaq_journal_acc *acc,
+				      enum bme68x_iaq_journal_field field, int32_t value);
+static void iaq_journal_acc_add_sample(struct iaq_journal_acc *acc,
+				       struct bme68x_iaq_sample const *iaq_sample);
+static void iaq_journal_acc_add_aggregate(struct iaq_journal_acc *acc,
+					  struct bme68x_iaq_aggregate const *aggregate);
+static void iaq_journal_acc_get(struct iaq_journal_acc const *acc,
+				struct bme68x_iaq_aggregate *aggregate);
+
+/* Aggregate (de)serialization. */
+static size_t iaq_journal_put_aggregate(enum bme68x_iaq_journal_kind kind,
+					struct bme68x_iaq_aggregate const *aggregate,
+					uint8_t *buf);
+static void iaq_journal_get_aggregate(uint8_t const *buf, struct bme68x_iaq_aggregate *aggregate);
+
+BME68X_IAQ_OBSERVER_DEFINE(iaq_journal_observer, iaq_journal_handler, 1, BME68X_IAQ_CHAN_ALL);
+
+static struct bme68x_iaq_aggregate iaq_journal_minutes[CONFIG_BME68X_IAQ_JOURNAL_MINUTES];
+static struct bme68x_iaq_aggregate iaq_journal_hours[CONFIG_BME68X_IAQ_JOURNAL_HOURS];
+static struct bme68x_iaq_aggregate iaq_journal_days[CONFIG_BME68X_IAQ_JOURNAL_DAYS];
+
+static struct iaq_journal_level iaq_journal_levels[BME68X_IAQ_JOURNAL_LEVEL_COUNT] = {
+	[BME68X_IAQ_JOURNAL_MINUTE] = {
+		.period_ms = 60 * MSEC_PER_SEC,
+		.ring = {
+			.buf = iaq_journal_minutes,
+			.size = ARRAY_SIZE(iaq_journal_minutes),
+		},
+	},
+	[BME68X_IAQ_JOURNAL_HOUR] = {
+		.period_ms = 3600 * MSEC_PER_SEC,
+		.ring = {
+			.buf = iaq_journal_hours,
+			.size = ARRAY_SIZE(iaq_journal_hours),
+		},
+	},
+	[BME68X_IAQ_JOURNAL_DAY] = {
+		.period_ms = 86400 * MSEC_PER_SEC,
+		.ring = {
+			.buf = iaq_journal_days,
+			.size = ARRAY_SIZE(iaq_journal_days),
+		},
+	},
+};
+
+/* Number of sectors of each aggregate FCB, from the start of the partition. */
+static uint8_t const iaq_journal_agg_sectors[IAQ_JOURNAL_FCB_COUNT] = {
+	[BME68X_IAQ_JOURNAL_KIND_MINUTE] = CONFIG_BME68X_IAQ_JOURNAL_MINUTE_SECTORS,
+	[BME68X_IAQ_JOURNAL_KIND_HOUR] = CONFIG_BME68X_IAQ_JOURNAL_HOUR_SECTORS,
+	[BME68X_IAQ_JOURNAL_KIND_DAY] = CONFIG_BME68X_IAQ_JOURNAL_DAY_SECTORS,
+};
+
+static struct flash_sector iaq_journal_sectors[CONFIG_BME68X_IAQ_JOURNAL_MAX_SECTORS];
+static struct fcb iaq_journal_fcbs[IAQ_JOURNAL_FCB_COUNT];
+static uint32_t iaq_journal_align;
+static bool iaq_journal_ready;
+
+/* Offset from uptime to journal time. */
+static int64_t iaq_journal_offset_ms;
+
+#if CONFIG_BME68X_IAQ_JOURNAL_SAMPLE_DECIMATION > 0
+/* Raw samples decimation counter. */
+static uint32_t iaq_journal_sample_cnt;
+#endif
+
+/* Protects the aggregation state, shared by the IAQ loop and the queries. */
+K_MUTEX_DEFINE(iaq_journal_mutex);
+
+/* Serializes the journal writer and the readers walking the FCB. */
+K_MUTEX_DEFINE(iaq_journal_fcb_mutex);
+
+K_MSGQ_DEFINE(iaq_journal_msgq, sizeof(struct iaq_journal_msg),
+	      CONFIG_BME68X_IAQ_JOURNAL_QUEUE_SIZE, 4);
+
+K_THREAD_DEFINE(iaq_journal_thread, CONFIG_BME68X_IAQ_JOURNAL_STACK_SIZE, iaq_journal_writer, NULL,
+		NULL, NULL, CONFIG_BME68X_IAQ_JOURNAL_PRIORITY, 0, 0);
+
+int bme68x_iaq_journal_init(void)
+{
+	uint32_t sector_cnt = ARRAY_SIZE(iaq_journal_sectors);
+	int ret = flash_area_get_sectors(IAQ_JOURNAL_PARTITION_ID, &sector_cnt,
+					 iaq_journal_sectors);
+	if (ret) {
+		LOG_ERR("journal partition unavailable: %d", ret);
+		return ret;
+	}
+
+	/* Raw samples in the sectors left by the aggregates. */
+	uint32_t agg_cnt = CONFIG_BME68X_IAQ_JOURNAL_MINUTE_SECTORS +
+			   CONFIG_BME68X_IAQ_JOURNAL_HOUR_SECTORS +
+			   CONFIG_BME68X_IAQ_JOURNAL_DAY_SECTORS;
+	uint32_t sample_cnt = (sector_cnt > agg_cnt) ? (sector_cnt - agg_cnt) : 0;
+	if ((sector_cnt < agg_cnt) ||
+	    ((CONFIG_BME68X_IAQ_JOURNAL_SAMPLE_DECIMATION > 0) && (sample_cnt < 2))) {
+		LOG_ERR("journal partition too small: %u sectors", sector_cnt);
+		return -ENOSPC;
+	}
+
+	k_mutex_lock(&iaq_journal_fcb_mutex, K_FOREVER);
+
+	struct flash_sector *sectors = iaq_journal_sectors;
+	for (int kind = BME68X_IAQ_JOURNAL_KIND_MINUTE; !ret && (kind < IAQ_JOURNAL_FCB_COUNT);
+	     kind++) {
+		ret = iaq_journal_fcb_init(kind, sectors, iaq_journal_agg_sectors[kind]);
+		sectors += iaq_journal_agg_sectors[kind];
+	}
+	if (!ret && (CONFIG_BME68X_IAQ_JOURNAL_SAMPLE_DECIMATION > 0)) {
+		ret = iaq_journal_fcb_init(BME68X_IAQ_JOURNAL_KIND_SAMPLE, sectors, sample_cnt);
+	}
+	if (!ret) {
+		iaq_journal_align =
+			flash_area_align(iaq_journal_fcbs[BME68X_IAQ_JOURNAL_KIND_MINUTE].fap);
+		if (iaq_journal_align > IAQ_JOURNAL_ALIGN_MAX) {
+			LOG_ERR("journal: unsupported write block size: %u", iaq_journal_align);
+			ret = -ENOTSUP;
+		}
+	}
+	if (!ret) {
+		LOG_INF("journal: %u x %u bytes, %u for raw samples", sector_cnt,
+			iaq_journal_sectors[0].fs_size, sample_cnt);
+		iaq_journal_rebuild();
+		iaq_journal_ready = true;
+	}
+
+	k_mutex_unlock(&iaq_journal_fcb_mutex);
+	return ret;
+}
+
+void bme68x_iaq_journal_set_time_offset(int64_t offset_ms)
+{
+	k_mutex_lock(&iaq_journal_mutex, K_FOREVER);
+
+	for (int level = 0; level < BME68X_IAQ_JOURNAL_LEVEL_COUNT; level++) {
+		iaq_journal_close(level);
+	}
+	iaq_journal_offset_ms = offset_ms;
+
+	k_mutex_unlock(&iaq_journal_mutex);
+}
+
+int64_t bme68x_iaq_journal_now_ms(void)
+{
+	return k_uptime_get() + iaq_journal_offset_ms;
+}
+
+int bme68x_iaq_journal_query(enum bme68x_iaq_journal_level level, int64_t from_ms,
+			     int64_t to_ms, struct bme68x_iaq_aggregate *result)
+{
+	if ((unsigned int)level >= BME68X_IAQ_JOURNAL_LEVEL_COUNT) {
+		return -EINVAL;
+	}
+
+	struct iaq_journal_level const *lvl = &iaq_journal_levels[level];
+	struct iaq_journal_ring const *ring = &lvl->ring;
+	struct iaq_journal_acc acc;
+	int ret = 0;
+
+	iaq_journal_acc_reset(&acc, INT64_MAX);
+
+	k_mutex_lock(&iaq_journal_mutex, K_FOREVER);
+
+	/* Oldest aggregate available from RAM. */
+	size_t tail = (ring->head + ring->size - ring->len) % ring->size;
+	int64_t cached_ms = INT64_MAX;
+	if (ring->len) {
+		cached_ms = ring->buf[tail].start_ms;
+	} else if (lvl->open) {
+		cached_ms = lvl->acc.start_ms;
+	}
+
+	for (size_t i = 0; i < ring->len; i++) {
+		struct bme68x_iaq_aggregate const *aggregate =
+			&ring->buf[(tail + i) % ring->size];
+		if ((aggregate->start_ms >= from_ms) && (aggregate->start_ms < to_ms)) {
+			iaq_journal_acc_add_aggregate(&acc, aggregate);
+		}
+	}
+
+	if (lvl->open && (lvl->acc.start_ms >= from_ms) && (lvl->acc.start_ms < to_ms)) {
+		struct bme68x_iaq_aggregate current;
+		iaq_journal_acc_get(&lvl->acc, &current);
+		iaq_journal_acc_add_aggregate(&acc, &current);
+	}
+
+	k_mutex_unlock(&iaq_journal_mutex);
+
+	if ((from_ms < cached_ms) && iaq_journal_ready) {
+		/*
+		 * Older aggregates from the journal, without blocking the IAQ loop:
+		 * aggregates closed meanwhile start after cached_ms.
+		 */
+		struct iaq_journal_walk_ctx ctx = {
+			.kinds = BIT(BME68X_IAQ_JOURNAL_KIND_MINUTE + level),
+			.from_ms = from_ms,
+			.to_ms = MIN(to_ms, cached_ms),
+			.cb = iaq_journal_query_entry,
+			.user_data = &acc,
+		};
+
+		/* Only this level's aggregates. */
+		k_mutex_lock(&iaq_journal_fcb_mutex, K_FOREVER);
+		ret = fcb_walk(&iaq_journal_fcbs[BME68X_IAQ_JOURNAL_KIND_MINUTE + level], NULL,
+			       iaq_journal_walk_entry, &ctx);
+		k_mutex_unlock(&iaq_journal_fcb_mutex);
+	}
+
+	if (ret) {
+		LOG_ERR("failed to walk journal: %d", ret);
+		return ret;
+	}
+	if (acc.start_ms == INT64_MAX) {
+		return -ENODATA;
+	}
+
+	iaq_journal_acc_get(&acc, result);
+	return 0;
+}
+
+int bme68x_iaq_journal_walk(uint32_t kinds, int64_t from_ms, bme68x_iaq_journal_walk_cb cb,
+			    void *user_data)
+{
+	struct iaq_journal_walk_ctx ctx = {
+		.kinds = kinds,
+		.from_ms = from_ms,
+		.to_ms = INT64_MAX,
+		.cb = cb,
+		.user_data = user_data,
+	};
+
+	if (!iaq_journal_ready) {
+		return -EAGAIN;
+	}
+	if (CONFIG_BME68X_IAQ_JOURNAL_SAMPLE_DECIMATION == 0) {
+		/* No raw samples FCB. */
+		kinds &= ~BIT(BME68X_IAQ_JOURNAL_KIND_SAMPLE);
+	}
+
+	int ret = 0;
+
+	k_mutex_lock(&iaq_journal_fcb_mutex, K_FOREVER);
+	for (int kind = 0; !ret && (kind < IAQ_JOURNAL_FCB_COUNT); kind++) {
+		if (kinds & BIT(kind)) {
+			ret = fcb_walk(&iaq_journal_fcbs[kind], NULL, iaq_journal_walk_entry, &ctx);
+		}
+	}
+	k_mutex_unlock(&iaq_journal_fcb_mutex);
+
+	return MAX(ret, 0);
+}
+
+void iaq_journal_handler(struct bme68x_iaq_sample const *iaq_sample)
+{
+	if (!iaq_journal_ready) {
+		return;
+	}
+
+	k_mutex_lock(&iaq_journal_mutex, K_FOREVER);
+
+	int64_t ts_ms = (iaq_sample->ts_ns / NSEC_PER_MSEC) + iaq_journal_offset_ms;
+
+	/* Incremental aggregation, all levels. */
+	for (int level = 0; level < BME68X_IAQ_JOURNAL_LEVEL_COUNT; level++) {
+		struct iaq_journal_level *lvl = &iaq_journal_levels[level];
+		int64_t start_ms = ts_ms - (ts_ms % lvl->period_ms);
+
+		if (lvl->open && (start_ms != lvl->acc.start_ms)) {
+			iaq_journal_close(level);
+		}
+		if (!lvl->open) {
+			iaq_journal_acc_reset(&lvl->acc, start_ms);
+			lvl->open = true;
+		}
+
+		iaq_journal_acc_add_sample(&lvl->acc, iaq_sample);
+	}
+
+#if CONFIG_BME68X_IAQ_JOURNAL_SAMPLE_DECIMATION > 0
+	if (!iaq_journal_sample_cnt) {
+		/* Self-contained record: key frame with absolute journal time. */
+		struct bme68x_iaq_codec codec;
+		struct bme68x_iaq_sample sample = *iaq_sample;
+		struct iaq_journal_msg msg;
+
+		sample.ts_ns = ts_ms * NSEC_PER_MSEC;
+		bme68x_iaq_codec_reset(&codec);
+		msg.data[0] = BME68X_IAQ_JOURNAL_KIND_SAMPLE;
+		int len = bme68x_iaq_encode(&codec, &sample, msg.data + 1,
+					    IAQ_JOURNAL_ENTRY_MAX_SIZE - 1);
+		if (len > 0) {
+			msg.len = len + 1;
+			iaq_journal_enqueue(&msg);
+		}
+	}
+	if (++iaq_journal_sample_cnt >= CONFIG_BME68X_IAQ_JOURNAL_SAMPLE_DECIMATION) {
+		iaq_journal_sample_cnt = 0;
+	}
+#endif
+
+	k_mutex_unlock(&iaq_journal_mutex);
+}
+
+void iaq_journal_close(enum bme68x_iaq_journal_level level)
+{
+	struct iaq_journal_level *lvl = &iaq_journal_levels[level];
+	struct iaq_journal_ring *ring = &lvl->ring;
+
+	if (!lvl->open) {
+		return;
+	}
+	lvl->open = false;
+
+	struct bme68x_iaq_aggregate aggregate;
+	iaq_journal_acc_get(&lvl->acc, &aggregate);
+	iaq_journal_ring_push(ring, &aggregate);
+
+	struct iaq_journal_msg msg;
+	msg.len = iaq_journal_put_aggregate(BME68X_IAQ_JOURNAL_KIND_MINUTE + level, &aggregate,
+					    msg.data);
+	iaq_journal_enqueue(&msg);
+}
+
+void iaq_journal_ring_push(struct iaq_journal_ring *ring,
+			   struct bme68x_iaq_aggregate const *aggregate)
+{
+	ring->buf[ring->head] = *aggregate;
+	ring->head = (ring->head + 1) % ring->size;
+	if (ring->len < ring->size) {
+		ring->len++;
+	}
+}
+
+int iaq_journal_fcb_init(enum bme68x_iaq_journal_kind kind, struct flash_sector *sectors,
+			 uint32_t sector_cnt)
+{
+	struct fcb *fcb = &iaq_journal_fcbs[kind];
+
+	fcb->f_magic = IAQ_JOURNAL_FCB_MAGIC + kind;
+	fcb->f_version = IAQ_JOURNAL_FCB_VERSION;
+	fcb->f_sector_cnt = (uint8_t)sector_cnt;
+	fcb->f_scratch_cnt = 0;
+	fcb->f_sectors = sectors;
+
+	int ret = fcb_init(IAQ_JOURNAL_PARTITION_ID, fcb);
+	if (ret) {
+		/* Previous journal format or layout: start over. */
+		struct flash_area const *fa;
+
+		LOG_WRN("journal %u: unknown content (%d), erasing", kind, ret);
+		ret = flash_area_open(IAQ_JOURNAL_PARTITION_ID, &fa);
+		if (!ret) {
+			for (uint32_t i = 0; !ret && (i < sector_cnt); i++) {
+				ret = flash_area_erase(fa, sectors[i].fs_off, sectors[i].fs_size);
+			}
+			flash_area_close(fa);
+		}
+		if (!ret) {
+			ret = fcb_init(IAQ_JOURNAL_PARTITION_ID, fcb);
+		}
+	}
+
+	if (ret) {
+		LOG_ERR("journal initialization failed: %d", ret);
+	}
+	return ret;
+}
+
+void iaq_journal_rebuild(void)
+{
+	struct iaq_journal_rebuild rebuild[IAQ_JOURNAL_FCB_COUNT];
+	struct iaq_journal_walk_ctx ctx = {
+		.from_ms = INT64_MIN,
+		.to_ms = INT64_MAX,
+		.cb = iaq_journal_rebuild_entry,
+	};
+
+	k_mutex_lock(&iaq_journal_mutex, K_FOREVER);
+
+	for (int kind = 0; kind < IAQ_JOURNAL_FCB_COUNT; kind++) {
+		rebuild[kind].last_ms = INT64_MIN;
+		iaq_journal_acc_reset(&rebuild[kind].acc, INT64_MIN);
+
+		ctx.kinds = BIT(kind);
+		ctx.user_data = &rebuild[kind];
+		if (kind == BME68X_IAQ_JOURNAL_KIND_SAMPLE) {
+			if (CONFIG_BME68X_IAQ_JOURNAL_SAMPLE_DECIMATION > 0) {
+				struct fcb *fcb = &iaq_journal_fcbs[kind];
+
+				/* Only the latest samples can be in the open minute. */
+				(void)fcb_walk(fcb, fcb->f_active.fe_sector, iaq_journal_walk_entry,
+					       &ctx);
+			}
+		} else {
+			struct iaq_journal_ring *ring =
+				&iaq_journal_levels[kind - BME68X_IAQ_JOURNAL_KIND_MINUTE].ring;
+
+			ring->head = 0;
+			ring->len = 0;
+			(void)fcb_walk(&iaq_journal_fcbs[kind], NULL, iaq_journal_walk_entry, &ctx);
+		}
+	}
+
+	/*
+	 * Level by level, the open interval is made of the entries of the level below
+	 * that aren't aggregated yet: closed ones (journal), and its open interval.
+	 */
+	for (int level = 0; level < BME68X_IAQ_JOURNAL_LEVEL_COUNT; level++) {
+		struct iaq_journal_level *lvl = &iaq_journal_levels[level];
+		struct iaq_journal_rebuild const *below = &rebuild[level];
+		int64_t closed_ms = rebuild[BME68X_IAQ_JOURNAL_KIND_MINUTE + level].last_ms;
+
+		lvl->open = false;
+		if ((below->acc.start_ms != INT64_MIN) && (below->acc.start_ms > closed_ms)) {
+			lvl->acc = below->acc;
+			lvl->open = true;
+		}
+
+		if ((level == 0) || !iaq_journal_levels[level - 1].open) {
+			continue;
+		}
+		struct iaq_journal_level const *lower = &iaq_journal_levels[level - 1];
+		int64_t start_ms = lower->acc.start_ms - (lower->acc.start_ms % lvl->period_ms);
+		if (start_ms <= closed_ms) {
+			continue;
+		}
+		if (lvl->open && (lvl->acc.start_ms != start_ms)) {
+			/* Interval never closed before the reset. */
+			iaq_journal_close(level);
+		}
+		if (!lvl->open) {
+			iaq_journal_acc_reset(&lvl->acc, start_ms);
+			lvl->open = true;
+		}
+
+		struct bme68x_iaq_aggregate current;
+		iaq_journal_acc_get(&lower->acc, &current);
+		iaq_journal_acc_add_aggregate(&lvl->acc, &current);
+	}
+
+	LOG_INF("journal: restored %zu minute, %zu hour, %zu day aggregates",
+		iaq_journal_levels[BME68X_IAQ_JOURNAL_MINUTE].ring.len,
+		iaq_journal_levels[BME68X_IAQ_JOURNAL_HOUR].ring.len,
+		iaq_journal_levels[BME68X_IAQ_JOURNAL_DAY].ring.len);
+
+	k_mutex_unlock(&iaq_journal_mutex);
+}
+
+int iaq_journal_rebuild_entry(struct bme68x_iaq_journal_entry const *entry, void *user_data)
+{
+	struct iaq_journal_rebuild *rebuild = user_data;
+	/* The level above the entry's (minute for samples). */
+	int level = entry->kind;
+
+	if (entry->kind == BME68X_IAQ_JOURNAL_KIND_SAMPLE) {
+		rebuild->last_ms = entry->sample.ts_ns / NSEC_PER_MSEC;
+	} else {
+		rebuild->last_ms = entry->aggregate.start_ms;
+		iaq_journal_ring_push(&iaq_journal_levels[level - 1].ring, &entry->aggregate);
+	}
+	if (level >= BME68X_IAQ_JOURNAL_LEVEL_COUNT) {
+		return 0;
+	}
+
+	int64_t period_ms = iaq_journal_levels[level].period_ms;
+	int64_t start_ms = rebuild->last_ms - (rebuild->last_ms % period_ms);
+	if (rebuild->acc.start_ms != start_ms) {
+		iaq_journal_acc_reset(&rebuild->acc, start_ms);
+	}
+	if (entry->kind == BME68X_IAQ_JOURNAL_KIND_SAMPLE) {
+		iaq_journal_acc_add_sample(&rebuild->acc, &entry->sample);
+	} else {
+		iaq_journal_acc_add_aggregate(&rebuild->acc, &entry->aggregate);
+	}
+	return 0;
+}
+
+void iaq_journal_enqueue(struct iaq_journal_msg const *msg)
+{
+	if (k_msgq_put(&iaq_journal_msgq, msg, K_NO_WAIT)) {
+		LOG_WRN("journal queue full, entry dropped");
+	}
+}
+
+void iaq_journal_writer(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	struct iaq_journal_msg msg;
+
+	for (;;) {
+		k_msgq_get(&iaq_journal_msgq, &msg, K_FOREVER);
+
+		k_mutex_lock(&iaq_journal_fcb_mutex, K_FOREVER);
+		iaq_journal_append(&msg);
+		k_mutex_unlock(&iaq_journal_fcb_mutex);
+	}
+}
+
+int iaq_journal_append(struct iaq_journal_msg *msg)
+{
+	size_t write_len = ROUND_UP(msg->len, iaq_journal_align);
+	struct fcb_entry loc;
+
+	/* The FCB of the entry kind. */
+	struct fcb *fcb = &iaq_journal_fcbs[msg->data[0]];
+
+	/* The FCB reserves aligned space for the entry, the padding isn't read back. */
+	memset(msg->data + msg->len, flash_area_erased_val(fcb->fap), write_len - msg->len);
+
+	int ret = fcb_append(fcb, msg->len, &loc);
+	if (ret == -ENOSPC) {
+		/* Journal full: erase oldest sector. */
+		ret = fcb_rotate(fcb);
+		if (!ret) {
+			ret = fcb_append(fcb, msg->len, &loc);
+		}
+	}
+	if (!ret) {
+		ret = flash_area_write(fcb->fap, FCB_ENTRY_FA_DATA_OFF(loc), msg->data, write_len);
+	}
+	if (!ret) {
+		ret = fcb_append_finish(fcb, &loc);
+	}
+
+	if (ret) {
+		LOG_ERR("failed to append journal entry: %d", ret);
+	}
+	return ret;
+}
+
+int iaq_journal_walk_entry(struct fcb_entry_ctx *loc_ctx, void *arg)
+{
+	struct iaq_journal_walk_ctx const *ctx = arg;
+	uint8_t buf[IAQ_JOURNAL_ENTRY_MAX_SIZE];
+	uint16_t len = loc_ctx->loc.fe_data_len;
+
+	if ((len < 1) || (len > sizeof(buf))) {
+		/* Not a journal entry we know about, skip. */
+		return 0;
+	}
+	int ret = flash_area_read(loc_ctx->fap, FCB_ENTRY_FA_DATA_OFF(loc_ctx->loc), buf, len);
+	if (ret) {
+		LOG_ERR("failed to read journal entry: %d", ret);
+		return ret;
+	}
+
+	enum bme68x_iaq_journal_kind kind = buf[0];
+	if ((kind > BME68X_IAQ_JOURNAL_KIND_DAY) || !(ctx->kinds & BIT(kind))) {
+		return 0;
+	}
+
+	struct bme68x_iaq_journal_entry entry = {
+		.kind = kind,
+	};
+	int64_t ts_ms;
+	if (kind == BME68X_IAQ_JOURNAL_KIND_SAMPLE) {
+		struct bme68x_iaq_codec codec;
+
+		bme68x_iaq_codec_reset(&codec);
+		if (bme68x_iaq_decode(&codec, buf + 1, len - 1, &entry.sample) < 0) {
+			return 0;
+		}
+		ts_ms = entry.sample.ts_ns / NSEC_PER_MSEC;
+	} else {
+		if (len != IAQ_JOURNAL_AGGREGATE_SIZE) {
+			return 0;
+		}
+		iaq_journal_get_aggregate(buf, &entry.aggregate);
+		ts_ms = entry.aggregate.start_ms;
+	}
+
+	if ((ts_ms < ctx->from_ms) || (ts_ms >= ctx->to_ms)) {
+		return 0;
+	}
+
+	/* Non-zero stops fcb_walk(). */
+	return ctx->cb(&entry, ctx->user_data) ? 1 : 0;
+}
+
+int iaq_journal_query_entry(struct bme68x_iaq_journal_entry const *entry, void *user_data)
+{
+	iaq_journal_acc_add_aggregate(user_data, &entry->aggregate);
+	return 0;
+}
+
+void iaq_journal_acc_reset(struct iaq_journal_acc *acc, int64_t start_ms)
+{
+	*acc = (struct iaq_journal_acc){
+		.start_ms = start_ms,
+	};
+}
+
+void iaq_journal_acc_add_value(struct iaq_journal_acc *acc, enum bme68x_iaq_journal_field field,
+			       int32_t value)
+{
+	struct bme68x_iaq_rollup *rollup = &acc->fields[field];
+
+	if (!rollup->count) {
+		rollup->min = value;
+		rollup->max = value;
+	} else {
+		rollup->min = MIN(rollup->min, value);
+		rollup->max = MAX(rollup->max, value);
+	}
+	acc->sum[field] += value;
+	rollup->count++;
+}
+
+void iaq_journal_acc_add_sample(struct iaq_journal_acc *acc,
+				struct bme68x_iaq_sample const *iaq_sample)
+{
+	if (iaq_sample->channels & BME68X_IAQ_CHAN_TEMPERATURE) {
+		iaq_journal_acc_add_value(acc, BME68X_IAQ_JOURNAL_TEMPERATURE,
+					  (int32_t)(iaq_sample->temperature * 100.0f));
+	}
+	if (iaq_sample->channels & BME68X_IAQ_CHAN_HUMIDITY) {
+		iaq_journal_acc_add_value(acc, BME68X_IAQ_JOURNAL_HUMIDITY,
+					  (int32_t)(iaq_sample->humidity * 100.0f));
+	}
+	if (iaq_sample->channels & BME68X_IAQ_CHAN_RAW_PRESSURE) {
+		iaq_journal_acc_add_value(acc, BME68X_IAQ_JOURNAL_PRESSURE,
+					  (int32_t)iaq_sample->raw_pressure);
+	}
+	if (iaq_sample->channels & BME68X_IAQ_CHAN_RAW_GAS) {
+		iaq_journal_acc_add_value(acc, BME68X_IAQ_JOURNAL_GAS_RES,
+					  (int32_t)MIN(iaq_sample->raw_gas_res, INT32_MAX));
+	}
+	if (iaq_sample->channels & BME68X_IAQ_CHAN_IAQ) {
+		iaq_journal_acc_add_value(acc, BME68X_IAQ_JOURNAL_IAQ, iaq_sample->iaq);
+	}
+	if (iaq_sample->channels & BME68X_IAQ_CHAN_CO2) {
+		iaq_journal_acc_add_value(acc, BME68X_IAQ_JOURNAL_CO2,
+					  (int32_t)iaq_sample->co2_equivalent);
+	}
+	if (iaq_sample->channels & BME68X_IAQ_CHAN_VOC) {
+		iaq_journal_acc_add_value(acc, BME68X_IAQ_JOURNAL_VOC,
+					  (int32_t)(iaq_sample->voc_equivalent * 100.0f));
+	}
+}
+
+void iaq_journal_acc_add_aggregate(struct iaq_journal_acc *acc,
+				   struct bme68x_iaq_aggregate const *aggregate)
+{
+	acc->start_ms = MIN(acc->start_ms, aggregate->start_ms);
+
+	for (int field = 0; field < BME68X_IAQ_JOURNAL_FIELD_COUNT; field++) {
+		struct bme68x_iaq_rollup const *src = &aggregate->fields[field];
+		struct bme68x_iaq_rollup *dst = &acc->fields[field];
+
+		if (!src->count) {
+			continue;
+		}
+		if (!dst->count) {
+			dst->min = src->min;
+			dst->max = src->max;
+		} else {
+			dst->min = MIN(dst->min, src->min);
+			dst->max = MAX(dst->max, src->max);
+		}
+		/* Weighted mean. */
+		acc->sum[field] += (int64_t)src->mean * src->count;
+		dst->count += src->count;
+	}
+}
+
+void iaq_journal_acc_get(struct iaq_journal_acc const *acc, struct bme68x_iaq_aggregate *aggregate)
+{
+	aggregate->start_ms = acc->start_ms;
+
+	for (int field = 0; field < BME68X_IAQ_JOURNAL_FIELD_COUNT; field++) {
+		aggregate->fields[field] = acc->fields[field];
+		if (acc->fields[field].count) {
+			aggregate->fields[field].mean =
+				(int32_t)(acc->sum[field] / acc->fields[field].count);
+		}
+	}
+}
+
+size_t iaq_journal_put_aggregate(enum bme68x_iaq_journal_kind kind,
+				 struct bme68x_iaq_aggregate const *aggregate, uint8_t *buf)
+{
+	uint8_t *p = buf;
+
+	*p++ = kind;
+	sys_put_le64((uint64_t)aggregate->start_ms, p);
+	p += 8;
+	for (int field = 0; field < BME68X_IAQ_JOURNAL_FIELD_COUNT; field++) {
+		sys_put_le32((uint32_t)aggregate->fields[field].min, p);
+		sys_put_le32((uint32_t)aggregate->fields[field].max, p + 4);
+		sys_put_le32((uint32_t)aggregate->fields[field].mean, p + 8);
+		sys_put_le32(aggregate->fields[field].count, p + 12);
+		p += 16;
+	}
+
+	return p - buf;
+}
+
+void iaq_journal_get_aggregate(uint8_t const *buf, struct bme68x_iaq_aggregate *aggregate)
+{
+	uint8_t const *p = buf + 1;
+
+	aggregate->start_ms = (int64_t)sys_get_le64(p);
+	p += 8;
+	for (int field = 0; field < BME68X_IAQ_JOURNAL_FIELD_COUNT; field++) {
+		aggregate->fields[field].min = (int32_t)sys_get_le32(p);
+		aggregate->fields[field].max = (int32_t)sys_get_le32(p + 4);
+		aggregate->fields[field].mean = (int32_t)sys_get_le32(p + 8);
+		aggregate->fields[field].count = sys_get_le32(p + 12);
+		p += 16;
+	}
+}
@@ -0,0 +1,490 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Multi-sensor IAQ engine:
+ * - sensor N is handled by worker N modulo the number of workers
+ * - each worker interleaves the BSEC control loops of its sensors:
+ *   while a sensor is measuring, the worker serves the other sensors
+ * - bus I/O sequences hold the bus lock, algorithm iterations don't
+ */
+
+#include "bme68x_iaq_multi.h"
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#include <drivers/bme68x_sensor_api.h>
+
+#include "bme68x.h"
+#include "bsec_interface_multi.h"
+
+#include "bme68x_iaq_bsec.h"
+
+LOG_MODULE_DECLARE(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
+
+#define IAQ_MULTI_WORKERS CONFIG_BME68X_IAQ_MULTI_WORKERS
+
+/* Worker thread and its load statistics. */
+struct iaq_multi_worker {
+	struct k_thread thread;
+	struct bme68x_iaq_multi_worker_stats stats;
+	int64_t start_ns;
+};
+
+/*
+ * Initialize a sensor and its BSEC instance.
+ *
+ * Returns 0 on success, negative errno, BSEC or BME68X Sensor API status otherwise.
+ */
+static int iaq_multi_sensor_init(struct bme68x_iaq_multi_sensor *sensor);
+
+/*
+ * Worker thread entry point.
+ *
+ * p1: worker index
+ */
+static void iaq_multi_worker_main(void *p1, void *p2, void *p3);
+
+/*
+ * Advance the BSEC control loop of a sensor which is due:
+ * - at the BSEC rendez-vous: sensor control, and trigger the requested measurement
+ * - at the end of the measurement: read data and run the algorithm iteration
+ *
+ * Updates the sensor's due time.
+ */
+static void iaq_multi_step(struct bme68x_iaq_multi_sensor *sensor);
+
+/*
+ * Trigger the TPHG measurement requested by the BSEC instance (holds the bus lock).
+ *
+ * Returns 0 on success, a BME68X Sensor API status otherwise.
+ */
+static int8_t iaq_multi_trigger(struct bme68x_iaq_multi_sensor *sensor);
+
+/*
+ * Read TPHG data (holds the bus lock), then run the algorithm iteration
+ * and invoke the sensor's callback.
+ *
+ * Returns 0 on success, BSEC or BME68X Sensor API status otherwise.
+ */
+static int iaq_multi_process(struct bme68x_iaq_multi_sensor *sensor);
+
+/*
+ * Lock the sensor's bus, accounting for the wait.
+ */
+static void iaq_multi_bus_lock(struct bme68x_iaq_multi_sensor *sensor);
+
+/* Uptime in nanoseconds. */
+static int64_t iaq_multi_uptime_ns(void);
+
+/* The controlled sensors, see bme68x_iaq_multi_init(). */
+static struct bme68x_iaq_multi_sensor *const *iaq_multi_sensors;
+static size_t iaq_multi_n_sensors;
+
+K_THREAD_STACK_ARRAY_DEFINE(iaq_multi_stacks, IAQ_MULTI_WORKERS,
+			    CONFIG_BME68X_IAQ_MULTI_WORKER_STACK_SIZE);
+static struct iaq_multi_worker iaq_multi_workers[IAQ_MULTI_WORKERS];
+
+static atomic_t iaq_multi_running;
+static atomic_t iaq_multi_stop_req;
+
+/* Protects sensors and workers statistics. */
+static struct k_spinlock iaq_multi_stats_lock;
+
+int bme68x_iaq_multi_init(struct bme68x_iaq_multi_sensor *const *sensors, size_t n_sensors)
+{
+	if (!n_sensors) {
+		return -EINVAL;
+	}
+	if (atomic_get(&iaq_multi_running)) {
+		return -EBUSY;
+	}
+
+	size_t inst_size = bsec_get_instance_size_m();
+	if (inst_size > CONFIG_BME68X_IAQ_MULTI_INSTANCE_SIZE) {
+		LOG_ERR("BSEC instance size: %zu > %u", inst_size,
+			CONFIG_BME68X_IAQ_MULTI_INSTANCE_SIZE);
+		return -ENOMEM;
+	}
+
+	for (size_t i = 0; i < n_sensors; i++) {
+		int ret = iaq_multi_sensor_init(sensors[i]);
+		if (ret) {
+			LOG_ERR("%s: initialization failed: %d", sensors[i]->dev->name, ret);
+			return ret;
+		}
+	}
+
+	iaq_multi_sensors = sensors;
+	iaq_multi_n_sensors = n_sensors;
+	LOG_INF("IAQ multi: %zu sensors, %u workers", n_sensors, IAQ_MULTI_WORKERS);
+	return 0;
+}
+
+int bme68x_iaq_multi_start(void)
+{
+	if (!iaq_multi_n_sensors) {
+		return -EINVAL;
+	}
+	if (!atomic_cas(&iaq_multi_running, 0, 1)) {
+		return -EALREADY;
+	}
+	atomic_clear(&iaq_multi_stop_req);
+
+	for (size_t i = 0; i < iaq_multi_n_sensors; i++) {
+		/* Abandoned measurements, if restarted. */
+		iaq_multi_sensors[i]->measuring = false;
+		iaq_multi_sensors[i]->due_ns = 0;
+	}
+
+	for (size_t w = 0; w < IAQ_MULTI_WORKERS; w++) {
+		struct iaq_multi_worker *worker = &iaq_multi_workers[w];
+		k_spinlock_key_t key = k_spin_lock(&iaq_multi_stats_lock);
+
+		worker->stats = (struct bme68x_iaq_multi_worker_stats){
+			.cpu = -1,
+			.sensors = (w < iaq_multi_n_sensors)
+					   ? DIV_ROUND_UP(iaq_multi_n_sensors - w, IAQ_MULTI_WORKERS)
+					   : 0,
+		};
+		worker->start_ns = iaq_multi_uptime_ns();
+		k_spin_unlock(&iaq_multi_stats_lock, key);
+
+		k_thread_create(&worker->thread, iaq_multi_stacks[w],
+				K_THREAD_STACK_SIZEOF(iaq_multi_stacks[w]), iaq_multi_worker_main,
+				UINT_TO_POINTER(w), NULL, NULL,
+				CONFIG_BME68X_IAQ_MULTI_WORKER_PRIORITY, 0, K_FOREVER);
+
+#if defined(CONFIG_SMP) && defined(CONFIG_SCHED_CPU_MASK)
+		/* Pin before the thread is runnable. */
+		int cpu = w % arch_num_cpus();
+		if (!k_thread_cpu_pin(&worker->thread, cpu)) {
+			key = k_spin_lock(&iaq_multi_stats_lock);
+			worker->stats.cpu = cpu;
+			k_spin_unlock(&iaq_multi_stats_lock, key);
+		}
+#endif
+		k_thread_start(&worker->thread);
+	}
+
+	return 0;
+}
+
+int bme68x_iaq_multi_stop(k_timeout_t timeout)
+{
+	if (!atomic_get(&iaq_multi_running)) {
+		return -EALREADY;
+	}
+
+	atomic_set(&iaq_multi_stop_req, 1);
+
+	int ret = 0;
+	for (size_t w = 0; w < IAQ_MULTI_WORKERS; w++) {
+		k_wakeup(&iaq_multi_workers[w].thread);
+		if (k_thread_join(&iaq_multi_workers[w].thread, timeout)) {
+			ret = -EAGAIN;
+		}
+	}
+
+	if (!ret) {
+		atomic_clear(&iaq_multi_running);
+	}
+	return ret;
+}
+
+void bme68x_iaq_multi_stats_get(struct bme68x_iaq_multi_sensor const *sensor,
+				struct bme68x_iaq_multi_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&iaq_multi_stats_lock);
+	*stats = sensor->stats;
+	k_spin_unlock(&iaq_multi_stats_lock, key);
+}
+
+int bme68x_iaq_multi_worker_stats_get(size_t worker, struct bme68x_iaq_multi_worker_stats *stats)
+{
+	if (worker >= IAQ_MULTI_WORKERS) {
+		return -EINVAL;
+	}
+
+	int64_t now_ns = iaq_multi_uptime_ns();
+	k_spinlock_key_t key = k_spin_lock(&iaq_multi_stats_lock);
+
+	*stats = iaq_multi_workers[worker].stats;
+	if (iaq_multi_workers[worker].start_ns) {
+		stats->elapsed_us = (now_ns - iaq_multi_workers[worker].start_ns) / NSEC_PER_USEC;
+	}
+	k_spin_unlock(&iaq_multi_stats_lock, key);
+
+	return 0;
+}
+
+int iaq_multi_sensor_init(struct bme68x_iaq_multi_sensor *sensor)
+{
+	sensor->bme68x_dev = (struct bme68x_dev){0};
+	int ret = bme68x_sensor_api_init(sensor->dev, &sensor->bme68x_dev);
+	if (!ret) {
+		ret = bme68x_init(&sensor->bme68x_dev);
+	}
+	if (ret) {
+		return ret;
+	}
+	/* Initialize temperature used to compute heater resistance. */
+	sensor->bme68x_dev.amb_temp = INT8_C(CONFIG_BME68X_IAQ_AMBIENT_TEMP);
+
+	size_t sz_conf;
+	uint8_t const *config = bme68x_iaq_bsec_config(sensor->bme68x_dev.variant_id, &sz_conf);
+	if (!config) {
+		LOG_ERR("%s: no BSEC configuration for variant %u", sensor->dev->name,
+			sensor->bme68x_dev.variant_id);
+		return -ENOTSUP;
+	}
+
+	void *inst = sensor->inst;
+	ret = bsec_init_m(inst);
+	if (!ret) {
+		/* NOTE: stack size > 4096 bytes. */
+		uint8_t buf[BSEC_MAX_WORKBUFFER_SIZE];
+		ret = bsec_set_configuration_m(inst, config, sz_conf, buf, sizeof(buf));
+	}
+	if (!ret) {
+		uint8_t n_phy = BSEC_MAX_PHYSICAL_SENSOR;
+		bsec_sensor_configuration_t phy_sensors[BSEC_MAX_PHYSICAL_SENSOR];
+		ret = bsec_update_subscription_m(inst, bme68x_iaq_virt_sensors,
+						 ARRAY_SIZE(bme68x_iaq_virt_sensors), phy_sensors,
+						 &n_phy);
+	}
+	if (ret) {
+		LOG_ERR("%s: BSEC instance: %d", sensor->dev->name, ret);
+		return ret;
+	}
+
+	sensor->settings = (bsec_bme_settings_t){0};
+	sensor->measuring = false;
+	sensor->due_ns = 0;
+	sensor->stats = (struct bme68x_iaq_multi_stats){0};
+	return 0;
+}
+
+void iaq_multi_worker_main(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	size_t const w = POINTER_TO_UINT(p1);
+	struct iaq_multi_worker *worker = &iaq_multi_workers[w];
+
+	if (w >= iaq_multi_n_sensors) {
+		/* More workers than sensors. */
+		return;
+	}
+
+	while (!atomic_get(&iaq_multi_stop_req)) {
+		int64_t busy_ns = iaq_multi_uptime_ns();
+		int64_t next_ns = INT64_MAX;
+
+		for (size_t i = w; i < iaq_multi_n_sensors; i += IAQ_MULTI_WORKERS) {
+			struct bme68x_iaq_multi_sensor *sensor = iaq_multi_sensors[i];
+
+			if (sensor->due_ns <= iaq_multi_uptime_ns()) {
+				iaq_multi_step(sensor);
+			}
+			next_ns = MIN(next_ns, sensor->due_ns);
+		}
+
+		int64_t now_ns = iaq_multi_uptime_ns();
+		k_spinlock_key_t key = k_spin_lock(&iaq_multi_stats_lock);
+		worker->stats.busy_us += (now_ns - busy_ns) / NSEC_PER_USEC;
+		k_spin_unlock(&iaq_multi_stats_lock, key);
+
+		if (next_ns == INT64_MAX) {
+			/* All sensors failed, wait for bme68x_iaq_multi_stop(). */
+			k_sleep(K_FOREVER);
+		} else if (next_ns > now_ns) {
+			k_sleep(K_NSEC(next_ns - now_ns));
+		}
+	}
+}
+
+void iaq_multi_step(struct bme68x_iaq_multi_sensor *sensor)
+{
+	bsec_bme_settings_t *settings = &sensor->settings;
+	int64_t ts_ns = iaq_multi_uptime_ns();
+
+	if (sensor->measuring) {
+		sensor->measuring = false;
+		sensor->due_ns = settings->next_call;
+		(void)iaq_multi_process(sensor);
+		return;
+	}
+
+	uint32_t late_us = 0;
+	if (settings->next_call && (ts_ns > settings->next_call)) {
+		late_us = (ts_ns - settings->next_call) / NSEC_PER_USEC;
+	}
+
+	*settings = (bsec_bme_settings_t){0};
+	int ret = bsec_sensor_control_m(sensor->inst, ts_ns, settings);
+
+	k_spinlock_key_t key = k_spin_lock(&iaq_multi_stats_lock);
+	sensor->stats.late_max_us = MAX(sensor->stats.late_max_us, late_us);
+	if (ret == BSEC_W_SC_CALL_TIMING_VIOLATION) {
+		sensor->stats.violations++;
+	}
+	k_spin_unlock(&iaq_multi_stats_lock, key);
+
+	if (ret < 0) {
+		/* Non recoverable error, the sensor is no longer served. */
+		LOG_ERR("%s: BSEC control error: %d", sensor->dev->name, ret);
+		sensor->due_ns = INT64_MAX;
+		return;
+	}
+
+	sensor->due_ns = settings->next_call;
+	if (ret) {
+		LOG_WRN("%s: BSEC control status: %d (late %u us)", sensor->dev->name, ret,
+			late_us);
+		return;
+	}
+	if (!settings->trigger_measurement) {
+		return;
+	}
+	if (settings->op_mode != BME68X_FORCED_MODE) {
+		/* The embedded IAQ configurations run forced mode measurements only. */
+		LOG_WRN("%s: unsupported operation mode: %u", sensor->dev->name, settings->op_mode);
+		return;
+	}
+
+	if (iaq_multi_trigger(sensor)) {
+		return;
+	}
+
+	sensor->ts_ns = ts_ns;
+	sensor->measuring = true;
+	sensor->due_ns = ts_ns + (int64_t)bme68x_iaq_tphg_meas_dur(settings) * NSEC_PER_USEC;
+}
+
+int8_t iaq_multi_trigger(struct bme68x_iaq_multi_sensor *sensor)
+{
+	bsec_bme_settings_t const *settings = &sensor->settings;
+	struct bme68x_dev *dev = &sensor->bme68x_dev;
+	struct bme68x_conf conf = {
+		.os_temp = settings->temperature_oversampling,
+		.os_pres = settings->pressure_oversampling,
+		.os_hum = settings->humidity_oversampling,
+		.odr = BME68X_ODR_NONE,
+	};
+	struct bme68x_heatr_conf heatr_conf = {
+		.enable = settings->run_gas,
+		.heatr_temp = settings->heater_temperature,
+		.heatr_dur = settings->heater_duration,
+	};
+
+	iaq_multi_bus_lock(sensor);
+	int8_t ret = bme68x_set_conf(&conf, dev);
+	if (!ret) {
+		ret = bme68x_set_heatr_conf(BME68X_FORCED_MODE, &heatr_conf, dev);
+	}
+	if (!ret) {
+		ret = bme68x_set_op_mode(BME68X_FORCED_MODE, dev);
+	}
+	k_mutex_unlock(sensor->bus->lock);
+
+	if (ret) {
+		LOG_ERR("%s: trigger failed: %d", sensor->dev->name, ret);
+
+		k_spinlock_key_t key = k_spin_lock(&iaq_multi_stats_lock);
+		sensor->stats.io_errors++;
+		k_spin_unlock(&iaq_multi_stats_lock, key);
+	}
+	return ret;
+}
+
+int iaq_multi_process(struct bme68x_iaq_multi_sensor *sensor)
+{
+	struct bme68x_data bme68x_data;
+	uint8_t n_data;
+
+	iaq_multi_bus_lock(sensor);
+	int ret = bme68x_get_data(sensor->settings.op_mode, &bme68x_data, &n_data,
+				  &sensor->bme68x_dev);
+	k_mutex_unlock(sensor->bus->lock);
+
+	if (ret) {
+		if (ret < 0) {
+			LOG_ERR("%s: failed to read BME68X data: %d", sensor->dev->name, ret);
+
+			k_spinlock_key_t key = k_spin_lock(&iaq_multi_stats_lock);
+			sensor->stats.io_errors++;
+			k_spin_unlock(&iaq_multi_stats_lock, key);
+		} else {
+			LOG_DBG("%s: no new data: %d", sensor->dev->name, ret);
+		}
+		return ret;
+	}
+
+	bsec_input_t bsec_inputs[BSEC_MAX_PHYSICAL_SENSOR];
+	bsec_output_t bsec_outputs[BME68X_IAQ_N_VIRT_SENSORS];
+	uint8_t n_outputs = ARRAY_SIZE(bsec_outputs);
+	uint8_t n_inputs = bme68x_iaq_bsec_set_inputs(&sensor->settings, sensor->ts_ns,
+						      &bme68x_data, bsec_inputs);
+
+	/* Bus released: instances on other workers iterate in parallel. */
+	int64_t steps_ns = iaq_multi_uptime_ns();
+	ret = bsec_do_steps_m(sensor->inst, bsec_inputs, n_inputs, bsec_outputs, &n_outputs);
+	uint32_t steps_us = (iaq_multi_uptime_ns() - steps_ns) / NSEC_PER_USEC;
+
+	k_spinlock_key_t key = k_spin_lock(&iaq_multi_stats_lock);
+	sensor->stats.steps_max_us = MAX(sensor->stats.steps_max_us, steps_us);
+	sensor->stats.steps_total_us += steps_us;
+	if (!ret && n_outputs) {
+		sensor->stats.samples++;
+	}
+	k_spin_unlock(&iaq_multi_stats_lock, key);
+
+	if (ret) {
+		if (ret < 0) {
+			LOG_ERR("%s: BSEC algorithm error: %d", sensor->dev->name, ret);
+		} else {
+			LOG_WRN("%s: BSEC algorithm status: %d", sensor->dev->name, ret);
+		}
+		return ret;
+	}
+
+	if (n_outputs) {
+		struct bme68x_iaq_sample iaq_sample;
+		bme68x_iaq_sample_set_outputs(sensor->ts_ns, bsec_outputs, n_outputs, &iaq_sample);
+
+		if (sensor->cb) {
+			sensor->cb(sensor, &iaq_sample);
+		}
+
+		if (iaq_sample.channels & BME68X_IAQ_CHAN_TEMPERATURE) {
+			/* Update temperature used to compute heater resistance. */
+			sensor->bme68x_dev.amb_temp = (int8_t)iaq_sample.temperature;
+		}
+	}
+	return 0;
+}
+
+void iaq_multi_bus_lock(struct bme68x_iaq_multi_sensor *sensor)
+{
+	int64_t wait_ns = iaq_multi_uptime_ns();
+	k_mutex_lock(sensor->bus->lock, K_FOREVER);
+	uint32_t wait_us = (iaq_multi_uptime_ns() - wait_ns) / NSEC_PER_USEC;
+
+	k_spinlock_key_t key = k_spin_lock(&iaq_multi_stats_lock);
+	sensor->stats.bus_wait_max_us = MAX(sensor->stats.bus_wait_max_us, wait_us);
+	k_spin_unlock(&iaq_multi_stats_lock, key);
+}
+
+int64_t iaq_multi_uptime_ns(void)
+{
+	return (int64_t)k_ticks_to_ns_floor64(k_uptime_ticks());
+}
@@ -3,9 +3,13 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  *
- * A BSEC state save consists of two NVS elements:
+ * A BSEC state save consists of three NVS elements:
  * - STATE_LEN: size of last saved state (4 bytes, plus 8 bytes of meta-data)
  * - STATE_BLOB: last saved state data (typically 220 bytes, plus 8 bytes of meta-data)
+ * - STATE_META: state tag, BSEC version and configuration (16 bytes, plus 8 bytes of meta-data)
+ *
+ * Each state slot has its own set of elements, slot 0 uses the original identifiers.
+ * States saved before STATE_META was introduced are untagged.
  */
 
 #include "bme68x_iaq_nvs.h"
@@ -15,8 +19,11 @@
 #include <zephyr/fs/nvs.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
 #include <zephyr/storage/flash_map.h>
 
+#include "bsec_datatypes.h"
+
 /*
  * NVSFS identifier for the state's length.
  */
@@ -27,6 +34,22 @@
  */
 #define BME68X_IAQ_NVS_BSEC_STATE_BLOB_ID 2U
 
+/*
+ * NVSFS identifier for the state's tag.
+ */
+#define BME68X_IAQ_NVS_BSEC_STATE_META_ID 3U
+
+/*
+ * NVSFS identifier of an element for a state slot.
+ */
+#define BME68X_IAQ_NVS_SLOT_ID(_slot, _id) ((uint16_t)(((_slot) << 8) | (_id)))
+#define BME68X_IAQ_NVS_LEN_ID(_slot)                                                               \
+	BME68X_IAQ_NVS_SLOT_ID(_slot, BME68X_IAQ_NVS_BSEC_STATE_LEN_ID)
+#define BME68X_IAQ_NVS_BLOB_ID(_slot)                                                              \
+	BME68X_IAQ_NVS_SLOT_ID(_slot, BME68X_IAQ_NVS_BSEC_STATE_BLOB_ID)
+#define BME68X_IAQ_NVS_META_ID(_slot)                                                              \
+	BME68X_IAQ_NVS_SLOT_ID(_slot, BME68X_IAQ_NVS_BSEC_STATE_META_ID)
+
 #define BME68X_IAQ_NVS_PARTITION_DEVICE FIXED_PARTITION_DEVICE(BME68X_IAQ_NVS_PARTITION_LABEL)
 #define BME68X_IAQ_NVS_PARTITION_OFFSET FIXED_PARTITION_OFFSET(BME68X_IAQ_NVS_PARTITION_LABEL)
 
@@ -53,17 +76,60 @@ int bme68x_iaq_nvs_delete_state(void)
 	LOG_WRN("NVS support disabled");
 	return -ENOSYS;
 }
+int bme68x_iaq_nvs_read_slot_state(uint8_t slot, uint8_t *data, uint32_t *len)
+{
+	LOG_WRN("NVS support disabled");
+	return -ENOSYS;
+}
+int bme68x_iaq_nvs_write_slot_state(uint8_t slot, uint8_t const *data, uint32_t len,
+				    struct bme68x_iaq_nvs_meta const *meta)
+{
+	LOG_WRN("NVS support disabled");
+	return -ENOSYS;
+}
+int bme68x_iaq_nvs_read_slot_meta(uint8_t slot, struct bme68x_iaq_nvs_meta *meta)
+{
+	LOG_WRN("NVS support disabled");
+	return -ENOSYS;
+}
+int bme68x_iaq_nvs_delete_slot_state(uint8_t slot)
+{
+	LOG_WRN("NVS support disabled");
+	return -ENOSYS;
+}
+int bme68x_iaq_nvs_maintain(uint32_t reserve)
+{
+	return -ENOSYS;
+}
+void bme68x_iaq_nvs_stats_get(struct bme68x_iaq_nvs_stats *stats)
+{
+	*stats = (struct bme68x_iaq_nvs_stats){0};
+}
 #else
 
-static int write_bsec_state_len(uint32_t len);
-static int write_bsec_state_blob(uint8_t const *data, uint32_t len);
-static int read_bsec_state_len(uint32_t *len);
-static int read_bsec_state_blob(uint8_t *data, uint32_t len);
-static int delete_bsec_state_len(void);
-static int delete_bsec_state_blob(void);
+static int write_bsec_state_len(uint8_t slot, uint32_t len);
+static int write_bsec_state_blob(uint8_t slot, uint8_t const *data, uint32_t len);
+static int read_bsec_state_len(uint8_t slot, uint32_t *len);
+static int read_bsec_state_blob(uint8_t slot, uint8_t *data, uint32_t len);
+static int delete_bsec_state_len(uint8_t slot);
+static int delete_bsec_state_blob(uint8_t slot);
+static int write_bsec_state_meta(uint8_t slot, struct bme68x_iaq_nvs_meta const *meta);
+static int delete_bsec_state_meta(uint8_t slot);
+static uint32_t nvs_elapsed_us(int64_t start_ticks);
 
 /* Dedicated file-system instance. */
 static struct nvs_fs nvsfs;
+/* Set once the file-system is mounted. */
+static bool nvs_mounted;
+/*
+ * Set when compacting didn't free enough space for the requested reserve:
+ * don't compact again until the next write.
+ */
+static bool nvs_maint_exhausted;
+
+/* Timing statistics. */
+static struct bme68x_iaq_nvs_stats nvs_stats;
+static struct k_spinlock nvs_stats_lock;
 
 int z_impl_bme68x_iaq_nvs_init(void)
 {
@@ -85,6 +151,7 @@ int z_impl_bme68x_iaq_nvs_init(void)
 		ret = nvs_mount(&nvsfs);
 	}
 
+	nvs_mounted = !ret;
 	if (!ret) {
 		LOG_INF("NVS-FS at 0x%lx (%u x %u bytes)", page_info.start_offset,
 			nvsfs.sector_count, nvsfs.sector_size);
@@ -97,9 +164,32 @@ int z_impl_bme68x_iaq_nvs_init(void)
 
 int z_impl_bme68x_iaq_nvs_read_state(uint8_t *data, uint32_t *len)
 {
-	int ret = read_bsec_state_len(len);
+	return z_impl_bme68x_iaq_nvs_read_slot_state(0, data, len);
+}
+
+int z_impl_bme68x_iaq_nvs_write_state(uint8_t const *data, uint32_t len)
+{
+	return z_impl_bme68x_iaq_nvs_write_slot_state(0, data, len, NULL);
+}
+
+int z_impl_bme68x_iaq_nvs_delete_state(void)
+{
+	return z_impl_bme68x_iaq_nvs_delete_slot_state(0);
+}
+
+int z_impl_bme68x_iaq_nvs_read_slot_state(uint8_t slot, uint8_t *data, uint32_t *len)
+{
+	if (slot >= BME68X_IAQ_NVS_SLOTS) {
+		return -EINVAL;
+	}
+
+	int ret = read_bsec_state_len(slot, len);
+	if (!ret && (*len > BSEC_MAX_STATE_BLOB_SIZE)) {
+		LOG_ERR("invalid STATE_LEN: %u bytes", *len);
+		ret = -ERANGE;
+	}
 	if (!ret) {
-		ret = read_bsec_state_blob(data, *len);
+		ret = read_bsec_state_blob(slot, data, *len);
 
 		if (ret == -ENOENT) {
 			/* If we got the length element, we should also get a blob element. */
@@ -110,32 +200,135 @@ int z_impl_bme68x_iaq_nvs_read_state(uint8_t *data, uint32_t *len)
 	return ret;
 }
 
-int z_impl_bme68x_iaq_nvs_write_state(uint8_t const *data, uint32_t len)
+int z_impl_bme68x_iaq_nvs_write_slot_state(uint8_t slot, uint8_t const *data, uint32_t len,
+					    struct bme68x_iaq_nvs_meta const *meta)
 {
+	if (slot >= BME68X_IAQ_NVS_SLOTS) {
+		return -EINVAL;
+	}
+
 	/*
 	 * Write STATE_BLOB first, creating BSEC state data.
-	 * Write STATE_LEN only if we successfully wrote the state data.
+	 * Then write (or remove) STATE_META, so that the tag matches the state data.
+	 * Write STATE_LEN only if we successfully wrote the state data and tag.
 	 */
-	int ret = write_bsec_state_blob(data, len);
+	int64_t start = k_uptime_ticks();
+	int ret = write_bsec_state_blob(slot, data, len);
 	if (!ret) {
-		ret = write_bsec_state_len(len);
+		ret = meta ? write_bsec_state_meta(slot, meta) : delete_bsec_state_meta(slot);
+		if (ret == -ENOENT) {
+			ret = 0;
+		}
 	}
+	if (!ret) {
+		ret = write_bsec_state_len(slot, len);
+	}
+
+	/* Includes garbage collection and erase, when the maintenance is late. */
+	uint32_t save_us = nvs_elapsed_us(start);
+	k_spinlock_key_t key = k_spin_lock(&nvs_stats_lock);
+	nvs_stats.saves++;
+	nvs_stats.save_last_us = save_us;
+	nvs_stats.save_max_us = MAX(nvs_stats.save_max_us, save_us);
+	nvs_maint_exhausted = false;
+	k_spin_unlock(&nvs_stats_lock, key);
+
+	LOG_DBG("STATE write: %u us", save_us);
 	return ret;
 }
 
-int z_impl_bme68x_iaq_nvs_delete_state(void)
+int z_impl_bme68x_iaq_nvs_read_slot_meta(uint8_t slot, struct bme68x_iaq_nvs_meta *meta)
+{
+	if (slot >= BME68X_IAQ_NVS_SLOTS) {
+		return -EINVAL;
+	}
+
+	ssize_t ret = nvs_read(&nvsfs, BME68X_IAQ_NVS_META_ID(slot), meta, sizeof(*meta));
+	if (ret == sizeof(*meta)) {
+		return (meta->version == BME68X_IAQ_NVS_META_VERSION) ? 0 : -ENOENT;
+	}
+
+	if (ret < 0) {
+		if (ret == -ENOENT) {
+			LOG_DBG("no STATE_META entry");
+		} else {
+			LOG_ERR("failed to read STATE_META: %d", ret);
+		}
+		return ret;
+	}
+
+	/* Unknown tag format, handled as untagged. */
+	LOG_WRN("invalid STATE_META: %u/%u bytes", sizeof(*meta), ret);
+	return -ENOENT;
+}
+
+int z_impl_bme68x_iaq_nvs_delete_slot_state(uint8_t slot)
 {
+	if (slot >= BME68X_IAQ_NVS_SLOTS) {
+		return -EINVAL;
+	}
+
 	/*
 	 * Delete STATE_LEN first to invalidate the saved BSEC state, if any.
 	 * Do not delete STATE_BLOB if we failed to invalidate an existing saved state.
 	 */
-	int ret = delete_bsec_state_len();
+	int ret = delete_bsec_state_len(slot);
 	if (!ret || (ret == -ENOENT)) {
-		ret = delete_bsec_state_blob();
+		ret = delete_bsec_state_blob(slot);
+	}
+	if (!ret || (ret == -ENOENT)) {
+		int ret_meta = delete_bsec_state_meta(slot);
+		if (ret_meta && (ret_meta != -ENOENT)) {
+			ret = ret_meta;
+		}
 	}
 	return ret;
 }
 
+int z_impl_bme68x_iaq_nvs_maintain(uint32_t reserve)
+{
+	if (!nvs_mounted) {
+		return -EAGAIN;
+	}
+
+	ssize_t free = nvs_sector_max_data_size(&nvsfs);
+	if (free < 0) {
+		LOG_ERR("NVS-FS free space unavailable: %d", free);
+		return free;
+	}
+	if ((free >= reserve) || nvs_maint_exhausted) {
+		return 0;
+	}
+
+	int64_t start = k_uptime_ticks();
+	int ret = nvs_sector_use_next(&nvsfs);
+	uint32_t maint_us = nvs_elapsed_us(start);
+	if (ret) {
+		LOG_ERR("NVS-FS maintenance failed: %d", ret);
+		return ret;
+	}
+
+	free = nvs_sector_max_data_size(&nvsfs);
+	k_spinlock_key_t key = k_spin_lock(&nvs_stats_lock);
+	nvs_stats.maint_runs++;
+	nvs_stats.maint_max_us = MAX(nvs_stats.maint_max_us, maint_us);
+	nvs_maint_exhausted = (free < reserve);
+	k_spin_unlock(&nvs_stats_lock, key);
+
+	if (free < reserve) {
+		LOG_WRN("NVS-FS sector too small: %d/%u bytes free", free, reserve);
+	}
+	LOG_DBG("NVS-FS maintenance: %u us, %d bytes free", maint_us, free);
+	return 0;
+}
+
+void z_impl_bme68x_iaq_nvs_stats_get(struct bme68x_iaq_nvs_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&nvs_stats_lock);
+	*stats = nvs_stats;
+	k_spin_unlock(&nvs_stats_lock, key);
+}
+
 #ifdef CONFIG_USERSPACE
 #include <zephyr/internal/syscall_handler.h>
 
@@ -147,7 +340,8 @@ int z_vrfy_bme68x_iaq_nvs_init(void)
 
 int z_vrfy_bme68x_iaq_nvs_read_state(uint8_t *data, uint32_t *len)
 {
-	K_OOPS(K_SYSCALL_MEMORY_WRITE(data, sizeof(*len)));
+	K_OOPS(K_SYSCALL_MEMORY_WRITE(len, sizeof(*len)));
+	K_OOPS(K_SYSCALL_MEMORY_WRITE(data, BSEC_MAX_STATE_BLOB_SIZE));
 	return z_impl_bme68x_iaq_nvs_read_state(data, len);
 }
 #include <syscalls/bme68x_iaq_nvs_read_state_mrsh.c>
@@ -165,12 +359,57 @@ int z_vrfy_bme68x_iaq_nvs_delete_state(void)
 }
 #include <syscalls/bme68x_iaq_nvs_delete_state_mrsh.c>
 
+int z_vrfy_bme68x_iaq_nvs_read_slot_state(uint8_t slot, uint8_t *data, uint32_t *len)
+{
+	K_OOPS(K_SYSCALL_MEMORY_WRITE(len, sizeof(*len)));
+	K_OOPS(K_SYSCALL_MEMORY_WRITE(data, BSEC_MAX_STATE_BLOB_SIZE));
+	return z_impl_bme68x_iaq_nvs_read_slot_state(slot, data, len);
+}
+#include <syscalls/bme68x_iaq_nvs_read_slot_state_mrsh.c>
+
+int z_vrfy_bme68x_iaq_nvs_write_slot_state(uint8_t slot, uint8_t const *data, uint32_t len,
+					    struct bme68x_iaq_nvs_meta const *meta)
+{
+	K_OOPS(K_SYSCALL_MEMORY_READ(data, len));
+	if (meta) {
+		K_OOPS(K_SYSCALL_MEMORY_READ(meta, sizeof(*meta)));
+	}
+	return z_impl_bme68x_iaq_nvs_write_slot_state(slot, data, len, meta);
+}
+#include <syscalls/bme68x_iaq_nvs_write_slot_state_mrsh.c>
+
+int z_vrfy_bme68x_iaq_nvs_read_slot_meta(uint8_t slot, struct bme68x_iaq_nvs_meta *meta)
+{
+	K_OOPS(K_SYSCALL_MEMORY_WRITE(meta, sizeof(*meta)));
+	return z_impl_bme68x_iaq_nvs_read_slot_meta(slot, meta);
+}
+#include <syscalls/bme68x_iaq_nvs_read_slot_meta_mrsh.c>
+
+int z_vrfy_bme68x_iaq_nvs_delete_slot_state(uint8_t slot)
+{
+	return z_impl_bme68x_iaq_nvs_delete_slot_state(slot);
+}
+#include <syscalls/bme68x_iaq_nvs_delete_slot_state_mrsh.c>
+
+int z_vrfy_bme68x_iaq_nvs_maintain(uint32_t reserve)
+{
+	return z_impl_bme68x_iaq_nvs_maintain(reserve);
+}
+#include <syscalls/bme68x_iaq_nvs_maintain_mrsh.c>
+
+void z_vrfy_bme68x_iaq_nvs_stats_get(struct bme68x_iaq_nvs_stats *stats)
+{
+	K_OOPS(K_SYSCALL_MEMORY_WRITE(stats, sizeof(*stats)));
+	z_impl_bme68x_iaq_nvs_stats_get(stats);
+}
+#include <syscalls/bme68x_iaq_nvs_stats_get_mrsh.c>
+
 #endif /* CONFIG_USERSPACE */
 
-int read_bsec_state_len(uint32_t *len)
+int read_bsec_state_len(uint8_t slot, uint32_t *len)
 {
 	size_t sz_state_len = sizeof(*len);
-	ssize_t ret = nvs_read(&nvsfs, BME68X_IAQ_NVS_BSEC_STATE_LEN_ID, len, sz_state_len);
+	ssize_t ret = nvs_read(&nvsfs, BME68X_IAQ_NVS_LEN_ID(slot), len, sz_state_len);
 
 	if (ret == sz_state_len) {
 		/* On success, returns the number of bytes requested to be read. */
@@ -195,9 +434,9 @@ int read_bsec_state_len(uint32_t *len)
 	return -ERANGE;
 }
 
-int read_bsec_state_blob(uint8_t *state, uint32_t len)
+int read_bsec_state_blob(uint8_t slot, uint8_t *state, uint32_t len)
 {
-	ssize_t ret = nvs_read(&nvsfs, BME68X_IAQ_NVS_BSEC_STATE_BLOB_ID, state, len);
+	ssize_t ret = nvs_read(&nvsfs, BME68X_IAQ_NVS_BLOB_ID(slot), state, len);
 
 	if (ret == len) {
 		return 0;
@@ -216,10 +455,10 @@ int read_bsec_state_blob(uint8_t *state, uint32_t len)
 	return -ERANGE;
 }
 
-int write_bsec_state_len(uint32_t len)
+int write_bsec_state_len(uint8_t slot, uint32_t len)
 {
 	size_t sz_state_len = sizeof(len);
-	ssize_t ret = nvs_write(&nvsfs, BME68X_IAQ_NVS_BSEC_STATE_LEN_ID, &len, sz_state_len);
+	ssize_t ret = nvs_write(&nvsfs, BME68X_IAQ_NVS_LEN_ID(slot), &len, sz_state_len);
 
 	if (ret < 0) {
 		/* On error, returns negative value of errno.h defined error codes. */
@@ -238,9 +477,9 @@ int write_bsec_state_len(uint32_t len)
 	return 0;
 }
 
-int write_bsec_state_blob(uint8_t const *data, uint32_t len)
+int write_bsec_state_blob(uint8_t slot, uint8_t const *data, uint32_t len)
 {
-	ssize_t ret = nvs_write(&nvsfs, BME68X_IAQ_NVS_BSEC_STATE_BLOB_ID, data, len);
+	ssize_t ret = nvs_write(&nvsfs, BME68X_IAQ_NVS_BLOB_ID(slot), data, len);
 
 	if (ret < 0) {
 		LOG_ERR("failed to write STATE_BLOB: %d", ret);
@@ -254,22 +493,52 @@ int write_bsec_state_blob(uint8_t const *data, uint32_t len)
 	return 0;
 }
 
-int delete_bsec_state_len(void)
+int delete_bsec_state_len(uint8_t slot)
 {
-	int ret = nvs_delete(&nvsfs, BME68X_IAQ_NVS_BSEC_STATE_LEN_ID);
+	int ret = nvs_delete(&nvsfs, BME68X_IAQ_NVS_LEN_ID(slot));
 	if (ret && (ret != -ENOENT)) {
 		LOG_ERR("failed to delete STATE_LEN: %d", ret);
 	}
 	return ret;
 }
 
-int delete_bsec_state_blob(void)
+int delete_bsec_state_blob(uint8_t slot)
 {
-	int ret = nvs_delete(&nvsfs, BME68X_IAQ_NVS_BSEC_STATE_BLOB_ID);
+	int ret = nvs_delete(&nvsfs, BME68X_IAQ_NVS_BLOB_ID(slot));
 	if (ret && (ret != -ENOENT)) {
 		LOG_ERR("failed to delete STATE_BLOB: %d", ret);
 	}
 	return ret;
 }
 
+int write_bsec_state_meta(uint8_t slot, struct bme68x_iaq_nvs_meta const *meta)
+{
+	ssize_t ret = nvs_write(&nvsfs, BME68X_IAQ_NVS_META_ID(slot), meta, sizeof(*meta));
+
+	if (ret < 0) {
+		LOG_ERR("failed to write STATE_META: %d", ret);
+		return ret;
+	}
+
+	if (!ret) {
+		LOG_DBG("same STATE_META data, skipped");
+	}
+
+	return 0;
+}
+
+int delete_bsec_state_meta(uint8_t slot)
+{
+	int ret = nvs_delete(&nvsfs, BME68X_IAQ_NVS_META_ID(slot));
+	if (ret && (ret != -ENOENT)) {
+		LOG_ERR("failed to delete STATE_META: %d", ret);
+	}
+	return ret;
+}
+
+uint32_t nvs_elapsed_us(int64_t start_ticks)
+{
+	return (uint32_t)k_ticks_to_us_ceil64(k_uptime_ticks() - start_ticks);
+}
+
 #endif /* BME68X_IAQ_NVS_ENABLED */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_iaq_roc.h"
+
+#include "bme68x_roc.h"
+
+/*
+ * Value of an IAQ output channel.
+ *
+ * iaq_sample: the IAQ sample
+ * channel: a single BME68X_IAQ_CHAN_* bit
+ */
+static float iaq_roc_value(struct bme68x_iaq_sample const *iaq_sample, uint32_t channel);
+
+uint32_t bme68x_iaq_roc_filter(struct bme68x_iaq_roc *roc,
+			       struct bme68x_iaq_sample const *iaq_sample)
+{
+	struct bme68x_iaq_sample const *last = &roc->last;
+	uint32_t reasons = 0;
+
+	if (!roc->primed) {
+		reasons |= BME68X_IAQ_ROC_FIRST;
+	} else {
+		if (bme68x_roc_heartbeat(roc->heartbeat_ms, last->ts_ns, iaq_sample->ts_ns)) {
+			reasons |= BME68X_IAQ_ROC_HEARTBEAT;
+		}
+
+		if (((iaq_sample->channels & BME68X_IAQ_CHAN_IAQ) &&
+		     (iaq_sample->iaq_accuracy != last->iaq_accuracy)) ||
+		    ((iaq_sample->channels & BME68X_IAQ_CHAN_CO2) &&
+		     (iaq_sample->co2_accuracy != last->co2_accuracy)) ||
+		    ((iaq_sample->channels & BME68X_IAQ_CHAN_VOC) &&
+		     (iaq_sample->voc_accuracy != last->voc_accuracy))) {
+			reasons |= BME68X_IAQ_ROC_ACCURACY;
+		}
+
+		if (((iaq_sample->channels & BME68X_IAQ_CHAN_STAB_STATUS) &&
+		     (iaq_sample->stab_status != last->stab_status)) ||
+		    ((iaq_sample->channels & BME68X_IAQ_CHAN_RUN_STATUS) &&
+		     (iaq_sample->run_status != last->run_status))) {
+			reasons |= BME68X_IAQ_ROC_STATUS;
+		}
+	}
+
+	for (size_t i = 0; i < roc->n_rules; i++) {
+		struct bme68x_iaq_roc_rule const *rule = &roc->rules[i];
+
+		if (!(iaq_sample->channels & rule->channel)) {
+			continue;
+		}
+		float value = iaq_roc_value(iaq_sample, rule->channel);
+
+		uint32_t changes = BME68X_ROC_EVAL(&roc->states[i], rule, value, roc->primed);
+		if (changes & BME68X_ROC_DEADBAND) {
+			reasons |= BME68X_IAQ_ROC_DEADBAND;
+		}
+		if (changes & BME68X_ROC_THRESHOLD) {
+			reasons |= BME68X_IAQ_ROC_THRESHOLD;
+		}
+	}
+
+	if (!reasons) {
+		atomic_inc(&roc->suppressed);
+		return 0;
+	}
+
+	/* Forwarded: update references for deadbands and changes. */
+	for (size_t i = 0; i < roc->n_rules; i++) {
+		if (iaq_sample->channels & roc->rules[i].channel) {
+			roc->states[i].value = iaq_roc_value(iaq_sample, roc->rules[i].channel);
+		}
+	}
+	roc->last = *iaq_sample;
+	roc->primed = true;
+
+	atomic_inc(&roc->forwarded);
+	return reasons;
+}
+
+void bme68x_iaq_roc_reset(struct bme68x_iaq_roc *roc)
+{
+	roc->primed = false;
+	for (size_t i = 0; i < roc->n_rules; i++) {
+		roc->states[i] = (struct bme68x_roc_state){0};
+	}
+}
+
+float iaq_roc_value(struct bme68x_iaq_sample const *iaq_sample, uint32_t channel)
+{
+	switch (channel) {
+	case BME68X_IAQ_CHAN_RAW_TEMPERATURE:
+		return iaq_sample->raw_temperature;
+	case BME68X_IAQ_CHAN_RAW_PRESSURE:
+		return iaq_sample->raw_pressure;
+	case BME68X_IAQ_CHAN_RAW_HUMIDITY:
+		return iaq_sample->raw_humidity;
+	case BME68X_IAQ_CHAN_RAW_GAS:
+		return iaq_sample->raw_gas_res;
+	case BME68X_IAQ_CHAN_TEMPERATURE:
+		return iaq_sample->temperature;
+	case BME68X_IAQ_CHAN_HUMIDITY:
+		return iaq_sample->humidity;
+	case BME68X_IAQ_CHAN_IAQ:
+		return iaq_sample->iaq;
+	case BME68X_IAQ_CHAN_STATIC_IAQ:
+		return (float)iaq_sample->static_iaq;
+	case BME68X_IAQ_CHAN_CO2:
+		return iaq_sample->co2_equivalent;
+	case BME68X_IAQ_CHAN_VOC:
+		return iaq_sample->voc_equivalent;
+	case BME68X_IAQ_CHAN_GAS_PERCENTAGE:
+		return iaq_sample->gas_percentage;
+	case BME68X_IAQ_CHAN_STAB_STATUS:
+		return iaq_sample->stab_status;
+	case BME68X_IAQ_CHAN_RUN_STATUS:
+		return iaq_sample->run_status;
+	default:
+		return 0.0f;
+	}
+}
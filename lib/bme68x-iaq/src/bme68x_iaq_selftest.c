@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * The self-test steps are those of bme68x_selftest_check():
+ * - step 0: heater at BME68X_HIGH_TEMP for BME68X_HEATR_DUR1, gas measurement must be valid
+ * - steps 1 to BME68X_N_MEAS: heater at BME68X_HIGH_TEMP or BME68X_LOW_TEMP (alternating)
+ *   for BME68X_HEATR_DUR2, then TPHG data analysis
+ *
+ * Unlike bme68x_selftest_check(), the controlled sensor is not reinitialized:
+ * its calibration data and ambient temperature are used as is.
+ */
+
+#include "bme68x_iaq_selftest.h"
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+
+#include "bme68x.h"
+#include "bme68x_iaq_bsec.h"
+
+/* Number of self-test steps (measurements). */
+#define IAQ_SELFTEST_STEPS (1 + BME68X_N_MEAS)
+
+/* Idle time left before the next BSEC rendez-vous once a step has completed. */
+#define IAQ_SELFTEST_MARGIN_NS ((int64_t)50 * NSEC_PER_MSEC)
+
+LOG_MODULE_DECLARE(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
+
+/*
+ * Complete the self-test in progress, if any, and notify its callback.
+ *
+ * result: the self-test result
+ */
+static void iaq_selftest_complete(int result);
+
+/*
+ * Analyze the TPHG data of the self-test steps 1 to BME68X_N_MEAS,
+ * with the criteria of bme68x_selftest_check().
+ *
+ * Returns BME68X_OK if passed, BME68X_E_SELF_TEST otherwise.
+ */
+static int iaq_selftest_analyze(void);
+
+/*
+ * Self-test in progress:
+ * - requested by any thread, while no callback is set
+ * - then owned by the IAQ control loop until completed
+ */
+static struct {
+	bme68x_iaq_selftest_cb cb;
+	void *user_data;
+	uint8_t step;
+	struct bme68x_data data[BME68X_N_MEAS];
+} iaq_selftest;
+static struct k_spinlock iaq_selftest_lock;
+
+int bme68x_iaq_selftest_request(bme68x_iaq_selftest_cb cb, void *user_data)
+{
+	if (!cb) {
+		return -EINVAL;
+	}
+
+	int ret = 0;
+	k_spinlock_key_t key = k_spin_lock(&iaq_selftest_lock);
+	if (iaq_selftest.cb) {
+		ret = -EBUSY;
+	} else {
+		iaq_selftest.cb = cb;
+		iaq_selftest.user_data = user_data;
+		iaq_selftest.step = 0;
+	}
+	k_spin_unlock(&iaq_selftest_lock, key);
+	return ret;
+}
+
+bool bme68x_iaq_selftest_step(struct bme68x_dev *dev, int64_t idle_ns)
+{
+	k_spinlock_key_t key = k_spin_lock(&iaq_selftest_lock);
+	bool pending = (iaq_selftest.cb != NULL);
+	k_spin_unlock(&iaq_selftest_lock, key);
+	if (!pending) {
+		return false;
+	}
+
+	uint8_t step = iaq_selftest.step;
+	struct bme68x_conf conf = {
+		.os_hum = BME68X_OS_1X,
+		.os_pres = BME68X_OS_16X,
+		.os_temp = BME68X_OS_2X,
+		.filter = BME68X_FILTER_OFF,
+		.odr = BME68X_ODR_NONE,
+	};
+	struct bme68x_heatr_conf heatr_conf = {
+		.enable = BME68X_ENABLE,
+		.heatr_temp = ((step % 2) || !step) ? BME68X_HIGH_TEMP : BME68X_LOW_TEMP,
+		.heatr_dur = step ? BME68X_HEATR_DUR2 : BME68X_HEATR_DUR1,
+	};
+
+	uint32_t meas_us = bme68x_get_meas_dur(BME68X_FORCED_MODE, &conf, dev) +
+			   heatr_conf.heatr_dur * USEC_PER_MSEC;
+	if (((int64_t)meas_us * NSEC_PER_USEC + IAQ_SELFTEST_MARGIN_NS) > idle_ns) {
+		/* Wait for an idle slot long enough. */
+		return false;
+	}
+
+	int8_t ret = bme68x_set_heatr_conf(BME68X_FORCED_MODE, &heatr_conf, dev);
+	if (!ret) {
+		ret = bme68x_set_conf(&conf, dev);
+	}
+	if (!ret) {
+		ret = bme68x_set_op_mode(BME68X_FORCED_MODE, dev);
+	}
+	if (ret) {
+		LOG_ERR("self-test step %u: configuration failed: %d", step, ret);
+		iaq_selftest_complete(ret);
+		return true;
+	}
+
+	LOG_DBG("self-test step %u: %u us ...", step, meas_us);
+	if (k_sleep(K_USEC(meas_us))) {
+		/* Woken up by bme68x_iaq_stop(), the control loop cancels the self-test. */
+		return true;
+	}
+
+	struct bme68x_data data;
+	uint8_t n_data;
+	ret = bme68x_get_data(BME68X_FORCED_MODE, &data, &n_data, dev);
+	if (ret) {
+		LOG_ERR("self-test step %u: no data: %d", step, ret);
+		iaq_selftest_complete((ret < 0) ? ret : BME68X_E_SELF_TEST);
+		return true;
+	}
+
+	if (!step) {
+		if ((data.idac == 0x00) || (data.idac == 0xFF) ||
+		    !(data.status & BME68X_GASM_VALID_MSK)) {
+			LOG_WRN("self-test: heater check failed");
+			iaq_selftest_complete(BME68X_E_SELF_TEST);
+			return true;
+		}
+	} else {
+		iaq_selftest.data[step - 1] = data;
+	}
+
+	iaq_selftest.step = ++step;
+	if (step == IAQ_SELFTEST_STEPS) {
+		iaq_selftest_complete(iaq_selftest_analyze());
+	}
+	return true;
+}
+
+void bme68x_iaq_selftest_cancel(int result)
+{
+	iaq_selftest_complete(result);
+}
+
+void iaq_selftest_complete(int result)
+{
+	k_spinlock_key_t key = k_spin_lock(&iaq_selftest_lock);
+	bme68x_iaq_selftest_cb cb = iaq_selftest.cb;
+	void *user_data = iaq_selftest.user_data;
+	iaq_selftest.cb = NULL;
+	k_spin_unlock(&iaq_selftest_lock, key);
+
+	if (cb) {
+		LOG_INF("self-test: %d", result);
+		cb(result, user_data);
+	}
+}
+
+int iaq_selftest_analyze(void)
+{
+	struct bme68x_data const *data = iaq_selftest.data;
+	unsigned int failed = 0;
+
+	if ((data[0].temperature < BME68X_MIN_TEMPERATURE) ||
+	    (data[0].temperature > BME68X_MAX_TEMPERATURE)) {
+		failed++;
+	}
+	if ((data[0].pressure < BME68X_MIN_PRESSURE) || (data[0].pressure > BME68X_MAX_PRESSURE)) {
+		failed++;
+	}
+	if ((data[0].humidity < BME68X_MIN_HUMIDITY) || (data[0].humidity > BME68X_MAX_HUMIDITY)) {
+		failed++;
+	}
+
+	/* Every gas measurement should be valid. */
+	for (uint8_t i = 0; i < BME68X_N_MEAS; i++) {
+		if (!(data[i].status & BME68X_GASM_VALID_MSK)) {
+			failed++;
+		}
+	}
+
+	/* Gas resistance ratio between the low and high temperature measurements. */
+	if (data[4].gas_resistance > 0) {
+		uint32_t cent_res =
+			(uint32_t)((5 * (data[3].gas_resistance + data[5].gas_resistance)) /
+				   (2 * data[4].gas_resistance));
+		if (cent_res < 6) {
+			failed++;
+		}
+	} else {
+		failed++;
+	}
+
+	if (failed) {
+		LOG_WRN("self-test: %u checks failed", failed);
+		return BME68X_E_SELF_TEST;
+	}
+	return BME68X_OK;
+}
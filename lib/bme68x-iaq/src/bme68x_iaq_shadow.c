@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Shadow BSEC instances (BSEC multi-instance interface):
+ * - fed with the primary instance's inputs, never drive the sensor
+ * - own outputs (callback) and state persistence (NVS slot)
+ */
+
+#include "bme68x_iaq_shadow.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+
+#include "bsec_interface_multi.h"
+
+#include "bme68x_iaq_bsec.h"
+#include "bme68x_iaq_nvs.h"
+
+LOG_MODULE_DECLARE(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
+
+/*
+ * Initialize a shadow's BSEC instance: configuration, saved state, subscriptions.
+ *
+ * Returns 0 on success, -EINVAL on invalid NVS slot, BSEC status otherwise.
+ */
+static int iaq_shadow_init(struct bme68x_iaq_shadow *shadow);
+
+/*
+ * Load a shadow's saved state from its NVS slot.
+ *
+ * Incompatible or rejected states are not loaded,
+ * and replaced on the next save.
+ *
+ * Returns 0 on success, -ENOENT if no state loaded, negative errno otherwise.
+ */
+static int iaq_shadow_load_state(struct bme68x_iaq_shadow *shadow);
+
+/* Shadows processed by the control loop. */
+static struct bme68x_iaq_shadow *const *iaq_shadows;
+static size_t iaq_n_shadows;
+
+/* Serializes shadow iterations and state saves (acquisition and processing threads). */
+static K_MUTEX_DEFINE(iaq_shadow_lock);
+/* Protects shadows statistics. */
+static struct k_spinlock iaq_shadow_stats_lock;
+
+int bme68x_iaq_shadow_init(struct bme68x_iaq_shadow *const *shadows, size_t n_shadows)
+{
+	size_t inst_size = bsec_get_instance_size_m();
+	if (inst_size > CONFIG_BME68X_IAQ_SHADOW_INSTANCE_SIZE) {
+		LOG_ERR("BSEC instance size: %u > %u", inst_size,
+			CONFIG_BME68X_IAQ_SHADOW_INSTANCE_SIZE);
+		return -ENOMEM;
+	}
+
+	k_mutex_lock(&iaq_shadow_lock, K_FOREVER);
+	iaq_n_shadows = 0;
+
+	int ret = 0;
+	for (size_t i = 0; (i < n_shadows) && !ret; i++) {
+		ret = iaq_shadow_init(shadows[i]);
+		if (ret) {
+			LOG_ERR("%s: initialization failed: %d", shadows[i]->name, ret);
+		}
+	}
+
+	if (!ret) {
+		iaq_shadows = shadows;
+		iaq_n_shadows = n_shadows;
+		LOG_INF("IAQ shadows: %u", n_shadows);
+	}
+	k_mutex_unlock(&iaq_shadow_lock);
+	return ret;
+}
+
+void bme68x_iaq_shadow_stats_get(struct bme68x_iaq_shadow const *shadow,
+				 struct bme68x_iaq_shadow_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&iaq_shadow_stats_lock);
+	*stats = shadow->stats;
+	k_spin_unlock(&iaq_shadow_stats_lock, key);
+}
+
+void bme68x_iaq_shadow_process(bsec_input_t const *bsec_inputs, uint8_t n_inputs, int64_t ts_ns)
+{
+	k_mutex_lock(&iaq_shadow_lock, K_FOREVER);
+
+	for (size_t i = 0; i < iaq_n_shadows; i++) {
+		struct bme68x_iaq_shadow *shadow = iaq_shadows[i];
+
+		if (ts_ns < shadow->next_ns) {
+			/* Slower shadow. */
+			k_spinlock_key_t key = k_spin_lock(&iaq_shadow_stats_lock);
+			shadow->stats.skipped++;
+			k_spin_unlock(&iaq_shadow_stats_lock, key);
+			continue;
+		}
+		if (shadow->sample_rate > 0) {
+			/* Tolerate some jitter of the primary rendez-vous. */
+			int64_t period_ns = (int64_t)(NSEC_PER_SEC / shadow->sample_rate);
+			shadow->next_ns = ts_ns + period_ns - (period_ns / 16);
+		}
+
+		bsec_output_t bsec_outputs[BME68X_IAQ_N_VIRT_SENSORS];
+		uint8_t n_outputs = ARRAY_SIZE(bsec_outputs);
+		int ret = bsec_do_steps_m(shadow->inst, bsec_inputs, n_inputs, bsec_outputs,
+					  &n_outputs);
+		if (ret) {
+			LOG_WRN("%s: BSEC algorithm status: %d", shadow->name, ret);
+		}
+
+		k_spinlock_key_t key = k_spin_lock(&iaq_shadow_stats_lock);
+		if (ret) {
+			shadow->stats.errors++;
+		} else if (n_outputs) {
+			shadow->stats.samples++;
+		}
+		k_spin_unlock(&iaq_shadow_stats_lock, key);
+
+		if ((ret >= 0) && n_outputs && shadow->cb) {
+			struct bme68x_iaq_sample iaq_sample;
+			bme68x_iaq_sample_set_outputs(ts_ns, bsec_outputs, n_outputs, &iaq_sample);
+			shadow->cb(shadow, &iaq_sample);
+		}
+	}
+
+	k_mutex_unlock(&iaq_shadow_lock);
+}
+
+void bme68x_iaq_shadow_save(void)
+{
+	/* NOTE: stack size > 221 + 4086 (4307 bytes). */
+	uint8_t state[BSEC_MAX_STATE_BLOB_SIZE];
+	uint8_t buf[BSEC_MAX_WORKBUFFER_SIZE];
+
+	k_mutex_lock(&iaq_shadow_lock, K_FOREVER);
+
+	for (size_t i = 0; i < iaq_n_shadows; i++) {
+		struct bme68x_iaq_shadow *shadow = iaq_shadows[i];
+		if (!shadow->nvs_slot) {
+			continue;
+		}
+
+		uint32_t len;
+		int ret = bsec_get_state_m(shadow->inst, 0, state, sizeof(state), buf, sizeof(buf),
+					   &len);
+		if (!ret) {
+			struct bme68x_iaq_nvs_meta meta;
+			bme68x_iaq_bsec_state_tag(shadow->config_crc, 0, &meta);
+			ret = bme68x_iaq_nvs_write_slot_state(shadow->nvs_slot, state, len, &meta);
+		}
+
+		if (ret) {
+			LOG_ERR("%s: failed to save BSEC state: %d", shadow->name, ret);
+		} else {
+			LOG_INF("%s: saved BSEC state (%u bytes)", shadow->name, len);
+		}
+	}
+
+	k_mutex_unlock(&iaq_shadow_lock);
+}
+
+int iaq_shadow_init(struct bme68x_iaq_shadow *shadow)
+{
+	if (shadow->nvs_slot >= BME68X_IAQ_NVS_FALLBACK_SLOT) {
+		return -EINVAL;
+	}
+	shadow->config_crc = crc32_ieee(shadow->config, shadow->config_size);
+
+	void *inst = shadow->inst;
+	int ret = bsec_init_m(inst);
+	if (!ret) {
+		/* NOTE: stack size > 4096 bytes. */
+		uint8_t buf[BSEC_MAX_WORKBUFFER_SIZE];
+		ret = bsec_set_configuration_m(inst, shadow->config, shadow->config_size, buf,
+					       sizeof(buf));
+	}
+	if (ret) {
+		LOG_ERR("%s: BSEC configuration failed: %d", shadow->name, ret);
+		return ret;
+	}
+
+	if (BME68X_IAQ_NVS_ENABLED && shadow->nvs_slot) {
+		ret = iaq_shadow_load_state(shadow);
+		if (ret && (ret != -ENOENT)) {
+			return ret;
+		}
+	}
+
+	/* Same virtual sensors as the primary instance, possibly at a slower rate. */
+	bsec_sensor_configuration_t virt_sensors[BME68X_IAQ_N_VIRT_SENSORS];
+	memcpy(virt_sensors, bme68x_iaq_virt_sensors, sizeof(virt_sensors));
+	if (shadow->sample_rate > 0) {
+		for (size_t i = 0; i < ARRAY_SIZE(virt_sensors); i++) {
+			virt_sensors[i].sample_rate = shadow->sample_rate;
+		}
+	}
+
+	uint8_t n_phy = BSEC_MAX_PHYSICAL_SENSOR;
+	bsec_sensor_configuration_t phy_sensors[BSEC_MAX_PHYSICAL_SENSOR];
+	ret = bsec_update_subscription_m(inst, virt_sensors, ARRAY_SIZE(virt_sensors),
+					 phy_sensors, &n_phy);
+	if (ret) {
+		LOG_ERR("%s: BSEC subscriptions failed: %d", shadow->name, ret);
+		return ret;
+	}
+
+	shadow->next_ns = 0;
+	shadow->stats = (struct bme68x_iaq_shadow_stats){0};
+	return 0;
+}
+
+int iaq_shadow_load_state(struct bme68x_iaq_shadow *shadow)
+{
+	/* NOTE: stack size > 221 + 4086 (4307 bytes). */
+	uint8_t data[BSEC_MAX_STATE_BLOB_SIZE];
+	uint8_t buf[BSEC_MAX_WORKBUFFER_SIZE];
+	uint32_t len;
+
+	int ret = bme68x_iaq_nvs_read_slot_state(shadow->nvs_slot, data, &len);
+	if (ret) {
+		if (ret == -ENOENT) {
+			LOG_INF("%s: no BSEC state available", shadow->name);
+		} else {
+			LOG_ERR("%s: failed to read BSEC state: %d", shadow->name, ret);
+		}
+		return ret;
+	}
+
+	struct bme68x_iaq_nvs_meta meta;
+	ret = bme68x_iaq_nvs_read_slot_meta(shadow->nvs_slot, &meta);
+	if (ret && (ret != -ENOENT)) {
+		return ret;
+	}
+	if (bme68x_iaq_bsec_state_compat(ret ? NULL : &meta, shadow->config_crc) ==
+	    BME68X_IAQ_STATE_COMPAT_NONE) {
+		LOG_WRN("%s: incompatible BSEC state: BSEC %u.%u.%u.%u, configuration 0x%08x",
+			shadow->name, meta.bsec_version[0], meta.bsec_version[1],
+			meta.bsec_version[2], meta.bsec_version[3], meta.config_crc);
+		return -ENOENT;
+	}
+
+	ret = bsec_set_state_m(shadow->inst, data, len, buf, sizeof(buf));
+	if (ret) {
+		LOG_WRN("%s: BSEC state rejected: %d", shadow->name, ret);
+		return -ENOENT;
+	}
+	LOG_INF("%s: loaded BSEC state (%u bytes)", shadow->name, len);
+	return 0;
+}
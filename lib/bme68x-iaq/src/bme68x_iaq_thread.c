@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Library-managed IAQ thread:
+ * - defined dormant, with Kconfig stack size and priority
+ * - pinned to a CPU (SMP) before its first start
+ * - initializes the sensor and BSEC, then runs the BSEC control loop,
+ *   once per start request: the BSEC working buffers are on the IAQ thread's stack,
+ *   never on the caller's
+ */
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include <drivers/bme68x_sensor_api.h>
+
+#include "bme68x.h"
+#include "bme68x_iaq.h"
+
+LOG_MODULE_DECLARE(bme68x_iaq, CONFIG_BME68X_IAQ_LOG_LEVEL);
+
+#if defined(CONFIG_BME68X_IAQ_THREAD_CPU)
+#define IAQ_THREAD_CPU CONFIG_BME68X_IAQ_THREAD_CPU
+#else
+#define IAQ_THREAD_CPU -1
+#endif
+
+/* IAQ thread entry point. */
+static void iaq_thread_main(void *p1, void *p2, void *p3);
+
+/*
+ * Bind and initialize the sensor, then the BSEC algorithm.
+ *
+ * Returns 0 on success, negative errno, BSEC or BME68X Sensor API status otherwise.
+ */
+static int iaq_thread_init(void);
+
+K_THREAD_DEFINE(bme68x_iaq_thread, CONFIG_BME68X_IAQ_THREAD_STACK_SIZE, iaq_thread_main, NULL,
+		NULL, NULL, CONFIG_BME68X_IAQ_THREAD_PRIORITY, 0, SYS_FOREVER_MS);
+
+/* Signaled by bme68x_iaq_thread_start(). */
+static K_SEM_DEFINE(iaq_thread_start_sem, 0, 1);
+/* Signaled when the initialization requested by bme68x_iaq_thread_start() completes. */
+static K_SEM_DEFINE(iaq_thread_init_sem, 0, 1);
+/* Signaled when the control loop returns. */
+static K_SEM_DEFINE(iaq_thread_stopped_sem, 0, 1);
+
+/* Whether the control loop is running (or about to). */
+static atomic_t iaq_thread_running;
+/* Whether the dormant thread was started. */
+static bool iaq_thread_started;
+
+/* The sensor controlled by the IAQ thread. */
+static struct bme68x_dev iaq_thread_sensor;
+/* The device bound to the sensor, set by bme68x_iaq_thread_start(). */
+static struct device const *iaq_thread_dev;
+/* Initialization status, valid once iaq_thread_init_sem is signaled. */
+static int iaq_thread_init_status;
+
+int bme68x_iaq_thread_start(struct device const *dev)
+{
+	if (!atomic_cas(&iaq_thread_running, 0, 1)) {
+		return -EALREADY;
+	}
+
+	iaq_thread_dev = dev;
+
+	if (!iaq_thread_started) {
+#if defined(CONFIG_SMP) && defined(CONFIG_SCHED_CPU_MASK)
+		if (IAQ_THREAD_CPU >= 0) {
+			/* The thread must not be runnable yet. */
+			int ret = k_thread_cpu_pin(bme68x_iaq_thread, IAQ_THREAD_CPU);
+			if (ret) {
+				LOG_WRN("IAQ thread CPU %d: %d", IAQ_THREAD_CPU, ret);
+			}
+		}
+#endif
+		iaq_thread_started = true;
+		k_thread_start(bme68x_iaq_thread);
+	}
+
+	/* Forget a previous return on fatal error. */
+	k_sem_reset(&iaq_thread_stopped_sem);
+	k_sem_give(&iaq_thread_start_sem);
+
+	/* Initialization runs on the IAQ thread's stack. */
+	k_sem_take(&iaq_thread_init_sem, K_FOREVER);
+	return iaq_thread_init_status;
+}
+
+int bme68x_iaq_thread_stop(k_timeout_t timeout)
+{
+	if (!atomic_get(&iaq_thread_running)) {
+		return -EALREADY;
+	}
+
+	bme68x_iaq_stop();
+	if (k_sem_take(&iaq_thread_stopped_sem, timeout)) {
+		return -EAGAIN;
+	}
+	return 0;
+}
+
+void iaq_thread_main(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	for (;;) {
+		k_sem_take(&iaq_thread_start_sem, K_FOREVER);
+
+		int ret = iaq_thread_init();
+		iaq_thread_init_status = ret;
+		if (ret) {
+			LOG_ERR("IAQ thread init: %d", ret);
+			atomic_clear(&iaq_thread_running);
+			k_sem_give(&iaq_thread_init_sem);
+			continue;
+		}
+		k_sem_give(&iaq_thread_init_sem);
+
+		LOG_INF("IAQ thread: started");
+		bme68x_iaq_run(&iaq_thread_sensor);
+		LOG_INF("IAQ thread: stopped");
+
+		/* Stopped, or fatal error. */
+		atomic_clear(&iaq_thread_running);
+		k_sem_give(&iaq_thread_stopped_sem);
+	}
+}
+
+int iaq_thread_init(void)
+{
+	int ret = bme68x_sensor_api_init(iaq_thread_dev, &iaq_thread_sensor);
+	if (ret == 0) {
+		ret = bme68x_init(&iaq_thread_sensor);
+	}
+	if (ret == 0) {
+		ret = bme68x_iaq_init(&iaq_thread_sensor);
+	}
+	return ret;
+}
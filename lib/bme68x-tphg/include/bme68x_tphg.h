@@ -0,0 +1,622 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Forced mode TPHG measurements:
+ * - with a single heater set-point
+ * - LP/ULP sample rates
+ * - or back-to-back at maximum throughput
+ *
+ * Periodic acquisition engine: drift-free scheduling,
+ * one engine per device, output callbacks and message queues.
+ */
+
+#ifndef BME68X_TPHG_H_
+#define BME68X_TPHG_H_
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "bme68x_defs.h"
+
+/**
+ * @brief Initial value of the expected ambient temperature
+ * used to compute heater resistance.
+ */
+#define BME68X_TPHG_AMBIENT_TEMP INT8_C(CONFIG_BME68X_TPHG_AMBIENT_TEMP)
+
+/**
+ * @brief Default TPHG measurement period in seconds.
+ */
+#define BME68X_TPHG_SAMPLE_RATE UINT32_C(CONFIG_BME68X_TPHG_SAMPLE_RATE)
+
+/**
+ * @brief Temperature oversampling.
+ */
+#if defined(CONFIG_BME68X_TPHG_TEMP_OS_1X)
+#define BME68X_TPHG_OSX_TEMP BME68X_OS_1X
+#elif defined(CONFIG_BME68X_TPHG_TEMP_OS_2X)
+#define BME68X_TPHG_OSX_TEMP BME68X_OS_2X
+#elif defined(CONFIG_BME68X_TPHG_TEMP_OS_4X)
+#define BME68X_TPHG_OSX_TEMP BME68X_OS_4X
+#elif defined(CONFIG_BME68X_TPHG_TEMP_OS_8X)
+#define BME68X_TPHG_OSX_TEMP BME68X_OS_8X
+#elif defined(CONFIG_BME68X_TPHG_TEMP_OS_16X)
+#define BME68X_TPHG_OSX_TEMP BME68X_OS_16X
+#elif defined(CONFIG_BME68X_TPHG_TEMP_OS_NONE)
+#define BME68X_TPHG_OSX_TEMP BME68X_OS_NONE
+#endif
+
+/**
+ * @brief Pressure oversampling.
+ */
+#if defined(CONFIG_BME68X_TPHG_PRESS_OS_1X)
+#define BME68X_TPHG_OSX_PRESS BME68X_OS_1X
+#elif defined(CONFIG_BME68X_TPHG_PRESS_OS_2X)
+#define BME68X_TPHG_OSX_PRESS BME68X_OS_2X
+#elif defined(CONFIG_BME68X_TPHG_PRESS_OS_4X)
+#define BME68X_TPHG_OSX_PRESS BME68X_OS_4X
+#elif defined(CONFIG_BME68X_TPHG_PRESS_OS_8X)
+#define BME68X_TPHG_OSX_PRESS BME68X_OS_8X
+#elif defined(CONFIG_BME68X_TPHG_PRESS_OS_16X)
+#define BME68X_TPHG_OSX_PRESS BME68X_OS_16X
+#elif defined(CONFIG_BME68X_TPHG_PRESS_OS_NONE)
+#define BME68X_TPHG_OSX_PRESS BME68X_OS_NONE
+#endif
+
+/**
+ * @brief Humidity oversampling.
+ */
+#if defined(CONFIG_BME68X_TPHG_HUM_OS_1X)
+#define BME68X_TPHG_OSX_HUM BME68X_OS_1X
+#elif defined(CONFIG_BME68X_TPHG_HUM_OS_2X)
+#define BME68X_TPHG_OSX_HUM BME68X_OS_2X
+#elif defined(CONFIG_BME68X_TPHG_HUM_OS_4X)
+#define BME68X_TPHG_OSX_HUM BME68X_OS_4X
+#elif defined(CONFIG_BME68X_TPHG_HUM_OS_8X)
+#define BME68X_TPHG_OSX_HUM BME68X_OS_8X
+#elif defined(CONFIG_BME68X_TPHG_HUM_OS_16X)
+#define BME68X_TPHG_OSX_HUM BME68X_OS_16X
+#elif defined(CONFIG_BME68X_TPHG_HUM_OS_NONE)
+#define BME68X_TPHG_OSX_HUM BME68X_OS_NONE
+#endif
+
+/**
+ * @brief IIR filter coefficient.
+ */
+#if defined(CONFIG_BME68X_TPHG_FILTER_2)
+#define BME68X_TPHG_IIR_FILTER BME68X_FILTER_SIZE_1
+#elif defined(CONFIG_BME68X_TPHG_FILTER_4)
+#define BME68X_TPHG_IIR_FILTER BME68X_FILTER_SIZE_3
+#elif defined(CONFIG_BME68X_TPHG_FILTER_8)
+#define BME68X_TPHG_IIR_FILTER BME68X_FILTER_SIZE_7
+#elif defined(CONFIG_BME68X_TPHG_FILTER_16)
+#define BME68X_TPHG_IIR_FILTER BME68X_FILTER_SIZE_15
+#elif defined(CONFIG_BME68X_TPHG_FILTER_32)
+#define BME68X_TPHG_IIR_FILTER BME68X_FILTER_SIZE_31
+#elif defined(CONFIG_BME68X_TPHG_FILTER_64)
+#define BME68X_TPHG_IIR_FILTER BME68X_FILTER_SIZE_63
+#elif defined(CONFIG_BME68X_TPHG_FILTER_128)
+#define BME68X_TPHG_IIR_FILTER BME68X_FILTER_SIZE_127
+#elif defined(CONFIG_BME68X_TPHG_FILTER_OFF)
+#define BME68X_TPHG_IIR_FILTER BME68X_FILTER_OFF
+#endif
+
+/**
+ * @brief Temperature set-point in degree Celsius.
+ */
+#define BME68X_TPHG_HEATR_TEMP UINT16_C(CONFIG_BME68X_TPHG_HEATR_TEMP)
+
+/**
+ * @brief Heating duration in milliseconds.
+ */
+#define BME68X_TPHG_HEATR_DUR UINT16_C(CONFIG_BME68X_TPHG_HEATR_DUR)
+
+/**
+ * @brief Default gas measurements period in seconds, zero for every cycle.
+ */
+#if defined(CONFIG_BME68X_TPHG_GAS_SAMPLE_RATE)
+#define BME68X_TPHG_GAS_SAMPLE_RATE UINT32_C(CONFIG_BME68X_TPHG_GAS_SAMPLE_RATE)
+#else
+#define BME68X_TPHG_GAS_SAMPLE_RATE UINT32_C(0)
+#endif
+
+/**
+ * @brief Whether gas measurements are enabled.
+ */
+#if defined(CONFIG_BME68X_TPHG_HEATR_NONE)
+#define BME68X_TPHG_GAS_ENABLE BME68X_DISABLE
+#else
+#define BME68X_TPHG_GAS_ENABLE BME68X_ENABLE
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief TPHG measurement.
+ */
+struct bme68x_tphg_meas {
+	/**
+	 * @brief Convenience for `new_data_0`.
+	 */
+	uint8_t new_data;
+	/**
+	 * @brief Convenience for `gas_valid_r`.
+	 */
+	uint8_t gas_valid;
+	/**
+	 * @brief Convenience for `heat_stab_r`.
+	 */
+	uint8_t heatr_stab;
+	/**
+	 * @brief Measurement data (as floating point numbers if `CONFIG_BME68X_API_FLOAT`).
+	 */
+	struct bme68x_data data;
+};
+
+/**
+ * @brief Latest TPHG measurement store.
+ *
+ * Double-buffered sequence lock: readers never block the measurement loop,
+ * and retry only if a new measurement was published while they were copying.
+ *
+ * Access with bme68x_tphg_latest_get().
+ */
+struct bme68x_tphg_latest {
+	/** Sequence number (wraps around), its parity selects the buffer readers copy. */
+	atomic_t seq;
+	/** Whether the first measurement is fully published. */
+	atomic_t published;
+	/** Both copies of the latest measurement. */
+	struct bme68x_tphg_meas buf[2];
+};
+
+/**
+ * @brief BME680/688 sensor.
+ *
+ * Convenience for a BME68X Sensor API sensor and its configuration.
+ */
+struct bme68x_tphg_sensor {
+	/**
+	 * @brief BME68X Sensor API sensor.
+	 */
+	struct bme68x_dev dev;
+	/**
+	 * @brief Temperature, pressure and humidity sensors configuration.
+	 *
+	 * Only oversampling and IIR filters are used (no ODR).
+	 */
+	struct bme68x_conf tph_conf;
+	/**
+	 * @brief Gas sensor configuration.
+	 *
+	 * A single heating profile is defined (temperature and duration).
+	 */
+	struct bme68x_heatr_conf gas_conf;
+	/**
+	 * @brief Cached `ctrl_gas_0` and `ctrl_gas_1` register images,
+	 * indexed by `BME68X_DISABLE` and `BME68X_ENABLE`.
+	 *
+	 * Set when the gas sensor is configured, used by bme68x_tphg_gas_enable()
+	 * to switch gas measurements without reconfiguring the heater.
+	 */
+	uint8_t ctrl_gas[2][2];
+	/**
+	 * @brief Latest TPHG measurement.
+	 *
+	 * Updated by bme68x_tphg_meas_read() upon new data.
+	 */
+	struct bme68x_tphg_latest latest;
+};
+
+/**
+ * @brief Register image of a TPHG acquisition configuration.
+ *
+ * Computed at build time for devicetree configurations (see bme68x_tphg_dt.h),
+ * and written to the device with a single burst, bypassing the BME68X Sensor API
+ * read-modify-write and validation.
+ *
+ * The heater resistance (`res_heat_0`) is not part of the image:
+ * it depends on the chip's calibration data, and is computed when applied.
+ */
+struct bme68x_tphg_regs {
+	/** `ctrl_meas`: temperature and pressure oversampling, sleep mode. */
+	uint8_t ctrl_meas;
+	/** `ctrl_hum`: humidity oversampling. */
+	uint8_t ctrl_hum;
+	/** `config`: IIR filter. */
+	uint8_t config;
+	/** `ctrl_gas_0`: heater on/off. */
+	uint8_t ctrl_gas_0;
+	/** `ctrl_gas_1`: `run_gas` and heater set-point 0, indexed by variant (`variant_id`). */
+	uint8_t ctrl_gas_1[2];
+	/** `gas_wait_0`: encoded heating duration. */
+	uint8_t gas_wait_0;
+};
+
+/**
+ * @brief TPHG acquisition configuration.
+ *
+ * Each engine has its own configuration, see BME68X_TPHG_CONFIG_DEFAULT
+ * for the defaults set with Kconfig, and bme68x_tphg_dt.h for configurations
+ * defined in devicetree.
+ */
+struct bme68x_tphg_config {
+	/** Temperature oversampling (`BME68X_OS_*`). */
+	uint8_t os_temp;
+	/** Pressure oversampling (`BME68X_OS_*`). */
+	uint8_t os_pres;
+	/** Relative humidity oversampling (`BME68X_OS_*`). */
+	uint8_t os_hum;
+	/** IIR filter coefficient (`BME68X_FILTER_*`). */
+	uint8_t iir_filter;
+	/** Heater temperature set-point in degree Celsius. */
+	uint16_t heatr_temp;
+	/** Heating duration in milliseconds. */
+	uint16_t heatr_dur;
+	/** Whether gas measurements are enabled (`BME68X_ENABLE` or `BME68X_DISABLE`). */
+	uint8_t gas_enable;
+	/** Expected ambient temperature in degree Celsius. */
+	int8_t amb_temp;
+	/**
+	 * @brief Measurement period in milliseconds.
+	 *
+	 * Zero for back-to-back measurements (maximum throughput),
+	 * completion being then detected by polling the status register.
+	 */
+	uint32_t period_ms;
+	/**
+	 * @brief Gas measurements period in milliseconds.
+	 *
+	 * Zero to measure gas resistance with every cycle. Otherwise, the heater
+	 * runs only for the first cycle at or after each gas deadline, the other
+	 * cycles measure temperature, pressure and humidity only.
+	 */
+	uint32_t gas_period_ms;
+	/** Status polling interval in microseconds for back-to-back measurements. */
+	uint32_t poll_us;
+	/**
+	 * @brief Pre-computed register image, NULL to configure through the BME68X Sensor API.
+	 *
+	 * Must match the other fields.
+	 */
+	struct bme68x_tphg_regs const *regs;
+};
+
+/**
+ * @brief Initializer for the default TPHG acquisition configuration (Kconfig).
+ */
+#define BME68X_TPHG_CONFIG_DEFAULT                                                                 \
+	{                                                                                          \
+		.os_temp = BME68X_TPHG_OSX_TEMP,                                                   \
+		.os_pres = BME68X_TPHG_OSX_PRESS,                                                  \
+		.os_hum = BME68X_TPHG_OSX_HUM,                                                     \
+		.iir_filter = BME68X_TPHG_IIR_FILTER,                                              \
+		.heatr_temp = BME68X_TPHG_HEATR_TEMP,                                              \
+		.heatr_dur = BME68X_TPHG_HEATR_DUR,                                                \
+		.gas_enable = BME68X_TPHG_GAS_ENABLE,                                              \
+		.amb_temp = BME68X_TPHG_AMBIENT_TEMP,                                              \
+		.period_ms = BME68X_TPHG_SAMPLE_RATE * MSEC_PER_SEC,                               \
+		.gas_period_ms = BME68X_TPHG_GAS_SAMPLE_RATE * MSEC_PER_SEC,                       \
+		.poll_us = 0,                                                                      \
+	}
+
+struct bme68x_tphg_engine;
+
+/**
+ * @brief TPHG sample produced by an acquisition engine.
+ */
+struct bme68x_tphg_sample {
+	/** The engine that produced the sample, e.g. to tell devices apart in a shared queue. */
+	struct bme68x_tphg_engine *engine;
+	/** Timestamp in nanoseconds since boot. */
+	int64_t ts_ns;
+	/** The measurement. */
+	struct bme68x_tphg_meas meas;
+};
+
+/**
+ * @brief Synchronous callback for handling the TPHG samples produced by an acquisition engine.
+ *
+ * Invoked from the engine's thread: the memory location of the sample
+ * is invalid once the handler has returned.
+ */
+typedef void (*bme68x_tphg_output_cb)(struct bme68x_tphg_sample const *sample, void *user_data);
+
+/**
+ * @brief Periodic TPHG acquisition engine.
+ *
+ * One engine per BME680/688 device, each run by its own thread
+ * with bme68x_tphg_engine_run().
+ *
+ * Measurements are scheduled on absolute deadlines: the period does not drift
+ * with the measurement cycle or the output handling. Missed periods are skipped
+ * (counted as overruns), keeping the schedule phase.
+ *
+ * Gas measurements may have their own, longer, period: the heater is switched
+ * on only for the cycles due for gas measurements.
+ *
+ * Define with BME68X_TPHG_ENGINE_DEFINE().
+ */
+struct bme68x_tphg_engine {
+	/** BME68X Sensor API device ("bosch,bme68x-sensor-api" bindings). */
+	struct device const *dev;
+	/** Acquisition configuration. */
+	struct bme68x_tphg_config const *config;
+	/** Synchronous output callback, may be NULL. */
+	bme68x_tphg_output_cb cb;
+	/** User data passed to the output callback. */
+	void *user_data;
+	/** Output queue of `struct bme68x_tphg_sample`, may be NULL. */
+	struct k_msgq *msgq;
+	/** The controlled sensor, initialized by bme68x_tphg_engine_init(). */
+	struct bme68x_tphg_sensor sensor;
+	/** Internal: the thread running the engine. */
+	k_tid_t thread;
+	/** Internal: whether the engine should stop. */
+	atomic_t stop;
+	/** Number of missed periods. */
+	atomic_t overruns;
+	/** Number of samples dropped because the output queue was full. */
+	atomic_t dropped;
+};
+
+/**
+ * @brief Define a TPHG acquisition engine.
+ *
+ * For example, two devices at different rates sharing an output queue:
+ *
+ * @code{.c}
+ * K_MSGQ_DEFINE(tphg_msgq, sizeof(struct bme68x_tphg_sample), 8, 4);
+ *
+ * static struct bme68x_tphg_config const indoor_config = BME68X_TPHG_CONFIG_DEFAULT;
+ * static struct bme68x_tphg_config const outdoor_config = {
+ *	...
+ *	.period_ms = 60 * MSEC_PER_SEC,
+ * };
+ *
+ * BME68X_TPHG_ENGINE_DEFINE(indoor, DEVICE_DT_GET(DT_NODELABEL(bme680_i2c)),
+ *			     &indoor_config, NULL, NULL, &tphg_msgq);
+ * BME68X_TPHG_ENGINE_DEFINE(outdoor, DEVICE_DT_GET(DT_NODELABEL(bme680_spi)),
+ *			     &outdoor_config, NULL, NULL, &tphg_msgq);
+ * @endcode
+ *
+ * @param _name Engine name.
+ * @param _dev BME68X Sensor API device.
+ * @param _config Acquisition configuration (`struct bme68x_tphg_config const *`).
+ * @param _cb Synchronous output callback (bme68x_tphg_output_cb), may be NULL.
+ * @param _user_data User data passed to the output callback.
+ * @param _msgq Output queue of `struct bme68x_tphg_sample`, may be NULL.
+ */
+#define BME68X_TPHG_ENGINE_DEFINE(_name, _dev, _config, _cb, _user_data, _msgq)                    \
+	static struct bme68x_tphg_engine _name = {                                                 \
+		.dev = (_dev),                                                                     \
+		.config = (_config),                                                               \
+		.cb = (_cb),                                                                       \
+		.user_data = (_user_data),                                                         \
+		.msgq = (_msgq),                                                                   \
+	}
+
+/**
+ * @brief Initialize and configure sensor for TPHG measurements.
+ *
+ * See Kconfig for the default configuration.
+ *
+ * @param sensor The sensor to configure.
+ *
+ * @returns 0 on success, BME68X API return code.
+ */
+int8_t bme68x_tphg_init(struct bme68x_tphg_sensor *sensor);
+
+/**
+ * @brief Configure sensor for TPHG measurements.
+ *
+ * The measurement period and polling interval are ignored.
+ *
+ * Configurations with a register image are written with a single bus transaction,
+ * the device must then be in sleep mode (no measurement in progress).
+ *
+ * @param sensor The sensor to configure.
+ * @param config The acquisition configuration.
+ *
+ * @returns 0 on success, BME68X API return code.
+ */
+int8_t bme68x_tphg_configure(struct bme68x_tphg_sensor *sensor,
+			     struct bme68x_tphg_config const *config);
+
+/**
+ * @brief Configure the temperature, pressure and humidity sensors of the BME680/688.
+ *
+ * @param sensor The sensor to configure.
+ * @param os_temp Temperature oversampling.
+ * Zero will switch off temperature measurements (not recommended).
+ * @param os_pres Pressure oversampling.
+ * Zero will switch off pressure measurements.
+ * @param os_temp Relative humidity oversampling.
+ * Zero will switch off relative humidity measurements.
+ * @param iir_filter IIR filter coefficient. Zero will disable IIR.
+ *
+ * @returns 0 on success, BME68X API return code.
+ */
+int8_t bme68x_tphg_configure_tph(struct bme68x_tphg_sensor *sensor, uint8_t os_temp,
+				 uint8_t os_pres, uint8_t os_hum, uint8_t iir_filter);
+
+/**
+ * @brief Configure the gas resistance sensor of the BME680/688.
+ *
+ * This configures a single heater set-point.
+ *
+ * @param sensor The sensor to configure.
+ * @param heatr_temp The target temperature in degree Celsius.
+ * @param heatr_dur The heating duration in milliseconds.
+ * @param gas_enable Whether to actually enable gas measurements (`BME68X_ENABLE`
+ * or `BME68X_DISABLE`).
+ *
+ * @returns 0 on success, BME68X API return code.
+ */
+int8_t bme68x_tphg_configure_gas(struct bme68x_tphg_sensor *sensor, uint16_t heatr_temp,
+				 uint16_t heatr_dur, uint8_t gas_enable);
+
+/**
+ * @brief Switch gas measurements on or off.
+ *
+ * Writes the cached heater control registers (`ctrl_gas_0` and `ctrl_gas_1`)
+ * in a single bus transaction, and only if the state actually changes:
+ * the heater set-point is kept, e.g. to alternate TPH only and TPHG cycles.
+ *
+ * The gas sensor must have been configured.
+ *
+ * @param sensor The sensor to configure.
+ * @param gas_enable Whether to enable gas measurements (`BME68X_ENABLE`
+ * or `BME68X_DISABLE`).
+ *
+ * @returns 0 on success, BME68X API return code.
+ */
+int8_t bme68x_tphg_gas_enable(struct bme68x_tphg_sensor *sensor, uint8_t gas_enable);
+
+/**
+ * @brief Initiate a TPHG measurement cycle by switching the BME680/688 device to forced mode.
+ *
+ * The device will return to sleep mode once the measurement is completed.
+ *
+ * @param sensor The sensor to switch to forced mode.
+ * @param cycle_us Output parameter for the TPHG measurement duration in microsecond.
+ * This is the time to wait before reading the measure data.
+ *
+ * @returns 0 on success, BME68X API return code.
+ */
+int8_t bme68x_tphg_meas_trigger(struct bme68x_tphg_sensor *sensor, uint32_t *cycle_us);
+
+/**
+ * @brief Wait for the completion of a TPHG measurement cycle.
+ *
+ * Polls the measurement status register instead of sleeping for the computed
+ * cycle duration: returns as soon as new data are available.
+ *
+ * @param sensor The sensor to poll.
+ * @param timeout_us Polling timeout in microseconds.
+ * @param poll_us Interval between polls in microseconds, zero for back-to-back reads.
+ *
+ * @returns 0 when new data are available, `BME68X_W_NO_NEW_DATA` on timeout,
+ * BME68X API return code otherwise.
+ */
+int8_t bme68x_tphg_meas_poll(struct bme68x_tphg_sensor *sensor, uint32_t timeout_us,
+			     uint32_t poll_us);
+
+/**
+ * @brief Configure the BME680/688 for maximum throughput.
+ *
+ * Minimal oversampling (x1) for temperature, pressure and humidity,
+ * IIR filter off. The heater set-point is kept.
+ *
+ * Intended for back-to-back forced measurements, completion
+ * being detected with bme68x_tphg_meas_poll().
+ *
+ * @param sensor The sensor to configure.
+ * @param gas_enable Whether to keep gas measurements enabled (`BME68X_ENABLE`
+ * or `BME68X_DISABLE`).
+ *
+ * @returns 0 on success, BME68X API return code.
+ */
+int8_t bme68x_tphg_configure_max_rate(struct bme68x_tphg_sensor *sensor, uint8_t gas_enable);
+
+/**
+ * @brief Read TPHG data from BME680/688 device registers.
+ *
+ * @param sensor The sensor from which to read the data registers.
+ * @param meas Output parameter for TPHG data.
+ *
+ * @returns 0 on success, BME68X API return code.
+ */
+int8_t bme68x_tphg_meas_read(struct bme68x_tphg_sensor *sensor, struct bme68x_tphg_meas *meas);
+
+/**
+ * @brief Get a snapshot of the latest TPHG measurement.
+ *
+ * Lock-free: any thread may poll the current measurement at its own rate
+ * without blocking the thread that reads the sensor.
+ *
+ * @param sensor The sensor to get the latest measurement of.
+ * @param meas Output parameter for the latest TPHG measurement.
+ *
+ * @returns 0 on success, -ENODATA if no measurement is available yet.
+ */
+int bme68x_tphg_latest_get(struct bme68x_tphg_sensor const *sensor,
+			   struct bme68x_tphg_meas *meas);
+
+/**
+ * @brief Compute forced mode TPHG measurement cycle duration in microseconds.
+ *
+ * The cycle includes:
+ * - the wake-up time needed to reach the forced mode
+ * - the time needed to measure temperature, pressure and humidity
+ * - the heating duration needed before we can measure the gas resistance
+ *   (if gas measurements are enabled)
+ *
+ * @note We'd prefer a const-qualified sensor, but bme68x_get_meas_dur() expects
+ * a non-const device.
+ *
+ * @param sensor The sensor to compute the TPHG cycle of.
+ *
+ * @return TPHG cycle duration in microsecond for the current sensor configuration.
+ */
+uint32_t bme68x_tphg_get_cycle_us(struct bme68x_tphg_sensor *sensor);
+
+/**
+ * @brief Initialize acquisition engine.
+ *
+ * Bind the engine's sensor to its device, initialize and configure the BME680/688.
+ *
+ * @param engine The engine to initialize.
+ *
+ * @returns 0 on success, negative errno or BME68X API return code.
+ */
+int bme68x_tphg_engine_init(struct bme68x_tphg_engine *engine);
+
+/**
+ * @brief Run acquisition engine.
+ *
+ * Each TPHG sample is published to the sensor's latest measurement store,
+ * passed to the output callback, then put into the output queue
+ * (never blocks, the sample is dropped if the queue is full).
+ *
+ * Won't return until bme68x_tphg_engine_stop() is called or a fatal error occurs.
+ *
+ * @param engine The engine to run, initialized with bme68x_tphg_engine_init().
+ *
+ * @returns 0 when stopped, BME68X API return code on fatal errors.
+ */
+int bme68x_tphg_engine_run(struct bme68x_tphg_engine *engine);
+
+/**
+ * @brief Stop acquisition engine.
+ *
+ * The engine returns after the current measurement cycle.
+ *
+ * @param engine The engine to stop.
+ */
+void bme68x_tphg_engine_stop(struct bme68x_tphg_engine *engine);
+
+/**
+ * @brief Get acquisition engine counters.
+ *
+ * @param engine The acquisition engine.
+ * @param overruns Output parameter for the number of missed periods.
+ * @param dropped Output parameter for the number of samples dropped (output queue full).
+ */
+static inline void bme68x_tphg_engine_stats(struct bme68x_tphg_engine const *engine,
+					    uint32_t *overruns, uint32_t *dropped)
+{
+	*overruns = (uint32_t)atomic_get(&engine->overruns);
+	*dropped = (uint32_t)atomic_get(&engine->dropped);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_TPHG_H_ */
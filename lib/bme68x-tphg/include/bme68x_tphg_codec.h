@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Compact binary encoding of TPHG measurements.
+ *
+ * Same record format as the IAQ samples (see lib/bme68x-common/include/bme68x_codec.h),
+ * with record type `BME68X_CODEC_TYPE_TPHG`:
+ * - header byte: version (bits 0-3), key frame (bit 4), record type (bits 5-7)
+ * - timestamp in milliseconds (unsigned LEB128 varint), absolute for key frames,
+ *   relative to the previous record otherwise
+ * - fixed-size payload (little-endian)
+ *
+ * See scripts/bme68x_decode.py for the host decoder.
+ */
+
+#ifndef BME68X_TPHG_CODEC_H_
+#define BME68X_TPHG_CODEC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bme68x_codec.h"
+#include "bme68x_tphg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Encoding format version.
+ */
+#define BME68X_TPHG_CODEC_VERSION BME68X_CODEC_VERSION
+
+/**
+ * @brief Record type for TPHG measurements.
+ */
+#define BME68X_TPHG_CODEC_TYPE BME68X_CODEC_TYPE_TPHG
+
+/**
+ * @brief Size in bytes of the TPHG record payload.
+ *
+ * | Field          | Encoding                                                  |
+ * |----------------|-----------------------------------------------------------|
+ * | status         | bit 7: new data, bit 5: gas valid, bit 4: heater stable,  |
+ * |                | bits 0-3: gas index                                       |
+ * | meas_index     | uint8                                                     |
+ * | temperature    | int16, 1/100 degC                                         |
+ * | pressure       | uint24, Pa                                                |
+ * | humidity       | uint16, 1/100 %                                           |
+ * | gas_resistance | uint32, Ohm                                               |
+ */
+#define BME68X_TPHG_CODEC_PAYLOAD_SIZE 13U
+
+/**
+ * @brief Maximum size in bytes of an encoded TPHG measurement
+ * (header, 64-bit varint timestamp and payload).
+ */
+#define BME68X_TPHG_CODEC_MAX_SIZE (BME68X_CODEC_HDR_MAX_SIZE + BME68X_TPHG_CODEC_PAYLOAD_SIZE)
+
+/**
+ * @brief Encoder or decoder context (delta-encoded timestamps).
+ */
+struct bme68x_tphg_codec {
+	/** Record header context. */
+	struct bme68x_codec ctx;
+};
+
+/**
+ * @brief Reset encoder or decoder context.
+ *
+ * The next encoded record will be a key frame.
+ *
+ * @param codec The context to reset.
+ */
+void bme68x_tphg_codec_reset(struct bme68x_tphg_codec *codec);
+
+/**
+ * @brief Encode TPHG measurement.
+ *
+ * @param codec Encoder context.
+ * @param ts_ns Measurement timestamp in nanoseconds.
+ * @param meas The TPHG measurement to encode.
+ * @param buf Destination buffer, `BME68X_TPHG_CODEC_MAX_SIZE` bytes is always enough.
+ * @param size Size of the destination buffer.
+ *
+ * @returns Number of encoded bytes on success, -ENOMEM if the buffer is too small
+ * (nothing is encoded, the context is left unchanged).
+ */
+int bme68x_tphg_encode(struct bme68x_tphg_codec *codec, int64_t ts_ns,
+		       struct bme68x_tphg_meas const *meas, uint8_t *buf, size_t size);
+
+/**
+ * @brief Decode TPHG measurement.
+ *
+ * @param codec Decoder context.
+ * @param buf Encoded record.
+ * @param len Number of available bytes.
+ * @param ts_ns Output parameter for the measurement timestamp in nanoseconds.
+ * @param meas Output parameter for the decoded TPHG measurement.
+ *
+ * @returns Number of consumed bytes on success,
+ * -ENOTSUP for an unsupported version or record type,
+ * -EMSGSIZE for a truncated record,
+ * -EAGAIN for a relative timestamp without prior key frame.
+ */
+int bme68x_tphg_decode(struct bme68x_tphg_codec *codec, uint8_t const *buf, size_t len,
+		       int64_t *ts_ns, struct bme68x_tphg_meas *meas);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_TPHG_CODEC_H_ */
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * TPHG acquisition configurations defined in devicetree:
+ * - device node properties: the device's default configuration
+ * - child nodes: named configurations
+ *
+ * See dts/bindings/bosch,bme68x-meas-config.yaml.
+ *
+ * Each configuration is a const bme68x_tphg_config with a register image
+ * computed at build time, out of range values fail the build.
+ */
+
+#ifndef BME68X_TPHG_DT_H_
+#define BME68X_TPHG_DT_H_
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/sys/util.h>
+
+#include "bme68x_tphg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Name of the TPHG configuration generated for a devicetree node.
+ *
+ * @param node_id A "bosch,bme68x-sensor-api" node, or one of its child nodes.
+ */
+#define BME68X_TPHG_DT_CONFIG_NAME(node_id) _CONCAT(__bme68x_tphg_dt_config_, DT_DEP_ORD(node_id))
+
+/**
+ * @brief Get the TPHG configuration defined by a devicetree node.
+ *
+ * For example, with the "fast" child node of the "bme680_i2c" device:
+ *
+ * @code{.c}
+ * BME68X_TPHG_ENGINE_DEFINE(engine, DEVICE_DT_GET(DT_NODELABEL(bme680_i2c)),
+ *			     BME68X_TPHG_DT_CONFIG_GET(DT_CHILD(DT_NODELABEL(bme680_i2c), fast)),
+ *			     NULL, NULL, &tphg_msgq);
+ * @endcode
+ *
+ * @param node_id A "bosch,bme68x-sensor-api" node, or one of its child nodes.
+ *
+ * @returns Pointer to the `struct bme68x_tphg_config const`.
+ */
+#define BME68X_TPHG_DT_CONFIG_GET(node_id) (&BME68X_TPHG_DT_CONFIG_NAME(node_id))
+
+/**
+ * @brief Define a TPHG acquisition engine with the default configuration of a devicetree node.
+ *
+ * @param _name Engine name.
+ * @param _node_id A "bosch,bme68x-sensor-api" node.
+ * @param _cb Synchronous output callback (bme68x_tphg_output_cb), may be NULL.
+ * @param _user_data User data passed to the output callback.
+ * @param _msgq Output queue of `struct bme68x_tphg_sample`, may be NULL.
+ */
+#define BME68X_TPHG_ENGINE_DT_DEFINE(_name, _node_id, _cb, _user_data, _msgq)                      \
+	BME68X_TPHG_ENGINE_DEFINE(_name, DEVICE_DT_GET(_node_id),                                  \
+				  BME68X_TPHG_DT_CONFIG_GET(_node_id), _cb, _user_data, _msgq)
+
+/* Declare the configurations of a device node and its child nodes. */
+#define BME68X_TPHG_DT_CONFIG_DECLARE(node_id)                                                     \
+	extern struct bme68x_tphg_config const BME68X_TPHG_DT_CONFIG_NAME(node_id);
+#define BME68X_TPHG_DT_CONFIGS_DECLARE(node_id)                                                    \
+	BME68X_TPHG_DT_CONFIG_DECLARE(node_id)                                                     \
+	DT_FOREACH_CHILD_STATUS_OKAY(node_id, BME68X_TPHG_DT_CONFIG_DECLARE)
+
+DT_FOREACH_STATUS_OKAY(bosch_bme68x_sensor_api, BME68X_TPHG_DT_CONFIGS_DECLARE)
+
+/**
+ * @brief Find a TPHG configuration defined in devicetree.
+ *
+ * @param dev A BME68X Sensor API device.
+ * @param name Name of the configuration child node, NULL for the device's default configuration.
+ *
+ * @returns The configuration, NULL if not found.
+ */
+struct bme68x_tphg_config const *bme68x_tphg_dt_config_find(struct device const *dev,
+							      char const *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_TPHG_DT_H_ */
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Report-on-change filtering of TPHG measurements.
+ */
+
+#ifndef BME68X_TPHG_ROC_H_
+#define BME68X_TPHG_ROC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#include "bme68x_roc.h"
+#include "bme68x_tphg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @name Reasons for forwarding a TPHG measurement.
+ *
+ * @{
+ */
+/** First measurement since initialization or reset. */
+#define BME68X_TPHG_ROC_FIRST     BIT(0)
+/** A quantity moved beyond its deadband. */
+#define BME68X_TPHG_ROC_DEADBAND  BIT(1)
+/** A quantity crossed its threshold (with hysteresis). */
+#define BME68X_TPHG_ROC_THRESHOLD BIT(2)
+/** Gas measurement validity or heater stability changed. */
+#define BME68X_TPHG_ROC_STATUS    BIT(3)
+/** The heartbeat expired. */
+#define BME68X_TPHG_ROC_HEARTBEAT BIT(4)
+/** @} */
+
+/**
+ * @brief TPHG quantities.
+ */
+enum bme68x_tphg_quantity {
+	/** Temperature in degree Celsius. */
+	BME68X_TPHG_TEMPERATURE = 0,
+	/** Pressure in Pa. */
+	BME68X_TPHG_PRESSURE,
+	/** Relative humidity in %. */
+	BME68X_TPHG_HUMIDITY,
+	/** Gas resistance in Ohm (only when the gas measurement is valid). */
+	BME68X_TPHG_GAS_RES,
+};
+
+/**
+ * @brief Report-on-change rule for a TPHG quantity.
+ *
+ * Same semantic as the IAQ rules (see bme68x_iaq_roc.h).
+ */
+struct bme68x_tphg_roc_rule {
+	/** Quantity. */
+	enum bme68x_tphg_quantity quantity;
+	/** Deadband, zero to disable. */
+	float deadband;
+	/** Whether threshold crossings are reported. */
+	bool threshold_enable;
+	/** Threshold. */
+	float threshold;
+	/** Hysteresis below the threshold. */
+	float hysteresis;
+};
+
+/**
+ * @brief Report-on-change filter for TPHG measurements.
+ */
+struct bme68x_tphg_roc {
+	/** Rules. */
+	struct bme68x_tphg_roc_rule const *rules;
+	/** Rules state, one per rule. */
+	struct bme68x_roc_state *states;
+	/** Number of rules. */
+	size_t n_rules;
+	/** Heartbeat in milliseconds, zero to disable. */
+	uint32_t heartbeat_ms;
+	/** Internal: timestamp of the last forwarded measurement. */
+	int64_t last_ts_ns;
+	/** Internal: status of the last forwarded measurement. */
+	uint8_t last_status;
+	/** Internal: whether a measurement was forwarded since initialization or reset. */
+	bool primed;
+	/** Number of forwarded measurements. */
+	atomic_t forwarded;
+	/** Number of suppressed measurements. */
+	atomic_t suppressed;
+};
+
+/**
+ * @brief Define a report-on-change filter for TPHG measurements.
+ *
+ * @param _name Filter name.
+ * @param _rules Array of rules (`struct bme68x_tphg_roc_rule`).
+ * @param _heartbeat_ms Heartbeat in milliseconds, zero to disable.
+ */
+#define BME68X_TPHG_ROC_DEFINE(_name, _rules, _heartbeat_ms)                                       \
+	static struct bme68x_roc_state _name##_states[ARRAY_SIZE(_rules)];                         \
+	static struct bme68x_tphg_roc _name = {                                                    \
+		.rules = (_rules),                                                                 \
+		.states = _name##_states,                                                          \
+		.n_rules = ARRAY_SIZE(_rules),                                                     \
+		.heartbeat_ms = (_heartbeat_ms),                                                   \
+	}
+
+/**
+ * @brief Filter TPHG measurement.
+ *
+ * @param roc The report-on-change filter.
+ * @param ts_ns Measurement timestamp in nanoseconds.
+ * @param meas The TPHG measurement to filter.
+ *
+ * @returns Reasons for forwarding the measurement (`BME68X_TPHG_ROC_*`),
+ * zero if the measurement is suppressed.
+ */
+uint32_t bme68x_tphg_roc_filter(struct bme68x_tphg_roc *roc, int64_t ts_ns,
+				struct bme68x_tphg_meas const *meas);
+
+/**
+ * @brief Reset filter: the next measurement will be forwarded.
+ *
+ * @param roc The report-on-change filter.
+ */
+void bme68x_tphg_roc_reset(struct bme68x_tphg_roc *roc);
+
+/**
+ * @brief Get filter counters.
+ *
+ * @param roc The report-on-change filter.
+ * @param forwarded Output parameter for the number of forwarded measurements.
+ * @param suppressed Output parameter for the number of suppressed measurements.
+ */
+static inline void bme68x_tphg_roc_stats(struct bme68x_tphg_roc const *roc, uint32_t *forwarded,
+					 uint32_t *suppressed)
+{
+	*forwarded = (uint32_t)atomic_get(&roc->forwarded);
+	*suppressed = (uint32_t)atomic_get(&roc->suppressed);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_TPHG_ROC_H_ */
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Sequential mode heater sweeps:
+ * - one sensor program for up to 10 heater set-points
+ * - fields streamed as they complete
+ * - sweep throughput statistics
+ */
+
+#ifndef BME68X_TPHG_SEQ_H_
+#define BME68X_TPHG_SEQ_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "bme68x_defs.h"
+#include "bme68x_tphg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum number of heater steps per sweep (BME688 heater profile).
+ */
+#define BME68X_TPHG_SEQ_MAX_STEPS 10
+
+/**
+ * @brief Sequential mode sweep configuration.
+ */
+struct bme68x_tphg_seq_config {
+	/** Temperature oversampling (`BME68X_OS_*`). */
+	uint8_t os_temp;
+	/** Pressure oversampling (`BME68X_OS_*`). */
+	uint8_t os_pres;
+	/** Relative humidity oversampling (`BME68X_OS_*`). */
+	uint8_t os_hum;
+	/** IIR filter coefficient (`BME68X_FILTER_*`). */
+	uint8_t iir_filter;
+	/** Expected ambient temperature in degree Celsius. */
+	int8_t amb_temp;
+	/** Number of heater steps, 1 to BME68X_TPHG_SEQ_MAX_STEPS. */
+	uint8_t n_steps;
+	/** Heater temperature set-points in degree Celsius. */
+	uint16_t heatr_temp[BME68X_TPHG_SEQ_MAX_STEPS];
+	/** Heating durations in milliseconds. */
+	uint16_t heatr_dur[BME68X_TPHG_SEQ_MAX_STEPS];
+};
+
+struct bme68x_tphg_seq;
+
+/**
+ * @brief Completed field of a sequential mode sweep.
+ */
+struct bme68x_tphg_seq_field {
+	/** The sweep engine that produced the field. */
+	struct bme68x_tphg_seq *seq;
+	/** Timestamp in nanoseconds since boot (when read). */
+	int64_t ts_ns;
+	/** Heater step (`gas_index`). */
+	uint8_t step;
+	/** Sub-measurement index (`meas_index`), wraps around. */
+	uint8_t meas_index;
+	/** The measurement. */
+	struct bme68x_tphg_meas meas;
+};
+
+/**
+ * @brief Synchronous callback for the fields completed by a sweep engine.
+ *
+ * Invoked from the engine's thread, in measurement order.
+ */
+typedef void (*bme68x_tphg_seq_cb)(struct bme68x_tphg_seq_field const *field, void *user_data);
+
+/**
+ * @brief Sweep throughput statistics.
+ */
+struct bme68x_tphg_seq_stats {
+	/** Number of fields streamed. */
+	uint32_t fields;
+	/** Number of fields lost (overwritten before they were read). */
+	uint32_t missed;
+	/** Number of complete sweeps. */
+	uint32_t sweeps;
+	/** Duration of the last complete sweep in microseconds (between first steps). */
+	uint32_t sweep_us;
+	/** Expected sweep duration in microseconds. */
+	uint32_t expected_us;
+};
+
+/**
+ * @brief Sequential mode sweep engine.
+ *
+ * The sensor is programmed once with the whole heater profile, and runs
+ * the sweep steps continuously in sequential mode: the engine only polls
+ * the data registers, and streams the new fields to its callback.
+ *
+ * Define with BME68X_TPHG_SEQ_DEFINE().
+ */
+struct bme68x_tphg_seq {
+	/** BME68X Sensor API device ("bosch,bme68x-sensor-api" bindings). */
+	struct device const *dev;
+	/** Sweep configuration. */
+	struct bme68x_tphg_seq_config const *config;
+	/** Synchronous field callback. */
+	bme68x_tphg_seq_cb cb;
+	/** User data passed to the callback. */
+	void *user_data;
+	/** The controlled sensor, initialized by bme68x_tphg_seq_init(). */
+	struct bme68x_tphg_sensor sensor;
+	/** Internal: the thread running the engine. */
+	k_tid_t thread;
+	/** Internal: whether the engine should stop. */
+	atomic_t stop;
+	/** Internal: throughput statistics, see bme68x_tphg_seq_stats_get(). */
+	struct bme68x_tphg_seq_stats stats;
+	/** Internal: data registers polling interval in microseconds (shortest step). */
+	uint32_t poll_us;
+	/** Internal: sub-measurement index of the last streamed field. */
+	uint8_t last_index;
+	/** Internal: whether a field was already streamed. */
+	bool primed;
+	/** Internal: timestamp of the current sweep's first step, zero if unknown. */
+	int64_t sweep_ts_ns;
+};
+
+/**
+ * @brief Define a sequential mode sweep engine.
+ *
+ * @param _name Engine name.
+ * @param _dev BME68X Sensor API device.
+ * @param _config Sweep configuration (`struct bme68x_tphg_seq_config const *`).
+ * @param _cb Field callback (bme68x_tphg_seq_cb).
+ * @param _user_data User data passed to the callback.
+ */
+#define BME68X_TPHG_SEQ_DEFINE(_name, _dev, _config, _cb, _user_data)                              \
+	static struct bme68x_tphg_seq _name = {                                                    \
+		.dev = (_dev),                                                                     \
+		.config = (_config),                                                               \
+		.cb = (_cb),                                                                       \
+		.user_data = (_user_data),                                                         \
+	}
+
+/**
+ * @brief Initialize sweep engine.
+ *
+ * Bind the engine's sensor to its device, initialize the BME680/688,
+ * and program the heater profile.
+ *
+ * @param seq The engine to initialize.
+ *
+ * @returns 0 on success, negative errno or BME68X API return code.
+ */
+int bme68x_tphg_seq_init(struct bme68x_tphg_seq *seq);
+
+/**
+ * @brief Run sweep engine.
+ *
+ * Switch the sensor to sequential mode, and stream completed fields
+ * until bme68x_tphg_seq_stop() is called or a fatal error occurs.
+ * The sensor is switched back to sleep mode on return.
+ *
+ * @param seq The engine to run, initialized with bme68x_tphg_seq_init().
+ *
+ * @returns 0 when stopped, BME68X API return code on fatal errors.
+ */
+int bme68x_tphg_seq_run(struct bme68x_tphg_seq *seq);
+
+/**
+ * @brief Stop sweep engine.
+ *
+ * @param seq The engine to stop.
+ */
+void bme68x_tphg_seq_stop(struct bme68x_tphg_seq *seq);
+
+/**
+ * @brief Get sweep throughput statistics.
+ *
+ * Should be called from the engine's thread, e.g. from its callback.
+ *
+ * @param seq The sweep engine.
+ * @param stats Output parameter for the statistics.
+ */
+static inline void bme68x_tphg_seq_stats_get(struct bme68x_tphg_seq const *seq,
+					     struct bme68x_tphg_seq_stats *stats)
+{
+	*stats = seq->stats;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME68X_TPHG_SEQ_H_ */
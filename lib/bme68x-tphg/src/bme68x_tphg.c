@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_tphg.h"
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/barrier.h>
+#include <zephyr/sys/util.h>
+
+#include <drivers/bme68x_sensor_api.h>
+
+#include "bme68x.h"
+#include "bme68x_heatr.h"
+
+LOG_MODULE_REGISTER(bme68x_tphg, CONFIG_BME68X_TPHG_LOG_LEVEL);
+
+/* Measurement status register (meas_status_0): conversions in progress. */
+#define TPHG_MEAS_STATUS_MEASURING     BIT(5)
+#define TPHG_MEAS_STATUS_GAS_MEASURING BIT(6)
+
+/* Get strings from configuration values. */
+static inline char const *tph_conf_osx2str(uint8_t osx);
+static inline char const *tph_conf_iir2str(uint8_t filter);
+
+/*
+ * Apply configuration register image, burst write.
+ * @returns 0 on success, BME68X API return code.
+ */
+static int8_t tphg_configure_regs(struct bme68x_tphg_sensor *sensor,
+				  struct bme68x_tphg_config const *config);
+
+/*
+ * Cache heater control register images from the current ctrl_gas_0/1 values.
+ */
+static void tphg_gas_cache(struct bme68x_tphg_sensor *sensor, uint8_t ctrl_gas_0,
+			   uint8_t ctrl_gas_1);
+
+/* Default configuration (Kconfig). */
+static struct bme68x_tphg_config const tphg_config_default = BME68X_TPHG_CONFIG_DEFAULT;
+
+/*
+ * Wait for the end of the measurement cycle, then read the TPHG data.
+ * @returns 0 on success, BME68X API return code.
+ */
+static int8_t tphg_engine_measure(struct bme68x_tphg_engine *engine,
+				  struct bme68x_tphg_sample *sample);
+
+/*
+ * Switch gas measurements for the next cycle when the gas period is independent.
+ * @returns 0 on success, BME68X API return code.
+ */
+static int8_t tphg_engine_schedule_gas(struct bme68x_tphg_engine *engine, int64_t *next_gas);
+
+/*
+ * Pass sample to the engine's output callback and queue.
+ */
+static void tphg_engine_output(struct bme68x_tphg_engine *engine,
+			       struct bme68x_tphg_sample const *sample);
+
+/*
+ * Publish new TPHG measurement to the sensor's latest measurement store.
+ */
+static void bme68x_tphg_latest_publish(struct bme68x_tphg_sensor *sensor,
+				       struct bme68x_tphg_meas const *meas);
+
+int8_t bme68x_tphg_init(struct bme68x_tphg_sensor *sensor)
+{
+	int8_t ret = bme68x_init(&sensor->dev);
+
+	if (ret == BME68X_OK) {
+		ret = bme68x_tphg_configure(sensor, &tphg_config_default);
+	}
+	return ret;
+}
+
+int8_t bme68x_tphg_configure(struct bme68x_tphg_sensor *sensor,
+			     struct bme68x_tphg_config const *config)
+{
+	sensor->dev.amb_temp = config->amb_temp;
+
+	if (config->regs) {
+		return tphg_configure_regs(sensor, config);
+	}
+
+	int8_t ret = bme68x_tphg_configure_tph(sensor, config->os_temp, config->os_pres,
+					       config->os_hum, config->iir_filter);
+	if (ret == BME68X_OK) {
+		ret = bme68x_tphg_configure_gas(sensor, config->heatr_temp, config->heatr_dur,
+						config->gas_enable);
+	}
+	return ret;
+}
+
+int8_t bme68x_tphg_configure_tph(struct bme68x_tphg_sensor *sensor, uint8_t os_temp,
+				 uint8_t os_pres, uint8_t os_hum, uint8_t iir_filter)
+{
+	struct bme68x_conf conf = {
+		.os_temp = os_temp,
+		.os_pres = os_pres,
+		.os_hum = os_hum,
+		.filter = iir_filter,
+		.odr = BME68X_ODR_NONE,
+	};
+	int8_t ret = bme68x_set_conf(&conf, &sensor->dev);
+
+	if (ret == BME68X_OK) {
+		sensor->tph_conf = conf;
+
+		LOG_INF("os_t:%s os_p:%s os_h:%s iir:%s",
+			tph_conf_osx2str(sensor->tph_conf.os_temp),
+			tph_conf_osx2str(sensor->tph_conf.os_pres),
+			tph_conf_osx2str(sensor->tph_conf.os_hum),
+			tph_conf_iir2str(sensor->tph_conf.filter));
+	} else {
+		LOG_ERR("sensor configuration error: %d", ret);
+	}
+	return ret;
+}
+
+int8_t bme68x_tphg_configure_gas(struct bme68x_tphg_sensor *sensor, uint16_t heatr_temp,
+				 uint16_t heatr_dur, uint8_t gas_enable)
+{
+	struct bme68x_heatr_conf heatr_conf = {
+		.heatr_temp = heatr_temp,
+		.heatr_dur = heatr_dur,
+		.enable = gas_enable,
+	};
+	uint8_t ctrl_gas[2];
+	int8_t ret = bme68x_set_heatr_conf(BME68X_FORCED_MODE, &heatr_conf, &sensor->dev);
+
+	if (ret == BME68X_OK) {
+		ret = bme68x_get_regs(BME68X_REG_CTRL_GAS_0, ctrl_gas, 2, &sensor->dev);
+	}
+	if (ret == BME68X_OK) {
+		sensor->gas_conf = heatr_conf;
+		tphg_gas_cache(sensor, ctrl_gas[0], ctrl_gas[1]);
+
+		LOG_INF("heatr_temp:%d degC  heatr_dur:%u ms", sensor->gas_conf.heatr_temp,
+			sensor->gas_conf.heatr_dur);
+	} else {
+		LOG_ERR("heating profile error: %d", ret);
+	}
+	return ret;
+}
+
+int8_t bme68x_tphg_gas_enable(struct bme68x_tphg_sensor *sensor, uint8_t gas_enable)
+{
+	uint8_t const addr[] = {BME68X_REG_CTRL_GAS_0, BME68X_REG_CTRL_GAS_1};
+	uint8_t const *data = sensor->ctrl_gas[gas_enable == BME68X_ENABLE];
+
+	if (sensor->gas_conf.enable == gas_enable) {
+		return BME68X_OK;
+	}
+
+	int8_t ret = bme68x_set_regs(addr, data, ARRAY_SIZE(addr), &sensor->dev);
+	if (ret == BME68X_OK) {
+		sensor->gas_conf.enable = gas_enable;
+	} else {
+		LOG_ERR("failed to switch gas measurements: %d", ret);
+	}
+	return ret;
+}
+
+int8_t bme68x_tphg_meas_trigger(struct bme68x_tphg_sensor *sensor, uint32_t *cycle_us)
+{
+	int8_t ret = bme68x_set_op_mode(BME68X_FORCED_MODE, &sensor->dev);
+
+	if (ret == BME68X_OK) {
+		*cycle_us = bme68x_tphg_get_cycle_us(sensor);
+
+	} else {
+		LOG_ERR("failed to switch to forced: %d", ret);
+	}
+	return ret;
+}
+
+int8_t bme68x_tphg_meas_poll(struct bme68x_tphg_sensor *sensor, uint32_t timeout_us,
+			     uint32_t poll_us)
+{
+	int64_t deadline = k_uptime_ticks() + k_us_to_ticks_ceil64(timeout_us);
+	uint8_t status;
+
+	for (;;) {
+		int8_t ret = bme68x_get_regs(BME68X_REG_FIELD0, &status, 1, &sensor->dev);
+		if (ret != BME68X_OK) {
+			LOG_ERR("failed to read measurement status: %d", ret);
+			return ret;
+		}
+
+		if ((status & BME68X_NEW_DATA_MSK) &&
+		    !(status & (TPHG_MEAS_STATUS_MEASURING | TPHG_MEAS_STATUS_GAS_MEASURING))) {
+			return BME68X_OK;
+		}
+		if (k_uptime_ticks() >= deadline) {
+			return BME68X_W_NO_NEW_DATA;
+		}
+		if (poll_us) {
+			k_sleep(K_USEC(poll_us));
+		}
+	}
+}
+
+int8_t bme68x_tphg_configure_max_rate(struct bme68x_tphg_sensor *sensor, uint8_t gas_enable)
+{
+	int8_t ret = bme68x_tphg_configure_tph(sensor, BME68X_OS_1X, BME68X_OS_1X, BME68X_OS_1X,
+					       BME68X_FILTER_OFF);
+
+	if (ret == BME68X_OK) {
+		ret = bme68x_tphg_configure_gas(sensor, sensor->gas_conf.heatr_temp,
+						sensor->gas_conf.heatr_dur, gas_enable);
+	}
+	return ret;
+}
+
+int8_t bme68x_tphg_meas_read(struct bme68x_tphg_sensor *sensor, struct bme68x_tphg_meas *meas)
+{
+	int8_t ret;
+	uint8_t n_data; /* Always 0 or 1 in forced mode.  */
+
+	ret = bme68x_get_data(BME68X_FORCED_MODE, &meas->data, &n_data, &sensor->dev);
+	if (ret == BME68X_OK) {
+		meas->new_data = meas->data.status & BME68X_NEW_DATA_MSK;
+		meas->heatr_stab = meas->data.status & BME68X_HEAT_STAB_MSK;
+		meas->gas_valid = meas->data.status & BME68X_GASM_VALID_MSK;
+
+		if (meas->new_data) {
+			bme68x_tphg_latest_publish(sensor, meas);
+		}
+
+	} else {
+		LOG_ERR("failed to read BME68X data: %d", ret);
+	}
+
+	return ret;
+}
+
+int bme68x_tphg_latest_get(struct bme68x_tphg_sensor const *sensor,
+			   struct bme68x_tphg_meas *meas)
+{
+	struct bme68x_tphg_latest const *latest = &sensor->latest;
+	atomic_val_t seq;
+
+	if (!atomic_get(&latest->published)) {
+		/* The first measurement is not yet fully published. */
+		return -ENODATA;
+	}
+
+	do {
+		seq = atomic_get(&latest->seq);
+		*meas = latest->buf[seq & 1];
+		barrier_dmem_fence_full();
+	} while (atomic_get(&latest->seq) != seq);
+
+	return 0;
+}
+
+uint32_t bme68x_tphg_get_cycle_us(struct bme68x_tphg_sensor *sensor)
+{
+	/* No heating when gas measurements are disabled. */
+	uint32_t heatr_dur_us = (sensor->gas_conf.enable == BME68X_ENABLE)
+					? sensor->gas_conf.heatr_dur * UINT32_C(1000)
+					: 0;
+	uint32_t meas_dur_us = bme68x_get_meas_dur(BME68X_FORCED_MODE, &sensor->tph_conf,
+						   &sensor->dev);
+	return meas_dur_us + heatr_dur_us;
+}
+
+int bme68x_tphg_engine_init(struct bme68x_tphg_engine *engine)
+{
+	if (!device_is_ready(engine->dev)) {
+		LOG_ERR("%s: device not ready", engine->dev->name);
+		return -ENODEV;
+	}
+
+	int ret = bme68x_sensor_api_init(engine->dev, &engine->sensor.dev);
+	if (!ret) {
+		ret = bme68x_init(&engine->sensor.dev);
+	}
+	if (!ret) {
+		ret = bme68x_tphg_configure(&engine->sensor, engine->config);
+	}
+	if (ret) {
+		LOG_ERR("%s: initialization error: %d", engine->dev->name, ret);
+	}
+	return ret;
+}
+
+int bme68x_tphg_engine_run(struct bme68x_tphg_engine *engine)
+{
+	k_ticks_t period = k_ms_to_ticks_ceil64(engine->config->period_ms);
+	struct bme68x_tphg_sample sample = {.engine = engine};
+	int64_t next = k_uptime_ticks();
+	/* The first cycle measures gas. */
+	int64_t next_gas = next;
+
+	engine->thread = k_current_get();
+	atomic_clear(&engine->stop);
+
+	while (!atomic_get(&engine->stop)) {
+		int8_t ret = tphg_engine_schedule_gas(engine, &next_gas);
+
+		if (ret == BME68X_OK) {
+			ret = tphg_engine_measure(engine, &sample);
+		}
+
+		if (ret == BME68X_OK) {
+			if (sample.meas.new_data) {
+				tphg_engine_output(engine, &sample);
+			}
+		} else if (ret < 0) {
+			/* Negative BME68X Sensor API status indicate fatal errors. */
+			LOG_ERR("%s: BME68X Sensor API: %d", engine->dev->name, ret);
+			return ret;
+		} else {
+			/* Warnings: try again with the next cycle. */
+			LOG_WRN("%s: BME68X Sensor API: %d", engine->dev->name, ret);
+		}
+
+		if (!period) {
+			/* Back-to-back measurements. */
+			continue;
+		}
+
+		/* Absolute deadlines: the period does not drift with the cycle duration. */
+		next += period;
+		int64_t now = k_uptime_ticks();
+		if (next <= now) {
+			int64_t missed = ((now - next) / period) + 1;
+
+			next += missed * period;
+			atomic_add(&engine->overruns, (atomic_val_t)missed);
+		}
+		k_sleep(K_TIMEOUT_ABS_TICKS(next));
+	}
+
+	return 0;
+}
+
+void bme68x_tphg_engine_stop(struct bme68x_tphg_engine *engine)
+{
+	atomic_set(&engine->stop, 1);
+	if (engine->thread) {
+		/* Don't wait for the end of the period. */
+		k_wakeup(engine->thread);
+	}
+}
+
+int8_t tphg_configure_regs(struct bme68x_tphg_sensor *sensor,
+			   struct bme68x_tphg_config const *config)
+{
+	struct bme68x_tphg_regs const *regs = config->regs;
+	/* Sleep mode first: ctrl_hum is latched by the next ctrl_meas write. */
+	uint8_t const addr[] = {
+		BME68X_REG_CTRL_MEAS, BME68X_REG_CTRL_HUM,   BME68X_REG_CONFIG,
+		BME68X_REG_CTRL_GAS_0, BME68X_REG_CTRL_GAS_1, BME68X_REG_GAS_WAIT0,
+		BME68X_REG_RES_HEAT0,
+	};
+	uint8_t const data[] = {
+		regs->ctrl_meas,
+		regs->ctrl_hum,
+		regs->config,
+		regs->ctrl_gas_0,
+		regs->ctrl_gas_1[sensor->dev.variant_id == BME68X_VARIANT_GAS_HIGH],
+		regs->gas_wait_0,
+		bme68x_res_heat(&sensor->dev, config->heatr_temp),
+	};
+
+	int8_t ret = bme68x_set_regs(addr, data, ARRAY_SIZE(addr), &sensor->dev);
+	if (ret == BME68X_OK) {
+		sensor->tph_conf = (struct bme68x_conf){
+			.os_temp = config->os_temp,
+			.os_pres = config->os_pres,
+			.os_hum = config->os_hum,
+			.filter = config->iir_filter,
+			.odr = BME68X_ODR_NONE,
+		};
+		sensor->gas_conf = (struct bme68x_heatr_conf){
+			.heatr_temp = config->heatr_temp,
+			.heatr_dur = config->heatr_dur,
+			.enable = config->gas_enable,
+		};
+		tphg_gas_cache(sensor, data[3], data[4]);
+
+		LOG_INF("os_t:%s os_p:%s os_h:%s iir:%s heatr_temp:%d degC heatr_dur:%u ms (regs)",
+			tph_conf_osx2str(config->os_temp), tph_conf_osx2str(config->os_pres),
+			tph_conf_osx2str(config->os_hum), tph_conf_iir2str(config->iir_filter),
+			config->heatr_temp, config->heatr_dur);
+	} else {
+		LOG_ERR("failed to write configuration registers: %d", ret);
+	}
+	return ret;
+}
+
+void tphg_gas_cache(struct bme68x_tphg_sensor *sensor, uint8_t ctrl_gas_0, uint8_t ctrl_gas_1)
+{
+	uint8_t run_gas = (sensor->dev.variant_id == BME68X_VARIANT_GAS_HIGH)
+				  ? BME68X_ENABLE_GAS_MEAS_H
+				  : BME68X_ENABLE_GAS_MEAS_L;
+
+	sensor->ctrl_gas[BME68X_DISABLE][0] =
+		BME68X_SET_BITS(ctrl_gas_0, BME68X_HCTRL, BME68X_DISABLE_HEATER);
+	sensor->ctrl_gas[BME68X_DISABLE][1] =
+		BME68X_SET_BITS(ctrl_gas_1, BME68X_RUN_GAS, BME68X_DISABLE_GAS_MEAS);
+	sensor->ctrl_gas[BME68X_ENABLE][0] =
+		BME68X_SET_BITS(ctrl_gas_0, BME68X_HCTRL, BME68X_ENABLE_HEATER);
+	sensor->ctrl_gas[BME68X_ENABLE][1] = BME68X_SET_BITS(ctrl_gas_1, BME68X_RUN_GAS, run_gas);
+}
+
+int8_t tphg_engine_measure(struct bme68x_tphg_engine *engine, struct bme68x_tphg_sample *sample)
+{
+	struct bme68x_tphg_sensor *sensor = &engine->sensor;
+	uint32_t cycle_us;
+
+	int8_t ret = bme68x_tphg_meas_trigger(sensor, &cycle_us);
+	if (ret != BME68X_OK) {
+		return ret;
+	}
+
+	if (engine->config->period_ms) {
+		k_sleep(K_USEC(cycle_us));
+	} else {
+		/* Generous timeout: twice the expected cycle, plus a millisecond. */
+		ret = bme68x_tphg_meas_poll(sensor, 2 * cycle_us + 1000, engine->config->poll_us);
+	}
+
+	if (ret == BME68X_OK) {
+		ret = bme68x_tphg_meas_read(sensor, &sample->meas);
+		sample->ts_ns = (int64_t)k_ticks_to_ns_floor64(k_uptime_ticks());
+	}
+	return ret;
+}
+
+int8_t tphg_engine_schedule_gas(struct bme68x_tphg_engine *engine, int64_t *next_gas)
+{
+	struct bme68x_tphg_config const *config = engine->config;
+
+	if (config->gas_enable != BME68X_ENABLE || !config->gas_period_ms) {
+		/* Gas measured with every cycle, or never. */
+		return BME68X_OK;
+	}
+
+	k_ticks_t gas_period = k_ms_to_ticks_ceil64(config->gas_period_ms);
+	int64_t now = k_uptime_ticks();
+	bool gas_due = now >= *next_gas;
+
+	if (gas_due) {
+		/* Absolute deadlines as well, missed gas periods are simply skipped. */
+		*next_gas += gas_period;
+		if (*next_gas <= now) {
+			*next_gas += (((now - *next_gas) / gas_period) + 1) * gas_period;
+		}
+	}
+	return bme68x_tphg_gas_enable(&engine->sensor, gas_due ? BME68X_ENABLE : BME68X_DISABLE);
+}
+
+void tphg_engine_output(struct bme68x_tphg_engine *engine, struct bme68x_tphg_sample const *sample)
+{
+	if (engine->cb) {
+		engine->cb(sample, engine->user_data);
+	}
+	if (engine->msgq && k_msgq_put(engine->msgq, sample, K_NO_WAIT)) {
+		atomic_inc(&engine->dropped);
+	}
+}
+
+void bme68x_tphg_latest_publish(struct bme68x_tphg_sensor *sensor,
+				struct bme68x_tphg_meas const *meas)
+{
+	struct bme68x_tphg_latest *latest = &sensor->latest;
+
+	/* Odd: readers switch to buf[1]. */
+	atomic_inc(&latest->seq);
+	latest->buf[0] = *meas;
+	/* Even: readers switch back to buf[0]. */
+	atomic_inc(&latest->seq);
+	latest->buf[1] = *meas;
+
+	/* Both copies written once. */
+	atomic_set(&latest->published, 1);
+}
+
+char const *tph_conf_osx2str(uint8_t osx)
+{
+	switch (osx) {
+	case BME68X_OS_1X:
+		return "x1";
+	case BME68X_OS_2X:
+		return "x2";
+	case BME68X_OS_4X:
+		return "x4";
+	case BME68X_OS_8X:
+		return "x8";
+	case BME68X_OS_16X:
+		return "x16";
+	case BME68X_OS_NONE:
+		return "off";
+	default:
+		return "?";
+	}
+}
+char const *tph_conf_iir2str(uint8_t filter)
+{
+	switch (filter) {
+	case BME68X_FILTER_SIZE_1:
+		return "2";
+	case BME68X_FILTER_SIZE_3:
+		return "4";
+	case BME68X_FILTER_SIZE_7:
+		return "8";
+	case BME68X_FILTER_SIZE_15:
+		return "16";
+	case BME68X_FILTER_SIZE_31:
+		return "32";
+	case BME68X_FILTER_SIZE_63:
+		return "64";
+	case BME68X_FILTER_SIZE_127:
+		return "128";
+	case BME68X_FILTER_OFF:
+		return "off";
+	default:
+		return "?";
+	}
+}
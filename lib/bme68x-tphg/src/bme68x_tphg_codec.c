@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_tphg_codec.h"
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+/* Status byte: BME68X status bits and gas index. */
+#define TPHG_CODEC_STATUS_MSK    (BME68X_NEW_DATA_MSK | BME68X_GASM_VALID_MSK | BME68X_HEAT_STAB_MSK)
+#define TPHG_CODEC_GAS_INDEX_MSK 0x0FU
+
+void bme68x_tphg_codec_reset(struct bme68x_tphg_codec *codec)
+{
+	bme68x_codec_reset(&codec->ctx);
+}
+
+int bme68x_tphg_encode(struct bme68x_tphg_codec *codec, int64_t ts_ns,
+		       struct bme68x_tphg_meas const *meas, uint8_t *buf, size_t size)
+{
+	int len = bme68x_codec_put_header(&codec->ctx, BME68X_CODEC_TYPE_TPHG, ts_ns,
+					  BME68X_TPHG_CODEC_PAYLOAD_SIZE, buf, size);
+	if (len < 0) {
+		return len;
+	}
+
+	uint8_t *p = buf + len;
+	*p++ = (meas->data.status & TPHG_CODEC_STATUS_MSK) |
+	       (meas->data.gas_index & TPHG_CODEC_GAS_INDEX_MSK);
+	*p++ = meas->data.meas_index;
+
+#if BME68X_SENSOR_API_FLOAT
+	float temperature = CLAMP(meas->data.temperature * 100.0f, INT16_MIN, INT16_MAX);
+	float pressure = CLAMP(meas->data.pressure, 0.0f, (float)BIT_MASK(24));
+	float humidity = CLAMP(meas->data.humidity * 100.0f, 0.0f, UINT16_MAX);
+	float gas_res = CLAMP(meas->data.gas_resistance, 0.0f, (float)INT32_MAX);
+
+	/* Round to nearest. */
+	sys_put_le16((uint16_t)(int16_t)(temperature + (temperature < 0 ? -0.5f : 0.5f)), p);
+	sys_put_le24((uint32_t)(pressure + 0.5f), p + 2);
+	sys_put_le16((uint16_t)(humidity + 0.5f), p + 5);
+	sys_put_le32((uint32_t)(gas_res + 0.5f), p + 7);
+#else
+	/* Fixed-point API: centidegrees, Pa, millipercent, Ohm. */
+	sys_put_le16((uint16_t)meas->data.temperature, p);
+	sys_put_le24(MIN(meas->data.pressure, BIT_MASK(24)), p + 2);
+	sys_put_le16((uint16_t)MIN((meas->data.humidity + 5U) / 10U, UINT16_MAX), p + 5);
+	sys_put_le32(meas->data.gas_resistance, p + 7);
+#endif
+	p += 11;
+
+	return (int)(p - buf);
+}
+
+int bme68x_tphg_decode(struct bme68x_tphg_codec *codec, uint8_t const *buf, size_t len,
+		       int64_t *ts_ns, struct bme68x_tphg_meas *meas)
+{
+	int hdr_len = bme68x_codec_get_header(&codec->ctx, BME68X_CODEC_TYPE_TPHG,
+					      BME68X_TPHG_CODEC_PAYLOAD_SIZE, buf, len, ts_ns);
+	if (hdr_len < 0) {
+		return hdr_len;
+	}
+
+	uint8_t const *p = buf + hdr_len;
+
+	*meas = (struct bme68x_tphg_meas){0};
+	meas->data.status = p[0] & TPHG_CODEC_STATUS_MSK;
+	meas->data.gas_index = p[0] & TPHG_CODEC_GAS_INDEX_MSK;
+	meas->data.meas_index = p[1];
+	meas->new_data = meas->data.status & BME68X_NEW_DATA_MSK;
+	meas->heatr_stab = meas->data.status & BME68X_HEAT_STAB_MSK;
+	meas->gas_valid = meas->data.status & BME68X_GASM_VALID_MSK;
+	p += 2;
+
+#if BME68X_SENSOR_API_FLOAT
+	meas->data.temperature = (int16_t)sys_get_le16(p) / 100.0f;
+	meas->data.pressure = (float)sys_get_le24(p + 2);
+	meas->data.humidity = sys_get_le16(p + 5) / 100.0f;
+	meas->data.gas_resistance = (float)sys_get_le32(p + 7);
+#else
+	meas->data.temperature = (int16_t)sys_get_le16(p);
+	meas->data.pressure = sys_get_le24(p + 2);
+	meas->data.humidity = sys_get_le16(p + 5) * 10U;
+	meas->data.gas_resistance = sys_get_le32(p + 7);
+#endif
+	p += 11;
+
+	return (int)(p - buf);
+}
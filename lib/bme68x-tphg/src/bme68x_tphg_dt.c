@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_tphg_dt.h"
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/sys/util.h>
+
+#include "bme68x_defs.h"
+
+/*
+ * Oversampling and IIR filter enumerations are ordered as the
+ * BME68X_OS_* and BME68X_FILTER_* register values.
+ */
+#define TPHG_DT_OS_TEMP(node_id) DT_ENUM_IDX(node_id, temperature_oversampling)
+#define TPHG_DT_OS_PRES(node_id) DT_ENUM_IDX(node_id, pressure_oversampling)
+#define TPHG_DT_OS_HUM(node_id)  DT_ENUM_IDX(node_id, humidity_oversampling)
+#define TPHG_DT_FILTER(node_id)  DT_ENUM_IDX(node_id, iir_filter)
+
+#define TPHG_DT_HEATR_TEMP(node_id) DT_PROP(node_id, heater_temperature)
+#define TPHG_DT_HEATR_DUR(node_id)  DT_PROP(node_id, heater_duration)
+#define TPHG_DT_GAS_ENABLE(node_id) (TPHG_DT_HEATR_DUR(node_id) > 0)
+
+/*
+ * Heating duration register (gas_wait_x): 6 bits value, 2 bits multiplier (x1, x4, x16, x64),
+ * same as the BME68X Sensor API (private calc_gas_wait()).
+ */
+#define TPHG_DT_GAS_WAIT(dur)                                                                      \
+	((dur) >= 0xfc0   ? 0xff                                                                   \
+	 : (dur) <= 0x3f  ? (dur)                                                                  \
+	 : (dur) <= 0xff  ? (((dur) / 4) | (1 << 6))                                               \
+	 : (dur) <= 0x3ff ? (((dur) / 16) | (2 << 6))                                              \
+			  : (((dur) / 64) | (3 << 6)))
+
+/* ctrl_gas_1: run_gas for the variant, heater set-point 0, ODR none (odr3). */
+#define TPHG_DT_CTRL_GAS_1(node_id, run_gas)                                                       \
+	((TPHG_DT_GAS_ENABLE(node_id) ? ((run_gas) << BME68X_RUN_GAS_POS) : 0) |                   \
+	 (1 << BME68X_ODR3_POS))
+
+#define TPHG_DT_REGS_NAME(node_id) _CONCAT(__bme68x_tphg_dt_regs_, DT_DEP_ORD(node_id))
+
+#define TPHG_DT_CONFIG_DEFINE(node_id)                                                             \
+	BUILD_ASSERT(TPHG_DT_HEATR_TEMP(node_id) <= 400,                                           \
+		     DT_NODE_FULL_NAME(node_id) ": heater-temperature above 400 degC");            \
+	BUILD_ASSERT(TPHG_DT_HEATR_DUR(node_id) <= 4032,                                           \
+		     DT_NODE_FULL_NAME(node_id) ": heater-duration above 4032 ms");                \
+	BUILD_ASSERT(DT_PROP(node_id, ambient_temperature) >= INT8_MIN &&                          \
+			     DT_PROP(node_id, ambient_temperature) <= INT8_MAX,                    \
+		     DT_NODE_FULL_NAME(node_id) ": ambient-temperature out of range");             \
+                                                                                                   \
+	static struct bme68x_tphg_regs const TPHG_DT_REGS_NAME(node_id) = {                        \
+		.ctrl_meas = (TPHG_DT_OS_TEMP(node_id) << BME68X_OST_POS) |                        \
+			     (TPHG_DT_OS_PRES(node_id) << BME68X_OSP_POS) | BME68X_SLEEP_MODE,     \
+		.ctrl_hum = TPHG_DT_OS_HUM(node_id),                                               \
+		.config = TPHG_DT_FILTER(node_id) << BME68X_FILTER_POS,                            \
+		.ctrl_gas_0 = (TPHG_DT_GAS_ENABLE(node_id) ? BME68X_ENABLE_HEATER                  \
+							   : BME68X_DISABLE_HEATER)                \
+			      << BME68X_HCTRL_POS,                                                 \
+		.ctrl_gas_1 =                                                                      \
+			{                                                                          \
+				[BME68X_VARIANT_GAS_LOW] = TPHG_DT_CTRL_GAS_1(                     \
+					node_id, BME68X_ENABLE_GAS_MEAS_L),                        \
+				[BME68X_VARIANT_GAS_HIGH] = TPHG_DT_CTRL_GAS_1(                    \
+					node_id, BME68X_ENABLE_GAS_MEAS_H),                        \
+			},                                                                         \
+		.gas_wait_0 = TPHG_DT_GAS_WAIT(TPHG_DT_HEATR_DUR(node_id)),                        \
+	};                                                                                         \
+                                                                                                   \
+	struct bme68x_tphg_config const BME68X_TPHG_DT_CONFIG_NAME(node_id) = {                    \
+		.os_temp = TPHG_DT_OS_TEMP(node_id),                                               \
+		.os_pres = TPHG_DT_OS_PRES(node_id),                                               \
+		.os_hum = TPHG_DT_OS_HUM(node_id),                                                 \
+		.iir_filter = TPHG_DT_FILTER(node_id),                                             \
+		.heatr_temp = TPHG_DT_HEATR_TEMP(node_id),                                         \
+		.heatr_dur = TPHG_DT_HEATR_DUR(node_id),                                           \
+		.gas_enable = TPHG_DT_GAS_ENABLE(node_id) ? BME68X_ENABLE : BME68X_DISABLE,        \
+		.amb_temp = DT_PROP(node_id, ambient_temperature),                                 \
+		.period_ms = DT_PROP(node_id, measurement_period_ms),                              \
+		.gas_period_ms = DT_PROP(node_id, gas_period_ms),                                  \
+		.poll_us = 0,                                                                      \
+		.regs = &TPHG_DT_REGS_NAME(node_id),                                               \
+	};
+
+#define TPHG_DT_CONFIGS_DEFINE(node_id)                                                            \
+	TPHG_DT_CONFIG_DEFINE(node_id)                                                             \
+	DT_FOREACH_CHILD_STATUS_OKAY(node_id, TPHG_DT_CONFIG_DEFINE)
+
+DT_FOREACH_STATUS_OKAY(bosch_bme68x_sensor_api, TPHG_DT_CONFIGS_DEFINE)
+
+/* Lookup table entry: configuration by device and name. */
+struct tphg_dt_entry {
+	struct device const *dev;
+	/* NULL for the device node's own configuration. */
+	char const *name;
+	struct bme68x_tphg_config const *config;
+};
+
+#define TPHG_DT_CHILD_ENTRY(node_id, parent_id)                                                    \
+	{DEVICE_DT_GET(parent_id), DT_NODE_FULL_NAME(node_id), BME68X_TPHG_DT_CONFIG_GET(node_id)},
+
+#define TPHG_DT_ENTRIES(node_id)                                                                   \
+	{DEVICE_DT_GET(node_id), NULL, BME68X_TPHG_DT_CONFIG_GET(node_id)},                        \
+		DT_FOREACH_CHILD_STATUS_OKAY_VARGS(node_id, TPHG_DT_CHILD_ENTRY, node_id)
+
+static struct tphg_dt_entry const tphg_dt_entries[] = {
+	DT_FOREACH_STATUS_OKAY(bosch_bme68x_sensor_api, TPHG_DT_ENTRIES)};
+
+struct bme68x_tphg_config const *bme68x_tphg_dt_config_find(struct device const *dev,
+							      char const *name)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(tphg_dt_entries); i++) {
+		struct tphg_dt_entry const *entry = &tphg_dt_entries[i];
+
+		if (entry->dev != dev) {
+			continue;
+		}
+		if (name ? (entry->name && !strcmp(entry->name, name)) : !entry->name) {
+			return entry->config;
+		}
+	}
+	return NULL;
+}
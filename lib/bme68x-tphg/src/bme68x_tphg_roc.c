@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_tphg_roc.h"
+
+#include "bme68x_roc.h"
+
+/* Status bits whose changes are reported. */
+#define TPHG_ROC_STATUS_MSK (BME68X_GASM_VALID_MSK | BME68X_HEAT_STAB_MSK)
+
+/*
+ * Value of a TPHG quantity, converted to the rule's unit.
+ *
+ * Returns false if the quantity is not available (invalid gas measurement).
+ */
+static bool tphg_roc_value(struct bme68x_tphg_meas const *meas,
+			   enum bme68x_tphg_quantity quantity, float *value);
+
+uint32_t bme68x_tphg_roc_filter(struct bme68x_tphg_roc *roc, int64_t ts_ns,
+				struct bme68x_tphg_meas const *meas)
+{
+	uint8_t status = meas->data.status & TPHG_ROC_STATUS_MSK;
+	uint32_t reasons = 0;
+
+	if (!roc->primed) {
+		reasons |= BME68X_TPHG_ROC_FIRST;
+	} else {
+		if (bme68x_roc_heartbeat(roc->heartbeat_ms, roc->last_ts_ns, ts_ns)) {
+			reasons |= BME68X_TPHG_ROC_HEARTBEAT;
+		}
+		if (status != roc->last_status) {
+			reasons |= BME68X_TPHG_ROC_STATUS;
+		}
+	}
+
+	for (size_t i = 0; i < roc->n_rules; i++) {
+		struct bme68x_tphg_roc_rule const *rule = &roc->rules[i];
+		float value;
+
+		if (!tphg_roc_value(meas, rule->quantity, &value)) {
+			continue;
+		}
+
+		uint32_t changes = BME68X_ROC_EVAL(&roc->states[i], rule, value, roc->primed);
+		if (changes & BME68X_ROC_DEADBAND) {
+			reasons |= BME68X_TPHG_ROC_DEADBAND;
+		}
+		if (changes & BME68X_ROC_THRESHOLD) {
+			reasons |= BME68X_TPHG_ROC_THRESHOLD;
+		}
+	}
+
+	if (!reasons) {
+		atomic_inc(&roc->suppressed);
+		return 0;
+	}
+
+	for (size_t i = 0; i < roc->n_rules; i++) {
+		float value;
+
+		if (tphg_roc_value(meas, roc->rules[i].quantity, &value)) {
+			roc->states[i].value = value;
+		}
+	}
+	roc->last_ts_ns = ts_ns;
+	roc->last_status = status;
+	roc->primed = true;
+
+	atomic_inc(&roc->forwarded);
+	return reasons;
+}
+
+void bme68x_tphg_roc_reset(struct bme68x_tphg_roc *roc)
+{
+	roc->primed = false;
+	for (size_t i = 0; i < roc->n_rules; i++) {
+		roc->states[i] = (struct bme68x_roc_state){0};
+	}
+}
+
+bool tphg_roc_value(struct bme68x_tphg_meas const *meas, enum bme68x_tphg_quantity quantity,
+		    float *value)
+{
+	switch (quantity) {
+	case BME68X_TPHG_TEMPERATURE:
+		/* Fixed-point API: centidegrees. */
+		*value = BME68X_SENSOR_API_FLOAT ? meas->data.temperature
+						 : meas->data.temperature / 100.0f;
+		return true;
+	case BME68X_TPHG_PRESSURE:
+		*value = meas->data.pressure;
+		return true;
+	case BME68X_TPHG_HUMIDITY:
+		/* Fixed-point API: millipercent. */
+		*value = BME68X_SENSOR_API_FLOAT ? meas->data.humidity
+						 : meas->data.humidity / 1000.0f;
+		return true;
+	case BME68X_TPHG_GAS_RES:
+		if (!(meas->gas_valid && meas->heatr_stab)) {
+			return false;
+		}
+		*value = meas->data.gas_resistance;
+		return true;
+	default:
+		return false;
+	}
+}
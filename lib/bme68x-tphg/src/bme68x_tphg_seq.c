@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_tphg_seq.h"
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include <drivers/bme68x_sensor_api.h>
+
+#include "bme68x.h"
+
+LOG_MODULE_DECLARE(bme68x_tphg, CONFIG_BME68X_TPHG_LOG_LEVEL);
+
+/* The BME680/688 data registers hold 3 fields. */
+#define TPHG_SEQ_N_FIELDS 3
+
+/*
+ * Configure oversampling, IIR filter and heater profile.
+ * @returns 0 on success, BME68X API return code.
+ */
+static int8_t tphg_seq_configure(struct bme68x_tphg_seq *seq);
+
+/*
+ * Stream a new field, skipping fields already streamed.
+ */
+static void tphg_seq_field(struct bme68x_tphg_seq *seq, struct bme68x_data const *data,
+			   int64_t ts_ns);
+
+int bme68x_tphg_seq_init(struct bme68x_tphg_seq *seq)
+{
+	struct bme68x_tphg_seq_config const *config = seq->config;
+
+	if (config->n_steps < 1 || config->n_steps > BME68X_TPHG_SEQ_MAX_STEPS) {
+		return -EINVAL;
+	}
+	if (!device_is_ready(seq->dev)) {
+		LOG_ERR("%s: device not ready", seq->dev->name);
+		return -ENODEV;
+	}
+
+	int ret = bme68x_sensor_api_init(seq->dev, &seq->sensor.dev);
+	if (!ret) {
+		ret = bme68x_init(&seq->sensor.dev);
+	}
+	if (!ret) {
+		ret = tphg_seq_configure(seq);
+	}
+	if (ret) {
+		LOG_ERR("%s: initialization error: %d", seq->dev->name, ret);
+	}
+	return ret;
+}
+
+int bme68x_tphg_seq_run(struct bme68x_tphg_seq *seq)
+{
+	struct bme68x_data data[TPHG_SEQ_N_FIELDS];
+	uint8_t n_fields;
+
+	seq->thread = k_current_get();
+	seq->primed = false;
+	seq->sweep_ts_ns = 0;
+	atomic_clear(&seq->stop);
+
+	int8_t ret = bme68x_set_op_mode(BME68X_SEQUENTIAL_MODE, &seq->sensor.dev);
+	if (ret != BME68X_OK) {
+		LOG_ERR("%s: failed to switch to sequential mode: %d", seq->dev->name, ret);
+		return ret;
+	}
+
+	while (!atomic_get(&seq->stop)) {
+		/* Polling at the shortest step won't let the sensor overwrite unread fields. */
+		k_sleep(K_USEC(seq->poll_us));
+
+		ret = bme68x_get_data(BME68X_SEQUENTIAL_MODE, data, &n_fields, &seq->sensor.dev);
+		if (ret == BME68X_W_NO_NEW_DATA) {
+			continue;
+		} else if (ret < 0) {
+			LOG_ERR("%s: BME68X Sensor API: %d", seq->dev->name, ret);
+			break;
+		} else if (ret > 0) {
+			LOG_WRN("%s: BME68X Sensor API: %d", seq->dev->name, ret);
+			continue;
+		}
+
+		int64_t ts_ns = (int64_t)k_ticks_to_ns_floor64(k_uptime_ticks());
+
+		/* Sorted by the Sensor API: new fields first, in measurement order. */
+		for (size_t i = 0; i < n_fields; i++) {
+			tphg_seq_field(seq, &data[i], ts_ns);
+		}
+	}
+
+	(void)bme68x_set_op_mode(BME68X_SLEEP_MODE, &seq->sensor.dev);
+	return ret < 0 ? ret : 0;
+}
+
+void bme68x_tphg_seq_stop(struct bme68x_tphg_seq *seq)
+{
+	atomic_set(&seq->stop, 1);
+	if (seq->thread) {
+		k_wakeup(seq->thread);
+	}
+}
+
+int8_t tphg_seq_configure(struct bme68x_tphg_seq *seq)
+{
+	struct bme68x_tphg_seq_config const *config = seq->config;
+	struct bme68x_tphg_sensor *sensor = &seq->sensor;
+	/* The Sensor API wants non-const profiles. */
+	uint16_t heatr_temp[BME68X_TPHG_SEQ_MAX_STEPS];
+	uint16_t heatr_dur[BME68X_TPHG_SEQ_MAX_STEPS];
+	struct bme68x_heatr_conf heatr_conf = {
+		.enable = BME68X_ENABLE,
+		.heatr_temp_prof = heatr_temp,
+		.heatr_dur_prof = heatr_dur,
+		.profile_len = config->n_steps,
+	};
+
+	sensor->dev.amb_temp = config->amb_temp;
+	sensor->tph_conf = (struct bme68x_conf){
+		.os_temp = config->os_temp,
+		.os_pres = config->os_pres,
+		.os_hum = config->os_hum,
+		.filter = config->iir_filter,
+		/* No standby time between sweeps. */
+		.odr = BME68X_ODR_NONE,
+	};
+
+	int8_t ret = bme68x_set_conf(&sensor->tph_conf, &sensor->dev);
+	if (ret != BME68X_OK) {
+		LOG_ERR("sensor configuration error: %d", ret);
+		return ret;
+	}
+
+	uint32_t meas_us = bme68x_get_meas_dur(BME68X_SEQUENTIAL_MODE, &sensor->tph_conf,
+					       &sensor->dev);
+	uint32_t expected_us = 0;
+	uint32_t poll_us = UINT32_MAX;
+
+	for (size_t i = 0; i < config->n_steps; i++) {
+		uint32_t step_us = meas_us + config->heatr_dur[i] * UINT32_C(1000);
+
+		heatr_temp[i] = config->heatr_temp[i];
+		heatr_dur[i] = config->heatr_dur[i];
+		expected_us += step_us;
+		poll_us = MIN(poll_us, step_us);
+	}
+
+	ret = bme68x_set_heatr_conf(BME68X_SEQUENTIAL_MODE, &heatr_conf, &sensor->dev);
+	if (ret != BME68X_OK) {
+		LOG_ERR("heating profile error: %d", ret);
+		return ret;
+	}
+
+	sensor->gas_conf = (struct bme68x_heatr_conf){.enable = BME68X_ENABLE};
+	seq->poll_us = poll_us;
+	seq->stats = (struct bme68x_tphg_seq_stats){.expected_us = expected_us};
+
+	LOG_INF("%s: %u steps, sweep %u us", seq->dev->name, config->n_steps, expected_us);
+	return BME68X_OK;
+}
+
+void tphg_seq_field(struct bme68x_tphg_seq *seq, struct bme68x_data const *data, int64_t ts_ns)
+{
+	struct bme68x_tphg_seq_stats *stats = &seq->stats;
+
+	if (!(data->status & BME68X_NEW_DATA_MSK)) {
+		return;
+	}
+
+	if (seq->primed) {
+		/* Sub-measurement index is 8-bit, fields behind the last one were streamed. */
+		uint8_t delta = data->meas_index - seq->last_index;
+
+		if (delta == 0 || delta > 128) {
+			return;
+		}
+		stats->missed += delta - 1;
+	}
+	seq->last_index = data->meas_index;
+	seq->primed = true;
+
+	if (data->gas_index == 0) {
+		/* A sweep completes when the next one starts. */
+		if (seq->sweep_ts_ns) {
+			stats->sweeps++;
+			stats->sweep_us = (uint32_t)((ts_ns - seq->sweep_ts_ns) / 1000);
+		}
+		seq->sweep_ts_ns = ts_ns;
+	}
+	stats->fields++;
+
+	struct bme68x_tphg_seq_field field = {
+		.seq = seq,
+		.ts_ns = ts_ns,
+		.step = data->gas_index,
+		.meas_index = data->meas_index,
+		.meas = {
+			.new_data = data->status & BME68X_NEW_DATA_MSK,
+			.gas_valid = data->status & BME68X_GASM_VALID_MSK,
+			.heatr_stab = data->status & BME68X_HEAT_STAB_MSK,
+			.data = *data,
+		},
+	};
+
+	if (seq->cb) {
+		seq->cb(&field, seq->user_data);
+	}
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Minimal BME680 I2C emulator: a register file with valid chip and variant IDs,
+ * and calibration coefficients. Forced mode measurements complete immediately
+ * with fixed ADC values, then the sensor is back to sleep mode.
+ */
+
+#define DT_DRV_COMPAT bosch_bme68x_sensor_api
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/sys/util.h>
+
+#include "bme68x_defs.h"
+
+/* Fixed ADC values: about 26 degC, 980 hPa, 52 %, 250 kOhm (typical coefficients). */
+#define BME680_EMUL_ADC_TEMP 0x7A9C0U
+#define BME680_EMUL_ADC_PRES 0x5A2C0U
+#define BME680_EMUL_ADC_HUM  0x5800U
+#define BME680_EMUL_ADC_GAS  0x200U
+#define BME680_EMUL_GAS_RNG  5U
+
+/* Register file, the read pointer is auto-incremented. */
+struct bme680_emul_data {
+	uint8_t regs[256];
+	uint8_t ptr;
+	uint8_t meas_index;
+};
+
+/*
+ * Implements i2c_emul_transfer_t.
+ *
+ * Writes are register address and data pairs,
+ * single-byte writes set the read pointer.
+ */
+static int bme680_emul_transfer(struct emul const *target, struct i2c_msg *msgs, int num_msgs,
+				int addr);
+
+/*
+ * Register write side effects.
+ */
+static void bme680_emul_reg_write(struct bme680_emul_data *data, uint8_t reg, uint8_t val);
+
+/*
+ * Emulator initialization: chip and variant IDs, calibration coefficients.
+ */
+static int bme680_emul_init(struct emul const *target, struct device const *parent);
+
+/* Calibration coefficients register blocks (see get_calib_data()). */
+static void bme680_emul_set_calib(struct bme680_emul_data *data);
+
+static struct i2c_emul_api const bme680_emul_api = {
+	.transfer = bme680_emul_transfer,
+};
+
+int bme680_emul_transfer(struct emul const *target, struct i2c_msg *msgs, int num_msgs, int addr)
+{
+	struct bme680_emul_data *data = target->data;
+
+	ARG_UNUSED(addr);
+
+	for (int i = 0; i < num_msgs; i++) {
+		struct i2c_msg *msg = &msgs[i];
+
+		if (msg->flags & I2C_MSG_READ) {
+			for (uint32_t j = 0; j < msg->len; j++) {
+				msg->buf[j] = data->regs[data->ptr++];
+			}
+		} else if (msg->len == 1) {
+			data->ptr = msg->buf[0];
+		} else {
+			for (uint32_t j = 0; (j + 1) < msg->len; j += 2) {
+				bme680_emul_reg_write(data, msg->buf[j], msg->buf[j + 1]);
+			}
+		}
+	}
+	return 0;
+}
+
+void bme680_emul_reg_write(struct bme680_emul_data *data, uint8_t reg, uint8_t val)
+{
+	if (reg == BME68X_REG_SOFT_RESET) {
+		/* Keep the calibration coefficients. */
+		return;
+	}
+
+	data->regs[reg] = val;
+	if ((reg != BME68X_REG_CTRL_MEAS) || ((val & BME68X_MODE_MSK) != BME68X_FORCED_MODE)) {
+		return;
+	}
+
+	/* Forced mode: measurement completes immediately, back to sleep mode. */
+	uint8_t *field = &data->regs[BME68X_REG_FIELD0];
+
+	memset(field, 0, BME68X_LEN_FIELD);
+	field[0] = BME68X_NEW_DATA_MSK;
+	field[1] = data->meas_index++;
+	field[2] = BME680_EMUL_ADC_PRES >> 12;
+	field[3] = (BME680_EMUL_ADC_PRES >> 4) & 0xFFU;
+	field[4] = (BME680_EMUL_ADC_PRES << 4) & 0xF0U;
+	field[5] = BME680_EMUL_ADC_TEMP >> 12;
+	field[6] = (BME680_EMUL_ADC_TEMP >> 4) & 0xFFU;
+	field[7] = (BME680_EMUL_ADC_TEMP << 4) & 0xF0U;
+	field[8] = BME680_EMUL_ADC_HUM >> 8;
+	field[9] = BME680_EMUL_ADC_HUM & 0xFFU;
+	field[13] = BME680_EMUL_ADC_GAS >> 2;
+	field[14] = ((BME680_EMUL_ADC_GAS & 0x03U) << 6) | BME68X_GASM_VALID_MSK |
+		    BME68X_HEAT_STAB_MSK | BME680_EMUL_GAS_RNG;
+
+	data->regs[reg] &= ~BME68X_MODE_MSK;
+}
+
+void bme680_emul_set_calib(struct bme680_emul_data *data)
+{
+	/* Typical BME680 coefficients. */
+	uint8_t coeff[BME68X_LEN_COEFF_ALL] = {
+		[BME68X_IDX_T1_LSB] = 0x64, [BME68X_IDX_T1_MSB] = 0x66,
+		[BME68X_IDX_T2_LSB] = 0x6E, [BME68X_IDX_T2_MSB] = 0x67,
+		[BME68X_IDX_T3] = 0x03,
+		[BME68X_IDX_P1_LSB] = 0x1D, [BME68X_IDX_P1_MSB] = 0x8D,
+		[BME68X_IDX_P2_LSB] = 0x23, [BME68X_IDX_P2_MSB] = 0xD7,
+		[BME68X_IDX_P3] = 0x58,
+		[BME68X_IDX_P4_LSB] = 0x34, [BME68X_IDX_P4_MSB] = 0x1B,
+		[BME68X_IDX_P5_LSB] = 0x9E, [BME68X_IDX_P5_MSB] = 0xFF,
+		[BME68X_IDX_P6] = 0x1E,
+		[BME68X_IDX_P7] = 0x1E,
+		[BME68X_IDX_P8_LSB] = 0x96, [BME68X_IDX_P8_MSB] = 0xF1,
+		[BME68X_IDX_P9_LSB] = 0x20, [BME68X_IDX_P9_MSB] = 0xF3,
+		[BME68X_IDX_P10] = 0x1E,
+		[BME68X_IDX_H1_MSB] = 0x31, [BME68X_IDX_H1_LSB] = 0xAA,
+		[BME68X_IDX_H2_MSB] = 0x3F,
+		[BME68X_IDX_H3] = 0x00,
+		[BME68X_IDX_H4] = 0x2D,
+		[BME68X_IDX_H5] = 0x14,
+		[BME68X_IDX_H6] = 0x78,
+		[BME68X_IDX_H7] = 0x9C,
+		[BME68X_IDX_GH1] = 0xC6,
+		[BME68X_IDX_GH2_LSB] = 0x16, [BME68X_IDX_GH2_MSB] = 0xD9,
+		[BME68X_IDX_GH3] = 0x12,
+		[BME68X_IDX_RES_HEAT_VAL] = 0x2A,
+		[BME68X_IDX_RES_HEAT_RANGE] = 0x10,
+		[BME68X_IDX_RANGE_SW_ERR] = 0x10,
+	};
+
+	memcpy(&data->regs[BME68X_REG_COEFF1], &coeff[0], BME68X_LEN_COEFF1);
+	memcpy(&data->regs[BME68X_REG_COEFF2], &coeff[BME68X_LEN_COEFF1], BME68X_LEN_COEFF2);
+	memcpy(&data->regs[BME68X_REG_COEFF3], &coeff[BME68X_LEN_COEFF1 + BME68X_LEN_COEFF2],
+	       BME68X_LEN_COEFF3);
+}
+
+int bme680_emul_init(struct emul const *target, struct device const *parent)
+{
+	struct bme680_emul_data *data = target->data;
+
+	ARG_UNUSED(parent);
+
+	memset(data, 0, sizeof(*data));
+	data->regs[BME68X_REG_CHIP_ID] = BME68X_CHIP_ID;
+	data->regs[BME68X_REG_VARIANT_ID] = BME68X_VARIANT_GAS_LOW;
+	bme680_emul_set_calib(data);
+	return 0;
+}
+
+#define BME680_EMUL_DEFINE(inst)                                                                   \
+	static struct bme680_emul_data bme680_emul_data_##inst;                                    \
+	EMUL_DT_INST_DEFINE(inst, bme680_emul_init, &bme680_emul_data_##inst, NULL,                \
+			    &bme680_emul_api, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(BME680_EMUL_DEFINE)
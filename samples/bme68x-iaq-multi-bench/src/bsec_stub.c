@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * BSEC interface stub (CONFIG_BSEC_STUB) for benchmarks:
+ * - bsec_sensor_control_m() requests a forced mode measurement
+ *   every CONFIG_BME68X_MULTI_BENCH_PERIOD_MS, and reports timing violations
+ *   beyond the BSEC tolerance (6.25% of the period)
+ * - bsec_do_steps_m() burns CONFIG_BME68X_MULTI_BENCH_STEPS_US of CPU time,
+ *   then outputs a fixed IAQ value
+ *
+ * The single-instance interface runs on a static instance.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "bme68x_defs.h"
+#include "bsec_interface.h"
+#include "bsec_interface_multi.h"
+
+#define BSEC_STUB_PERIOD_NS ((int64_t)CONFIG_BME68X_MULTI_BENCH_PERIOD_MS * NSEC_PER_MSEC)
+
+/* Stub instance. */
+struct bsec_stub_inst {
+	/* Next BSEC rendez-vous in nanoseconds, zero before the first one. */
+	int64_t next_call;
+};
+
+/* Instance of the single-instance interface. */
+static struct bsec_stub_inst bsec_stub_single;
+
+size_t bsec_get_instance_size_m(void)
+{
+	return sizeof(struct bsec_stub_inst);
+}
+
+bsec_library_return_t bsec_get_version_m(void *inst, bsec_version_t *bsec_version_p)
+{
+	ARG_UNUSED(inst);
+
+	/* Not a BSEC version. */
+	*bsec_version_p = (bsec_version_t){0};
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_init_m(void *inst)
+{
+	*(struct bsec_stub_inst *)inst = (struct bsec_stub_inst){0};
+	return BSEC_OK;
+}
+
+bsec_library_return_t
+bsec_update_subscription_m(void *inst,
+			   bsec_sensor_configuration_t const *const requested_virtual_sensors,
+			   uint8_t const n_requested_virtual_sensors,
+			   bsec_sensor_configuration_t *required_sensor_settings,
+			   uint8_t *n_required_sensor_settings)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(requested_virtual_sensors);
+	ARG_UNUSED(n_requested_virtual_sensors);
+	ARG_UNUSED(required_sensor_settings);
+
+	*n_required_sensor_settings = 0;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_do_steps_m(void *inst, bsec_input_t const *const inputs,
+				      uint8_t const n_inputs, bsec_output_t *outputs,
+				      uint8_t *n_outputs)
+{
+	ARG_UNUSED(inst);
+
+	k_busy_wait(CONFIG_BME68X_MULTI_BENCH_STEPS_US);
+
+	if (!n_inputs || !*n_outputs) {
+		*n_outputs = 0;
+		return BSEC_OK;
+	}
+	outputs[0] = (bsec_output_t){
+		.time_stamp = inputs[0].time_stamp,
+		.signal = 50.0f,
+		.signal_dimensions = 1,
+		.sensor_id = BSEC_OUTPUT_IAQ,
+	};
+	*n_outputs = 1;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_reset_output_m(void *inst, uint8_t sensor_id)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(sensor_id);
+
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_configuration_m(void *inst, uint8_t const *const serialized_settings,
+					       uint32_t const n_serialized_settings,
+					       uint8_t *work_buffer,
+					       uint32_t const n_work_buffer_size)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(serialized_settings);
+	ARG_UNUSED(n_serialized_settings);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer_size);
+
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_state_m(void *inst, uint8_t const *const serialized_state,
+				       uint32_t const n_serialized_state, uint8_t *work_buffer,
+				       uint32_t const n_work_buffer_size)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(serialized_state);
+	ARG_UNUSED(n_serialized_state);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer_size);
+
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_configuration_m(void *inst, uint8_t const config_id,
+					       uint8_t *serialized_settings,
+					       uint32_t const n_serialized_settings_max,
+					       uint8_t *work_buffer, uint32_t const n_work_buffer,
+					       uint32_t *n_serialized_settings)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(config_id);
+	ARG_UNUSED(serialized_settings);
+	ARG_UNUSED(n_serialized_settings_max);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer);
+
+	*n_serialized_settings = 0;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_state_m(void *inst, uint8_t const state_set_id,
+				       uint8_t *serialized_state,
+				       uint32_t const n_serialized_state_max,
+				       uint8_t *work_buffer, uint32_t const n_work_buffer,
+				       uint32_t *n_serialized_state)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(state_set_id);
+	ARG_UNUSED(serialized_state);
+	ARG_UNUSED(n_serialized_state_max);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer);
+
+	*n_serialized_state = 0;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_sensor_control_m(void *inst, int64_t const time_stamp,
+					    bsec_bme_settings_t *sensor_settings)
+{
+	struct bsec_stub_inst *stub = inst;
+	bsec_library_return_t ret = BSEC_OK;
+
+	if (stub->next_call && ((time_stamp - stub->next_call) > (BSEC_STUB_PERIOD_NS / 16))) {
+		/* Missed rendez-vous: skip this measurement, restart from now. */
+		ret = BSEC_W_SC_CALL_TIMING_VIOLATION;
+		stub->next_call = 0;
+	}
+	if (!stub->next_call) {
+		stub->next_call = time_stamp;
+	}
+	stub->next_call += BSEC_STUB_PERIOD_NS;
+
+	*sensor_settings = (bsec_bme_settings_t){
+		.next_call = stub->next_call,
+		.process_data = BSEC_PROCESS_TEMPERATURE | BSEC_PROCESS_PRESSURE |
+				BSEC_PROCESS_HUMIDITY | BSEC_PROCESS_GAS,
+		.heater_temperature = 320,
+		.heater_duration = CONFIG_BME68X_MULTI_BENCH_HEATER_MS,
+		.run_gas = 1,
+		.pressure_oversampling = BME68X_OS_1X,
+		.temperature_oversampling = BME68X_OS_1X,
+		.humidity_oversampling = BME68X_OS_1X,
+		.trigger_measurement = (ret == BSEC_OK),
+		.op_mode = BME68X_FORCED_MODE,
+	};
+	return ret;
+}
+
+bsec_library_return_t bsec_get_version(bsec_version_t *bsec_version_p)
+{
+	return bsec_get_version_m(&bsec_stub_single, bsec_version_p);
+}
+
+bsec_library_return_t bsec_init(void)
+{
+	return bsec_init_m(&bsec_stub_single);
+}
+
+bsec_library_return_t
+bsec_update_subscription(bsec_sensor_configuration_t const *const requested_virtual_sensors,
+			 uint8_t const n_requested_virtual_sensors,
+			 bsec_sensor_configuration_t *required_sensor_settings,
+			 uint8_t *n_required_sensor_settings)
+{
+	return bsec_update_subscription_m(&bsec_stub_single, requested_virtual_sensors,
+					  n_requested_virtual_sensors, required_sensor_settings,
+					  n_required_sensor_settings);
+}
+
+bsec_library_return_t bsec_do_steps(bsec_input_t const *const inputs, uint8_t const n_inputs,
+				    bsec_output_t *outputs, uint8_t *n_outputs)
+{
+	return bsec_do_steps_m(&bsec_stub_single, inputs, n_inputs, outputs, n_outputs);
+}
+
+bsec_library_return_t bsec_reset_output(uint8_t sensor_id)
+{
+	return bsec_reset_output_m(&bsec_stub_single, sensor_id);
+}
+
+bsec_library_return_t bsec_set_configuration(uint8_t const *const serialized_settings,
+					     uint32_t const n_serialized_settings,
+					     uint8_t *work_buffer,
+					     uint32_t const n_work_buffer_size)
+{
+	return bsec_set_configuration_m(&bsec_stub_single, serialized_settings,
+					n_serialized_settings, work_buffer, n_work_buffer_size);
+}
+
+bsec_library_return_t bsec_set_state(uint8_t const *const serialized_state,
+				     uint32_t const n_serialized_state, uint8_t *work_buffer,
+				     uint32_t const n_work_buffer_size)
+{
+	return bsec_set_state_m(&bsec_stub_single, serialized_state, n_serialized_state,
+				work_buffer, n_work_buffer_size);
+}
+
+bsec_library_return_t bsec_get_configuration(uint8_t const config_id, uint8_t *serialized_settings,
+					     uint32_t const n_serialized_settings_max,
+					     uint8_t *work_buffer, uint32_t const n_work_buffer,
+					     uint32_t *n_serialized_settings)
+{
+	return bsec_get_configuration_m(&bsec_stub_single, config_id, serialized_settings,
+					n_serialized_settings_max, work_buffer, n_work_buffer,
+					n_serialized_settings);
+}
+
+bsec_library_return_t bsec_get_state(uint8_t const state_set_id, uint8_t *serialized_state,
+				     uint32_t const n_serialized_state_max, uint8_t *work_buffer,
+				     uint32_t const n_work_buffer, uint32_t *n_serialized_state)
+{
+	return bsec_get_state_m(&bsec_stub_single, state_set_id, serialized_state,
+				n_serialized_state_max, work_buffer, n_work_buffer,
+				n_serialized_state);
+}
+
+bsec_library_return_t bsec_sensor_control(int64_t const time_stamp,
+					  bsec_bme_settings_t *sensor_settings)
+{
+	return bsec_sensor_control_m(&bsec_stub_single, time_stamp, sensor_settings);
+}
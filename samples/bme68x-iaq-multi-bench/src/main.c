@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Scaling benchmark of the multi-sensor IAQ engine (CONFIG_BME68X_IAQ_MULTI),
+ * e.g. on qemu_x86_64 (SMP, 2 CPUs), with emulated BME680 sensors on two I2C buses,
+ * and a BSEC stub which burns a fixed CPU time per algorithm iteration.
+ *
+ * Runs the engine with 1 to 4 sensors, and reports the throughput
+ * and the per-worker load.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include "bme68x_iaq_multi.h"
+
+LOG_MODULE_REGISTER(app, CONFIG_BME68X_SAMPLE_LOG_LEVEL);
+
+#define BENCH_WORKERS CONFIG_BME68X_IAQ_MULTI_WORKERS
+
+/*
+ * Run the engine with the first n_sensors sensors
+ * during CONFIG_BME68X_MULTI_BENCH_DURATION seconds, and report.
+ *
+ * Returns 0 on success, negative errno, BSEC or BME68X Sensor API status otherwise.
+ */
+static int bench_run(size_t n_sensors);
+
+BME68X_IAQ_MULTI_BUS_DEFINE(bench_bus0);
+BME68X_IAQ_MULTI_BUS_DEFINE(bench_bus1);
+
+BME68X_IAQ_MULTI_SENSOR_DEFINE(bench_sensor0, DEVICE_DT_GET(DT_NODELABEL(bme680_0)), &bench_bus0,
+			       NULL, NULL);
+BME68X_IAQ_MULTI_SENSOR_DEFINE(bench_sensor1, DEVICE_DT_GET(DT_NODELABEL(bme680_1)), &bench_bus0,
+			       NULL, NULL);
+BME68X_IAQ_MULTI_SENSOR_DEFINE(bench_sensor2, DEVICE_DT_GET(DT_NODELABEL(bme680_2)), &bench_bus1,
+			       NULL, NULL);
+BME68X_IAQ_MULTI_SENSOR_DEFINE(bench_sensor3, DEVICE_DT_GET(DT_NODELABEL(bme680_3)), &bench_bus1,
+			       NULL, NULL);
+
+/* Round-robin: with 2 workers, each worker serves a sensor on each bus. */
+static struct bme68x_iaq_multi_sensor *const bench_sensors[] = {
+	&bench_sensor0,
+	&bench_sensor2,
+	&bench_sensor1,
+	&bench_sensor3,
+};
+
+int main(void)
+{
+	LOG_INF("%u CPUs, %u workers, period %u ms, iteration %u us", arch_num_cpus(),
+		BENCH_WORKERS, CONFIG_BME68X_MULTI_BENCH_PERIOD_MS,
+		CONFIG_BME68X_MULTI_BENCH_STEPS_US);
+
+	for (size_t n = 1; n <= ARRAY_SIZE(bench_sensors); n++) {
+		int ret = bench_run(n);
+		if (ret) {
+			LOG_ERR("%zu sensors: benchmark error: %d", n, ret);
+			return 0;
+		}
+	}
+
+	LOG_INF("done");
+	return 0;
+}
+
+int bench_run(size_t n_sensors)
+{
+	int ret = bme68x_iaq_multi_init(bench_sensors, n_sensors);
+	if (!ret) {
+		ret = bme68x_iaq_multi_start();
+	}
+	if (ret) {
+		return ret;
+	}
+
+	k_sleep(K_SECONDS(CONFIG_BME68X_MULTI_BENCH_DURATION));
+
+	/* Worker loads while running. */
+	uint32_t busy_pct[BENCH_WORKERS];
+	for (size_t w = 0; w < BENCH_WORKERS; w++) {
+		struct bme68x_iaq_multi_worker_stats stats;
+
+		bme68x_iaq_multi_worker_stats_get(w, &stats);
+		busy_pct[w] = stats.elapsed_us
+				      ? (uint32_t)((stats.busy_us * 100U) / stats.elapsed_us)
+				      : 0;
+	}
+
+	ret = bme68x_iaq_multi_stop(K_SECONDS(1));
+	if (ret) {
+		return ret;
+	}
+
+	uint32_t samples = 0;
+	uint32_t violations = 0;
+	uint32_t late_max_us = 0;
+	uint32_t bus_wait_max_us = 0;
+	for (size_t i = 0; i < n_sensors; i++) {
+		struct bme68x_iaq_multi_stats stats;
+
+		bme68x_iaq_multi_stats_get(bench_sensors[i], &stats);
+		samples += stats.samples;
+		violations += stats.violations;
+		late_max_us = MAX(late_max_us, stats.late_max_us);
+		bus_wait_max_us = MAX(bus_wait_max_us, stats.bus_wait_max_us);
+	}
+
+	/* Samples per second (x1000). */
+	uint32_t rate = (samples * 1000U) / CONFIG_BME68X_MULTI_BENCH_DURATION;
+	uint32_t expected = (n_sensors * 1000000U) / CONFIG_BME68X_MULTI_BENCH_PERIOD_MS;
+
+	LOG_INF("%zu sensors: %u.%03u samples/s (expected %u.%03u), violations %u, "
+		"late max %u us, bus wait max %u us",
+		n_sensors, rate / 1000U, rate % 1000U, expected / 1000U, expected % 1000U,
+		violations, late_max_us, bus_wait_max_us);
+	for (size_t w = 0; w < BENCH_WORKERS; w++) {
+		LOG_INF("%zu sensors: worker %zu busy %u%%", n_sensors, w, busy_pct[w]);
+	}
+	return 0;
+}
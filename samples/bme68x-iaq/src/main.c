@@ -14,6 +14,9 @@
 #include "bme68x.h"
 
 #include "bme68x_iaq.h"
+#if defined(CONFIG_BME68X_SAMPLE_BASELINE_EXPORT)
+#include "bme68x_iaq_baseline.h"
+#endif
 
 LOG_MODULE_REGISTER(app, CONFIG_BME68X_SAMPLE_LOG_LEVEL);
 
@@ -79,11 +82,26 @@ struct iaq_output {
 /* Log IAQ samples. */
 static void iaq_output_handler(struct bme68x_iaq_sample const *iaq_sample);
 
+#if defined(CONFIG_BME68X_SAMPLE_BASELINE_EXPORT)
+/* Log the baseline image once the IAQ accuracy is high. */
+static void iaq_baseline_export(struct bme68x_iaq_sample const *iaq_sample);
+#endif
+
+/* Observe all IAQ output channels, log all samples. */
+BME68X_IAQ_OBSERVER_DEFINE(iaq_log_observer, iaq_output_handler, 1, BME68X_IAQ_CHAN_ALL);
+
 int main(void)
 {
 	/* Any compatible device will be fine. */
 	struct device const *const dev = DEVICE_DT_GET_ONE(bosch_bme68x_sensor_api);
 
+#if defined(CONFIG_BME68X_IAQ_THREAD)
+	/* BSEC control loop runs in the library's IAQ thread. */
+	int ret = bme68x_iaq_thread_start(dev);
+	if (ret) {
+		LOG_ERR("IAQ thread start failed: %d", ret);
+	}
+#else
 	struct bme68x_dev bme68x_dev = {0};
 	int ret = bme68x_sensor_api_init(dev, &bme68x_dev);
 	if (!ret) {
@@ -94,16 +112,17 @@ int main(void)
 		goto sleep_forever;
 	}
 
-	ret = bme68x_iaq_init();
+	ret = bme68x_iaq_init(&bme68x_dev);
 	if (ret) {
 		LOG_ERR("IAQ initialization failed: %d", ret);
 		goto sleep_forever;
 	}
 
 	/* Enter BSEC control loop. */
-	bme68x_iaq_run(&bme68x_dev, iaq_output_handler);
+	bme68x_iaq_run(&bme68x_dev);
 
 sleep_forever:
+#endif
 	k_sleep(K_FOREVER);
 	return 0;
 }
@@ -176,4 +195,29 @@ void iaq_output_handler(struct bme68x_iaq_sample const *iaq_sample)
 		accuracy2str[iaq_output.voc_accuracy]);
 	LOG_INF("stabilization: %s, %s", stab2str[iaq_output.stab_status],
 		stab2str[iaq_output.run_status]);
+
+#if defined(CONFIG_BME68X_SAMPLE_BASELINE_EXPORT)
+	iaq_baseline_export(iaq_sample);
+#endif
+}
+
+#if defined(CONFIG_BME68X_SAMPLE_BASELINE_EXPORT)
+void iaq_baseline_export(struct bme68x_iaq_sample const *iaq_sample)
+{
+	static uint8_t image[BME68X_IAQ_BASELINE_IMAGE_MAX_SIZE];
+	static bool exported;
+	size_t len;
+
+	if (exported || (iaq_sample->iaq_accuracy != BME68X_IAQ_ACCURACY_HIGH)) {
+		return;
+	}
+
+	int ret = bme68x_iaq_baseline_export(image, sizeof(image), &len);
+	if (ret) {
+		LOG_ERR("baseline export failed: %d", ret);
+		return;
+	}
+	exported = true;
+	LOG_HEXDUMP_INF(image, len, "BSEC baseline image");
 }
+#endif
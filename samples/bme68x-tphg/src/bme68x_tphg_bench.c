@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_tphg_bench.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include <drivers/bme68x_sensor_api.h>
+
+#include "bme68x.h"
+
+#include "bme68x_tphg.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_BME68X_SAMPLE_LOG_LEVEL);
+
+/* Benchmarked configuration. */
+struct tphg_bench_conf {
+	uint8_t os_temp;
+	uint8_t os_pres;
+	uint8_t os_hum;
+	/* Heating duration in milliseconds, zero to disable gas measurements. */
+	uint16_t heatr_dur;
+};
+
+/* Results of a benchmark run. */
+struct tphg_bench_result {
+	uint32_t samples;
+	uint32_t timeouts;
+	uint64_t elapsed_us;
+};
+
+/*
+ * From minimal oversampling without gas measurements (maximum throughput)
+ * to the sample's defaults with the LP heating profile.
+ */
+static struct tphg_bench_conf const tphg_bench_confs[] = {
+	{BME68X_OS_1X, BME68X_OS_NONE, BME68X_OS_NONE, 0},
+	{BME68X_OS_1X, BME68X_OS_1X, BME68X_OS_1X, 0},
+	{BME68X_OS_2X, BME68X_OS_16X, BME68X_OS_1X, 0},
+	{BME68X_OS_16X, BME68X_OS_16X, BME68X_OS_16X, 0},
+	{BME68X_OS_1X, BME68X_OS_1X, BME68X_OS_1X, 20},
+	{BME68X_OS_2X, BME68X_OS_16X, BME68X_OS_1X, 197},
+};
+
+/* Oversampling to multiplier, e.g. for logging. */
+static uint8_t tphg_bench_osx(uint8_t osx);
+
+/*
+ * Run back-to-back measurements for the given duration.
+ * @returns 0 on success, BME68X API return code.
+ */
+static int8_t tphg_bench_conf_run(struct bme68x_tphg_sensor *sensor, uint32_t duration_ms,
+				  struct tphg_bench_result *result);
+
+int bme68x_tphg_bench_run(struct device const *dev, uint32_t duration_ms)
+{
+	struct bme68x_tphg_sensor sensor = {0};
+
+	int ret = bme68x_sensor_api_init(dev, &sensor.dev);
+	if (!ret) {
+		ret = bme68x_tphg_init(&sensor);
+	}
+	if (ret) {
+		LOG_ERR("%s: sensor initialization error: %d", dev->name, ret);
+		return ret;
+	}
+
+	char const *bus = (sensor.dev.intf == BME68X_SPI_INTF) ? "spi" : "i2c";
+
+	for (size_t i = 0; i < ARRAY_SIZE(tphg_bench_confs); i++) {
+		struct tphg_bench_conf const *conf = &tphg_bench_confs[i];
+		struct tphg_bench_result result = {0};
+		uint8_t gas_enable = conf->heatr_dur ? BME68X_ENABLE : BME68X_DISABLE;
+
+		ret = bme68x_tphg_configure_tph(&sensor, conf->os_temp, conf->os_pres,
+						conf->os_hum, BME68X_FILTER_OFF);
+		if (!ret) {
+			ret = bme68x_tphg_configure_gas(&sensor, BME68X_TPHG_HEATR_TEMP,
+							conf->heatr_dur, gas_enable);
+		}
+		if (!ret) {
+			ret = tphg_bench_conf_run(&sensor, duration_ms, &result);
+		}
+		if (ret < 0) {
+			LOG_ERR("%s: benchmark error: %d", dev->name, ret);
+			return ret;
+		}
+
+		/* Rates in millisamples per second, cycles in microseconds. */
+		uint32_t rate = result.elapsed_us
+					? (uint32_t)((result.samples * UINT64_C(1000000000)) /
+						     result.elapsed_us)
+					: 0;
+		uint32_t cycle_us =
+			result.samples ? (uint32_t)(result.elapsed_us / result.samples) : 0;
+
+		LOG_INF("%s: os %ux/%ux/%ux gas %u ms: %u.%03u samples/s, cycle %u us "
+			"(expected %u us), timeouts %u",
+			bus, tphg_bench_osx(conf->os_temp), tphg_bench_osx(conf->os_pres),
+			tphg_bench_osx(conf->os_hum), conf->heatr_dur, rate / 1000, rate % 1000,
+			cycle_us, bme68x_tphg_get_cycle_us(&sensor), result.timeouts);
+	}
+
+	return 0;
+}
+
+int8_t tphg_bench_conf_run(struct bme68x_tphg_sensor *sensor, uint32_t duration_ms,
+			   struct tphg_bench_result *result)
+{
+	struct bme68x_tphg_meas meas;
+	uint32_t cycle_us;
+	int8_t ret = BME68X_OK;
+
+	int64_t start = k_uptime_ticks();
+	int64_t end = start + k_ms_to_ticks_ceil64(duration_ms);
+	int64_t now = start;
+
+	while (now < end) {
+		ret = bme68x_tphg_meas_trigger(sensor, &cycle_us);
+		if (ret == BME68X_OK) {
+			/* Generous timeout: twice the expected cycle, plus a millisecond. */
+			ret = bme68x_tphg_meas_poll(sensor, 2 * cycle_us + 1000,
+						    CONFIG_BME68X_TPHG_MAX_RATE_POLL_US);
+		}
+		if (ret == BME68X_OK) {
+			ret = bme68x_tphg_meas_read(sensor, &meas);
+		}
+
+		if (ret < 0) {
+			return ret;
+		}
+		if ((ret == BME68X_OK) && meas.new_data) {
+			result->samples++;
+		} else {
+			result->timeouts++;
+		}
+		now = k_uptime_ticks();
+	}
+
+	result->elapsed_us = k_ticks_to_us_floor64(now - start);
+	return BME68X_OK;
+}
+
+uint8_t tphg_bench_osx(uint8_t osx)
+{
+	return (osx == BME68X_OS_NONE) ? 0 : BIT(osx - BME68X_OS_1X);
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Throughput benchmark: back-to-back forced measurements,
+ * for a set of oversampling and heater configurations.
+ */
+
+#ifndef _BME68X_TPHG_BENCH_H_
+#define _BME68X_TPHG_BENCH_H_
+
+#include <stdint.h>
+
+#include <zephyr/device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run the throughput benchmark on a BME680/688 device.
+ *
+ * For each configuration, measurements are triggered back-to-back,
+ * completion being detected by polling the status register.
+ * Achieved samples per second are logged, together with
+ * the actual and expected cycle durations.
+ *
+ * @param dev BME68X Sensor API device (either bus).
+ * @param duration_ms Duration of each configuration run in milliseconds.
+ *
+ * @returns 0 on success, BME68X API return code or negative errno otherwise.
+ */
+int bme68x_tphg_bench_run(struct device const *dev, uint32_t duration_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BME68X_TPHG_BENCH_H_ */
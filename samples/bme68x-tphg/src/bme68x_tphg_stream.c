@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_tphg_stream.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+LOG_MODULE_DECLARE(app, CONFIG_BME68X_SAMPLE_LOG_LEVEL);
+
+#define TPHG_STREAM_UART DEVICE_DT_GET(DT_CHOSEN(bme68x_stream_uart))
+
+/* Unencoded frame: type, payload, CRC. */
+#define TPHG_STREAM_FRAME_MAX (1U + BME68X_TPHG_STREAM_MAX_PAYLOAD + 2U)
+
+/* COBS overhead: one byte per 254 bytes (at least one), plus the delimiter. */
+#define TPHG_STREAM_COBS_MAX (TPHG_STREAM_FRAME_MAX + (TPHG_STREAM_FRAME_MAX / 254U) + 2U)
+
+/*
+ * COBS-encode frame, including the zero delimiter.
+ * Returns the encoded length.
+ */
+static size_t tphg_stream_cobs(uint8_t const *src, size_t len, uint8_t *dst);
+
+/*
+ * Start transmitting the fill buffer, then swap buffers.
+ * Must be called with the lock held, and no transmission in progress.
+ */
+static void tphg_stream_tx_start(void);
+
+/*
+ * Async UART callback: on TX completion, start transmitting pending frames.
+ */
+static void tphg_stream_uart_cb(struct device const *dev, struct uart_event *evt,
+				void *user_data);
+
+/* Double buffering: one buffer is transmitted while the other is filled. */
+static struct {
+	uint8_t bufs[2][CONFIG_BME68X_TPHG_STREAM_BUF_SIZE];
+	/* Buffer being filled. */
+	uint8_t fill;
+	/* Length of the buffer being filled. */
+	size_t fill_len;
+	/* Whether a transmission is in progress. */
+	bool tx_busy;
+	/* Whether queued frames were lost since the last bme68x_tphg_stream_send(). */
+	bool tx_lost;
+	uint32_t sent;
+	uint32_t dropped;
+	struct k_spinlock lock;
+} tphg_stream;
+
+BUILD_ASSERT(CONFIG_BME68X_TPHG_STREAM_BUF_SIZE >= TPHG_STREAM_COBS_MAX,
+	     "stream buffer too small for a single frame");
+
+int bme68x_tphg_stream_init(void)
+{
+	struct device const *uart = TPHG_STREAM_UART;
+
+	if (!device_is_ready(uart)) {
+		LOG_ERR("stream UART not ready");
+		return -ENODEV;
+	}
+
+	int ret = uart_callback_set(uart, tphg_stream_uart_cb, NULL);
+	if (ret) {
+		LOG_ERR("stream UART does not support the async API: %d", ret);
+	}
+	return ret;
+}
+
+int bme68x_tphg_stream_send(uint8_t type, uint8_t const *payload, size_t len)
+{
+	uint8_t frame[TPHG_STREAM_FRAME_MAX];
+
+	if (len > BME68X_TPHG_STREAM_MAX_PAYLOAD) {
+		return -EINVAL;
+	}
+
+	frame[0] = type;
+	memcpy(&frame[1], payload, len);
+	sys_put_le16(crc16_ccitt(0xffff, frame, len + 1), &frame[len + 1]);
+	len += 3;
+
+	k_spinlock_key_t key = k_spin_lock(&tphg_stream.lock);
+
+	if (tphg_stream.tx_lost) {
+		/* Frames already queued were lost: drop this one too, the caller resynchronizes. */
+		tphg_stream.tx_lost = false;
+		tphg_stream.dropped++;
+		k_spin_unlock(&tphg_stream.lock, key);
+		return -EIO;
+	}
+
+	if ((tphg_stream.fill_len + TPHG_STREAM_COBS_MAX) > CONFIG_BME68X_TPHG_STREAM_BUF_SIZE) {
+		/* Both buffers busy: drop frame rather than block the measurement loop. */
+		tphg_stream.dropped++;
+		k_spin_unlock(&tphg_stream.lock, key);
+		return -ENOBUFS;
+	}
+
+	uint8_t *dst = &tphg_stream.bufs[tphg_stream.fill][tphg_stream.fill_len];
+	tphg_stream.fill_len += tphg_stream_cobs(frame, len, dst);
+	tphg_stream.sent++;
+
+	int ret = 0;
+	if (!tphg_stream.tx_busy) {
+		tphg_stream_tx_start();
+		if (tphg_stream.tx_lost) {
+			/* This frame was lost with the buffer. */
+			tphg_stream.tx_lost = false;
+			ret = -EIO;
+		}
+	}
+
+	k_spin_unlock(&tphg_stream.lock, key);
+	return ret;
+}
+
+void bme68x_tphg_stream_stats(uint32_t *sent, uint32_t *dropped)
+{
+	k_spinlock_key_t key = k_spin_lock(&tphg_stream.lock);
+
+	*sent = tphg_stream.sent;
+	*dropped = tphg_stream.dropped;
+
+	k_spin_unlock(&tphg_stream.lock, key);
+}
+
+void tphg_stream_tx_start(void)
+{
+	uint8_t const *buf = tphg_stream.bufs[tphg_stream.fill];
+	size_t len = tphg_stream.fill_len;
+
+	tphg_stream.fill ^= 1U;
+	tphg_stream.fill_len = 0;
+
+	int ret = uart_tx(TPHG_STREAM_UART, buf, len, SYS_FOREVER_US);
+	tphg_stream.tx_busy = (ret == 0);
+	if (ret) {
+		LOG_WRN("stream TX failed: %d", ret);
+		tphg_stream.dropped++;
+		tphg_stream.tx_lost = true;
+	}
+}
+
+void tphg_stream_uart_cb(struct device const *dev, struct uart_event *evt, void *user_data)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(user_data);
+
+	if ((evt->type != UART_TX_DONE) && (evt->type != UART_TX_ABORTED)) {
+		return;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&tphg_stream.lock);
+
+	tphg_stream.tx_busy = false;
+	if (tphg_stream.fill_len) {
+		tphg_stream_tx_start();
+	}
+
+	k_spin_unlock(&tphg_stream.lock, key);
+}
+
+size_t tphg_stream_cobs(uint8_t const *src, size_t len, uint8_t *dst)
+{
+	size_t code_pos = 0;
+	size_t out = 1;
+	uint8_t code = 1;
+
+	for (size_t i = 0; i < len; i++) {
+		if (src[i]) {
+			dst[out++] = src[i];
+			code++;
+		}
+		if (!src[i] || (code == 0xff)) {
+			dst[code_pos] = code;
+			code_pos = out++;
+			code = 1;
+		}
+	}
+	dst[code_pos] = code;
+	dst[out++] = 0;
+
+	return out;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Binary streaming of TPHG frames over UART (async API).
+ *
+ * Each frame is:
+ * - frame type (1 byte, BME68X_TPHG_STREAM_*)
+ * - payload
+ * - CRC-16/CCITT of type and payload (crc16_ccitt(), seed 0xffff, little-endian)
+ *
+ * COBS-encoded and terminated by a zero byte.
+ *
+ * See scripts/bme68x_stream.py for the host decoder.
+ */
+
+#ifndef _BME68X_TPHG_STREAM_H_
+#define _BME68X_TPHG_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Frame type: compact TPHG record (see bme68x_tphg_codec.h).
+ */
+#define BME68X_TPHG_STREAM_RECORD    0x01U
+
+/**
+ * @brief Frame type: raw field data registers, from 0x1d (`BME68X_LEN_FIELD` bytes).
+ */
+#define BME68X_TPHG_STREAM_RAW_FIELD 0x02U
+
+/**
+ * @brief Maximum payload size of a frame.
+ */
+#define BME68X_TPHG_STREAM_MAX_PAYLOAD 64U
+
+/**
+ * @brief Initialize streaming on the UART chosen with `bme68x,stream-uart`.
+ *
+ * @returns 0 on success, negative errno otherwise.
+ */
+int bme68x_tphg_stream_init(void);
+
+/**
+ * @brief Queue frame for transmission.
+ *
+ * Frames are accumulated in the buffer not being transmitted,
+ * the buffers are swapped upon transmission completion.
+ *
+ * Never blocks: when the buffer is full, the frame is dropped.
+ *
+ * Frames are lost when a transmission fails to start: this frame,
+ * or the next one if the failure happens upon completion of a previous transmission,
+ * is then dropped with -EIO, e.g. for the caller to force a key frame.
+ *
+ * @param type Frame type (`BME68X_TPHG_STREAM_*`).
+ * @param payload Frame payload.
+ * @param len Payload length, at most `BME68X_TPHG_STREAM_MAX_PAYLOAD` bytes.
+ *
+ * @returns 0 on success, -ENOBUFS if the frame was dropped,
+ * -EIO if queued frames were lost (the caller should resynchronize the stream),
+ * -EINVAL if the payload is too large.
+ */
+int bme68x_tphg_stream_send(uint8_t type, uint8_t const *payload, size_t len);
+
+/**
+ * @brief Get streaming counters.
+ *
+ * @param sent Output parameter for the number of queued frames.
+ * @param dropped Output parameter for the number of dropped frames.
+ */
+void bme68x_tphg_stream_stats(uint32_t *sent, uint32_t *dropped);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BME68X_TPHG_STREAM_H_ */
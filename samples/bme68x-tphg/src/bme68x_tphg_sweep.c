@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "bme68x_tphg_sweep.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "bme68x_tphg_seq.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_BME68X_SAMPLE_LOG_LEVEL);
+
+/* Heater profile from the BME68X Sensor API sequential mode example. */
+static struct bme68x_tphg_seq_config const tphg_sweep_config = {
+	.os_temp = BME68X_OS_2X,
+	.os_pres = BME68X_OS_1X,
+	.os_hum = BME68X_OS_16X,
+	.iir_filter = BME68X_FILTER_OFF,
+	.amb_temp = 25,
+	.n_steps = 10,
+	.heatr_temp = {200, 240, 280, 320, 360, 360, 320, 280, 240, 200},
+	.heatr_dur = {100, 100, 100, 100, 100, 100, 100, 100, 100, 100},
+};
+
+/* Log completed fields, and throughput once per sweep. */
+static void tphg_sweep_field(struct bme68x_tphg_seq_field const *field, void *user_data);
+
+/* Stop the sweeps. */
+static void tphg_sweep_expiry(struct k_timer *timer);
+
+int bme68x_tphg_sweep_run(struct device const *dev, uint32_t duration_ms)
+{
+	struct bme68x_tphg_seq seq = {
+		.dev = dev,
+		.config = &tphg_sweep_config,
+		.cb = tphg_sweep_field,
+	};
+	struct k_timer timer;
+
+	int ret = bme68x_tphg_seq_init(&seq);
+	if (ret) {
+		return ret;
+	}
+
+	k_timer_init(&timer, tphg_sweep_expiry, NULL);
+	k_timer_user_data_set(&timer, &seq);
+	k_timer_start(&timer, K_MSEC(duration_ms), K_NO_WAIT);
+
+	ret = bme68x_tphg_seq_run(&seq);
+	k_timer_stop(&timer);
+
+	struct bme68x_tphg_seq_stats stats;
+	bme68x_tphg_seq_stats_get(&seq, &stats);
+	LOG_INF("%s: %u sweeps, %u fields, %u missed", dev->name, stats.sweeps, stats.fields,
+		stats.missed);
+
+	return ret;
+}
+
+void tphg_sweep_field(struct bme68x_tphg_seq_field const *field, void *user_data)
+{
+	struct bme68x_data const *data = &field->meas.data;
+
+	ARG_UNUSED(user_data);
+
+#if BME68X_SENSOR_API_FLOAT
+	LOG_DBG("#%u step %u: T:%.02f deg C, G:%.03f kOhm%s", field->meas_index, field->step,
+		(double)data->temperature, (double)data->gas_resistance / 1000.0,
+		field->meas.gas_valid && field->meas.heatr_stab ? "" : " (invalid)");
+#else
+	LOG_DBG("#%u step %u: T:%d.%02u deg C, G:%u.%03u kOhm%s", field->meas_index, field->step,
+		data->temperature / 100, data->temperature % 100, data->gas_resistance / 1000,
+		data->gas_resistance % 1000,
+		field->meas.gas_valid && field->meas.heatr_stab ? "" : " (invalid)");
+#endif
+
+	if (field->step == 0) {
+		struct bme68x_tphg_seq_stats stats;
+
+		bme68x_tphg_seq_stats_get(field->seq, &stats);
+		if (stats.sweeps && stats.sweep_us) {
+			LOG_INF("sweep %u: %u us (expected %u us), %u.%03u sweeps/s, missed %u",
+				stats.sweeps, stats.sweep_us, stats.expected_us,
+				1000000 / stats.sweep_us, (1000000000 / stats.sweep_us) % 1000,
+				stats.missed);
+		}
+	}
+}
+
+void tphg_sweep_expiry(struct k_timer *timer)
+{
+	bme68x_tphg_seq_stop(k_timer_user_data_get(timer));
+}
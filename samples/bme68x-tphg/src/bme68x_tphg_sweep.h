@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Heater sweep: sequential mode gas scanning over a 10 steps heater profile.
+ */
+
+#ifndef _BME68X_TPHG_SWEEP_H_
+#define _BME68X_TPHG_SWEEP_H_
+
+#include <stdint.h>
+
+#include <zephyr/device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run heater sweeps on a BME680/688 device.
+ *
+ * Fields are logged as they complete, the sweep throughput once per sweep.
+ *
+ * @param dev BME68X Sensor API device.
+ * @param duration_ms Duration of the run in milliseconds.
+ *
+ * @returns 0 on success, BME68X API return code or negative errno otherwise.
+ */
+int bme68x_tphg_sweep_run(struct device const *dev, uint32_t duration_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BME68X_TPHG_SWEEP_H_ */
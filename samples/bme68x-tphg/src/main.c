@@ -3,19 +3,32 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  *
- * Forced mode TPHG measurements with a single heater set-point.
+ * Periodic forced mode TPHG measurements with a single heater set-point.
  *
  * Test application for the BME68X Sensor API driver.
  */
 
+#include <errno.h>
+
+#include <zephyr/devicetree.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
-#include <drivers/bme68x_sensor_api.h>
-
 #include "bme68x.h"
 
 #include "bme68x_tphg.h"
+#include "bme68x_tphg_codec.h"
+#include "bme68x_tphg_dt.h"
+#include "bme68x_tphg_roc.h"
+#if CONFIG_BME68X_TPHG_STREAM
+#include "bme68x_tphg_stream.h"
+#endif
+#if CONFIG_BME68X_TPHG_BENCHMARK
+#include "bme68x_tphg_bench.h"
+#endif
+#if CONFIG_BME68X_TPHG_SWEEP
+#include "bme68x_tphg_sweep.h"
+#endif
 
 LOG_MODULE_REGISTER(app, CONFIG_BME68X_SAMPLE_LOG_LEVEL);
 
@@ -31,11 +44,81 @@ struct k_thread bme68x_tphg_thrd;
 
 #endif /* CONFIG_USERSPACE */
 
+#if CONFIG_BME68X_TPHG_BENCHMARK
+/*
+ * Benchmark all compatible devices, e.g. on both I2C and SPI buses.
+ */
+#define BME68X_TPHG_BENCH_DEV(node_id) DEVICE_DT_GET(node_id),
+
+static struct device const *const bme68x_tphg_bench_devs[] = {
+	DT_FOREACH_STATUS_OKAY(bosch_bme68x_sensor_api, BME68X_TPHG_BENCH_DEV)};
+#endif
+
+#if CONFIG_BME68X_TPHG_ROC
 /*
- * What to do upon new TPHG measurements.
+ * Report-on-change: forward measurements only upon significant changes.
  */
-static void bme68x_tphg_data_sink(struct bme68x_tphg_meas const *meas)
+static struct bme68x_tphg_roc_rule const bme68x_tphg_roc_rules[] = {
+	{.quantity = BME68X_TPHG_TEMPERATURE, .deadband = 0.2f},
+	{.quantity = BME68X_TPHG_PRESSURE, .deadband = 50.0f},
+	{.quantity = BME68X_TPHG_HUMIDITY, .deadband = 1.0f},
+	{.quantity = BME68X_TPHG_GAS_RES, .deadband = 2000.0f},
+};
+BME68X_TPHG_ROC_DEFINE(bme68x_tphg_roc, bme68x_tphg_roc_rules,
+		       CONFIG_BME68X_TPHG_ROC_HEARTBEAT * 1000U);
+#endif
+
+/*
+ * What to do upon new TPHG measurements (engine output callback).
+ */
+static void bme68x_tphg_data_sink(struct bme68x_tphg_sample const *sample, void *user_data)
 {
+	struct bme68x_tphg_meas const *meas = &sample->meas;
+	int64_t ts_ns = sample->ts_ns;
+	/* Compact binary encoding, e.g. for storage or uplink. */
+	static struct bme68x_tphg_codec codec;
+
+	ARG_UNUSED(user_data);
+
+#if CONFIG_BME68X_TPHG_STREAM_RAW
+	uint8_t field[BME68X_LEN_FIELD];
+
+	/* Still valid until the next measurement is triggered. */
+	if (!bme68x_get_regs(BME68X_REG_FIELD0, field, sizeof(field),
+			     &sample->engine->sensor.dev)) {
+		if (bme68x_tphg_stream_send(BME68X_TPHG_STREAM_RAW_FIELD, field, sizeof(field)) ==
+		    -EIO) {
+			/* Records were lost with the raw data. */
+			bme68x_tphg_codec_reset(&codec);
+		}
+	}
+#endif
+
+#if CONFIG_BME68X_TPHG_ROC
+	uint32_t forwarded;
+	uint32_t suppressed;
+
+	uint32_t reasons = bme68x_tphg_roc_filter(&bme68x_tphg_roc, ts_ns, meas);
+	bme68x_tphg_roc_stats(&bme68x_tphg_roc, &forwarded, &suppressed);
+	if (!reasons) {
+		LOG_DBG("suppressed (%u/%u)", suppressed, forwarded + suppressed);
+		return;
+	}
+	LOG_DBG("forwarded (0x%x): %u/%u", reasons, forwarded, forwarded + suppressed);
+#endif
+
+	uint8_t record[BME68X_TPHG_CODEC_MAX_SIZE];
+	int len = bme68x_tphg_encode(&codec, ts_ns, meas, record, sizeof(record));
+	if (len > 0) {
+		LOG_HEXDUMP_DBG(record, len, "TPHG record");
+#if CONFIG_BME68X_TPHG_STREAM
+		if (bme68x_tphg_stream_send(BME68X_TPHG_STREAM_RECORD, record, len)) {
+			/* Force a key frame so that the host can resynchronize. */
+			bme68x_tphg_codec_reset(&codec);
+		}
+#endif
+	}
+
 #if BME68X_SENSOR_API_FLOAT
 	if (meas->gas_valid && meas->heatr_stab) {
 		LOG_INF("T:%.02f deg C, P:%.03f kPa, H:%.03f %%, G:%.03f kOhm",
@@ -74,12 +157,13 @@ static void bme68x_tphg_main(void *p1, void *p2, void *p3)
 	ARG_UNUSED(p2);
 	ARG_UNUSED(p3);
 
-	/* Any compatible device will be fine. */
-	struct device const *const dev = DEVICE_DT_GET_ONE(bosch_bme68x_sensor_api);
-
-	struct bme68x_tphg_sensor sensor = {0};
-	struct bme68x_tphg_meas tphg_meas = {0};
-	uint32_t tphg_cycle_us;
+	struct bme68x_tphg_config config = BME68X_TPHG_CONFIG_DEFAULT;
+	struct bme68x_tphg_engine engine = {
+		/* Any compatible device will be fine. */
+		.dev = DEVICE_DT_GET_ONE(bosch_bme68x_sensor_api),
+		.config = &config,
+		.cb = bme68x_tphg_data_sink,
+	};
 
 	if (k_is_user_context()) {
 		LOG_INF("User mode");
@@ -87,59 +171,68 @@ static void bme68x_tphg_main(void *p1, void *p2, void *p3)
 		LOG_INF("Supervisor mode");
 	}
 
-	int err = bme68x_sensor_api_init(dev, &sensor.dev);
-	if (!err) {
-		err = bme68x_init(&sensor.dev);
+#if CONFIG_BME68X_TPHG_DT_CONFIG
+	char const *dt_name = CONFIG_BME68X_TPHG_DT_CONFIG_NAME;
+	struct bme68x_tphg_config const *dt_config =
+		bme68x_tphg_dt_config_find(engine.dev, dt_name[0] ? dt_name : NULL);
+	if (!dt_config) {
+		LOG_ERR("devicetree configuration not found: \"%s\"", dt_name);
+		return;
 	}
+	config = *dt_config;
+#endif
+
+	int err = bme68x_tphg_engine_init(&engine);
 	if (err) {
 		LOG_ERR("sensor initialization error: %d", err);
 		return;
 	}
 
-	err = bme68x_tphg_init(&sensor);
+#if CONFIG_BME68X_TPHG_MAX_RATE
+	/* Back-to-back measurements. */
+	config.period_ms = 0;
+	config.poll_us = CONFIG_BME68X_TPHG_MAX_RATE_POLL_US;
+
+	err = bme68x_tphg_configure_max_rate(&engine.sensor, config.gas_enable);
 	if (err) {
 		LOG_ERR("sensor configuration error: %d", err);
 		return;
 	}
+#endif
 
 	/* Should not change unless the sensor is reconfigured. */
-	tphg_cycle_us = bme68x_tphg_get_cycle_us(&sensor);
-	LOG_INF("TPHG cycle: %u us", tphg_cycle_us);
-
-	for (;;) {
-		err = bme68x_tphg_meas_trigger(&sensor, &tphg_cycle_us);
-		if (!err) {
-			k_sleep(K_USEC(tphg_cycle_us));
-
-			err = bme68x_tphg_meas_read(&sensor, &tphg_meas);
-			if (!err && tphg_meas.new_data) {
-				bme68x_tphg_data_sink(&tphg_meas);
-			}
-		}
+	LOG_INF("TPHG cycle: %u us, period: %u ms", bme68x_tphg_get_cycle_us(&engine.sensor),
+		config.period_ms);
 
-		if (err) {
-			if (err < 0) {
-				/*
-				 * Negative BME68X Sensor API status indicate fatal errors.
-				 */
-				LOG_ERR("BME68X Sensor API: %d", err);
-				break;
-
-			} else {
-				/*
-				 * Positive BME68X Sensor API status indicate warnings
-				 * that we interpret as "try again/later"
-				 */
-				LOG_WRN("BME68X Sensor API: %d", err);
-			}
-		}
+#if CONFIG_BME68X_TPHG_STREAM
+	err = bme68x_tphg_stream_init();
+	if (err) {
+		LOG_ERR("stream initialization error: %d", err);
+		return;
+	}
+#endif
 
-		k_sleep(K_SECONDS(BME68X_TPHG_SAMPLE_RATE));
+	/* Won't return unless a fatal error occurs. */
+	err = bme68x_tphg_engine_run(&engine);
+	if (err) {
+		LOG_ERR("BME68X Sensor API: %d", err);
 	}
 }
 
 int main(void)
 {
+#if CONFIG_BME68X_TPHG_BENCHMARK
+	for (size_t i = 0; i < ARRAY_SIZE(bme68x_tphg_bench_devs); i++) {
+		bme68x_tphg_bench_run(bme68x_tphg_bench_devs[i],
+				      CONFIG_BME68X_TPHG_BENCHMARK_DURATION * MSEC_PER_SEC);
+	}
+#endif
+
+#if CONFIG_BME68X_TPHG_SWEEP
+	bme68x_tphg_sweep_run(DEVICE_DT_GET_ONE(bosch_bme68x_sensor_api),
+			      CONFIG_BME68X_TPHG_SWEEP_DURATION * MSEC_PER_SEC);
+#endif
+
 #if CONFIG_USERSPACE
 	/*
 	 * Verify that everything still works from user threads.
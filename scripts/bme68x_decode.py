@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024, Chris Duf
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Host decoder for the compact binary encoding of IAQ samples and TPHG measurements.
+
+Records are self-delimiting and may be concatenated:
+
+- header byte: version (bits 0-3), key frame (bit 4), record type (bits 5-7)
+- timestamp in milliseconds (unsigned LEB128), absolute for key frames,
+  relative to the previous record otherwise
+- fixed-size little-endian payload (see bme68x_iaq_codec.h and bme68x_tphg_codec.h)
+
+Usage:
+    bme68x_decode.py [FILE]          decode binary records (stdin if no file)
+    bme68x_decode.py --hex HEX...    decode hexadecimal records (e.g. from LOG_HEXDUMP)
+
+Decoded records are printed as JSON lines.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+CODEC_VERSION = 1
+KEY_FRAME = 0x10
+TYPE_IAQ = 0
+TYPE_TPHG = 1
+
+IAQ_CHANNELS = (
+    "raw_temperature",
+    "raw_pressure",
+    "raw_humidity",
+    "raw_gas_res",
+    "temperature",
+    "humidity",
+    "iaq",
+    "static_iaq",
+    "co2_equivalent",
+    "voc_equivalent",
+    "gas_percentage",
+    "stab_status",
+    "run_status",
+)
+
+IAQ_PAYLOAD_SIZE = 27
+TPHG_PAYLOAD_SIZE = 13
+
+
+class DecodeError(Exception):
+    pass
+
+
+def _u24(buf, pos):
+    return buf[pos] | (buf[pos + 1] << 8) | (buf[pos + 2] << 16)
+
+
+def _decode_iaq(buf, pos):
+    (channels, raw_t) = struct.unpack_from("<Hh", buf, pos)
+    raw_p = _u24(buf, pos + 4)
+    (raw_h, raw_g, temp, hum, iaq, siaq, co2, voc, gas_pct, flags) = struct.unpack_from(
+        "<HIhHHHHHBB", buf, pos + 7
+    )
+    return {
+        "type": "iaq",
+        "channels": [name for i, name in enumerate(IAQ_CHANNELS) if channels & (1 << i)],
+        "raw_temperature": raw_t / 100.0,
+        "raw_pressure": raw_p,
+        "raw_humidity": raw_h / 100.0,
+        "raw_gas_res": raw_g,
+        "temperature": temp / 100.0,
+        "humidity": hum / 100.0,
+        "iaq": iaq,
+        "static_iaq": siaq,
+        "co2_equivalent": co2,
+        "voc_equivalent": voc / 100.0,
+        "gas_percentage": gas_pct,
+        "iaq_accuracy": flags & 0x03,
+        "co2_accuracy": (flags >> 2) & 0x03,
+        "voc_accuracy": (flags >> 4) & 0x03,
+        "stab_status": (flags >> 6) & 0x01,
+        "run_status": (flags >> 7) & 0x01,
+    }
+
+
+def _decode_tphg(buf, pos):
+    (status, meas_index, temp) = struct.unpack_from("<BBh", buf, pos)
+    press = _u24(buf, pos + 4)
+    (hum, gas) = struct.unpack_from("<HI", buf, pos + 7)
+    return {
+        "type": "tphg",
+        "new_data": bool(status & 0x80),
+        "gas_valid": bool(status & 0x20),
+        "heatr_stab": bool(status & 0x10),
+        "gas_index": status & 0x0F,
+        "meas_index": meas_index,
+        "temperature": temp / 100.0,
+        "pressure": press,
+        "humidity": hum / 100.0,
+        "gas_resistance": gas,
+    }
+
+
+RECORDS = {
+    TYPE_IAQ: (IAQ_PAYLOAD_SIZE, _decode_iaq),
+    TYPE_TPHG: (TPHG_PAYLOAD_SIZE, _decode_tphg),
+}
+
+
+class Decoder:
+    """Stateful decoder, tracks the timestamp of the last record per record type."""
+
+    def __init__(self):
+        self.ts_ms = {}
+
+    def decode(self, buf, pos=0):
+        """Decode the record at pos, returns (record, next position)."""
+        if pos >= len(buf):
+            raise DecodeError("truncated record")
+        hdr = buf[pos]
+        version = hdr & 0x0F
+        rtype = hdr >> 5
+        if version != CODEC_VERSION or rtype not in RECORDS:
+            raise DecodeError(f"unsupported record header: 0x{hdr:02x}")
+        pos += 1
+
+        ts_val = 0
+        shift = 0
+        while True:
+            if pos >= len(buf) or shift >= 64:
+                raise DecodeError("truncated timestamp")
+            byte = buf[pos]
+            pos += 1
+            ts_val |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+
+        if hdr & KEY_FRAME:
+            ts_ms = ts_val
+        elif rtype in self.ts_ms:
+            ts_ms = self.ts_ms[rtype] + ts_val
+        else:
+            raise DecodeError("relative timestamp without key frame")
+
+        (size, decode_payload) = RECORDS[rtype]
+        if len(buf) - pos < size:
+            raise DecodeError("truncated payload")
+        record = decode_payload(buf, pos)
+        self.ts_ms[rtype] = ts_ms
+        record["ts_ms"] = ts_ms
+        return record, pos + size
+
+    def decode_all(self, buf):
+        pos = 0
+        while pos < len(buf):
+            record, pos = self.decode(buf, pos)
+            yield record
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("file", nargs="?", help="binary records (default: stdin)")
+    parser.add_argument("--hex", nargs="+", metavar="HEX", help="hexadecimal records")
+    args = parser.parse_args()
+
+    if args.hex:
+        buf = bytes.fromhex("".join(args.hex))
+    elif args.file:
+        with open(args.file, "rb") as f:
+            buf = f.read()
+    else:
+        buf = sys.stdin.buffer.read()
+
+    decoder = Decoder()
+    try:
+        for record in decoder.decode_all(buf):
+            print(json.dumps(record))
+    except DecodeError as e:
+        print(f"decode error: {e}", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
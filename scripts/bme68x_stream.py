@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024, Chris Duf
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Host decoder for the binary TPHG stream (UART).
+
+Frames are COBS-encoded and terminated by a zero byte:
+
+- frame type (1 byte)
+- payload
+- CRC-16/CCITT of type and payload (Zephyr crc16_ccitt(), seed 0xffff, little-endian)
+
+Frame types:
+
+- 0x01: compact TPHG record (see bme68x_decode.py)
+- 0x02: raw field data registers, from 0x1d (17 bytes)
+
+Usage:
+    bme68x_stream.py [--baudrate BAUD] PORT    decode from serial port (or PTY)
+    bme68x_stream.py FILE                      decode captured stream
+    bme68x_stream.py                           decode stdin
+
+Decoded frames are printed as JSON lines, errors are counted and reported on exit.
+"""
+
+import argparse
+import json
+import os
+import stat
+import sys
+import termios
+import tty
+
+from bme68x_decode import DecodeError, Decoder
+
+FRAME_RECORD = 0x01
+FRAME_RAW_FIELD = 0x02
+
+RAW_FIELD_SIZE = 17
+
+
+class FrameError(Exception):
+    pass
+
+
+def crc16_ccitt(seed, buf):
+    """Port of Zephyr crc16_ccitt() (reflected polynomial 0x8408, no final XOR)."""
+    for byte in buf:
+        e = (seed ^ byte) & 0xFF
+        f = (e ^ (e << 4)) & 0xFF
+        seed = ((seed >> 8) ^ (f << 8) ^ (f << 3) ^ (f >> 4)) & 0xFFFF
+    return seed
+
+
+def cobs_decode(buf):
+    out = bytearray()
+    pos = 0
+    while pos < len(buf):
+        code = buf[pos]
+        if code == 0 or pos + code > len(buf):
+            raise FrameError("invalid COBS encoding")
+        out += buf[pos + 1 : pos + code]
+        pos += code
+        if code != 0xFF and pos < len(buf):
+            out.append(0)
+    return bytes(out)
+
+
+def _decode_raw_field(buf):
+    if len(buf) != RAW_FIELD_SIZE:
+        raise FrameError(f"invalid raw field size: {len(buf)}")
+    return {
+        "type": "raw_field",
+        "new_data": bool(buf[0] & 0x80),
+        "gas_meas_index": buf[0] & 0x0F,
+        "meas_index": buf[1],
+        "adc_pres": (buf[2] << 12) | (buf[3] << 4) | (buf[4] >> 4),
+        "adc_temp": (buf[5] << 12) | (buf[6] << 4) | (buf[7] >> 4),
+        "adc_hum": (buf[8] << 8) | buf[9],
+        # BME680 (low) and BME688 (high) gas ADC registers.
+        "adc_gas_res_low": (buf[13] << 2) | (buf[14] >> 6),
+        "gas_range_low": buf[14] & 0x0F,
+        "adc_gas_res_high": (buf[15] << 2) | (buf[16] >> 6),
+        "gas_range_high": buf[16] & 0x0F,
+        "gas_valid": bool(buf[16] & 0x20),
+        "heatr_stab": bool(buf[16] & 0x10),
+    }
+
+
+class StreamDecoder:
+    """Stateful frame decoder."""
+
+    def __init__(self):
+        self.records = Decoder()
+        self.pending = bytearray()
+        self.frames = 0
+        self.errors = 0
+
+    def decode_frame(self, encoded):
+        frame = cobs_decode(encoded)
+        if len(frame) < 3:
+            raise FrameError("truncated frame")
+        crc = frame[-2] | (frame[-1] << 8)
+        if crc16_ccitt(0xFFFF, frame[:-2]) != crc:
+            raise FrameError("CRC mismatch")
+        (ftype, payload) = (frame[0], frame[1:-2])
+
+        if ftype == FRAME_RECORD:
+            record, size = self.records.decode(payload)
+            if size != len(payload):
+                raise FrameError("trailing bytes after record")
+            return record
+        if ftype == FRAME_RAW_FIELD:
+            return _decode_raw_field(payload)
+        raise FrameError(f"unknown frame type: 0x{ftype:02x}")
+
+    def feed(self, data):
+        """Feed received bytes, yields decoded frames."""
+        self.pending += data
+        while True:
+            end = self.pending.find(0)
+            if end < 0:
+                return
+            encoded = bytes(self.pending[:end])
+            del self.pending[: end + 1]
+            if not encoded:
+                continue
+            try:
+                frame = self.decode_frame(encoded)
+            except (FrameError, DecodeError) as e:
+                # The next frame is still aligned on the delimiter.
+                self.errors += 1
+                print(f"frame error: {e}", file=sys.stderr)
+                continue
+            self.frames += 1
+            yield frame
+
+
+BAUDRATES = {
+    9600: termios.B9600,
+    19200: termios.B19200,
+    38400: termios.B38400,
+    57600: termios.B57600,
+    115200: termios.B115200,
+    230400: termios.B230400,
+    460800: getattr(termios, "B460800", None),
+    921600: getattr(termios, "B921600", None),
+    1000000: getattr(termios, "B1000000", None),
+}
+
+
+def _open_tty(fd, baudrate):
+    tty.setraw(fd)
+    if baudrate:
+        speed = BAUDRATES.get(baudrate)
+        if speed is None:
+            raise ValueError(f"unsupported baudrate: {baudrate}")
+        attrs = termios.tcgetattr(fd)
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", nargs="?", help="serial port, PTY or file (default: stdin)")
+    parser.add_argument("--baudrate", type=int, help="serial port baudrate")
+    args = parser.parse_args()
+
+    if args.port:
+        fd = os.open(args.port, os.O_RDONLY | os.O_NOCTTY)
+    else:
+        fd = sys.stdin.fileno()
+    if stat.S_ISCHR(os.fstat(fd).st_mode) and os.isatty(fd):
+        _open_tty(fd, args.baudrate)
+
+    decoder = StreamDecoder()
+    try:
+        while True:
+            data = os.read(fd, 4096)
+            if not data:
+                break
+            for frame in decoder.feed(data):
+                print(json.dumps(frame), flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print(f"frames: {decoder.frames}, errors: {decoder.errors}", file=sys.stderr)
+    return 0 if not decoder.errors else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024, Chris Duf
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Extract the baseline BSEC state image from a reference unit's log (see bme68x_iaq_baseline.h).
+
+The reference unit logs its baseline image as a Zephyr hexdump
+(bme68x_iaq_baseline_export(), e.g. CONFIG_BME68X_SAMPLE_BASELINE_EXPORT):
+
+    [00:12:34.567,890] <inf> app: BSEC baseline image
+                                  42 53 42 4c 01 02 06 00  00 00 00 00 12 34 56 78 |BSBL.... .....4Vx
+                                  ...
+
+The image is the 32 bytes header followed by the BSEC state:
+
+- magic "BSBL", header version
+- BSEC version and configuration CRC-32 of the reference unit
+- state size and CRC-32 (IEEE)
+
+Usage:
+    bsec_baseline_image.py [-o OUT] [LOG]        extract from captured log (stdin if no file)
+    bsec_baseline_image.py [-o OUT] --hex HEX    extract from hexadecimal string
+
+The image is checked, its header printed, and written to OUT if given,
+then provisioned at the start of the bsec_baseline_partition of new devices.
+"""
+
+import argparse
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = 0x4C425342
+HDR_VERSION = 1
+HDR_FORMAT = "<IB4s3xIII8x"
+HDR_SIZE = 32
+MARKER = "BSEC baseline image"
+
+HEXDUMP_LINE = re.compile(r"^\s+((?:[0-9a-f]{2}\s+){1,16})\|")
+
+
+def parse_log(lines):
+    """Collect the hexdump bytes following the last baseline marker."""
+    image = None
+    for line in lines:
+        if MARKER in line:
+            image = bytearray()
+            continue
+        if image is None:
+            continue
+        match = HEXDUMP_LINE.match(line)
+        if not match:
+            if image:
+                # End of the hexdump.
+                break
+            continue
+        image.extend(bytes.fromhex(match.group(1).replace(" ", "")))
+    if not image:
+        raise ValueError("no baseline image found")
+    return bytes(image)
+
+
+def check_image(image):
+    """Check the image header and state CRC, return the header fields."""
+    if len(image) < HDR_SIZE:
+        raise ValueError(f"truncated image: {len(image)} bytes")
+    magic, hdr_version, bsec_version, config_crc, size, crc = struct.unpack_from(HDR_FORMAT,
+                                                                                 image)
+    if magic != MAGIC:
+        raise ValueError(f"invalid magic: 0x{magic:08x}")
+    if hdr_version != HDR_VERSION:
+        raise ValueError(f"unsupported header version: {hdr_version}")
+    state = image[HDR_SIZE:]
+    if len(state) != size:
+        raise ValueError(f"invalid state size: {len(state)}/{size} bytes")
+    if (zlib.crc32(state) & 0xFFFFFFFF) != crc:
+        raise ValueError("state CRC error")
+    return {
+        "bsec_version": ".".join(str(v) for v in bsec_version),
+        "config_crc": f"0x{config_crc:08x}",
+        "size": size,
+        "crc": f"0x{crc:08x}",
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="captured log (default: stdin)")
+    parser.add_argument("--hex", help="hexadecimal image")
+    parser.add_argument("-o", "--output", help="image file")
+    args = parser.parse_args()
+
+    try:
+        if args.hex:
+            image = bytes.fromhex(args.hex)
+        elif args.log:
+            with open(args.log, encoding="utf-8", errors="replace") as f:
+                image = parse_log(f)
+        else:
+            image = parse_log(sys.stdin)
+        hdr = check_image(image)
+    except (OSError, ValueError) as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+
+    for key, value in hdr.items():
+        print(f"{key}: {value}")
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(image)
+        print(f"{args.output}: {len(image)} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024, Chris Duf
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Build the BSEC configuration store image (see bme68x_iaq_config_store.h).
+
+The image is the 64 bytes store header followed by the BSEC configuration blob:
+
+- magic "BSCF", header version, sensor variant
+- configuration name, version, size and CRC-32 (IEEE) of the blob
+
+The configuration is read either from a BSEC configuration source file
+(e.g. config/bme680/bme680_iaq_33v_3s_28d/bsec_iaq.c), or from a raw binary blob.
+
+Usage:
+    bsec_config_image.py -n NAME -v VERSION [--variant {bme680,bme688,any}] -o OUT INPUT
+
+The image is then written at the start of the bsec_config_partition,
+e.g. with the flash programmer of the board, or with a DFU tool.
+"""
+
+import argparse
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = 0x46435342
+HDR_VERSION = 1
+HDR_FORMAT = "<IBBH32sIII12x"
+HDR_SIZE = 64
+NAME_SIZE = 32
+MAX_BLOB_SIZE = 2063
+
+VARIANTS = {
+    "bme680": 0,
+    "bme688": 1,
+    "any": 0xFF,
+}
+
+
+def read_config(path):
+    """Read the BSEC configuration blob from a C source or raw binary file."""
+    if path.endswith(".c"):
+        with open(path, encoding="utf-8") as f:
+            src = f.read()
+        match = re.search(r"=\s*\{([^}]*)\}", src)
+        if not match:
+            raise ValueError(f"{path}: no configuration array")
+        return bytes(int(v, 0) for v in match.group(1).replace("\n", "").split(",") if v.strip())
+
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def build_image(blob, name, version, variant):
+    """Prepend the store header to the configuration blob."""
+    if not blob or len(blob) > MAX_BLOB_SIZE:
+        raise ValueError(f"invalid configuration size: {len(blob)} bytes")
+    name = name.encode("ascii")
+    if len(name) >= NAME_SIZE:
+        raise ValueError(f"name too long (max {NAME_SIZE - 1} characters)")
+
+    hdr = struct.pack(HDR_FORMAT, MAGIC, HDR_VERSION, variant, 0, name, version, len(blob),
+                      zlib.crc32(blob) & 0xFFFFFFFF)
+    assert len(hdr) == HDR_SIZE
+    return hdr + blob
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="BSEC configuration (.c source or raw binary)")
+    parser.add_argument("-n", "--name", required=True, help="configuration name")
+    parser.add_argument("-v", "--version", required=True, type=lambda v: int(v, 0),
+                        help="configuration version")
+    parser.add_argument("--variant", choices=VARIANTS, default="any",
+                        help="sensor variant (default: any)")
+    parser.add_argument("-o", "--output", required=True, help="image file")
+    args = parser.parse_args()
+
+    try:
+        image = build_image(read_config(args.input), args.name, args.version,
+                            VARIANTS[args.variant])
+    except (OSError, ValueError) as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print(f"{args.output}: {args.name} v{args.version} ({len(image) - HDR_SIZE} bytes)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,70 @@
+# Copyright (c) 2024, Chris Duf
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Decode the binary TPHG stream from the native_sim PTY with scripts/bme68x_stream.py."""
+
+import os
+import re
+import select
+import sys
+import time
+import tty
+from pathlib import Path
+
+from twister_harness import DeviceAdapter
+
+sys.path.insert(0, str(Path(__file__).resolve().parents[3] / "scripts"))
+
+from bme68x_stream import StreamDecoder  # noqa: E402
+
+# CONFIG_BME68X_TPHG_STREAM_TEST_FRAMES
+FRAMES = 1000
+
+TIMEOUT = 30
+
+
+def _read_until(dut: DeviceAdapter, pattern):
+    lines = dut.readlines_until(regex=pattern, timeout=TIMEOUT)
+    for line in lines:
+        m = re.search(pattern, line)
+        if m:
+            return m, lines
+    raise AssertionError(f"{pattern} not found")
+
+
+def test_stream(dut: DeviceAdapter):
+    # uart0 is the console (stdin/stdout), the stream UART is the PTY of uart1.
+    _, lines = _read_until(dut, r"stream ready")
+    ptys = [m.group(1) for m in map(re.compile(r"uart_1 connected to pseudotty: (\S+)").search,
+                                    lines) if m]
+    assert ptys, "stream PTY not found"
+
+    fd = os.open(ptys[0], os.O_RDONLY | os.O_NOCTTY | os.O_NONBLOCK)
+    try:
+        tty.setraw(fd)
+        dut.write(b"s\n")
+
+        decoder = StreamDecoder()
+        frames = []
+        deadline = time.monotonic() + TIMEOUT
+        while len(frames) < FRAMES and time.monotonic() < deadline:
+            ready, _, _ = select.select([fd], [], [], 1.0)
+            if ready:
+                frames.extend(decoder.feed(os.read(fd, 4096)))
+    finally:
+        os.close(fd)
+
+    assert decoder.errors == 0
+    assert len(frames) == FRAMES
+    for index, frame in enumerate(frames):
+        assert frame["type"] == "raw_field"
+        assert frame["new_data"]
+        assert frame["gas_meas_index"] == index & 0x0F
+        assert frame["meas_index"] == index & 0xFF
+        assert frame["adc_temp"] == index & 0xFFFFF
+        assert frame["adc_pres"] == 0
+
+    m, _ = _read_until(dut, r"stream done: sent (\d+), dropped \d+, lost (\d+)")
+    assert int(m.group(1)) == FRAMES
+    assert int(m.group(2)) == 0
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2024, Chris Duf
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Stream test on native_sim: the stream UART is a PTY,
+ * decoded on the host by scripts/bme68x_stream.py (see pytest/test_stream.py).
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "bme68x_tphg_stream.h"
+
+LOG_MODULE_REGISTER(app, CONFIG_BME68X_SAMPLE_LOG_LEVEL);
+
+#define TEST_CONSOLE DEVICE_DT_GET(DT_CHOSEN(zephyr_console))
+
+/* Raw field data registers, from 0x1d (BME68X_LEN_FIELD). */
+#define TEST_RAW_FIELD_SIZE 17U
+
+/*
+ * Fill raw field frame for the given index:
+ * sequence numbers, and 20-bit ADC values including zero bytes.
+ */
+static void test_raw_field(uint32_t index, uint8_t *buf);
+
+/*
+ * Wait for the host to open the stream PTY and write to the console.
+ */
+static void test_wait_host(void);
+
+int main(void)
+{
+	uint8_t buf[TEST_RAW_FIELD_SIZE];
+	uint32_t lost = 0;
+
+	int ret = bme68x_tphg_stream_init();
+	if (ret) {
+		return 0;
+	}
+
+	printk("stream ready\n");
+	test_wait_host();
+
+	for (uint32_t i = 0; i < CONFIG_BME68X_TPHG_STREAM_TEST_FRAMES;) {
+		test_raw_field(i, buf);
+		ret = bme68x_tphg_stream_send(BME68X_TPHG_STREAM_RAW_FIELD, buf, sizeof(buf));
+		if (ret == -ENOBUFS) {
+			/* Both buffers busy: retry the same frame, the host expects all of them. */
+			k_msleep(1);
+			continue;
+		}
+		if (ret) {
+			lost++;
+		}
+		i++;
+	}
+
+	/* Let the last buffer drain. */
+	k_msleep(500);
+
+	uint32_t sent, dropped;
+	bme68x_tphg_stream_stats(&sent, &dropped);
+	printk("stream done: sent %u, dropped %u, lost %u\n", sent, dropped, lost);
+	return 0;
+}
+
+void test_raw_field(uint32_t index, uint8_t *buf)
+{
+	uint32_t adc = index & 0xFFFFFU;
+
+	memset(buf, 0, TEST_RAW_FIELD_SIZE);
+	/* new_data, gas_meas_index. */
+	buf[0] = 0x80U | (index & 0x0FU);
+	/* meas_index. */
+	buf[1] = index & 0xFFU;
+	/* adc_temp. */
+	buf[5] = (adc >> 12) & 0xFFU;
+	buf[6] = (adc >> 4) & 0xFFU;
+	buf[7] = (adc << 4) & 0xF0U;
+}
+
+void test_wait_host(void)
+{
+	unsigned char c;
+
+	while (uart_poll_in(TEST_CONSOLE, &c) != 0) {
+		k_msleep(10);
+	}
+}